@@ -0,0 +1,543 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions inputFile source code must retain the above copyright
+ *    notice, this list inputFile conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list inputFile conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name inputFile the copyright holder nor the names inputFile
+ *    its contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \addtogroup Applications
+ * @{
+ */
+
+/**
+ * \file bench.cpp
+ * \brief Load generator measuring throughput and latency of S3 operations
+ */
+/// [S3 benchmark]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_delete.h"
+#include "lyra/lyra.hpp"
+#include "metrics_registry.h"
+#include "s3-api.h"
+#include "s3-client.h"
+#include "utility.h"
+
+using namespace std;
+using namespace sss;
+using Clock = chrono::steady_clock;
+
+namespace {
+//------------------------------------------------------------------------------
+enum Op { PUT, GET, HEAD, LIST, NUM_OPS };
+const char *OP_NAMES[NUM_OPS] = {"PUT", "GET", "HEAD", "LIST"};
+
+//------------------------------------------------------------------------------
+// Parse size with optional binary unit suffix: 512, 4KiB, 4K, 1.5MiB, 2G
+size_t ParseSize(const string &s) {
+  size_t pos = 0;
+  const double n = stod(s, &pos);
+  string unit = ToLower(s.substr(pos));
+  TrimLine(unit);
+  const char u = unit.empty() ? 'b' : unit[0];
+  const double m = u == 'k'   ? 1024.
+                   : u == 'm' ? 1024. * 1024
+                   : u == 'g' ? 1024. * 1024 * 1024
+                   : u == 'b' ? 1.
+                              : -1.;
+  if (n < 0 || m < 0)
+    throw invalid_argument("Invalid size " + s);
+  return size_t(n * m);
+}
+
+//------------------------------------------------------------------------------
+// Object size distribution: single size, log-uniform range "MIN-MAX" or
+// weighted list "SIZE:WEIGHT,SIZE:WEIGHT..."
+class SizeDistribution {
+public:
+  explicit SizeDistribution(const string &spec) {
+    if (spec.find(':') != string::npos) {
+      vector<double> weights;
+      for (auto i : SplitRange(spec, ",")) {
+        const string e(i);
+        const size_t c = e.find(':');
+        if (c == string::npos)
+          throw invalid_argument("Missing weight in " + e);
+        sizes_.push_back(ParseSize(e.substr(0, c)));
+        weights.push_back(stod(e.substr(c + 1)));
+      }
+      weighted_ = discrete_distribution<size_t>(begin(weights), end(weights));
+    } else if (spec.find('-') != string::npos) {
+      const size_t d = spec.find('-');
+      sizes_ = {ParseSize(spec.substr(0, d)), ParseSize(spec.substr(d + 1))};
+      if (sizes_[0] > sizes_[1])
+        throw invalid_argument("Invalid size range " + spec);
+      range_ = true;
+    } else {
+      sizes_ = {ParseSize(spec)};
+    }
+  }
+  size_t Max() const { return *max_element(begin(sizes_), end(sizes_)); }
+  size_t operator()(mt19937_64 &rng) {
+    if (range_) {
+      // log-uniform: as many small objects as large ones per size decade
+      const double lo = log(double(max(sizes_[0], size_t(1))));
+      const double hi = log(double(max(sizes_[1], size_t(1))));
+      return min(sizes_[1],
+                 size_t(exp(uniform_real_distribution<>(lo, hi)(rng))));
+    }
+    return sizes_.size() == 1 ? sizes_[0] : sizes_[weighted_(rng)];
+  }
+
+private:
+  vector<size_t> sizes_;
+  discrete_distribution<size_t> weighted_;
+  bool range_ = false;
+};
+
+//------------------------------------------------------------------------------
+// Parse operation mix "put:20,get:70,head:5,list:5"
+vector<double> ParseMix(const string &spec) {
+  vector<double> mix(NUM_OPS, 0.);
+  for (auto i : SplitRange(spec, ",")) {
+    const string e(i);
+    const size_t c = e.find(':');
+    const string name = ToLower(e.substr(0, c));
+    const double w = c == string::npos ? 1. : stod(e.substr(c + 1));
+    auto op = find_if(OP_NAMES, OP_NAMES + NUM_OPS, [&](const char *n) {
+      return ToLower(n) == name;
+    });
+    if (op == OP_NAMES + NUM_OPS || w < 0)
+      throw invalid_argument("Invalid operation " + e);
+    mix[op - OP_NAMES] = w;
+  }
+  if (all_of(begin(mix), end(mix), [](double w) { return w == 0; }))
+    throw invalid_argument("Empty operation mix");
+  return mix;
+}
+
+//------------------------------------------------------------------------------
+// Shared benchmark state
+struct Bench {
+  S3DataTransferConfig transfer; // credentials, endpoints and bucket
+  string prefix;
+  vector<double> mix;
+  SizeDistribution sizes{"1MiB"};
+  size_t objects = 0; // number of objects read or written by each worker
+  size_t multipartThreshold = 0;
+  vector<size_t> objectSizes; // sizes of objects read by GET and HEAD
+  vector<char> data;          // data sent by PUT requests
+  Clock::time_point deadline;
+  size_t maxOps = 0;
+  atomic<size_t> ops{0};
+  MetricsRegistry stats;
+  mutex errorMutex;
+  size_t reportedErrors = 0;
+};
+
+string ReadKey(const Bench &b, size_t i) {
+  return b.prefix + "r/" + to_string(i);
+}
+
+// Discard received data and count bytes
+size_t CountBytes(char *, size_t size, size_t nmemb, void *count) {
+  *static_cast<size_t *>(count) += size * nmemb;
+  return size * nmemb;
+}
+
+//------------------------------------------------------------------------------
+// Upload object with a single PutObject request or with a parallel
+// multipart upload if larger than threshold
+void Put(api::S3Api &s3, Bench &b, const string &key, size_t size) {
+  if (size >= b.multipartThreshold) {
+    S3DataTransferConfig cfg = b.transfer;
+    cfg.key = key;
+    cfg.data = b.data.data();
+    cfg.size = size;
+    Upload(cfg);
+  } else {
+    s3.PutObject(b.transfer.bucket, key, b.data.data(), size);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Download object discarding data or with a parallel download if larger than
+// threshold
+void Get(api::S3Api &s3, Bench &b, const string &key, size_t size,
+         vector<char> &buffer) {
+  if (size >= b.multipartThreshold) {
+    buffer.resize(size);
+    S3DataTransferConfig cfg = b.transfer;
+    cfg.key = key;
+    cfg.data = buffer.data();
+    cfg.size = size;
+    Download(cfg);
+    return;
+  }
+  size_t received = 0;
+  s3.Send({.method = "GET", .bucket = b.transfer.bucket, .key = key},
+          nullptr, nullptr, CountBytes, &received);
+  if (received != size) {
+    throw runtime_error("Received " + to_string(received) + " bytes, " +
+                        to_string(size) + " expected");
+  }
+}
+
+//------------------------------------------------------------------------------
+api::S3Api Client(const Bench &b, int id) {
+  const auto &e = b.transfer.endpoints;
+  api::S3Api s3(b.transfer.accessKey, b.transfer.secretKey, e[id % e.size()]);
+  s3.SetEndpointSelector(b.transfer.endpointSelector);
+  s3.SetMetricsRegistry(b.transfer.registry);
+  return s3;
+}
+
+//------------------------------------------------------------------------------
+void Worker(Bench &b, int id, unsigned seed) {
+  api::S3Api s3 = Client(b, id);
+  mt19937_64 rng(seed);
+  discrete_distribution<int> mix(begin(b.mix), end(b.mix));
+  SizeDistribution sizes = b.sizes;
+  vector<char> buffer;
+  size_t writes = 0;
+  while (Clock::now() < b.deadline) {
+    if (b.maxOps && b.ops++ >= b.maxOps)
+      break;
+    const Op op = Op(mix(rng));
+    const Labels labels = {{"operation", OP_NAMES[op]}};
+    const auto start = Clock::now();
+    try {
+      size_t bytes = 0;
+      if (op == PUT) {
+        // each worker overwrites its own set of keys
+        const string key = b.prefix + "w/" + to_string(id) + "/" +
+                           to_string(writes++ % b.objects);
+        bytes = sizes(rng);
+        Put(s3, b, key, bytes);
+      } else if (op == GET || op == HEAD) {
+        const size_t i = uniform_int_distribution<size_t>(
+            0, b.objectSizes.size() - 1)(rng);
+        if (op == GET) {
+          bytes = b.objectSizes[i];
+          Get(s3, b, ReadKey(b, i), bytes, buffer);
+        } else {
+          s3.HeadObject(b.transfer.bucket, ReadKey(b, i));
+        }
+      } else {
+        api::S3Api::ListObjectV2Config cfg;
+        cfg.prefix = b.prefix + "r/";
+        api::S3Api::ListObjectV2Result r;
+        s3.ListObjectsV2(b.transfer.bucket, cfg, r);
+      }
+      b.stats.Observe("latency_us", labels,
+                      chrono::duration_cast<chrono::microseconds>(
+                          Clock::now() - start));
+      b.stats.Increment("bytes", labels, bytes);
+    } catch (const exception &e) {
+      b.stats.Increment("errors", labels);
+      lock_guard<mutex> lock(b.errorMutex);
+      if (b.reportedErrors++ < 10)
+        cerr << OP_NAMES[op] << ": " << e.what() << endl;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Upload objects read by GET and HEAD operations
+void Prefill(Bench &b, int jobs, mt19937_64 &rng) {
+  b.objectSizes.resize(b.objects);
+  for (auto &s : b.objectSizes)
+    s = b.sizes(rng);
+  atomic<size_t> next{0};
+  atomic<size_t> errors{0};
+  vector<thread> workers;
+  for (int j = 0; j != jobs; ++j) {
+    workers.emplace_back([&b, &next, &errors, j] {
+      api::S3Api s3 = Client(b, j);
+      for (size_t i = next++; i < b.objects; i = next++) {
+        try {
+          Put(s3, b, ReadKey(b, i), b.objectSizes[i]);
+        } catch (const exception &e) {
+          if (!errors++)
+            cerr << "Prefill: " << e.what() << endl;
+        }
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  if (errors)
+    throw runtime_error("Cannot upload " + to_string(errors) + " objects");
+}
+
+//------------------------------------------------------------------------------
+// JSON report: throughput and latency percentiles in milliseconds per
+// operation and total
+string Report(const Bench &b, double seconds, int jobs) {
+  const double MB = 1e6;
+  ostringstream os;
+  os << "{\n  \"duration_s\": " << seconds << ",\n  \"jobs\": " << jobs
+     << ",\n  \"endpoints\": " << b.transfer.endpoints.size()
+     << ",\n  \"operations\": {";
+  uint64_t totalOps = 0, totalErrors = 0, totalBytes = 0;
+  bool first = true;
+  for (int op = 0; op != NUM_OPS; ++op) {
+    if (b.mix[op] == 0)
+      continue;
+    const Labels labels = {{"operation", OP_NAMES[op]}};
+    const auto h = b.stats.Histogram("latency_us", labels);
+    const uint64_t errors = b.stats.Counter("errors", labels);
+    const uint64_t bytes = b.stats.Counter("bytes", labels);
+    auto ms = [](uint64_t us) { return us / 1000.; };
+    os << (first ? "" : ",") << "\n    \"" << OP_NAMES[op] << "\": {"
+       << "\"ops\": " << h.count << ", \"errors\": " << errors
+       << ", \"bytes\": " << bytes
+       << ", \"ops_per_s\": " << h.count / seconds
+       << ", \"MB_per_s\": " << bytes / MB / seconds
+       << ",\n      \"latency_ms\": {\"mean\": " << h.Mean() / 1000.
+       << ", \"p50\": " << ms(h.Quantile(.5))
+       << ", \"p90\": " << ms(h.Quantile(.9))
+       << ", \"p99\": " << ms(h.Quantile(.99))
+       << ", \"p999\": " << ms(h.Quantile(.999))
+       << ", \"max\": " << ms(h.Max()) << "}}";
+    first = false;
+    totalOps += h.count;
+    totalErrors += errors;
+    totalBytes += bytes;
+  }
+  os << "\n  },\n  \"total\": {\"ops\": " << totalOps
+     << ", \"errors\": " << totalErrors << ", \"bytes\": " << totalBytes
+     << ", \"ops_per_s\": " << totalOps / seconds
+     << ", \"MB_per_s\": " << totalBytes / MB / seconds << "}\n}\n";
+  return os.str();
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+int main(int argc, char const *argv[]) {
+  try {
+    Bench bench;
+    S3DataTransferConfig &config = bench.transfer;
+    bool showHelp = false;
+    bool cleanup = false;
+    string credentialsFile;
+    string awsProfile;
+    string endpoint;
+    string endpointsFile;
+    string mix = "put:20,get:70,head:5,list:5";
+    string sizes = "1MiB";
+    string outFile;
+    string prometheusFile;
+    int jobs = 16;
+    double duration = 30;
+    size_t threshold = 64;
+    unsigned seed = 1;
+    bench.prefix = "s3-bench/";
+    bench.objects = 64;
+    config.jobs = 4;
+    auto cli =
+        lyra::help(showHelp).description(
+            "Run mixed workload against S3 service and report throughput "
+            "and latency percentiles in JSON format") |
+        lyra::opt(config.accessKey,
+                  "awsAccessKey")["-a"]["--access_key"]("AWS access key")
+            .optional() |
+        lyra::opt(config.secretKey,
+                  "awsSecretKey")["-s"]["--secret_key"]("AWS secret key")
+            .optional() |
+        lyra::opt(endpoint, "endpoint")["-e"]["--endpoint"]("Endpoint URL")
+            .optional() |
+        lyra::opt(endpointsFile, "endpointsFile")["-E"]["--endpoints-file"](
+            "File with list of endpoints, requests are balanced among "
+            "endpoints")
+            .optional() |
+        lyra::opt(credentialsFile, "credentials file")["-c"]["--credentials"](
+            "Credentials file, AWS cli format")
+            .optional() |
+        lyra::opt(awsProfile, "AWS config profile")["-p"]["--profile"](
+            "Profile in AWS config file")
+            .optional() |
+        lyra::opt(config.bucket, "bucket")["-b"]["--bucket"]("Bucket name")
+            .required() |
+        lyra::opt(bench.prefix, "prefix")["-x"]["--prefix"](
+            "Prefix of keys created by benchmark, default is 's3-bench/'")
+            .optional() |
+        lyra::opt(mix, "mix")["-w"]["--workload"](
+            "Operation weights, default is 'put:20,get:70,head:5,list:5'")
+            .optional() |
+        lyra::opt(sizes, "sizes")["-z"]["--sizes"](
+            "Object sizes: single size e.g. '1MiB', log-uniform range e.g. "
+            "'4KiB-16MiB' or weighted list e.g. '4KiB:50,1MiB:40,64MiB:10'; "
+            "default is 1MiB")
+            .optional() |
+        lyra::opt(bench.objects, "objects")["-k"]["--objects"](
+            "Number of objects read by GET and HEAD and written by each job, "
+            "default is 64")
+            .optional() |
+        lyra::opt(jobs, "jobs")["-j"]["--jobs"](
+            "Number of concurrent requests, default is 16")
+            .optional() |
+        lyra::opt(duration, "seconds")["-d"]["--duration"](
+            "Duration in seconds, default is 30; zero for no time limit")
+            .optional() |
+        lyra::opt(bench.maxOps, "operations")["-n"]["--ops"](
+            "Maximum number of operations, default is unlimited")
+            .optional() |
+        lyra::opt(threshold, "MiB")["-t"]["--multipart-threshold"](
+            "Objects larger than threshold are sent and received with "
+            "parallel multipart transfers, default is 64 MiB")
+            .optional() |
+        lyra::opt(config.jobs, "part jobs")["-J"]["--part-jobs"](
+            "Number of parallel jobs of each multipart transfer, default is 4")
+            .optional() |
+        lyra::opt(seed, "seed")["-S"]["--seed"]("Random seed, default is 1")
+            .optional() |
+        lyra::opt(outFile, "file")["-o"]["--output"](
+            "JSON report file, default is standard output")
+            .optional() |
+        lyra::opt(prometheusFile, "file")["-M"]["--metrics"](
+            "Write per-request library metrics in Prometheus format to file")
+            .optional() |
+        lyra::opt(cleanup)["-C"]["--cleanup"](
+            "Delete all objects under prefix when done")
+            .optional();
+
+    // Parse the program arguments:
+    auto result = cli.parse({argc, argv});
+    if (!result) {
+      cerr << result.message() << endl;
+      cerr << cli << endl;
+      exit(EXIT_FAILURE);
+    }
+    if (showHelp) {
+      cout << cli;
+      exit(EXIT_SUCCESS);
+    }
+    if (endpoint.empty() && endpointsFile.empty()) {
+      cerr << "Specify either an endpoint URL or a file name containing a list "
+              "of URLs, one per line"
+           << endl;
+      exit(EXIT_FAILURE);
+    }
+    if (!endpoint.empty()) {
+      config.endpoints.push_back(endpoint);
+    } else {
+      ifstream is(endpointsFile);
+      if (!is) {
+        cerr << "Cannot read from " << endpointsFile << endl;
+        exit(EXIT_FAILURE);
+      }
+      string line;
+      while (getline(is, line)) {
+        TrimLine(line);
+        if (line.empty() || line[0] == '#')
+          continue;
+        config.endpoints.push_back(line);
+      }
+    }
+    if (config.accessKey.empty() || config.secretKey.empty()) {
+      if (credentialsFile.empty()) {
+        credentialsFile = GetHomeDir() + "/.aws/credentials";
+      }
+      auto c = GetS3Credentials(credentialsFile, awsProfile);
+      config.accessKey = c.accessKey;
+      config.secretKey = c.secretKey;
+    }
+    if (config.endpoints.size() > 1) {
+      config.endpointSelector = make_shared<EndpointSelector>(config.endpoints);
+    }
+    if (jobs < 1 || bench.objects == 0) {
+      throw invalid_argument("Number of jobs and objects must be positive");
+    }
+    bench.mix = ParseMix(mix);
+    bench.sizes = SizeDistribution(sizes);
+    bench.multipartThreshold = threshold * 1024 * 1024;
+    if (!bench.prefix.empty() && bench.prefix.back() != '/')
+      bench.prefix += '/';
+    // random data, uploaded by PUT requests
+    mt19937_64 rng(seed);
+    bench.data.resize(max(bench.sizes.Max(), size_t(1)));
+    generate(begin(bench.data), end(bench.data),
+             [&rng] { return char(rng()); });
+    if (bench.mix[GET] > 0 || bench.mix[HEAD] > 0) {
+      cerr << "Uploading " << bench.objects << " objects..." << endl;
+      config.registry = nullptr;
+      Prefill(bench, jobs, rng);
+    }
+    // library metrics of benchmark requests only
+    MetricsRegistry requestMetrics;
+    config.registry = &requestMetrics;
+    cerr << "Running..." << endl;
+    const auto start = Clock::now();
+    bench.deadline = duration > 0
+                         ? start + chrono::duration_cast<Clock::duration>(
+                                       chrono::duration<double>(duration))
+                         : Clock::time_point::max();
+    vector<thread> workers;
+    for (int j = 0; j != jobs; ++j) {
+      workers.emplace_back(Worker, ref(bench), j, unsigned(seed + j + 1));
+    }
+    for (auto &w : workers)
+      w.join();
+    const double seconds =
+        chrono::duration<double>(Clock::now() - start).count();
+    const string report = Report(bench, seconds, jobs);
+    if (outFile.empty()) {
+      cout << report;
+    } else {
+      ofstream(outFile) << report;
+    }
+    if (!prometheusFile.empty()) {
+      ofstream(prometheusFile) << requestMetrics.Prometheus();
+    }
+    if (cleanup) {
+      const auto r = api::DeletePrefix(Client(bench, 0), config.bucket,
+                                       bench.prefix);
+      cerr << r.deleted << " objects deleted" << endl;
+    }
+    return 0;
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
+/// [S3 benchmark]
+/**
+ * @}
+ */
@@ -55,11 +55,15 @@ int main(int argc, char const *argv[]) {
   try {
     S3DataTransferConfig config;
     bool showHelp = false;
+    bool printMetrics = false;
+    bool printProgress = false;
+    string traceFile;
     string endpoint;
     string endpointsFile;
     string credentialsFile;
     string awsProfile;
     bool overwrite = false;
+    double maxBandwidth = 0;
     auto cli =
         lyra::help(showHelp).description("Download file from S3 bucket") |
         lyra::opt(config.accessKey,
@@ -95,6 +99,23 @@ int main(int argc, char const *argv[]) {
             .optional() |
         lyra::opt(overwrite)["-y"]["--overwrite"](
             "Overwrite exsisting file, default is 'false'")
+            .optional() |
+        lyra::opt(maxBandwidth, "MiB/s")["-B"]["--max-bandwidth"](
+            "Maximum aggregate bandwidth in MiB/s, default is unlimited")
+            .optional() |
+        lyra::opt(config.hedgeRequests)["-H"]["--hedge"](
+            "Request slow parts again and keep first response received")
+            .optional() |
+        lyra::opt(printMetrics)["-M"]["--metrics"](
+            "Print timing breakdown of all requests to standard error")
+            .optional() |
+        lyra::opt(printProgress)["-P"]["--progress"](
+            "Print progress line to standard error")
+            .optional() |
+        lyra::opt(traceFile, "file")["-T"]["--trace"](
+            "Write a span per transfer, part and request to file, in Chrome "
+            "trace event format if the extension is .json, JSON lines "
+            "otherwise")
             .optional();
     if (showHelp) {
       cout << cli;
@@ -143,7 +164,27 @@ int main(int argc, char const *argv[]) {
       config.accessKey = c.accessKey;
       config.secretKey = c.secretKey;
     }
+    if (maxBandwidth > 0) {
+      config.bandwidthShaper =
+          make_shared<TokenBucket>(maxBandwidth * 1024 * 1024);
+    }
+    RequestMetrics metrics;
+    if (printMetrics)
+      config.metrics = &metrics;
+    if (printProgress) {
+      config.progress =
+          make_shared<TransferProgress>([](const ProgressInfo &p) {
+            cerr << '\r' << p << "\33[K" << (p.finished ? "\n" : "")
+                 << flush;
+          });
+    }
+    if (!traceFile.empty()) {
+      config.tracer = make_shared<Tracer>(
+          traceFile, Tracer::FormatFromFileName(traceFile));
+    }
     Download(config);
+    if (printMetrics)
+      cerr << metrics << endl;
     return 0;
   } catch (const exception &e) {
     cerr << e.what() << endl;
@@ -40,12 +40,15 @@
  * \brief Parallel upload to S3 service
  */
 /// [Parallel upload to to S3 object]
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
 
+#include "endpoint_selector.h"
 #include "lyra/lyra.hpp"
 #include "s3-client.h"
+#include "sync.h"
 #include "url_utility.h"
 #include "utility.h"
 
@@ -56,13 +59,19 @@ int main(int argc, char const *argv[]) {
   try {
     S3DataTransferConfig config;
     bool showHelp = false;
+    bool printMetrics = false;
+    bool printProgress = false;
+    string traceFile;
     string credentialsFile;
     string awsProfile;
     string endpoint;
     string endpointsFile;
     string metaData;
+    double maxBandwidth = 0;
+    size_t threshold = 64;
     auto cli =
-        lyra::help(showHelp).description("Upload file to S3 bucket") |
+        lyra::help(showHelp).description(
+            "Upload file or directory to S3 bucket") |
         lyra::opt(config.accessKey,
                   "awsAccessKey")["-a"]["--access_key"]("AWS access key")
             .optional() |
@@ -77,7 +86,26 @@ int main(int argc, char const *argv[]) {
         lyra::opt(config.bucket, "bucket")["-b"]["--bucket"]("Bucket name")
             .required() |
         lyra::opt(config.key, "key")["-k"]["--key"]("Key name").required() |
-        lyra::opt(config.file, "file")["-f"]["--file"]("File name").optional() |
+        lyra::opt(config.file, "file")["-f"]["--file"](
+            "File name; if directory, upload all files under directory "
+            "using key as prefix")
+            .optional() |
+        lyra::opt(threshold, "MiB")["-t"]["--multipart-threshold"](
+            "Directory mode: files larger than threshold are uploaded with "
+            "parallel multipart uploads, smaller files with single requests "
+            "sent by parallel jobs, default is 64 MiB")
+            .optional() |
+        lyra::opt(printMetrics)["-M"]["--metrics"](
+            "Print timing breakdown of all requests to standard error")
+            .optional() |
+        lyra::opt(printProgress)["-P"]["--progress"](
+            "Print progress line to standard error, single file only")
+            .optional() |
+        lyra::opt(traceFile, "file")["-T"]["--trace"](
+            "Write a span per transfer, part and request to file, in Chrome "
+            "trace event format if the extension is .json, JSON lines "
+            "otherwise; single file only")
+            .optional() |
         lyra::opt(config.jobs, "parallel jobs")["-j"]["--jobs"](
             "Number of parallel upload jobs")
             .optional() |
@@ -97,6 +125,9 @@ int main(int argc, char const *argv[]) {
         lyra::opt(metaData, "metaData")["-m"]["--meta"](
             "Metadata list formatted as headers: "
             "meta_key1:meta_value1;meta_key2:meta_value2")
+            .optional() |
+        lyra::opt(maxBandwidth, "MiB/s")["-B"]["--max-bandwidth"](
+            "Maximum aggregate bandwidth in MiB/s, default is unlimited")
             .optional();
 
     // Parse the program arguments:
@@ -142,6 +173,10 @@ int main(int argc, char const *argv[]) {
       config.secretKey = c.secretKey;
     }
 
+    if (maxBandwidth > 0) {
+      config.bandwidthShaper =
+          make_shared<TokenBucket>(maxBandwidth * 1024 * 1024);
+    }
     MetaDataMap mm;
     if (!metaData.empty()) {
       for (auto i : SplitRange(metaData, ";")) {
@@ -158,7 +193,51 @@ int main(int argc, char const *argv[]) {
         mm["x-amz-meta-" + ToLower(k)] = v;
       }
     }
+    RequestMetrics metrics;
+    if (printMetrics)
+      config.metrics = &metrics;
+    if (printProgress) {
+      config.progress =
+          make_shared<TransferProgress>([](const ProgressInfo &p) {
+            cerr << '\r' << p << "\33[K" << (p.finished ? "\n" : "")
+                 << flush;
+          });
+    }
+    if (std::filesystem::is_directory(config.file)) {
+      api::S3Api s3(config.accessKey, config.secretKey,
+                    config.endpoints.front());
+      if (config.endpoints.size() > 1) {
+        s3.SetEndpointSelector(
+            make_shared<EndpointSelector>(config.endpoints));
+      }
+      api::SyncConfig sc;
+      sc.jobs = config.jobs;
+      sc.maxRetries = config.maxRetries;
+      sc.multipartThreshold = threshold * 1024 * 1024;
+      sc.metaData = mm;
+      sc.bandwidthShaper = config.bandwidthShaper;
+      sc.metrics = config.metrics;
+      string prefix = config.key;
+      if (!prefix.empty() && prefix.back() != '/')
+        prefix += '/';
+      const auto r =
+          UploadDirectory(s3, config.file, config.bucket, prefix, sc);
+      cout << r.transferred << " files uploaded (" << r.plan.bytes
+           << " bytes)" << endl;
+      for (const auto &e : r.errors) {
+        cerr << e.first << ": " << e.second << endl;
+      }
+      if (printMetrics)
+        cerr << metrics << endl;
+      return r.errors.empty() ? 0 : 1;
+    }
+    if (!traceFile.empty()) {
+      config.tracer = make_shared<Tracer>(
+          traceFile, Tracer::FormatFromFileName(traceFile));
+    }
     cout << Upload(config, mm);
+    if (printMetrics)
+      cerr << endl << metrics << endl;
     return 0;
   } catch (const exception &e) {
     cerr << e.what() << endl;
@@ -0,0 +1,205 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions inputFile source code must retain the above copyright
+ *    notice, this list inputFile conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list inputFile conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name inputFile the copyright holder nor the names inputFile
+ *    its contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \addtogroup Applications
+ * \brief Command line tools to interact with an S3 service.
+ * @{
+ */
+/**
+ * \file sync.cpp
+ * \brief Synchronize local directory or S3 prefix with S3 prefix
+ */
+/// [Synchronize directory or prefix with S3 prefix]
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "endpoint_selector.h"
+#include "lyra/lyra.hpp"
+#include "s3-client.h"
+#include "sync.h"
+#include "url_utility.h"
+#include "utility.h"
+
+using namespace std;
+using namespace sss;
+using namespace sss::api;
+//------------------------------------------------------------------------------
+int main(int argc, char const *argv[]) {
+  try {
+    SyncConfig config;
+    bool showHelp = false;
+    string accessKey;
+    string secretKey;
+    string credentialsFile;
+    string awsProfile;
+    string endpoint;
+    string endpointsFile;
+    string source;
+    string bucket;
+    string prefix;
+    auto cli =
+        lyra::help(showHelp).description(
+            "Synchronize local directory or S3 prefix with S3 prefix, "
+            "transferring only new and modified files") |
+        lyra::opt(accessKey,
+                  "awsAccessKey")["-a"]["--access_key"]("AWS access key")
+            .optional() |
+        lyra::opt(secretKey,
+                  "awsSecretKey")["-s"]["--secret_key"]("AWS secret key")
+            .optional() |
+        lyra::opt(endpoint, "endpoint")["-e"]["--endpoint"]("Endpoint URL")
+            .optional() |
+        lyra::opt(endpointsFile, "endpointsFile")["-E"]["--endpoints-file"](
+            "File with list of endpoints")
+            .optional() |
+        lyra::opt(source, "source")["-f"]["--from"](
+            "Source directory or s3://bucket/prefix")
+            .required() |
+        lyra::opt(bucket, "bucket")["-b"]["--bucket"](
+            "Destination bucket name")
+            .required() |
+        lyra::opt(prefix, "prefix")["-k"]["--prefix"](
+            "Destination folder, '/' is appended if missing")
+            .optional() |
+        lyra::opt(config.jobs, "parallel jobs")["-j"]["--jobs"](
+            "Number of concurrent transfers")
+            .optional() |
+        lyra::opt(config.partJobs, "part jobs")["-J"]["--part-jobs"](
+            "Number of parallel part transfers for each large object")
+            .optional() |
+        lyra::opt(config.deleteExtraneous)["-d"]["--delete"](
+            "Delete destination objects not found in source")
+            .optional() |
+        lyra::opt(config.sizeOnly)["-S"]["--size-only"](
+            "Compare sizes only")
+            .optional() |
+        lyra::opt(config.checksum)["-m"]["--checksum"](
+            "Compare MD5 digest of local files with ETags")
+            .optional() |
+        lyra::opt(config.dryRun)["-n"]["--dry-run"](
+            "Print actions without transferring or deleting data")
+            .optional() |
+        lyra::opt(credentialsFile, "credentials file")["-c"]["--credentials"](
+            "Credentials file, AWS cli format")
+            .optional() |
+        lyra::opt(awsProfile, "AWS config profile")["-p"]["--profile"](
+            "Profile in AWS config file")
+            .optional() |
+        lyra::opt(config.maxRetries,
+                  "Max retries")["-r"]["--retries"]("Max number of retries")
+            .optional();
+
+    // Parse the program arguments:
+    auto result = cli.parse({argc, argv});
+    if (!result) {
+      cerr << result.message() << endl;
+      cerr << cli << endl;
+      exit(EXIT_FAILURE);
+    }
+    if (showHelp) {
+      cout << cli;
+      exit(EXIT_SUCCESS);
+    }
+    vector<string> endpoints;
+    if (endpoint.empty() && endpointsFile.empty()) {
+      cerr << "Specify either an endpoint URL or a file name containing a list "
+              "of URLs, one per line"
+           << endl;
+      exit(EXIT_FAILURE);
+    }
+    if (!endpoint.empty()) {
+      endpoints.push_back(endpoint);
+    } else {
+      ifstream is(endpointsFile);
+      if (!is) {
+        cerr << "Cannot read from " << endpointsFile << endl;
+        exit(EXIT_FAILURE);
+      }
+      string line;
+      while (getline(is, line)) {
+        TrimLine(line);
+        if (line.empty() || line[0] == '#')
+          continue;
+        endpoints.push_back(line);
+      }
+    }
+    if (accessKey.empty() || secretKey.empty()) {
+      if (credentialsFile.empty()) {
+        credentialsFile = GetHomeDir() + "/.aws/credentials";
+      }
+      auto c = GetS3Credentials(credentialsFile, awsProfile);
+      accessKey = c.accessKey;
+      secretKey = c.secretKey;
+    }
+    S3Api s3(accessKey, secretKey, endpoints.front());
+    if (endpoints.size() > 1) {
+      s3.SetEndpointSelector(make_shared<EndpointSelector>(endpoints));
+    }
+    const string S3_SCHEME = "s3://";
+    SyncResult r;
+    if (source.substr(0, S3_SCHEME.size()) == S3_SCHEME) {
+      const string path = source.substr(S3_SCHEME.size());
+      const size_t slash = path.find('/');
+      const string srcBucket = path.substr(0, slash);
+      const string srcPrefix =
+          slash == string::npos ? string() : path.substr(slash + 1);
+      r = SyncPrefix(s3, srcBucket, srcPrefix, bucket, prefix, config);
+    } else {
+      r = SyncDirectory(s3, source, bucket, prefix, config);
+    }
+    if (config.dryRun) {
+      for (const auto &t : r.plan.transfers) {
+        cout << "transfer " << t.key << " " << t.size << endl;
+      }
+      for (const auto &k : r.plan.deletes) {
+        cout << "delete " << k << endl;
+      }
+    }
+    cout << "transferred: " << r.transferred << '/'
+         << r.plan.transfers.size() << " (" << r.plan.bytes << " bytes)"
+         << ", deleted: " << r.deleted << '/' << r.plan.deletes.size()
+         << ", unchanged: " << r.plan.unchanged << endl;
+    for (const auto &e : r.errors) {
+      cerr << e.first << ": " << e.second << endl;
+    }
+    return r.errors.empty() ? 0 : 1;
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
+/// [Synchronize directory or prefix with S3 prefix]
+/**
+ * @}
+ */
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file batch_delete.h
+ * \brief Recursive deletion of objects with batched parallel requests.
+ */
+#pragma once
+
+#include "s3-api.h"
+
+#include <string>
+#include <vector>
+
+namespace sss {
+namespace api {
+
+/// \brief DeletePrefix configuration
+struct DeletePrefixConfig {
+  int jobs = 8;        ///< number of concurrent \c DeleteObjects requests
+  int maxRetries = 3;  ///< retries of each failed \c DeleteObjects request
+  size_t batchSize = S3Api::MAX_DELETE_OBJECTS; ///< objects per request
+  Headers headers = {{}}; ///< optional http headers sent with each request
+};
+
+/// \brief DeletePrefix result
+struct DeletePrefixResult {
+  size_t deleted = 0;              ///< number of deleted objects
+  std::vector<DeleteError> errors; ///< objects which could not be deleted
+};
+
+/**
+ * \brief Delete all objects whose key starts with prefix.
+ *
+ * Objects are listed page by page and deleted in batches of \c batchSize
+ * keys through quiet \c DeleteObjects requests sent by \c jobs workers while
+ * the following pages are being listed.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] bucket bucket name
+ * \param[in] prefix key prefix, an empty prefix deletes all the objects in
+ * the bucket
+ * \param[in] cfg configuration
+ * \return number of deleted objects and objects which could not be deleted
+ * \throw first exception thrown by listing or delete requests after all
+ * retries failed
+ */
+DeletePrefixResult DeletePrefix(const S3Api &s3, const std::string &bucket,
+                                const std::string &prefix,
+                                const DeletePrefixConfig &cfg = {});
+} // namespace api
+} // namespace sss
@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file bucket_index.h
+ * \brief Persistent memory mapped index of bucket objects.
+ */
+#pragma once
+
+#include "list_objects.h"
+#include "object_inventory.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sss {
+namespace api {
+/**
+ * \brief Read only, memory mapped snapshot of the objects under a bucket
+ * prefix.
+ *
+ * The index file stores keys sorted in binary order together with sizes,
+ * modification times and MD5 ETags; lookups are binary searches on the
+ * mapped file and prefix sizes are computed from cumulative sizes, so that
+ * queries do not depend on the number of objects under the prefix.
+ *
+ * Files are written in native byte order and are not portable across
+ * platforms with different endianness.
+ *
+ * \code{.cpp}
+ * BuildBucketIndex(s3, "bucket", "logs/", "logs.idx");
+ * BucketIndex idx("logs.idx");
+ * if (idx.Contains("logs/2023/01/01.gz")) {
+ *   cout << idx.TotalSize("logs/2023/") << endl;
+ * }
+ * \endcode
+ */
+class BucketIndex {
+public:
+  /// Returned by Find() when key is not found
+  static constexpr size_t npos = size_t(-1);
+  /// \brief Open and map index file.
+  /// \param[in] path index file path
+  /// \throw std::runtime_error if the file cannot be mapped or is not a valid
+  /// index
+  explicit BucketIndex(const std::string &path);
+  BucketIndex(const BucketIndex &) = delete;
+  BucketIndex &operator=(const BucketIndex &) = delete;
+  ~BucketIndex();
+  /// \return number of objects
+  size_t Size() const { return count_; }
+  /// \return bucket name
+  const std::string &Bucket() const { return bucket_; }
+  /// \return prefix of indexed objects
+  const std::string &Prefix() const { return prefix_; }
+  /// \return index creation time in milliseconds since epoch
+  int64_t Created() const;
+  /// \return key of i-th object
+  std::string_view Key(size_t i) const {
+    return std::string_view(keys_ + keyOffsets_[i],
+                            keyOffsets_[i + 1] - keyOffsets_[i]);
+  }
+  /// \return size of i-th object
+  uint64_t ObjectSize(size_t i) const {
+    return cumulativeSizes_[i + 1] - cumulativeSizes_[i];
+  }
+  /// \return modification time of i-th object in milliseconds since epoch
+  int64_t LastModified(size_t i) const { return lastModified_[i]; }
+  /// \return ETag of i-th object without quotes, empty if ETag was not in MD5
+  /// format
+  std::string ETag(size_t i) const;
+  /// \return MD5 bytes of ETag of i-th object
+  const std::array<uint8_t, 16> &ETagMD5(size_t i) const { return md5_[i]; }
+  /// \return number of parts of multipart ETag of i-th object
+  /// \see ObjectInventory::ETagParts
+  uint32_t ETagParts(size_t i) const { return parts_[i]; }
+  /// \return index of object or \c npos if not found
+  size_t Find(std::string_view key) const;
+  /// \return \c true if object exists
+  bool Contains(std::string_view key) const { return Find(key) != npos; }
+  /// \return {first, last} indices of objects whose key starts with prefix,
+  /// \c last excluded
+  std::pair<size_t, size_t> PrefixRange(std::string_view prefix) const;
+  /// \return number of objects whose key starts with prefix
+  size_t Count(std::string_view prefix) const;
+  /// \return total size of objects whose key starts with prefix
+  uint64_t TotalSize(std::string_view prefix) const;
+  /// \brief Write index file.
+  ///
+  /// Data is written to a uniquely named temporary file in the same
+  /// directory which, once synced to disk, replaces \c path; instances
+  /// mapping the previous file are not affected.
+  ///
+  /// \param[in] path index file path
+  /// \param[in] bucket bucket name
+  /// \param[in] prefix prefix of indexed objects
+  /// \param[in] inventory objects sorted by key
+  /// \throw std::logic_error if inventory is not sorted
+  /// \throw std::runtime_error in case of I/O error
+  static void Write(const std::string &path, const std::string &bucket,
+                    const std::string &prefix,
+                    const ObjectInventory &inventory);
+
+private:
+  size_t LowerBound(std::string_view key) const;
+
+private:
+  void *data_ = nullptr;
+  size_t size_ = 0;
+  std::string bucket_;
+  std::string prefix_;
+  size_t count_ = 0;
+  const uint64_t *keyOffsets_ = nullptr;
+  const uint64_t *cumulativeSizes_ = nullptr;
+  const int64_t *lastModified_ = nullptr;
+  const uint32_t *parts_ = nullptr;
+  const std::array<uint8_t, 16> *md5_ = nullptr;
+  const char *keys_ = nullptr;
+};
+
+/// \brief Incremental refresh configuration.
+struct BucketIndexRefreshConfig {
+  /// if \c true new keys following the last indexed key of each unchanged
+  /// common prefix are listed with \c start-after, otherwise unchanged
+  /// prefixes are copied from the previous index without sending requests;
+  /// in both cases keys deleted, overwritten or added before the last
+  /// indexed key of unchanged prefixes are missed
+  bool appendOnly = true;
+  /// prefixes known to have changed, listed again entirely
+  std::vector<std::string> relist;
+  /// configuration of listings, \c prefix is ignored
+  ParallelListConfig list;
+};
+
+/// \brief List objects under prefix and write index file.
+/// \param[in] s3 S3Api instance used to copy credentials and endpoints from
+/// \param[in] bucket bucket name
+/// \param[in] prefix prefix of objects to index
+/// \param[in] path index file path
+/// \param[in] cfg listing configuration, \c prefix is ignored
+/// \return number of indexed objects
+size_t BuildBucketIndex(const S3Api &s3, const std::string &bucket,
+                        const std::string &prefix, const std::string &path,
+                        ParallelListConfig cfg = {});
+
+/**
+ * \brief Refresh index file listing only the parts of the key space which
+ * changed.
+ *
+ * The common prefixes under the index prefix are listed up to the delimiter
+ * and compared with the ones in the index:
+ *   - new prefixes and prefixes in \c relist are listed entirely
+ *   - prefixes not present anymore are removed
+ *   - entries of the other prefixes are copied from the previous index; with
+ *     \c appendOnly keys greater than the last indexed one are added
+ *
+ * Keys directly under the index prefix are always listed again. Deleted and
+ * overwritten keys of unchanged prefixes are not detected and remain in the
+ * index with their previous size, time and ETag: pass the prefixes in
+ * \c relist or rebuild the index.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] path index file path
+ * \param[in] cfg refresh configuration
+ * \return number of indexed objects
+ */
+size_t RefreshBucketIndex(const S3Api &s3, const std::string &path,
+                          const BucketIndexRefreshConfig &cfg = {});
+} // namespace api
+} // namespace sss
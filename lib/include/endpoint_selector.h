@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file endpoint_selector.h
+ * \brief Client-side load balancing across multiple endpoints.
+ */
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sss {
+/**
+ * \addtogroup LoadBalancing
+ * \brief Client-side load balancing.
+ * @{
+ */
+
+/// \brief EndpointSelector configuration.
+struct EndpointSelectorConfig {
+  /// weight of last sample in exponentially weighted moving average of
+  /// latency
+  double ewmaAlpha = 0.3;
+  /// number of consecutive failures causing endpoint ejection
+  int maxConsecutiveFailures = 3;
+  /// ejection time, doubled at each consecutive ejection
+  std::chrono::milliseconds ejectionTime{10000};
+  /// maximum ejection time
+  std::chrono::milliseconds maxEjectionTime{300000};
+};
+
+/**
+ * \brief Select endpoint for next request using the \e power \e of \e two
+ * \e choices algorithm.
+ *
+ * Two endpoints are picked at random among the healthy ones and the one with
+ * the lowest <tt>EWMA latency x (outstanding requests + 1)</tt> score is
+ * selected. Latency is measured as time to first byte; endpoints without
+ * latency samples are scored with the average latency of the other
+ * endpoints, so that their outstanding requests are accounted for.
+ *
+ * Endpoints failing \c maxConsecutiveFailures times in a row (transport errors
+ * or 5xx and 429 responses) are ejected; after the ejection time expires the
+ * endpoint is re-probed with a single request: on success the endpoint is
+ * marked as healthy again, on failure it is ejected for twice the time.
+ * If all endpoints are ejected the one whose ejection expires first is
+ * returned.
+ *
+ * Instances are thread safe and can be shared among multiple S3Api objects
+ * and parallel transfers.
+ */
+class EndpointSelector {
+public:
+  using Clock = std::chrono::steady_clock;
+  /// \brief Endpoint state
+  struct EndpointStats {
+    std::string endpoint;   ///< endpoint URL
+    int outstanding = 0;    ///< number of requests in flight
+    double latency = 0;     ///< EWMA of time to first byte in seconds
+    int failures = 0;       ///< consecutive failures
+    int ejections = 0;      ///< consecutive ejections
+    Clock::time_point ejectedUntil; ///< end of ejection period
+    size_t requests = 0;            ///< total number of requests
+    size_t errors = 0;              ///< total number of failed requests
+  };
+
+public:
+  /// Constructor
+  /// \param[in] endpoints list of endpoint URLs
+  /// \param[in] cfg configuration
+  /// \throws std::invalid_argument if list of endpoints is empty
+  EndpointSelector(const std::vector<std::string> &endpoints,
+                   const EndpointSelectorConfig &cfg = {});
+  /// \param[in] exclude endpoint not to select unless it is the only one
+  /// available, e.g. the endpoint of a request being hedged
+  /// \return endpoint to send next request to
+  std::string Select(const std::string &exclude = "");
+  /// Notify start of request.
+  /// \param[in] endpoint endpoint the request is sent to
+  void Begin(const std::string &endpoint);
+  /// Notify end of request started with EndpointSelector::Begin.
+  /// \param[in] endpoint endpoint the request was sent to
+  /// \param[in] success \c false if request failed because of transport error
+  /// or endpoint overload (5xx, 429)
+  /// \param[in] latency time to first byte
+  void Report(const std::string &endpoint, bool success,
+              Clock::duration latency);
+  /// Notify end of request started with EndpointSelector::Begin and aborted
+  /// by the client: no latency sample nor failure is recorded.
+  /// \param[in] endpoint endpoint the request was sent to
+  void Cancel(const std::string &endpoint);
+  /// \return copy of endpoint state
+  std::vector<EndpointStats> Stats() const;
+
+private:
+  bool Available(const EndpointStats &e, Clock::time_point now) const;
+  EndpointStats *Find(const std::string &endpoint);
+
+private:
+  mutable std::mutex mutex_;
+  EndpointSelectorConfig config_;
+  std::vector<EndpointStats> endpoints_;
+};
+/**
+ * @}
+ */
+} // namespace sss
@@ -32,6 +32,7 @@
  ******************************************************************************/
 #pragma once
 #include "webclient.h"
+#include <stdexcept>
 #include <string>
 namespace sss {
 /**
@@ -40,9 +41,50 @@ namespace sss {
  * @{
  */
 
+/// \brief Error returned by server: HTTP status >= 400.
+class HTTPError : public std::logic_error {
+public:
+  /// Constructor
+  /// \param[in] msg error message
+  /// \param[in] status HTTP status code
+  /// \param[in] code S3 error code e.g. \c "SlowDown"
+  /// \param[in] retryAfter value of \c Retry-After header in seconds,
+  /// negative if not present
+  HTTPError(const std::string &msg, long status, const std::string &code,
+            int retryAfter = -1)
+      : std::logic_error(msg), status_(status), code_(code),
+        retryAfter_(retryAfter) {}
+  /// \return HTTP status code
+  long Status() const { return status_; }
+  /// \return S3 error code
+  const std::string &Code() const { return code_; }
+  /// \return \c Retry-After value in seconds, negative if not present
+  int RetryAfter() const { return retryAfter_; }
+
+private:
+  long status_;
+  std::string code_;
+  int retryAfter_;
+};
+
+/// \brief Error sending request or receiving response e.g. connection reset.
+class TransportError : public std::runtime_error {
+public:
+  /// Constructor
+  /// \param[in] msg error message
+  /// \param[in] code \c libcurl error code
+  TransportError(const std::string &msg, CURLcode code = CURLE_OK)
+      : std::runtime_error(msg), code_(code) {}
+  /// \return \c libcurl error code
+  CURLcode Code() const { return code_; }
+
+private:
+  CURLcode code_;
+};
+
 /// \brief handle errors when sending request receiving an \c 400 response
-/// \throws std::runtime_error if request not sent
-/// \throws std::logic_error if return code >= 400
+/// \throws TransportError if request not sent
+/// \throws HTTPError if return code >= 400
 /// \param wc reference to WebClient instance
 /// \param prefix string to pre-pend to error message
 void HandleError(const WebClient &wc, const std::string &prefix = "");
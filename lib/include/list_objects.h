@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file list_objects.h
+ * \brief Lazy iteration over all objects in a bucket.
+ */
+#pragma once
+
+#include "object_inventory.h"
+#include "s3-api.h"
+
+#include <functional>
+#include <future>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace sss {
+namespace api {
+/**
+ * \brief Input range over all the objects returned by paginated
+ * \c ListObjectsV2 requests.
+ *
+ * Pages are requested lazily following continuation tokens; when prefetching
+ * is enabled the next page is requested in the background while the current
+ * one is being consumed. Requests are sent through an internal S3Api instance
+ * with the same credentials, endpoint and endpoint selector of the one passed
+ * to the constructor, which can therefore be used while iterating.
+ *
+ * Errors are reported by throwing from \c begin() and \c operator++.
+ *
+ * \code{.cpp}
+ * S3Api::ListObjectV2Config cfg;
+ * cfg.prefix = "logs/";
+ * cfg.delimiter = "/";
+ * ListObjectsV2Range objects(s3, "bucket", cfg);
+ * for (const auto &o : objects) {
+ *   cout << o.key << '\t' << o.size << endl;
+ * }
+ * for (const auto &p : objects.CommonPrefixes()) {
+ *   cout << p << endl;
+ * }
+ * \endcode
+ */
+class ListObjectsV2Range {
+public:
+  /// \brief Input iterator over ObjectInfo records.
+  class Iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ObjectInfo;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ObjectInfo *;
+    using reference = const ObjectInfo &;
+    Iterator(ListObjectsV2Range *range = nullptr) : range_(range) {}
+    reference operator*() const { return range_->page_.keys[range_->pos_]; }
+    pointer operator->() const { return &(**this); }
+    Iterator &operator++() {
+      if (!range_->Advance())
+        range_ = nullptr;
+      return *this;
+    }
+    bool operator==(const Iterator &other) const {
+      return range_ == other.range_;
+    }
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+  private:
+    ListObjectsV2Range *range_;
+  };
+  friend class Iterator;
+
+public:
+  /// Constructor
+  /// \param[in] s3 S3Api instance used to copy credentials and endpoints from
+  /// \param[in] bucket bucket name
+  /// \param[in] config ListObjectsV2 parameters, \c continuationToken is the
+  /// token of the first page to retrieve
+  /// \param[in] prefetch if \c true request next page while current page is
+  /// being consumed
+  /// \param[in] headers optional http headers sent along with each request
+  ListObjectsV2Range(const S3Api &s3, const std::string &bucket,
+                     const S3Api::ListObjectV2Config &config = {},
+                     bool prefetch = true, const Headers &headers = {{}});
+  ListObjectsV2Range(const ListObjectsV2Range &) = delete;
+  ListObjectsV2Range &operator=(const ListObjectsV2Range &) = delete;
+  /// Retrieve first page and return iterator to first object, can only be
+  /// invoked once.
+  Iterator begin();
+  /// \return end iterator
+  Iterator end() { return Iterator(); }
+  /// \return common prefixes found in pages retrieved so far
+  const std::vector<std::string> &CommonPrefixes() const {
+    return commonPrefixes_;
+  }
+  /// \return number of pages retrieved so far
+  size_t Pages() const { return pages_; }
+
+private:
+  std::future<S3Api::ListObjectV2Result> Fetch(const std::string &token);
+  bool NextPage();
+  bool Advance();
+
+private:
+  S3Api s3_;
+  std::string bucket_;
+  S3Api::ListObjectV2Config config_;
+  bool prefetch_;
+  Headers headers_;
+  bool started_ = false;
+  bool last_ = false;
+  std::future<S3Api::ListObjectV2Result> next_;
+  S3Api::ListObjectV2Result page_;
+  S3Api::ListObjectV2Result spare_; // recycled page buffer
+  size_t pos_ = 0;
+  size_t pages_ = 0;
+  std::vector<std::string> commonPrefixes_;
+};
+
+/// \brief Parallel listing configuration
+struct ParallelListConfig {
+  std::string prefix;          ///< list only keys starting with prefix
+  std::string delimiter = "/"; ///< delimiter used to discover partitions
+  int jobs = 8;                ///< number of concurrent partition listings
+  /// if \c true objects are passed to the consumer in key order, otherwise in
+  /// the order pages are received
+  bool ordered = true;
+  size_t maxKeys = 0;          ///< page size, server default if zero
+  /// number of partitions created with \c start-after split points when
+  /// less than two common prefixes are found, \c 4 x \c jobs if zero
+  int splitPoints = 0;
+  Headers headers = {{}}; ///< optional http headers sent with each request
+};
+
+/// \brief Function receiving batches of listed objects; invocations are
+/// serialized.
+using ObjectBatchConsumer = std::function<void(const std::vector<ObjectInfo> &)>;
+
+/**
+ * \brief List all objects under prefix by listing partitions of the key space
+ * concurrently.
+ *
+ * The key space is first partitioned by the common prefixes found under
+ * \c prefix up to \c delimiter in the first page of results; each common
+ * prefix is then listed recursively as a separate partition, and the key
+ * space following the first page, if truncated, is split by \c start-after
+ * boundaries. A single common prefix is descended into. If less than two
+ * common prefixes are found the whole key space is split by \c start-after
+ * boundaries sampled from the keys with single key requests: the boundaries
+ * are placed after the leading characters shared by all keys, evenly within
+ * the range of the following two characters.
+ *
+ * Partitions are listed by \c jobs workers, each reusing the same S3Api
+ * instance and therefore the same connection for all its requests.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] bucket bucket name
+ * \param[in] cfg configuration
+ * \param[in] consumer function receiving object batches
+ * \return number of listed objects
+ */
+size_t ListObjectsParallel(const S3Api &s3, const std::string &bucket,
+                           const ParallelListConfig &cfg,
+                           const ObjectBatchConsumer &consumer);
+
+/**
+ * \brief List all objects under prefix into a sorted ObjectInventory.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] bucket bucket name
+ * \param[in] cfg parallel listing configuration \see ListObjectsParallel
+ * \return inventory sorted by key
+ */
+ObjectInventory ListObjectInventory(const S3Api &s3, const std::string &bucket,
+                                    const ParallelListConfig &cfg = {});
+} // namespace api
+} // namespace sss
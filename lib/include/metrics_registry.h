@@ -0,0 +1,267 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file metrics_registry.h
+ * \brief Process-wide registry of counters, gauges and latency histograms.
+ */
+#pragma once
+
+#include "request_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sss {
+/**
+ * \addtogroup Metrics
+ * @{
+ */
+
+/// \brief Metric labels as ordered {name, value} pairs.
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * \brief Snapshot of a latency histogram.
+ *
+ * Values are recorded into log-linear buckets: values below 8 have their
+ * own bucket, larger values are split into 8 buckets per power of two,
+ * the relative error of any reported value is therefore at most 12.5%.
+ */
+struct HistogramSnapshot {
+  static constexpr size_t SUB_BUCKETS = 8; ///< buckets per power of two
+  static constexpr size_t NUM_BUCKETS = SUB_BUCKETS * 62; ///< total buckets
+  uint64_t count = 0;            ///< number of recorded values
+  uint64_t sum = 0;              ///< sum of recorded values
+  std::vector<uint64_t> buckets; ///< per-bucket counts, \c NUM_BUCKETS
+  /// \return average of recorded values, zero if none
+  double Mean() const { return count ? double(sum) / count : 0.; }
+  /// \param[in] q quantile in the [0, 1] range
+  /// \return upper bound of bucket holding the requested quantile, zero if
+  /// no values were recorded
+  uint64_t Quantile(double q) const;
+  /// \return upper bound of highest non-empty bucket
+  uint64_t Max() const { return Quantile(1.); }
+  /// \return index of bucket holding \c value
+  static size_t BucketIndex(uint64_t value);
+  /// \return largest value stored in bucket \c i
+  static uint64_t BucketUpperBound(size_t i);
+};
+
+/**
+ * \brief Registry of named metrics identified by name and labels.
+ *
+ * Counters and histograms are recorded into per-thread shards without
+ * locking: each thread owns its shard and is the only writer, readers
+ * merge all shards when collecting. The registry mutex is only acquired
+ * the first time a thread records a series and when reading.
+ * Gauges are shared atomic values.
+ *
+ * A single global instance, returned by MetricsRegistry::Global(), is fed by
+ * all WebClient instances unless a different registry is set through
+ * WebClient::SetMetricsRegistry, and by the Upload, Download and Copy
+ * transfer functions.
+ *
+ * Recorded metrics:
+ * - \c s3_requests_total{operation,endpoint,status}: requests by S3
+ *   operation and status class ("2xx" ... "5xx", "error" if no response)
+ * - \c s3_request_duration_microseconds{operation,endpoint}: total request
+ *   time histogram
+ * - \c s3_request_first_byte_microseconds{operation,endpoint}: time to first
+ *   byte histogram
+ * - \c s3_request_sent_bytes_total, \c s3_request_received_bytes_total
+ *   {operation,endpoint}: request and response body bytes
+ * - \c s3_connections_total{endpoint}: new connections opened
+ * - \c s3_requests_in_flight{endpoint}: gauge of requests being sent
+ * - \c s3_transfers_total{operation,status}: Upload, Download and Copy
+ *   calls, status "ok" or "error"
+ * - \c s3_transfer_bytes_total{operation}: bytes transferred
+ * - \c s3_transfer_duration_microseconds{operation}: transfer time histogram
+ *
+ * \code{.cpp}
+ * std::ofstream("metrics.prom") << MetricsRegistry::Global().Prometheus();
+ * \endcode
+ */
+class MetricsRegistry {
+public:
+  /// \brief Metric type
+  enum Kind { COUNTER, GAUGE, HISTOGRAM };
+  /// \brief Value of a single series.
+  struct Sample {
+    Kind kind = COUNTER;
+    std::string name;
+    Labels labels;
+    int64_t value = 0;           ///< counter or gauge value
+    HistogramSnapshot histogram; ///< histogram data, empty if not histogram
+  };
+  MetricsRegistry();
+  ~MetricsRegistry();
+  MetricsRegistry(const MetricsRegistry &) = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+  /// \brief Add value to counter.
+  /// \throws std::logic_error if series already registered with other type
+  void Increment(const std::string &name, const Labels &labels,
+                 uint64_t value = 1);
+  /// \brief Record value into histogram.
+  /// \throws std::logic_error if series already registered with other type
+  void Observe(const std::string &name, const Labels &labels, uint64_t value);
+  /// \brief Record duration in microseconds into histogram.
+  void Observe(const std::string &name, const Labels &labels,
+               std::chrono::microseconds value) {
+    Observe(name, labels, uint64_t(std::max(value.count(), int64_t(0))));
+  }
+  /// \brief Set gauge value.
+  /// \throws std::logic_error if series already registered with other type
+  void SetGauge(const std::string &name, const Labels &labels, int64_t value);
+  /// \brief Add value to gauge.
+  /// \throws std::logic_error if series already registered with other type
+  void AddGauge(const std::string &name, const Labels &labels, int64_t delta);
+  /// \return counter value, zero if not recorded
+  uint64_t Counter(const std::string &name, const Labels &labels) const;
+  /// \return gauge value, zero if not recorded
+  int64_t Gauge(const std::string &name, const Labels &labels) const;
+  /// \return histogram snapshot, empty if not recorded
+  HistogramSnapshot Histogram(const std::string &name,
+                              const Labels &labels) const;
+  /// \return snapshot of all series ordered by name, then by registration
+  std::vector<Sample> Collect() const;
+  /// \return all series in Prometheus text exposition format, histograms
+  /// include only non-empty buckets
+  std::string Prometheus() const;
+  /// \return all series as JSON object with \c counters, \c gauges and
+  /// \c histograms arrays, histograms include p50, p90, p99 and max
+  std::string JSON() const;
+  /// \return global instance
+  static MetricsRegistry &Global();
+
+private:
+  friend class RequestRecorder;
+  struct Impl;
+  struct Local;
+  /// \brief Series storage as seen by the calling thread.
+  struct Handle {
+    Kind kind;
+    std::atomic<uint64_t> *slots;  ///< counter or histogram slots in shard
+    std::atomic<int64_t> *gauge;   ///< shared gauge value
+  };
+  const Handle &Find(Kind kind, const std::string &name, const Labels &labels);
+  std::shared_ptr<Impl> impl_;
+};
+
+/// \brief Record metrics of a completed request.
+/// \param[in] registry target registry
+/// \param[in] operation S3 operation name, e.g. \c GetObject
+/// \param[in] endpoint endpoint the request was sent to
+/// \param[in] status HTTP status code, zero if no response was received
+/// \param[in] m request metrics
+void RecordRequest(MetricsRegistry &registry, const std::string &operation,
+                   const std::string &endpoint, long status,
+                   const RequestMetrics &m);
+
+/**
+ * \brief Records the metrics of RecordRequest through series handles
+ * resolved once per {operation, endpoint} pair.
+ *
+ * Handles refer to the shard of the thread which resolved them and are
+ * resolved again when the registry, operation, endpoint or recording thread
+ * change: repeated requests are recorded without building labels or looking
+ * up series. Each WebClient owns one instance.
+ */
+class RequestRecorder {
+public:
+  /// \brief Record start of request, incrementing the in-flight gauge.
+  /// \param[in] registry target registry
+  /// \param[in] operation S3 operation name, e.g. \c GetObject
+  /// \param[in] endpoint endpoint the request is sent to
+  void Begin(MetricsRegistry &registry, const std::string &operation,
+             const std::string &endpoint);
+  /// \brief Record completion of request started by Begin(), must be called
+  /// from the same thread.
+  /// \param[in] status HTTP status code, zero if no response was received
+  /// \param[in] m request metrics
+  void End(long status, const RequestMetrics &m);
+
+private:
+  using Slots = std::atomic<uint64_t> *;
+  static constexpr size_t STATUS_CLASSES = 6; ///< error, 1xx ... 5xx
+  MetricsRegistry *registry_ = nullptr;
+  uint64_t registryId_ = 0;
+  uint64_t thread_ = 0; ///< resolving thread serial number, zero if none
+  std::string operation_;
+  std::string endpoint_;
+  Slots duration_ = nullptr;
+  Slots firstByte_ = nullptr;
+  Slots sent_ = nullptr;
+  Slots received_ = nullptr;
+  Slots connections_ = nullptr;           ///< resolved on first use
+  Slots requests_[STATUS_CLASSES] = {};   ///< resolved on first use
+  std::atomic<int64_t> *inFlight_ = nullptr;
+};
+
+/// \brief Record duration, size and outcome of a transfer when going out of
+/// scope; the transfer is recorded as failed unless Success() was called.
+class TransferRecorder {
+public:
+  /// Constructor
+  /// \param[in] registry target registry, \c nullptr to disable
+  /// \param[in] operation transfer name, e.g. \c Upload
+  /// \param[in] bytes number of bytes transferred
+  TransferRecorder(MetricsRegistry *registry, const std::string &operation,
+                   uint64_t bytes = 0)
+      : registry_(registry), operation_(operation), bytes_(bytes),
+        start_(std::chrono::steady_clock::now()) {}
+  TransferRecorder(const TransferRecorder &) = delete;
+  TransferRecorder &operator=(const TransferRecorder &) = delete;
+  /// Set number of bytes transferred, when not known at construction
+  void SetBytes(uint64_t bytes) { bytes_ = bytes; }
+  /// Mark transfer as successful
+  void Success() { success_ = true; }
+  /// Destructor
+  ~TransferRecorder();
+
+private:
+  MetricsRegistry *registry_;
+  std::string operation_;
+  uint64_t bytes_;
+  std::chrono::steady_clock::time_point start_;
+  bool success_ = false;
+};
+/**
+ * @}
+ */
+} // namespace sss
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file object_inventory.h
+ * \brief Compact columnar storage of object listings.
+ */
+#pragma once
+
+#include "s3-api.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sss {
+namespace api {
+/**
+ * \brief In-memory inventory of objects stored by column.
+ *
+ * Object records are not stored as ObjectInfo instances, each field is
+ * stored in a separate array instead:
+ *   - keys are concatenated into a single buffer indexed by offset
+ *   - storage class, checksum algorithm and owner strings are interned into a
+ *     dictionary and referenced by index
+ *   - sizes and modification times are stored as integers, modification time
+ *     as milliseconds since epoch
+ *   - MD5 ETags are stored as 16 bytes plus number of parts for multipart
+ *     uploads; non MD5 ETags are stored as strings
+ *
+ * Objects are stored in insertion order, call \c Sort() before using the key
+ * lookup functions unless objects were appended in key order, as returned by
+ * \c ListObjectsV2.
+ *
+ * \code{.cpp}
+ * ObjectInventory inv;
+ * for (const auto &o : ListObjectsV2Range(s3, "bucket")) {
+ *   inv.Append(o);
+ * }
+ * auto [first, last] = inv.PrefixRange("logs/2023/");
+ * cout << inv.TotalSize(first, last) << endl;
+ * \endcode
+ */
+class ObjectInventory {
+public:
+  /// Returned by Find() when key is not found
+  static constexpr size_t npos = size_t(-1);
+  /// Returned by ETagParts() for ETags not in MD5 format
+  static constexpr uint32_t NON_MD5 = uint32_t(-1);
+  /// \brief Append object.
+  /// \param[in] o object record
+  void Append(const ObjectInfo &o);
+  /// \brief Append object from already parsed fields.
+  /// \param[in] key object key
+  /// \param[in] size object size
+  /// \param[in] lastModified modification time in milliseconds since epoch
+  /// \param[in] md5 ETag MD5 bytes
+  /// \param[in] parts number of parts for multipart ETags or \c NON_MD5
+  void Append(std::string_view key, uint64_t size, int64_t lastModified,
+              const std::array<uint8_t, 16> &md5, uint32_t parts);
+  /// \brief Append objects.
+  /// \param[in] objects object records
+  void Append(const std::vector<ObjectInfo> &objects);
+  /// \brief Reserve memory.
+  /// \param[in] objects number of objects
+  /// \param[in] keyBytes total size of keys
+  void Reserve(size_t objects, size_t keyBytes = 0);
+  /// \return number of objects
+  size_t Size() const { return sizes_.size(); }
+  /// \return \c true if no objects stored
+  bool Empty() const { return sizes_.empty(); }
+  /// \return key of i-th object, valid until next non-const call
+  std::string_view Key(size_t i) const {
+    return std::string_view(keys_.data() + keyOffsets_[i],
+                            keyOffsets_[i + 1] - keyOffsets_[i]);
+  }
+  /// \return size of i-th object
+  uint64_t ObjectSize(size_t i) const { return sizes_[i]; }
+  /// \return modification time of i-th object in milliseconds since epoch
+  int64_t LastModified(size_t i) const { return lastModified_[i]; }
+  /// \return ETag of i-th object without quotes
+  std::string ETag(size_t i) const;
+  /// \return MD5 bytes of ETag of i-th object
+  const std::array<uint8_t, 16> &ETagMD5(size_t i) const { return md5_[i]; }
+  /// \return number of parts of multipart ETag, \c 0 for single part
+  /// uploads or \c NON_MD5
+  uint32_t ETagParts(size_t i) const { return parts_[i]; }
+  /// \return storage class of i-th object
+  const std::string &StorageClass(size_t i) const {
+    return strings_[storageClass_[i]];
+  }
+  /// \return owner id of i-th object
+  const std::string &OwnerID(size_t i) const { return strings_[ownerID_[i]]; }
+  /// \return i-th object as ObjectInfo record
+  ObjectInfo Get(size_t i) const;
+  /// \brief Sort objects by key.
+  void Sort();
+  /// \return \c true if objects are sorted by key
+  bool Sorted() const { return sorted_; }
+  /// \brief Find object by key, requires sorted inventory.
+  /// \param[in] key object key
+  /// \return object index or \c npos if not found
+  size_t Find(std::string_view key) const;
+  /// \brief Return range of objects whose key starts with prefix, requires
+  /// sorted inventory.
+  /// \param[in] prefix key prefix
+  /// \return {first, last} indices, \c last excluded
+  std::pair<size_t, size_t> PrefixRange(std::string_view prefix) const;
+  /// \return sum of sizes of objects in range [first, last)
+  uint64_t TotalSize(size_t first, size_t last) const;
+  /// \return approximate memory used by inventory in bytes
+  size_t MemoryUsage() const;
+  /// \brief Remove all objects.
+  void Clear();
+
+private:
+  uint32_t Intern(const std::string &s);
+  size_t LowerBound(std::string_view key) const;
+
+private:
+  std::string keys_;
+  std::vector<uint64_t> keyOffsets_ = {0};
+  std::vector<uint64_t> sizes_;
+  std::vector<int64_t> lastModified_;
+  std::vector<std::array<uint8_t, 16>> md5_;
+  // number of parts for multipart ETags, 0 for single part, NON_MD5 if ETag
+  // stored in etags_ or missing
+  std::vector<uint32_t> parts_;
+  std::unordered_map<size_t, std::string> etags_;
+  std::vector<uint32_t> storageClass_;
+  std::vector<uint32_t> checksumAlgo_;
+  std::vector<uint32_t> ownerID_;
+  std::vector<uint32_t> ownerDisplayName_;
+  std::vector<std::string> strings_ = {""};
+  std::unordered_map<std::string, uint32_t> stringIndex_ = {{"", 0}};
+  bool sorted_ = true;
+};
+
+/// \brief Convert ISO 8601 UTC time to milliseconds since epoch.
+/// \param[in] t time in the format \c "2023-03-01T08:47:15.843Z"
+/// \return milliseconds since epoch or \c 0 if the format is not recognized
+int64_t ParseISO8601(std::string_view t);
+/// \brief Convert milliseconds since epoch to ISO 8601 UTC time.
+/// \param[in] ms milliseconds since epoch
+/// \return time in the format \c "2023-03-01T08:47:15.843Z"
+std::string FormatISO8601(int64_t ms);
+} // namespace api
+} // namespace sss
@@ -0,0 +1,229 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file rate_limiter.h
+ * \brief Token buckets and process-wide request limiter used to bound the
+ * number of requests and bytes in flight.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace sss {
+/**
+ * \addtogroup RateLimiting
+ * \brief Token bucket rate limiting.
+ * @{
+ */
+
+/// \brief Thrown by RequestLimiter::Acquire when the limiter is configured
+/// in fail-fast mode and a request cannot be admitted immediately.
+class RateLimitError : public std::runtime_error {
+public:
+  /// Constructor
+  /// \param[in] msg error message
+  explicit RateLimitError(const std::string &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * \brief Thread-safe token bucket.
+ *
+ * Tokens are added at \c rate tokens per second up to \c burst tokens.
+ * A rate of zero disables the bucket: all requests are granted immediately.
+ *
+ * Consuming more tokens than available puts the bucket into debt, callers
+ * then wait for the debt to be repaid; this allows charging requests after
+ * the fact (e.g. bytes received) and requests bigger than the burst size.
+ */
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+  /// Constructor
+  /// \param[in] rate tokens per second, zero means unlimited
+  /// \param[in] burst maximum number of tokens stored, if zero it is set
+  /// equal to \c rate
+  TokenBucket(double rate = 0, double burst = 0) { SetRate(rate, burst); }
+  /// Change rate and burst size, can be invoked while other threads are
+  /// consuming tokens.
+  /// \param[in] rate tokens per second, zero means unlimited
+  /// \param[in] burst maximum number of tokens stored, if zero it is set
+  /// equal to \c rate
+  void SetRate(double rate, double burst = 0);
+  /// \return current rate in tokens per second
+  double Rate() const;
+  /// \return \c true if rate is greater than zero
+  bool Enabled() const { return Rate() > 0; }
+  /// Consume tokens only if available; requests bigger than the burst size
+  /// are granted when the bucket is full and put the bucket into debt.
+  /// \param[in] tokens number of tokens
+  /// \return \c true if tokens were consumed, \c false otherwise
+  bool TryConsume(double tokens);
+  /// Return previously consumed tokens, up to the burst size.
+  /// \param[in] tokens number of tokens
+  void Refund(double tokens);
+  /// Consume tokens, going into debt if not enough tokens are available.
+  /// \param[in] tokens number of tokens
+  /// \return time to wait before the debt is repaid
+  Clock::duration Reserve(double tokens);
+  /// Consume tokens, blocking the calling thread until the tokens are
+  /// available.
+  /// \param[in] tokens number of tokens
+  void Consume(double tokens);
+
+private:
+  void Refill(Clock::time_point now);
+
+private:
+  mutable std::mutex mutex_;
+  double rate_ = 0;
+  double burst_ = 0;
+  double tokens_ = 0;
+  Clock::time_point last_ = Clock::now();
+};
+
+/// \brief Request limiter configuration; zero values disable the
+/// corresponding limit.
+struct RequestLimiterConfig {
+  double requestsPerSecond = 0; ///< request rate
+  double requestBurst = 0; ///< request burst size, \c requestsPerSecond if 0
+  double bytesPerSecond = 0; ///< rate of bytes sent and received
+  double byteBurst = 0;      ///< byte burst size, \c bytesPerSecond if 0
+  size_t maxInFlightRequests = 0; ///< max concurrent requests
+  size_t maxInFlightBytes = 0;    ///< max bytes being uploaded concurrently
+  size_t maxInFlightRequestsPerEndpoint = 0; ///< default per-endpoint cap
+  /// per-endpoint caps overriding \c maxInFlightRequestsPerEndpoint
+  std::map<std::string, size_t> endpointMaxInFlightRequests;
+  /// if \c true wait until a request can be admitted, throw RateLimitError
+  /// otherwise
+  bool blocking = true;
+};
+
+/**
+ * \brief Limits the number of requests and bytes in flight and the request
+ * and byte rates.
+ *
+ * A single global instance, returned by RequestLimiter::Global(), is used
+ * by all WebClient instances unless a different limiter is set through
+ * WebClient::SetRequestLimiter. The global limiter is disabled by default.
+ *
+ * \code{.cpp}
+ * RequestLimiter::Global().Configure({.requestsPerSecond = 500,
+ *                                     .maxInFlightRequests = 64,
+ *                                     .maxInFlightRequestsPerEndpoint = 16});
+ * \endcode
+ */
+class RequestLimiter {
+public:
+  /// \brief RAII object releasing in-flight request and byte counts on
+  /// destruction.
+  class Permit {
+    friend class RequestLimiter;
+
+  public:
+    Permit() = default;
+    Permit(const Permit &) = delete;
+    Permit &operator=(const Permit &) = delete;
+    Permit(Permit &&other)
+        : limiter_(other.limiter_), endpoint_(std::move(other.endpoint_)),
+          bytes_(other.bytes_) {
+      other.limiter_ = nullptr;
+    }
+    ~Permit() {
+      if (limiter_)
+        limiter_->Release(endpoint_, bytes_);
+    }
+
+  private:
+    Permit(RequestLimiter *l, const std::string &ep, size_t bytes)
+        : limiter_(l), endpoint_(ep), bytes_(bytes) {}
+
+  private:
+    RequestLimiter *limiter_ = nullptr;
+    std::string endpoint_;
+    size_t bytes_ = 0;
+  };
+
+public:
+  RequestLimiter() = default;
+  /// Constructor
+  /// \param[in] cfg configuration
+  RequestLimiter(const RequestLimiterConfig &cfg) { Configure(cfg); }
+  RequestLimiter(const RequestLimiter &) = delete;
+  RequestLimiter &operator=(const RequestLimiter &) = delete;
+  /// Replace configuration; permits already granted are not affected.
+  void Configure(const RequestLimiterConfig &cfg);
+  /// \return \c true if any limit is configured
+  bool Enabled() const { return enabled_; }
+  /// Admit a request.
+  /// \param[in] endpoint endpoint the request is sent to
+  /// \param[in] bytes number of bytes to upload
+  /// \return permit to keep alive until the request completes
+  /// \throws RateLimitError in non-blocking mode when the request cannot be
+  /// admitted immediately
+  Permit Acquire(const std::string &endpoint, size_t bytes = 0);
+  /// Charge bytes against the byte rate after a transfer, e.g. for bytes
+  /// received whose size is unknown when the request is admitted.
+  void Charge(size_t bytes);
+  /// \return number of requests currently in flight
+  size_t InFlightRequests() const;
+  /// \return number of bytes currently in flight
+  size_t InFlightBytes() const;
+  /// \return process-wide limiter instance
+  static RequestLimiter &Global();
+
+private:
+  bool CanAdmit(const std::string &endpoint, size_t bytes) const;
+  size_t EndpointCap(const std::string &endpoint) const;
+  void Release(const std::string &endpoint, size_t bytes);
+
+private:
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+  RequestLimiterConfig config_;
+  std::atomic<bool> enabled_{false};
+  size_t inFlightRequests_ = 0;
+  size_t inFlightBytes_ = 0;
+  std::map<std::string, size_t> inFlightPerEndpoint_;
+  TokenBucket requests_;
+  TokenBucket bytes_;
+};
+/**
+ * @}
+ */
+} // namespace sss
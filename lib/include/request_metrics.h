@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file request_metrics.h
+ * \brief Per-request timing and transfer metrics.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+namespace sss {
+/**
+ * \addtogroup Metrics
+ * \brief Request timing breakdown.
+ * @{
+ */
+
+/**
+ * \brief Timing breakdown and transfer sizes of one or more requests.
+ *
+ * Filled by WebClient after each request from \c curl_easy_getinfo.
+ * \c nameLookup, \c connect and \c tlsHandshake are consecutive phases
+ * included in \c firstByte, which also includes sending the request and
+ * the server processing time; <tt>total = firstByte + transfer</tt>.
+ *
+ * Metrics of multiple requests are aggregated by summing all fields.
+ */
+struct RequestMetrics {
+  using Duration = std::chrono::microseconds; ///< time unit
+  Duration nameLookup{0};   ///< DNS resolution
+  Duration connect{0};      ///< TCP connection after name resolution
+  Duration tlsHandshake{0}; ///< TLS handshake, zero if not using TLS
+  /// time from start of request to first byte received
+  Duration firstByte{0};
+  Duration transfer{0}; ///< time from first to last byte received
+  Duration total{0};    ///< total time
+  uint64_t bytesSent = 0;     ///< request body bytes sent
+  uint64_t bytesReceived = 0; ///< response body bytes received
+  size_t requests = 0;        ///< number of requests
+  /// number of new connections, a request reusing an existing connection
+  /// does not open any
+  size_t newConnections = 0;
+  /// \return \c true if all requests reused existing connections
+  bool ConnectionReused() const { return newConnections == 0; }
+  /// \brief Add metrics of other requests.
+  RequestMetrics &operator+=(const RequestMetrics &m) {
+    nameLookup += m.nameLookup;
+    connect += m.connect;
+    tlsHandshake += m.tlsHandshake;
+    firstByte += m.firstByte;
+    transfer += m.transfer;
+    total += m.total;
+    bytesSent += m.bytesSent;
+    bytesReceived += m.bytesReceived;
+    requests += m.requests;
+    newConnections += m.newConnections;
+    return *this;
+  }
+};
+
+/// \brief Add metrics to aggregate shared among threads.
+/// \param[in,out] total aggregated metrics
+/// \param[in] m metrics to add
+void AccumulateMetrics(RequestMetrics &total, const RequestMetrics &m);
+
+/// \brief Add metrics of all requests sent by client to aggregate when going
+/// out of scope, also when the scope is exited because of an exception.
+/// \tparam ClientT type with a \c Metrics() method, WebClient or S3Api
+template <typename ClientT> class MetricsGuard {
+public:
+  /// Constructor
+  /// \param[in] total aggregate, \c nullptr to disable
+  /// \param[in] client client whose metrics are added to \c total
+  MetricsGuard(RequestMetrics *total, const ClientT &client)
+      : total_(total), client_(client) {}
+  MetricsGuard(const MetricsGuard &) = delete;
+  MetricsGuard &operator=(const MetricsGuard &) = delete;
+  /// Destructor
+  ~MetricsGuard() {
+    if (total_)
+      AccumulateMetrics(*total_, client_.Metrics());
+  }
+
+private:
+  RequestMetrics *total_;
+  const ClientT &client_;
+};
+
+/// \brief Print metrics as \c name=value pairs, times in milliseconds.
+std::ostream &operator<<(std::ostream &os, const RequestMetrics &m);
+/**
+ * @}
+ */
+} // namespace sss
@@ -36,8 +36,8 @@
  */
 #pragma once
 
-#include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "common.h"
@@ -52,7 +52,7 @@ namespace sss {
 /// \param[in] xml XML text
 /// \param[in] tag \c <tag> name
 /// \return \c <tag> content
-std::string XMLTag(const std::string &xml, const std::string &tag);
+std::string XMLTag(std::string_view xml, const std::string &tag);
 
 /// \brief Extract and return content of all XML tags matching word
 /// \param[in] xml XML text
@@ -66,6 +66,67 @@ std::vector<std::string> XMLTags(const std::string &xml,
 /// \return content of tag if found, empty string otherwise
 std::string XMLTagPath(const std::string &xml, const std::string &path);
 
+/// \brief Case-insensitive flat map of HTTP response headers.
+///
+/// Entries are stored as offsets into an externally owned header buffer and
+/// returned as \c std::string_view, valid until the buffer is modified.
+/// Header lines are parsed one at a time as they are received; a status line
+/// starts a new header block and discards the headers of previous responses
+/// e.g. \c 100 \c Continue or redirects.
+class HTTPHeaderMap {
+public:
+  /// \param[in] buffer buffer containing raw header lines
+  explicit HTTPHeaderMap(const std::vector<char> *buffer = nullptr)
+      : buffer_(buffer) {}
+  /// Copy entries from another map and bind them to a different buffer with
+  /// identical content.
+  HTTPHeaderMap(const HTTPHeaderMap &other, const std::vector<char> *buffer)
+      : buffer_(buffer), entries_(other.entries_) {}
+  /// \brief Parse header line.
+  /// \param[in] begin offset of first character of line in buffer
+  /// \param[in] end offset of one past the last character of line
+  void ParseLine(size_t begin, size_t end);
+  /// Parse entire buffer.
+  void Parse();
+  /// Remove all entries.
+  void Clear() { entries_.clear(); }
+  /// \brief Case-insensitive header lookup.
+  /// \param[in] name header name
+  /// \return value of first header matching \c name, empty if not found
+  std::string_view Get(std::string_view name) const;
+  /// \return \c true if header is present, \c false otherwise
+  bool Has(std::string_view name) const;
+  /// \return number of headers
+  size_t Size() const { return entries_.size(); }
+  /// \return name of i-th header
+  std::string_view Name(size_t i) const {
+    return View(entries_[i].name, entries_[i].nameSize);
+  }
+  /// \return value of i-th header
+  std::string_view Value(size_t i) const {
+    return View(entries_[i].value, entries_[i].valueSize);
+  }
+  /// \return {header name, header value} map
+  Headers ToHeaders() const;
+  /// \return \c x-amz-meta-* headers with prefix removed
+  MetaDataMap MetaData() const;
+
+private:
+  std::string_view View(size_t offset, size_t size) const {
+    return std::string_view(buffer_->data() + offset, size);
+  }
+
+private:
+  struct Entry {
+    size_t name;
+    size_t nameSize;
+    size_t value;
+    size_t valueSize;
+  };
+  const std::vector<char> *buffer_;
+  std::vector<Entry> entries_;
+};
+
 /// \brief Extract and return HTTP header
 /// \param[in] headers text containing the header section of an HTTP payload
 /// \param[in] header header name
@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file retry_policy.h
+ * \brief Retry policy with exponential backoff and decorrelated jitter.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
+namespace sss {
+/**
+ * \addtogroup ErrorHandling
+ * @{
+ */
+
+/**
+ * \brief Retry operations failing with transient errors.
+ *
+ * Each invocation of RetryPolicy::Run keeps its own attempt counter: a failing
+ * part can be retried up to \c maxRetries times regardless of failures in other
+ * parts.
+ *
+ * The delay between attempts is computed with the \e decorrelated \e jitter
+ * algorithm: <tt>delay = min(maxDelay, random(baseDelay, 3 * previous
+ * delay))</tt>; if the server returns a \c Retry-After header the delay is at
+ * least the requested value, up to \c maxDelay.
+ *
+ * \code{.cpp}
+ * RetryPolicy policy(3);
+ * const ETag etag = policy.Run([&] {
+ *   return s3.UploadPart(bucket, key, uploadId, part, data, size);
+ * });
+ * \endcode
+ */
+class RetryPolicy {
+public:
+  using Duration = std::chrono::milliseconds;
+  /// Constructor
+  /// \param[in] maxRetries maximum number of retries after first attempt
+  /// \param[in] baseDelay minimum delay between attempts
+  /// \param[in] maxDelay maximum delay between attempts
+  RetryPolicy(int maxRetries = 1, Duration baseDelay = Duration(100),
+              Duration maxDelay = Duration(20000))
+      : maxRetries_(maxRetries), baseDelay_(baseDelay), maxDelay_(maxDelay) {}
+  /// \return maximum number of retries
+  int MaxRetries() const { return maxRetries_; }
+  /// \brief Classify error.
+  ///
+  /// Retryable errors:
+  ///   - HTTP 5xx, 408 and 429 status codes
+  ///   - S3 \c SlowDown, \c RequestTimeout, \c InternalError error codes
+  ///   - transport errors such as connection reset or timeout, but not
+  ///     malformed URLs or unsupported protocols
+  ///   - RateLimitError thrown by a fail-fast RequestLimiter
+  ///   - other \c std::runtime_error exceptions e.g. missing \c ETag
+  ///
+  /// \c std::logic_error exceptions, including 4xx HTTP errors, are not
+  /// retried.
+  /// \param[in] e exception
+  /// \return \c true if operation can be retried
+  static bool Retryable(const std::exception &e);
+  /// \param[in] e exception
+  /// \return delay requested by server through \c Retry-After header, zero if
+  /// not present
+  static Duration RetryAfter(const std::exception &e);
+  /// Compute next delay.
+  /// \param[in] previous previous delay, \c baseDelay for first retry
+  /// \return random delay in the range [baseDelay, min(maxDelay, 3 *
+  /// previous)]
+  Duration NextDelay(Duration previous) const;
+  /// Invoke function until it succeeds, the error is not retryable or the
+  /// maximum number of retries is reached; the last exception is re-thrown.
+  /// \param[in] f function to invoke
+  /// \param[out] retries if not \c NULL incremented at each retry
+  /// \param[in] cancel if not \c NULL no further attempts are made once set:
+  /// the delay between attempts is interrupted and the last exception
+  /// re-thrown
+  /// \return value returned by \c f
+  template <typename F>
+  auto Run(F &&f, std::atomic<int> *retries = nullptr,
+           const std::atomic<bool> *cancel = nullptr) const -> decltype(f()) {
+    Duration delay = baseDelay_;
+    for (int attempt = 0;; ++attempt) {
+      std::exception_ptr error;
+      try {
+        return f();
+      } catch (const std::exception &e) {
+        if (attempt >= maxRetries_ || !Retryable(e) || (cancel && *cancel))
+          throw;
+        delay = NextDelay(delay);
+        // server requested delay, bounded by maxDelay
+        const Duration requested = std::min(RetryAfter(e), maxDelay_);
+        if (requested > delay)
+          delay = requested;
+        error = std::current_exception();
+      }
+      if (!Wait(delay, cancel))
+        std::rethrow_exception(error);
+      if (retries)
+        ++(*retries);
+    }
+  }
+
+private:
+  /// interval at which the cancel flag is checked while waiting
+  static constexpr Duration CANCEL_POLL_INTERVAL = Duration(10);
+  /// Sleep for \c delay, polling \c cancel if not \c NULL.
+  /// \return \c false if cancelled
+  static bool Wait(Duration delay, const std::atomic<bool> *cancel) {
+    if (!cancel) {
+      std::this_thread::sleep_for(delay);
+      return true;
+    }
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration poll = CANCEL_POLL_INTERVAL;
+    const auto end = Clock::now() + delay;
+    for (auto now = Clock::now(); now < end && !*cancel; now = Clock::now()) {
+      std::this_thread::sleep_for(std::min(end - now, poll));
+    }
+    return !*cancel;
+  }
+
+  int maxRetries_;
+  Duration baseDelay_;
+  Duration maxDelay_;
+};
+/**
+ * @}
+ */
+} // namespace sss
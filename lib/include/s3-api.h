@@ -145,6 +145,30 @@ struct AccessControlPolicy {
 /// \brief {name, value} map representing bucket or object tags.
 /// \ingroup Types
 using TagMap = std::unordered_map<std::string, std::string>;
+
+/// \brief Object to delete in \c DeleteObjects request
+/// \ingroup Types
+struct ObjectIdentifier {
+  std::string key;
+  std::string versionId; ///< leave blank for latest version
+};
+
+/// \brief Object which could not be deleted by \c DeleteObjects request
+/// \ingroup Types
+struct DeleteError {
+  std::string key;
+  std::string versionId;
+  std::string code;
+  std::string message;
+};
+
+/// \brief XML -> C++ mapping of \c DeleteObjects response
+/// See https://docs.aws.amazon.com/AmazonS3/latest/API/API_DeleteObjects.html
+/// \ingroup Types
+struct DeleteObjectsResult {
+  std::vector<ObjectIdentifier> deleted; ///< empty in quiet mode
+  std::vector<DeleteError> errors;
+};
 /**
  * \brief S3 Client inteface.
  *
@@ -229,11 +253,17 @@ public:
   /// struct ListObjectV2Result {
   ///   bool truncated;
   ///   std::vector<ObjectInfo> keys;
+  ///   std::string nextContinuationToken;
+  ///   std::vector<std::string> commonPrefixes;
+  ///   size_t keyCount;
   /// };
   /// \endcode
   struct ListObjectV2Result {
-    bool truncated;
+    bool truncated = false;
     std::vector<ObjectInfo> keys;
+    std::string nextContinuationToken; ///< pass to next request if truncated
+    std::vector<std::string> commonPrefixes; ///< prefixes up to delimiter
+    size_t keyCount = 0; ///< number of keys and common prefixes returned
   };
   /// \brief Memory buffer used in SendParams
   struct ReadBuffer {
@@ -300,7 +330,8 @@ public:
   S3Api(S3Api &&other)
       : access_(other.access_), secret_(other.secret_),
         endpoint_(other.endpoint_), signingEndpoint_(other.signingEndpoint_),
-        webClient_(std::move(other.webClient_)) {}
+        webClient_(std::move(other.webClient_)), selector_(other.selector_),
+        requestEndpoint_(std::atomic_load(&other.requestEndpoint_)) {}
 
 public:
   /// \brief Check if bucket exist.
@@ -375,9 +406,12 @@ public:
   void Send(const SendParams &params, WebClient::ReadFunction sendFun,
             void *sendUserData, WebClient::WriteFunction receiveFun,
             void *receiveUserData) {
+    Config(params);
+    // Config resets read and write functions
     webClient_.SetWriteFunction(receiveFun, receiveUserData);
     webClient_.SetReadFunction(sendFun, sendUserData);
-    Send(params);
+    webClient_.Send();
+    HandleError(webClient_);
   }
 
   // High level API
@@ -481,6 +515,36 @@ public:
                                const std::string &key,
                                const std::vector<ETag> &etags);
 
+  /// Maximum size of objects copied by a single \c CopyObject request and of
+  /// parts copied by \c UploadPartCopy
+  static constexpr size_t MAX_COPY_SIZE = size_t(5) << 30;
+
+  /// Minimum size of all parts but the last in a multipart upload
+  static constexpr size_t MIN_PART_SIZE = size_t(5) << 20;
+
+  /// \brief Server-side copy of object
+  ///
+  /// \param[in] srcBucket source bucket name
+  ///
+  /// \param[in] srcKey source key name
+  ///
+  /// \param[in] dstBucket destination bucket name
+  ///
+  /// \param[in] dstKey destination key name
+  ///
+  /// \param[in] headers optional HTTP headers as {name, value} map e.g.
+  /// \c x-amz-metadata-directive and \c x-amz-meta-* to replace metadata
+  ///
+  /// \param[in] srcVersionId source version id, latest version if empty
+  ///
+  /// \return ETag of destination object
+  /// \throws HTTPError also when the server reports an error after
+  /// returning a \c 200 status code
+  ETag CopyObject(const std::string &srcBucket, const std::string &srcKey,
+                  const std::string &dstBucket, const std::string &dstKey,
+                  const Headers &headers = {},
+                  const std::string &srcVersionId = "");
+
   /// \brief Create bucket
   ///
   /// \param[in] bucket bucket name
@@ -532,6 +596,27 @@ public:
                     const Headers &headers = {},
                     const std::string &versionId = "");
 
+  /// Maximum number of objects deleted by a single \c DeleteObjects request
+  static constexpr size_t MAX_DELETE_OBJECTS = 1000;
+
+  /// \brief Delete multiple objects with a single request
+  ///
+  /// \param[in] bucket bucket name
+  ///
+  /// \param[in] objects objects to delete, at most \c MAX_DELETE_OBJECTS
+  ///
+  /// \param[in] quiet if \c true only errors are returned
+  ///
+  /// \param[in] headers optional http headers as {name, value} map sent along
+  /// with request
+  ///
+  /// \return deleted objects and per-object errors
+  /// \throw std::logic_error if more than \c MAX_DELETE_OBJECTS objects passed
+  DeleteObjectsResult DeleteObjects(const std::string &bucket,
+                                    const std::vector<ObjectIdentifier> &objects,
+                                    bool quiet = true,
+                                    const Headers &headers = {});
+
   /// \brief Remove all tags from bucket
   /// \param[in] bucket bucket name
   /// \param[in] headers optional http headers as {name, value} map
@@ -679,6 +764,9 @@ public:
 
   /// \brief List objects by sending a \c ListObjectsV2 request
   ///
+  /// A single page of at most \c maxKeys (default 1000) objects is returned,
+  /// use ListObjectsV2Range to iterate over all the objects.
+  ///
   /// \param[in] bucket bucket name
   ///
   /// \param[in] config optional configuration parameters \see
@@ -692,6 +780,20 @@ public:
   ListObjectsV2(const std::string &bucket,
                 const ListObjectV2Config &config = ListObjectV2Config{},
                 const Headers & = {{}});
+  /// \brief List objects by sending a \c ListObjectsV2 request, storing the
+  /// result into an existing instance.
+  ///
+  /// Memory already allocated by \c result is reused, pass the same instance
+  /// when requesting multiple pages to avoid per-object allocations.
+  ///
+  /// \param[in] bucket bucket name
+  /// \param[in] config configuration parameters \see ListObjectV2Config
+  /// \param[out] result object list \see ListObjectV2Result
+  /// \param[in] headers optional http headers as {name, value} map sent along
+  /// with request
+  void ListObjectsV2(const std::string &bucket,
+                     const ListObjectV2Config &config,
+                     ListObjectV2Result &result, const Headers & = {{}});
   /// \brief Return all versions and delete markers for object
   ///
   /// \param[in] bucket bucket name
@@ -797,6 +899,35 @@ public:
                   size_t size, int maxRetries = 1, Headers headers = {{}},
                   const std::string &payloadHash = {});
 
+  /// \brief Upload part by copying a byte range of an existing object
+  ///
+  /// \param[in] bucket destination bucket name
+  ///
+  /// \param[in] key destination key name
+  ///
+  /// \param[in] uid upload id returned by CreateMultipartUpload
+  ///
+  /// \param[in] partNum zero-indexed part number
+  ///
+  /// \param[in] srcBucket source bucket name
+  ///
+  /// \param[in] srcKey source key name
+  ///
+  /// \param[in] begin offset of first byte to copy
+  ///
+  /// \param[in] end offset of last byte to copy, inclusive
+  ///
+  /// \param[in] headers optional HTTP headers as {header name, value} map
+  ///
+  /// \param[in] srcVersionId source version id, latest version if empty
+  ///
+  /// \return etag
+  ETag UploadPartCopy(const std::string &bucket, const std::string &key,
+                      const UploadId &uid, int partNum,
+                      const std::string &srcBucket, const std::string &srcKey,
+                      size_t begin, size_t end, Headers headers = {},
+                      const std::string &srcVersionId = "");
+
 public:
   /// \return access token
   const std::string &Access() const { return access_; }
@@ -804,21 +935,83 @@ public:
   const std::string &Secret() const { return secret_; }
   /// \return endpoint URL
   const std::string &Endpoint() const { return endpoint_; }
+  /// \return endpoint of the request being sent or last sent, which differs
+  /// from Endpoint() when an endpoint selector is set; can be called from
+  /// other threads while a request is in progress
+  std::string RequestEndpoint() const {
+    auto e = std::atomic_load(&requestEndpoint_);
+    return e ? *e : endpoint_;
+  }
   /// \return signing endpoint URL
   const std::string &SigningEndpoint() const { return signingEndpoint_; }
+  /// \brief Set bandwidth shaper shared among multiple instances.
+  /// \see WebClient::SetBandwidthShaper
+  void SetBandwidthShaper(std::shared_ptr<TokenBucket> shaper) {
+    webClient_.SetBandwidthShaper(shaper);
+  }
+  /// \brief Set flag used to abort transfers in progress.
+  /// \see WebClient::SetCancelFlag
+  void SetCancelFlag(const std::atomic<bool> *cancel) {
+    webClient_.SetCancelFlag(cancel);
+  }
+  /// \brief Set progress updated by requests.
+  /// \see WebClient::SetProgress
+  void SetProgress(TransferProgress *progress, size_t part = 0) {
+    webClient_.SetProgress(progress, part);
+  }
+  /// \brief Set endpoint selector shared among multiple instances: each
+  /// request is sent to the endpoint returned by EndpointSelector::Select
+  /// instead of the one passed to the constructor.
+  void SetEndpointSelector(std::shared_ptr<EndpointSelector> selector) {
+    selector_ = selector;
+    webClient_.SetEndpointSelector(selector_.get());
+    std::atomic_store(&requestEndpoint_,
+                      std::shared_ptr<const std::string>());
+  }
+  /// \return endpoint selector or \c nullptr if not set
+  std::shared_ptr<EndpointSelector> GetEndpointSelector() const {
+    return selector_;
+  }
+  /// \return timing breakdown and transfer sizes of last request
+  /// \see WebClient::LastRequestMetrics
+  const RequestMetrics &LastRequestMetrics() const {
+    return webClient_.LastRequestMetrics();
+  }
+  /// \return metrics of all requests sent since construction or last call to
+  /// ResetMetrics(), retries included
+  const RequestMetrics &Metrics() const { return webClient_.Metrics(); }
+  /// \brief Reset aggregated metrics.
+  void ResetMetrics() { webClient_.ResetMetrics(); }
+  /// \brief Set registry receiving per-operation metrics of each request.
+  /// \see WebClient::SetMetricsRegistry
+  void SetMetricsRegistry(MetricsRegistry *registry) {
+    webClient_.SetMetricsRegistry(registry);
+  }
+  /// \brief Set tracer receiving a span per request.
+  /// \see WebClient::SetTracer
+  void SetTracer(Tracer *tracer) { webClient_.SetTracer(tracer); }
+  /// \brief S3 operation name of request, e.g. \c GetObject or
+  /// \c UploadPart, used to label metrics.
+  /// \param[in] p request parameters
+  /// \return operation name or HTTP method if not recognised
+  static std::string OperationName(const SendParams &p);
   /// \return response body
   const std::vector<char> &GetResponseBody() const {
     return webClient_.GetResponseBody();
   }
   /// \return response body as text
   std::string GetResponseText() const { return webClient_.GetContentText(); }
+  /// \return response body as text view, valid until the next request
+  std::string_view GetResponseView() const {
+    return webClient_.GetContentView();
+  }
 
   /// \brief Get returned HTTP headers.
   /// Use this method to retrieve additional information e.g. \c versionId
   /// after sending a request
   /// \return {header name, header value} map
   Headers GetResponseHeaders() const {
-    return HTTPHeaders(webClient_.GetHeaderText());
+    return webClient_.ResponseHeaders().ToHeaders();
   }
 
 private:
@@ -834,6 +1027,9 @@ private:
 
 private:
   sss::WebClient webClient_;
+  std::shared_ptr<EndpointSelector> selector_;
+  /// endpoint returned by selector_ for the current request
+  std::shared_ptr<const std::string> requestEndpoint_;
   std::string access_;
   std::string secret_;
   std::string endpoint_;
@@ -39,6 +39,7 @@
 #include "aws_sign.h"
 #include "common.h"
 #include "webclient.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -120,6 +121,30 @@ struct S3DataTransferConfig {
   std::string payloadHash; ///< payload hash if empty the literal \c
                            ///< "UNSIGNED-PAYLOAD" is used instead of the SHA256
                            ///< hash code
+  /// shared bandwidth shaper, one token per byte sent or received by all
+  /// parallel transfers, \c nullptr to disable bandwidth shaping
+  std::shared_ptr<TokenBucket> bandwidthShaper;
+  /// if \c true, parts of parallel downloads not received within the p95
+  /// latency observed so far are requested again, possibly from a different
+  /// endpoint, and the first response received is kept
+  bool hedgeRequests = false;
+  /// endpoint selector shared by all parallel transfers; if \c nullptr and
+  /// more than one endpoint is specified a new selector is created for each
+  /// transfer
+  std::shared_ptr<EndpointSelector> endpointSelector;
+  /// if not \c NULL, metrics of all requests sent by the transfer are added
+  /// to the referenced instance
+  RequestMetrics *metrics = nullptr;
+  /// registry receiving per-operation request metrics and the outcome of the
+  /// transfer, \c nullptr to disable
+  MetricsRegistry *registry = &MetricsRegistry::Global();
+  /// progress shared by all parallel transfers, updated while data is sent
+  /// or received, \c nullptr to disable progress tracking
+  std::shared_ptr<TransferProgress> progress;
+  /// tracer receiving a span for the transfer, one for each part and one
+  /// for each request, \c nullptr to disable tracing unless the transfer
+  /// is started from within an active span
+  std::shared_ptr<Tracer> tracer;
 };
 
 /// \brief read S3 credentials from file in AWS S3 format (`Toml`).
@@ -171,6 +196,23 @@ ETag Upload(const S3DataTransferConfig &cfg, const MetaDataMap &mm = {},
 /// in case versioning not enabled
 void Download(const S3DataTransferConfig &cfg, bool sync = false,
               const std::string &versionId = "");
+/// \brief Parallel server-side copy
+/// Copy source object to \c cfg.bucket/cfg.key without transferring data
+/// through the client: objects smaller than two minimum size parts are copied
+/// with a single \c CopyObject request, larger objects with parallel
+/// \c UploadPartCopy requests scheduled like upload parts.
+/// \param[in] cfg data transfer configuration, \c file, \c data and
+/// \c size are ignored, \see S3DataTransferConfig
+/// \param[in] srcBucket source bucket name
+/// \param[in] srcKey source key name
+/// \param[in] mm metadata of destination object; if empty, single request
+/// copies preserve the source metadata while multipart copies do not
+/// \param[in] sync if `sync==true` perform serial transfer
+/// \param[in] srcVersionId source version id or blank for latest version
+/// \return ETag of destination object
+ETag Copy(const S3DataTransferConfig &cfg, const std::string &srcBucket,
+          const std::string &srcKey, const MetaDataMap &mm = {},
+          bool sync = false, const std::string &srcVersionId = "");
 /// \brief Read S3 credentials from file.
 /// \param[in] fileName name of configuration file in AWS TOML format
 /// \param[in] awsProfile profile
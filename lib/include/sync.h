@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file sync.h
+ * \brief Synchronization of local directories and S3 prefixes with S3
+ * prefixes.
+ */
+#pragma once
+
+#include "list_objects.h"
+#include "s3-api.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sss {
+namespace api {
+
+/// \brief File or object record used to compare source and destination
+struct SyncEntry {
+  std::string key;          ///< path relative to directory or prefix
+  uint64_t size = 0;        ///< size in bytes
+  int64_t lastModified = 0; ///< modification time, milliseconds since epoch
+  /// ETag without quotes; MD5 digest of local files, empty if not computed
+  std::string etag;
+};
+
+/// \brief Entries sorted by key
+using SyncManifest = std::vector<SyncEntry>;
+
+/// \brief Sync configuration
+struct SyncConfig {
+  int jobs = 8;       ///< number of concurrent transfers
+  int maxRetries = 3; ///< retries of each failed request
+  /// delete destination objects not found in source
+  bool deleteExtraneous = false;
+  /// compare sizes only, ignoring modification times and ETags
+  bool sizeOnly = false;
+  /// compute MD5 digest of local files and compare it with single part
+  /// destination ETags instead of modification times
+  bool checksum = false;
+  /// compute and return the plan without transferring or deleting data
+  bool dryRun = false;
+  /// objects larger than this are transferred with parallel multipart
+  /// uploads or copies
+  size_t multipartThreshold = size_t(64) << 20;
+  /// number of parallel part transfers for each multipart transfer
+  int partJobs = 4;
+  /// metadata of uploaded and copied objects as \c x-amz-meta-* headers; if
+  /// empty, copies preserve the metadata of the source objects
+  MetaDataMap metaData;
+  /// shared bandwidth shaper, \c nullptr to disable bandwidth shaping
+  std::shared_ptr<TokenBucket> bandwidthShaper;
+  /// if not \c NULL, metrics of all transfer and delete requests are added to
+  /// the referenced instance
+  RequestMetrics *metrics = nullptr;
+  /// parallel listing configuration, \c prefix is ignored
+  ParallelListConfig list;
+};
+
+/// \brief Transfer required to synchronize a single entry
+struct SyncTransfer {
+  std::string key; ///< key relative to source and destination
+  uint64_t size;   ///< size in bytes
+};
+
+/// \brief Result of the comparison of source and destination manifests
+struct SyncPlan {
+  std::vector<SyncTransfer> transfers; ///< new or modified entries
+  std::vector<std::string> deletes;    ///< keys to delete from destination
+  size_t unchanged = 0;                ///< number of unchanged entries
+  uint64_t bytes = 0;                  ///< total number of bytes to transfer
+};
+
+/// \brief Sync result
+struct SyncResult {
+  SyncPlan plan;           ///< computed plan
+  size_t transferred = 0;  ///< number of uploaded or copied objects
+  size_t deleted = 0;      ///< number of deleted objects
+  /// {key, error message} of failed transfers and deletions
+  std::vector<std::pair<std::string, std::string>> errors;
+};
+
+/**
+ * \brief Build manifest of regular files under directory, recursively.
+ *
+ * \param[in] dir directory path
+ * \param[in] checksum if \c true compute MD5 digest of each file
+ * \return entries sorted by key, keys are relative paths with \c '/'
+ * separators
+ */
+SyncManifest LocalManifest(const std::string &dir, bool checksum = false);
+
+/**
+ * \brief Build manifest of objects under prefix through a parallel listing.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] bucket bucket name
+ * \param[in] prefix key prefix, removed from manifest keys; matched as a
+ * plain string prefix, without a trailing \c '/' keys of sibling
+ * "directories" are included, e.g. \c dir2/a with key \c 2/a for prefix
+ * \c dir
+ * \param[in] cfg parallel listing configuration, \c prefix is ignored
+ * \return entries sorted by key
+ */
+SyncManifest S3Manifest(const S3Api &s3, const std::string &bucket,
+                        const std::string &prefix,
+                        const ParallelListConfig &cfg = {});
+
+/**
+ * \brief Compare source and destination manifests.
+ *
+ * An entry is transferred if missing from the destination or if sizes
+ * differ. Entries of equal size are compared by ETag when both ETags are
+ * MD5 digests of the whole content or are identical, by modification time
+ * otherwise: the entry is transferred if the source is newer than the
+ * destination.
+ *
+ * \param[in] src source manifest sorted by key
+ * \param[in] dst destination manifest sorted by key
+ * \param[in] cfg configuration
+ * \return transfers and deletions
+ */
+SyncPlan DiffManifests(const SyncManifest &src, const SyncManifest &dst,
+                       const SyncConfig &cfg = {});
+
+/**
+ * \brief Upload new and modified files from local directory to prefix.
+ *
+ * Files not larger than \c multipartThreshold are uploaded with single
+ * requests by \c jobs workers, larger files with parallel multipart uploads.
+ * Failed transfers do not stop the synchronization and are reported in the
+ * returned errors.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] dir source directory
+ * \param[in] bucket destination bucket
+ * \param[in] prefix destination "directory", prepended to relative paths
+ * followed by \c '/' if not already ending with one
+ * \param[in] cfg configuration
+ * \return plan and number of transferred and deleted objects
+ * \throw first exception thrown while listing
+ */
+SyncResult SyncDirectory(const S3Api &s3, const std::string &dir,
+                         const std::string &bucket, const std::string &prefix,
+                         const SyncConfig &cfg = {});
+
+/**
+ * \brief Upload all files under local directory to prefix, recursively.
+ *
+ * Same as SyncDirectory without listing the destination: every file is
+ * uploaded, overwriting existing objects. Small files are sent with single
+ * \c PutObject requests over the \c jobs pooled connections, avoiding the
+ * three or more round trips of multipart uploads.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] dir source directory
+ * \param[in] bucket destination bucket
+ * \param[in] prefix destination "directory", prepended to relative paths
+ * followed by \c '/' if not already ending with one
+ * \param[in] cfg configuration, comparison and deletion options are ignored
+ * \return plan and number of uploaded objects
+ * \see SyncDirectory
+ */
+SyncResult UploadDirectory(const S3Api &s3, const std::string &dir,
+                           const std::string &bucket,
+                           const std::string &prefix,
+                           const SyncConfig &cfg = {});
+
+/**
+ * \brief Copy new and modified objects from source prefix to destination
+ * prefix with server-side copies.
+ *
+ * \param[in] s3 S3Api instance used to copy credentials and endpoints from
+ * \param[in] srcBucket source bucket
+ * \param[in] srcPrefix source "directory", \c '/' is appended to non-empty
+ * prefixes not ending with one
+ * \param[in] dstBucket destination bucket
+ * \param[in] dstPrefix destination "directory", \c '/' is appended to
+ * non-empty prefixes not ending with one
+ * \param[in] cfg configuration
+ * \return plan and number of transferred and deleted objects
+ * \throw first exception thrown while listing
+ * \see SyncDirectory
+ */
+SyncResult SyncPrefix(const S3Api &s3, const std::string &srcBucket,
+                      const std::string &srcPrefix,
+                      const std::string &dstBucket,
+                      const std::string &dstPrefix,
+                      const SyncConfig &cfg = {});
+} // namespace api
+} // namespace sss
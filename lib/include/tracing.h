@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file tracing.h
+ * \brief Span based tracing of transfers and requests.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sss {
+/**
+ * \addtogroup Metrics
+ * @{
+ */
+
+class Span;
+
+/**
+ * \brief Write completed spans to a file.
+ *
+ * Two formats are supported:
+ * - \c JSON_LINES: one JSON object per span and line with \c name, \c id,
+ *   \c parent (zero for root spans), \c thread, \c start_us (microseconds
+ *   since the Unix epoch), \c duration_us, \c error and \c attributes.
+ * - \c CHROME_TRACE: array of complete (\c "ph":"X") trace events, which
+ *   can be loaded into \c chrome://tracing or \c ui.perfetto.dev; span ids
+ *   and attributes are stored in \c args.
+ *
+ * Spans are written when they end, children before their parents.
+ * Thread-safe, can be shared by multiple transfers through
+ * S3DataTransferConfig::tracer.
+ */
+class Tracer {
+public:
+  enum Format { JSON_LINES, CHROME_TRACE };
+  /// \brief Open output file.
+  /// \param[in] fileName output file, truncated if it exists
+  /// \param[in] format output format
+  /// \throw std::runtime_error if the file cannot be opened
+  explicit Tracer(const std::string &fileName, Format format = JSON_LINES);
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+  /// \brief Complete and close output file.
+  ~Tracer();
+  /// \brief Return \c CHROME_TRACE for files with \c .json extension,
+  /// \c JSON_LINES otherwise.
+  static Format FormatFromFileName(const std::string &fileName);
+  /// \brief Flush output file.
+  void Flush();
+
+private:
+  friend class Span;
+  uint64_t NextId() { return ++lastId_; }
+  void Write(const Span &span, std::chrono::steady_clock::time_point end);
+  Format format_;
+  std::ofstream os_;
+  std::mutex mutex_;
+  std::atomic<uint64_t> lastId_{0};
+  bool first_ = true;
+  /// epoch of steady clock in microseconds since the Unix epoch
+  int64_t epoch_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * \brief Timed operation, nested into a parent span.
+ *
+ * A span started without an explicit parent is nested into the innermost
+ * span active in the current thread, work executed by other threads is
+ * nested by passing the parent explicitly. Spans without a tracer and a
+ * parent are inactive: all methods return immediately, the cost of tracing
+ * disabled is a thread-local lookup per span.
+ *
+ * Spans end when destroyed or when End() is called; spans destroyed while
+ * an exception is propagating are marked as failed.
+ *
+ * \code{.cpp}
+ * Tracer tracer("upload.json", Tracer::CHROME_TRACE);
+ * Span upload("Upload", &tracer);
+ * upload.Set("bytes", size);
+ * auto f = std::async(std::launch::async, [&] {
+ *   Span part("Part", &upload);
+ *   s3.UploadPart(...); // request span nested into part
+ * });
+ * \endcode
+ */
+class Span {
+public:
+  /// \brief Start span nested into current thread's active span.
+  /// \param[in] name span name
+  /// \param[in] tracer output, if \c nullptr use parent's tracer
+  explicit Span(std::string name, Tracer *tracer = nullptr);
+  /// \brief Start span nested into parent.
+  /// \param[in] name span name
+  /// \param[in] parent parent span, possibly started by another thread; if
+  /// \c nullptr or inactive the span is inactive
+  Span(std::string name, Span *parent);
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+  /// \brief End span.
+  ~Span();
+  /// \return \c true if span is recorded
+  bool Active() const { return tracer_ != nullptr; }
+  /// \brief Add attribute.
+  void Set(const std::string &key, const std::string &value);
+  void Set(const std::string &key, const char *value) {
+    Set(key, std::string(value));
+  }
+  void Set(const std::string &key, double value);
+  void Set(const std::string &key, bool value);
+  template <typename T>
+  std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>
+  Set(const std::string &key, T value) {
+    if (tracer_)
+      attributes_.emplace_back(key, std::to_string(value));
+  }
+  /// \brief Mark span as failed and add \c error attribute.
+  void SetError(const std::string &message);
+  /// \brief Return number of spans with the same name previously started
+  /// under the same parent, i.e. the retry number of a request.
+  int Attempt();
+  /// \brief End span and write it to tracer, further calls are ignored.
+  void End();
+  /// \return innermost active span started by the current thread or
+  /// \c nullptr
+  static Span *Current();
+
+private:
+  friend class Tracer;
+  void Begin(Tracer *tracer, Span *parent);
+  std::string name_;
+  Tracer *tracer_ = nullptr;
+  Span *parent_ = nullptr;
+  Span *previous_ = nullptr; ///< active span of thread when started
+  uint64_t id_ = 0;
+  uint64_t parentId_ = 0;
+  uint32_t thread_ = 0;
+  int exceptions_ = 0; ///< uncaught exceptions when started
+  bool failed_ = false;
+  std::chrono::steady_clock::time_point start_;
+  /// {key, JSON value}
+  std::vector<std::pair<std::string, std::string>> attributes_;
+  std::mutex childrenMutex_;
+  std::unordered_map<std::string, int> children_; ///< spans started by name
+};
+
+/**
+ * @}
+ */
+} // namespace sss
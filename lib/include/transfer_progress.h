@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file transfer_progress.h
+ * \brief Progress and throughput of parallel transfers.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sss {
+/**
+ * \addtogroup Metrics
+ * @{
+ */
+
+/// \brief Progress snapshot passed to TransferProgress observers.
+struct ProgressInfo {
+  using Duration = std::chrono::milliseconds;
+  uint64_t totalBytes = 0; ///< bytes to transfer
+  uint64_t bytes = 0;      ///< bytes transferred
+  size_t parts = 0;        ///< number of parts
+  size_t partsDone = 0;    ///< parts completed successfully
+  size_t partsInFlight = 0; ///< parts being transferred
+  size_t retries = 0;       ///< requests sent again for the same part
+  double throughput = 0;    ///< bytes per second since previous report
+  double averageThroughput = 0; ///< bytes per second since start
+  Duration elapsed{0};          ///< time since start
+  Duration sinceLastData{0};    ///< time since last byte transferred
+  std::vector<uint64_t> partBytes; ///< bytes transferred per part
+  bool finished = false;           ///< \c true in last report
+  /// \return transferred fraction in the [0, 1] range
+  double Fraction() const {
+    return totalBytes ? double(bytes) / totalBytes : (finished ? 1. : 0.);
+  }
+};
+
+/**
+ * \brief Aggregate progress of all parts of a transfer.
+ *
+ * Shared among all the parallel jobs of a transfer through
+ * S3DataTransferConfig::progress. Byte counts are updated from the
+ * \c libcurl progress callback of each WebClient with atomic additions;
+ * bytes received or sent by failed requests are subtracted when the
+ * request completes. \c libcurl invokes the callback at least once per
+ * second also when no data is flowing, so the observer is notified
+ * periodically and stalled transfers can be detected through
+ * ProgressInfo::sinceLastData.
+ *
+ * The observer is invoked at most once per reporting interval by the
+ * thread of the job that updated the progress last, it must therefore be
+ * fast and thread-safe; the last report, with \c finished set, is sent by
+ * Finish(), which Upload, Download and Copy call also when failing.
+ *
+ * \code{.cpp}
+ * config.progress = std::make_shared<TransferProgress>(
+ *     [](const ProgressInfo &p) {
+ *       std::cerr << '\r' << int(100 * p.Fraction()) << "% "
+ *                 << p.throughput / 0x100000 << " MiB/s" << std::flush;
+ *     });
+ * Download(config);
+ * \endcode
+ */
+class TransferProgress {
+public:
+  using Observer = std::function<void(const ProgressInfo &)>;
+  using Clock = std::chrono::steady_clock;
+  /// Constructor
+  /// \param[in] observer function invoked with progress reports
+  /// \param[in] interval minimum time between reports
+  explicit TransferProgress(
+      Observer observer = Observer(),
+      std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+  /// \brief Reset counters, called by transfer functions before sending
+  /// any data; must not be called while other methods are executing.
+  /// \param[in] totalBytes number of bytes to transfer
+  /// \param[in] parts number of parts
+  void Start(uint64_t totalBytes, size_t parts);
+  /// \brief Mark part as in flight.
+  void PartBegin(size_t part);
+  /// \brief Mark part as completed.
+  /// \param[in] part part index
+  /// \param[in] success \c true if part transferred successfully
+  void PartEnd(size_t part, bool success);
+  /// \brief Notify start of request for part, requests following the first
+  /// one are counted as retries.
+  void RequestBegin(size_t part);
+  /// \brief Add transferred bytes and report progress if interval expired.
+  /// \param[in] part part index
+  /// \param[in] bytes number of bytes, negative to discard bytes of failed
+  /// requests
+  void Add(size_t part, int64_t bytes);
+  /// \brief Send last report.
+  void Finish();
+  /// \return current progress
+  ProgressInfo Snapshot() const;
+
+private:
+  void Report(Clock::time_point now);
+  using Counter = std::atomic<uint64_t>;
+  Observer observer_;
+  Clock::duration interval_;
+  Clock::time_point start_;
+  uint64_t totalBytes_ = 0;
+  size_t parts_ = 0;
+  std::unique_ptr<Counter[]> partBytes_;
+  std::unique_ptr<Counter[]> partRequests_;
+  Counter bytes_{0};
+  Counter partsDone_{0};
+  Counter partsInFlight_{0};
+  Counter retries_{0};
+  // times in nanoseconds since start
+  std::atomic<int64_t> nextReport_{0};
+  std::atomic<int64_t> lastData_{0};
+  std::atomic<int64_t> reportedTime_{0};
+  Counter reportedBytes_{0};
+  std::mutex reporting_; ///< held while invoking observer
+};
+
+/// \brief Track progress of a single part: set progress on client and mark
+/// part as in flight, reset client and mark part as done when going out of
+/// scope.
+/// \tparam ClientT type with a \c SetProgress(TransferProgress*, size_t)
+/// method, WebClient or S3Api
+template <typename ClientT> class PartProgress {
+public:
+  /// Constructor
+  /// \param[in] progress shared progress, \c nullptr to disable
+  /// \param[in] client client sending the requests for the part
+  /// \param[in] part part index
+  PartProgress(TransferProgress *progress, ClientT &client, size_t part)
+      : progress_(progress), client_(client), part_(part) {
+    if (!progress_)
+      return;
+    progress_->PartBegin(part_);
+    client_.SetProgress(progress_, part_);
+  }
+  PartProgress(const PartProgress &) = delete;
+  PartProgress &operator=(const PartProgress &) = delete;
+  /// Mark part as successfully transferred
+  void Success() { success_ = true; }
+  /// Destructor
+  ~PartProgress() {
+    if (!progress_)
+      return;
+    client_.SetProgress(nullptr, 0);
+    progress_->PartEnd(part_, success_);
+  }
+
+private:
+  TransferProgress *progress_;
+  ClientT &client_;
+  size_t part_;
+  bool success_ = false;
+};
+
+/// \brief Send last progress report when going out of scope, also when the
+/// transfer fails with an exception.
+class ProgressFinisher {
+public:
+  /// Constructor
+  /// \param[in] progress shared progress, \c nullptr to disable
+  explicit ProgressFinisher(TransferProgress *progress)
+      : progress_(progress) {}
+  ProgressFinisher(const ProgressFinisher &) = delete;
+  ProgressFinisher &operator=(const ProgressFinisher &) = delete;
+  /// Destructor
+  ~ProgressFinisher() {
+    if (!progress_)
+      return;
+    try {
+      progress_->Finish();
+    } catch (...) {
+      // never throw from destructor
+    }
+  }
+
+private:
+  TransferProgress *progress_;
+};
+/// \brief Print progress on a single line: percentage, MiB transferred,
+/// instantaneous and average throughput, parts, retries and, if no data was
+/// received or sent in the last second, time since last byte.
+std::ostream &operator<<(std::ostream &os, const ProgressInfo &p);
+/**
+ * @}
+ */
+} // namespace sss
@@ -44,6 +44,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "common.h"
@@ -74,13 +75,34 @@ URL ParseURL(const std::string &s);
 /// URL-encode url
 /// \param s text
 /// \return url-encoded url
-std::string UrlEncode(const std::string &s);
+std::string UrlEncode(std::string_view s);
+
+/// URL-encode text and append it to buffer
+/// \param s text
+/// \param out buffer receiving url-encoded text
+void UrlEncode(std::string_view s, std::string &out);
 
 /// URL-encode url from \c {key,value} pairs
 /// \param p \c {key,value} map
 /// \return url-encoded url
 std::string UrlEncode(const Map &p);
 
+/// URL-encode \c {key,value} pairs and append query string to buffer
+/// \param p \c {key,value} map
+/// \param out buffer receiving \c key1=value1&key2=value2...
+void UrlEncode(const Map &p, std::string &out);
+
+/// URL-encode each segment of path, leaving \c '/' separators intact, as
+/// required for S3 keys in request URLs and canonical URIs
+/// \param path path \c /bucket/key
+/// \return url-encoded path
+std::string UrlEncodePath(std::string_view path);
+
+/// URL-encode path and append it to buffer
+/// \param path path \c /bucket/key
+/// \param out buffer receiving url-encoded path
+void UrlEncodePath(std::string_view path, std::string &out);
+
 /// Time data type, used to generate pre-signed URLs
 struct Time {
   std::string timeStamp; ///< full date-time in \c "%Y%m%dT%H%M%SZ" format
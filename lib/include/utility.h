@@ -219,6 +219,26 @@ std::string ToUpper(std::string s);
 /// \param s text
 /// \return lowercase text
 std::string ToLower(std::string s);
+
+/// Encode data in base64 format
+/// \ingroup Utility
+/// \param data data to encode
+/// \param size size of data in bytes
+/// \return base64 text
+std::string Base64Encode(const void *data, size_t size);
+
+/// Compute value of \c Content-MD5 header: base64 encoded MD5 digest
+/// \ingroup Utility
+/// \param data request body
+/// \return base64 encoded MD5 digest of data
+std::string ContentMD5(const std::string &data);
+
+/// Compute MD5 digest of file content, equal to the ETag of objects uploaded
+/// with a single request
+/// \ingroup Utility
+/// \param fileName file name
+/// \return hex encoded MD5 digest
+std::string FileMD5(const std::string &fileName);
 } // namespace sss
 
 /**
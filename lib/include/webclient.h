@@ -49,11 +49,20 @@
 #include <array>
 #include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "common.h"
+#include "endpoint_selector.h"
+#include "rate_limiter.h"
+#include "metrics_registry.h"
+#include "request_metrics.h"
+#include "response_parser.h"
+#include "tracing.h"
+#include "transfer_progress.h"
 #include "url_utility.h"
 #include "utility.h"
 
@@ -70,6 +79,9 @@ namespace sss {
  *   - GetResponseHeader()
  *   - GetContentText()
  *   - GetHeaderText()
+ *   - GetContentView()
+ *   - GetHeaderView()
+ *   - GetHeader()
  *
  * Error handling is managed by having libcurl log errors into a char buffer.
  * When a method fails returning \c false, you can extract the error message
@@ -153,13 +165,7 @@ public:
   /// Disable copy constructor: only one libcurl handle per thread allwed
   WebClient(const WebClient &) = delete;
   /// Move constructor
-  WebClient(WebClient &&other)
-      : endpoint_(other.endpoint_), path_(other.path_), method_(other.method_),
-        params_(other.params_), headers_(other.headers_),
-        writeBuffer_(other.writeBuffer_), headerBuffer_(other.headerBuffer_),
-        curl_(other.curl_) {
-    other.curl_ = NULL;
-  }
+  WebClient(WebClient &&other);
   /// Default constructor. First instance initializes libcurl.
   WebClient() { InitEnv(); }
   /// Constructor initializing only URL
@@ -180,9 +186,57 @@ public:
   ~WebClient();
   /// Send request.
   ///
+  /// The request is admitted through the configured RequestLimiter before
+  /// being sent; bytes received are charged to the limiter after the
+  /// transfer completes.
+  ///
   /// \return \c false if error, retrieve error message through
   /// WebClient::ErroMsg
+  /// \throws RateLimitError if the limiter is in fail-fast mode and the
+  /// request cannot be admitted
   bool Send();
+  /// Set request limiter, default is RequestLimiter::Global().
+  /// \param[in] limiter request limiter, \c nullptr to disable rate limiting
+  void SetRequestLimiter(RequestLimiter *limiter) { limiter_ = limiter; }
+  /// Set bandwidth shaper: all data sent and received through read and write
+  /// functions consumes one token per byte. The same shaper can be shared
+  /// among multiple instances to cap aggregate bandwidth, rate can be changed
+  /// at any time through TokenBucket::SetRate.
+  /// \param[in] shaper shared token bucket, \c nullptr to disable shaping
+  void SetBandwidthShaper(std::shared_ptr<TokenBucket> shaper) {
+    shaper_ = shaper;
+  }
+  /// Set flag checked periodically during transfers: when the flag is set
+  /// the transfer is aborted and Send() fails with error
+  /// \c CURLE_ABORTED_BY_CALLBACK.
+  /// \param[in] cancel pointer to flag, \c nullptr to disable; the flag must
+  /// outlive any transfer started while set
+  void SetCancelFlag(const std::atomic<bool> *cancel);
+  /// Set progress updated with the bytes sent and received by each request;
+  /// bytes of requests failing or returning an error status are discarded.
+  /// \param[in] progress shared progress, \c nullptr to disable
+  /// \param[in] part index of part transferred by the requests
+  void SetProgress(TransferProgress *progress, size_t part = 0);
+  /// Set endpoint selector notified of the start and completion of each
+  /// request, with time to first byte and success status.
+  /// \param[in] selector endpoint selector, \c nullptr to disable
+  void SetEndpointSelector(EndpointSelector *selector) {
+    selector_ = selector;
+  }
+  /// Set registry receiving metrics of each request, default is
+  /// MetricsRegistry::Global().
+  /// \param[in] registry metrics registry, \c nullptr to disable
+  void SetMetricsRegistry(MetricsRegistry *registry) { registry_ = registry; }
+  /// Set operation name used to label request metrics, e.g. \c GetObject;
+  /// the HTTP method is used if empty.
+  void SetOperation(const std::string &operation) { operation_ = operation; }
+  /// Set operation name, reusing the storage of the previous name.
+  void SetOperation(const char *operation) { operation_.assign(operation); }
+  /// Set tracer receiving a span per request, nested into the span active in
+  /// the calling thread if any; requests are also traced without a tracer
+  /// when sent from within an active span.
+  /// \param[in] tracer tracer, \c nullptr to trace only nested requests
+  void SetTracer(Tracer *tracer) { tracer_ = tracer; }
   /// Set SSL verification options: peer and/or host
   /// Verification should be disabled when sending https requests through
   /// SSH tunnels.
@@ -195,7 +249,8 @@ public:
   /// Set endpoint: `<proto>://<server>:<port>`
   void SetEndpoint(const std::string &ep);
   /// Set URL path.
-  /// \param[in] path URL with endpoint part removed.
+  /// \param[in] path URL with endpoint part removed, already URL-encoded
+  /// \see UrlEncodePath
   void SetPath(const std::string &path);
   /// Store headers into internal buffer.
   /// \param[in] headers HTTP headers
@@ -234,6 +289,27 @@ public:
   /// Get headers as text.
   /// \return response headers as a single string.
   std::string GetHeaderText() const;
+  /// \brief Get response body without copying.
+  /// \return view of the response buffer, valid until the next request.
+  std::string_view GetContentView() const {
+    return std::string_view(writeBuffer_.data.data(), writeBuffer_.data.size());
+  }
+  /// \brief Get raw response headers without copying.
+  /// \return view of the header buffer, valid until the next request.
+  std::string_view GetHeaderView() const {
+    return std::string_view(headerBuffer_.data(), headerBuffer_.size());
+  }
+  /// \brief Get response header, case-insensitive.
+  ///
+  /// Headers are parsed as they are received; the returned view references
+  /// the internal header buffer and is valid until the next request.
+  /// \param[in] name header name
+  /// \return header value, empty if not found
+  std::string_view GetHeader(std::string_view name) const {
+    return responseHeaders_.Get(name);
+  }
+  /// Get parsed headers of last response.
+  const HTTPHeaderMap &ResponseHeaders() const { return responseHeaders_; }
   /// Set function libcurl uses to store response data.
   /// \param[in] f pointer to function called by \a libcurl to consume returned
   /// data.
@@ -284,6 +360,15 @@ public:
   /// \return \a libcurl error as returned by \c curl_easy_strerror or \c
   /// curl_multi_strerror.
   std::string ErrorMsg() const;
+  /// Return \a libcurl error code of last executed request.
+  CURLcode ErrorCode() const { return errorCode_; }
+  /// Return metrics of last executed request.
+  const RequestMetrics &LastRequestMetrics() const { return lastMetrics_; }
+  /// Return metrics of all requests executed since construction or last call
+  /// to ResetMetrics().
+  const RequestMetrics &Metrics() const { return metrics_; }
+  /// Reset aggregated metrics.
+  void ResetMetrics() { metrics_ = RequestMetrics(); }
   /// \brief Passthrough to \c curl_easy_setopt
   ///
   /// https://curl.se/libcurl/c/curl_easy_setopt.html
@@ -301,6 +386,7 @@ public:
     writeBuffer_.data.clear();
     writeBuffer_.offset = 0;
     headerBuffer_.clear();
+    responseHeaders_.Clear();
   }
   /// Reset read/write functions to default.
   void ResetRWFunctions() {
@@ -318,21 +404,33 @@ private:
   bool Status(CURLcode cc) const;
   void InitEnv();
   bool Init();
-  bool BuildURL();
+  void BuildURL() const;
   static size_t Writer(char *data, size_t size, size_t nmemb,
                        Buffer *outbuffer);
   static size_t HeaderWriter(char *data, size_t size, size_t nmemb,
-                             std::vector<char> *writerData);
+                             WebClient *self);
   static size_t Reader(void *ptr, size_t size, size_t nmemb, Buffer *inBuffer);
   static size_t MemReader(void *ptr, size_t size, size_t nmemb,
                           MemReadBuffer *inBuffer);
+  static size_t ShapedReader(void *ptr, size_t size, size_t nmemb,
+                             WebClient *self);
+  static size_t ShapedWriter(char *data, size_t size, size_t nmemb,
+                             WebClient *self);
+  static int XferInfo(WebClient *self, curl_off_t dltotal, curl_off_t dlnow,
+                      curl_off_t ultotal, curl_off_t ulnow);
+  void CaptureMetrics();
+  void TraceRequest(Span &span, const std::string &endpoint);
 
 private:
   CURL *curl_ = NULL; ///< curl handle C pointer
-  std::string url_;   ///< full url address <protocol>://<server name>:port/path
+  /// full url address <protocol>://<server name>:port/path, built from
+  /// endpoint, path and parameters when the request is sent
+  mutable std::string url_;
+  mutable bool urlDirty_ = false; ///< endpoint, path or parameters changed
   std::array<char, CURL_ERROR_SIZE> errorBuffer_; ///< holds error message
   Buffer writeBuffer_;                            ///< store received response
   std::vector<char> headerBuffer_; ///< store received response buffer
+  HTTPHeaderMap responseHeaders_{&headerBuffer_}; ///< parsed headers
   std::string endpoint_;           ///< https://a.b.c:8080
   std::string path_;               ///< /root/child1/child1.1
   Map headers_;        ///<{{{"host", "myhost"},...} --> host: myhost
@@ -341,9 +439,28 @@ private:
   std::string method_; ///< GET | POST | PUT | HEAD | DELETE
   curl_slist *curlHeaderList_ = NULL; ///< C struct --> NULL not nullptr
   long responseCode_ = 0;             ///< CURL uses a long type for status
+  CURLcode errorCode_ = CURLE_OK;     ///< libcurl error code of last request
   std::string urlEncodedPostData_;    ///< store url-encodd post data
   Buffer readBuffer_;                 ///< store data to send
   MemReadBuffer refBuffer_;           ///< pointer to input memory region.
+  RequestLimiter *limiter_ = &RequestLimiter::Global(); ///< request limiter
+  size_t requestBodySize_ = 0; ///< size of data to send, used by limiter
+  std::shared_ptr<TokenBucket> shaper_; ///< bandwidth shaper
+  ReadFunction readFunction_ = NULL;    ///< user read function
+  void *readData_ = NULL;               ///< user data passed to read function
+  WriteFunction writeFunction_ = NULL;  ///< user write function
+  void *writeData_ = NULL; ///< user data passed to write function
+  const std::atomic<bool> *cancel_ = nullptr; ///< abort transfer if set
+  EndpointSelector *selector_ = nullptr; ///< notified of request completion
+  RequestMetrics lastMetrics_; ///< metrics of last request
+  RequestMetrics metrics_;     ///< aggregated metrics
+  MetricsRegistry *registry_ = &MetricsRegistry::Global(); ///< metrics sink
+  std::string operation_; ///< operation name used to label metrics
+  RequestRecorder recorder_; ///< cached request series of registry_
+  TransferProgress *progress_ = nullptr; ///< updated during transfers
+  size_t progressPart_ = 0;              ///< part index passed to progress_
+  uint64_t progressBytes_ = 0; ///< bytes added to progress_ by last request
+  Tracer *tracer_ = nullptr;   ///< receives request spans
                                       /**
                                        * @}
                                        */
@@ -36,6 +36,7 @@
 #pragma once
 #include "tinyxml2.h"
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -48,7 +49,7 @@
 /// \param[in] xml XML text.
 /// \param[in] element name of XML tag to search for.
 /// \return XML text element.
-std::string FindElementText(const std::string &xml, const std::string &element);
+std::string FindElementText(std::string_view xml, const std::string &element);
 /// \brief Extract text under XML path.
 ///
 /// \param[in] XML text.
@@ -179,11 +180,71 @@ std::vector<std::string> ParseXMLMultiPathText(const std::string &xml,
  * \return list of record maps, each map contains the {field name, field value}
  *         entries for one record.
  *
+ * \deprecated records are aligned by position, fields missing from some
+ * records shift the values of the following ones; use ExtractRecords.
  */
 std::vector<std::unordered_map<std::string, std::string>> RecordList(
     const std::string &prefix,
     const std::unordered_map<std::string, std::vector<std::string>> &domMap);
 
+/// \brief Records extracted from XML elements, stored by column.
+///
+/// Each field is a path relative to the record element, lowercase and without
+/// namespace prefixes, e.g. \c "/owner/id"; attributes are stored as
+/// \c "/path/@name". The values of field \c f in record \c r are
+/// \code{.cpp}
+/// values[f][offsets[f][r]] ... values[f][offsets[f][r + 1] - 1]
+/// \endcode
+/// so that missing or repeated fields do not affect other records.
+///
+/// \see ExtractRecords
+struct XMLColumns {
+  std::vector<std::string> fields;               ///< field paths
+  std::vector<std::vector<std::string>> values;  ///< values of each field
+  std::vector<std::vector<size_t>> offsets; ///< first value of each record
+  size_t size = 0;                          ///< number of records
+  /// \return index of field or \c fields.size() if not found
+  size_t Field(const std::string &path) const;
+  /// \return number of values of field in record
+  size_t Count(size_t record, size_t field) const;
+  /// \return first value of field in record or empty string
+  const std::string &Get(size_t record, size_t field) const;
+  /// \return first value of field in record or empty string
+  const std::string &Get(size_t record, const std::string &path) const;
+};
+
+/// \brief Extract all records found at path in a single pass.
+///
+/// Each element matching \c path is a record, built from the text elements
+/// and attributes of its own subtree. Path matching is case insensitive.
+///
+/// \b Input
+/// \code{.xml}
+/// <ListVersionsResult>
+///   <Version>
+///     <Key>k1</Key>
+///     <Owner><ID>o1</ID></Owner>
+///   </Version>
+///   <Version>
+///     <Key>k2</Key>
+///   </Version>
+/// </ListVersionsResult>
+/// \endcode
+///
+/// \b Output of \c ExtractRecords(xml, "/listversionsresult/version")
+/// \code{.cpp}
+/// XMLColumns c = {.fields = {"/key", "/owner/id"},
+///                 .values = {{"k1", "k2"}, {"o1"}},
+///                 .offsets = {{0, 1, 2}, {0, 1, 1}},
+///                 .size = 2};
+/// \endcode
+///
+/// \param[in] xml XML text
+/// \param[in] path path to record elements: \c "/tag1/tag12/...."
+/// \return records stored by column
+/// \throw std::logic_error if XML is malformed
+XMLColumns ExtractRecords(std::string_view xml, const std::string &path);
+
 /// \brief Return all elements at location grouped by element name
 ///
 /// \b Input
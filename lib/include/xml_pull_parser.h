@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file xml_pull_parser.h
+ * \brief Streaming XML parser returning views into the input buffer.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace sss {
+/**
+ * \addtogroup Parsing
+ * @{
+ */
+
+/**
+ * \brief Pull XML parser.
+ *
+ * Returns one event at a time without building a DOM: element names and
+ * text are returned as views into the input buffer, which must outlive the
+ * parser. Declarations, processing instructions and comments are skipped,
+ * attributes are available through \c Attributes(); whitespace only text is
+ * not reported.
+ *
+ * \code{.cpp}
+ * XMLPullParser p(xml);
+ * string key;
+ * for (auto e = p.Next(); e != XMLPullParser::END_DOCUMENT; e = p.Next()) {
+ *   if (e == XMLPullParser::START_ELEMENT && p.NameIs("key")) {
+ *     key.clear();
+ *   } else if (e == XMLPullParser::TEXT) {
+ *     p.AppendText(key);
+ *   }
+ * }
+ * \endcode
+ */
+class XMLPullParser {
+public:
+  /// Parser events
+  enum Event { START_ELEMENT, END_ELEMENT, TEXT, END_DOCUMENT };
+  /// Constructor
+  /// \param[in] xml XML text, not copied
+  explicit XMLPullParser(std::string_view xml) : xml_(xml) {}
+  /// \brief Move to next event.
+  /// \return event type
+  /// \throw std::logic_error if XML is malformed
+  Event Next();
+  /// \return name of current element, valid after \c START_ELEMENT and
+  /// \c END_ELEMENT events
+  std::string_view Name() const { return name_; }
+  /// \return \c true if current element name matches \c name, case
+  /// insensitive
+  bool NameIs(std::string_view name) const;
+  /// \return depth of current element, \c 1 for root element; after a
+  /// \c TEXT event the depth of the element containing the text
+  int Depth() const { return depth_; }
+  /// \brief Invoke function for each attribute of current element.
+  ///
+  /// Valid after \c START_ELEMENT event, values are passed as found in the
+  /// XML buffer, use XMLUnescape to decode entities.
+  /// \param[in] f function receiving {name, value} pairs
+  void Attributes(
+      const std::function<void(std::string_view, std::string_view)> &f) const;
+  /// \return text as found in the XML buffer, entities are not decoded
+  std::string_view RawText() const { return text_; }
+  /// \brief Append decoded text to string.
+  /// \param[out] out string to append text to
+  void AppendText(std::string &out) const;
+
+private:
+  std::string_view xml_;
+  size_t pos_ = 0;
+  std::string_view name_;
+  std::string_view attributes_;
+  std::string_view text_;
+  bool cdata_ = false;
+  int depth_ = 0;
+  bool popDepth_ = false;  // decrement depth at next event
+  bool selfClosed_ = false; // emit END_ELEMENT for <tag/>
+};
+
+/// \brief Decode XML entities and append text to string.
+/// \param[in] text XML text
+/// \param[out] out string to append decoded text to
+void XMLUnescape(std::string_view text, std::string &out);
+/**
+ * @}
+ */
+} // namespace sss
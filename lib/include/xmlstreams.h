@@ -277,10 +277,13 @@ public:
   /// to sbtrees under path if it does not start with \c '/'
   ///
   /// \return reference to current instance
-  /// \see RecordList
+  /// \see ExtractRecords
   const XMLIStream &operator[](const std::string &p) const {
     // return all text elements under path
     if (p.front() == '/') {
+      if (dd_.empty()) {
+        dd_ = DOMToDict(xml_);
+      }
       auto r = dd_.find(p);
       if (r == end(dd_)) {
         v_ = false;
@@ -293,11 +296,19 @@ public:
       }
       // return all records under path
     } else {
-      auto r = RecordList("/" + p, dd_);
-      if (r.empty()) {
+      const auto c = ExtractRecords(xml_, "/" + p);
+      if (c.size == 0) {
         v_ = false;
       } else {
-        v_ = r;
+        XMLRecords r(c.size);
+        for (size_t f = 0; f != c.fields.size(); ++f) {
+          for (size_t i = 0; i != c.size; ++i) {
+            if (c.Count(i, f)) {
+              r[i][c.fields[f]] = c.Get(i, f);
+            }
+          }
+        }
+        v_ = std::move(r);
       }
     }
     return *this;
@@ -328,11 +339,13 @@ public:
   }
   /// Constructor
   /// \param[in] xml xml text
-  XMLIStream(const std::string &xml) : dd_(DOMToDict(xml)) {}
+  XMLIStream(const std::string &xml) : xml_(xml) {}
 
 private:
+  std::string xml_;
   mutable XMLResult v_;
-  std::unordered_map<std::string, std::vector<std::string>> dd_;
+  // built on first path query
+  mutable std::unordered_map<std::string, std::vector<std::string>> dd_;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+// Recursive batched delete
+
+#include "batch_delete.h"
+#include "list_objects.h"
+#include "retry_policy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace sss {
+namespace api {
+
+//-----------------------------------------------------------------------------
+DeletePrefixResult DeletePrefix(const S3Api &s3, const string &bucket,
+                                const string &prefix,
+                                const DeletePrefixConfig &cfg) {
+  const size_t batchSize =
+      clamp(cfg.batchSize, size_t(1), S3Api::MAX_DELETE_OBJECTS);
+  const size_t maxQueued = 2 * size_t(max(1, cfg.jobs));
+  mutex m;
+  condition_variable cv;
+  deque<vector<ObjectIdentifier>> queue;
+  bool listed = false;
+  atomic<bool> abort{false};
+  exception_ptr error;
+  DeletePrefixResult result;
+  auto fail = [&] {
+    lock_guard<mutex> lock(m);
+    if (!error)
+      error = current_exception();
+    abort = true;
+    cv.notify_all();
+  };
+  auto worker = [&] {
+    S3Api client(s3.Access(), s3.Secret(), s3.Endpoint(),
+                 s3.SigningEndpoint());
+    client.SetEndpointSelector(s3.GetEndpointSelector());
+    const RetryPolicy retry(cfg.maxRetries);
+    while (true) {
+      vector<ObjectIdentifier> batch;
+      {
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [&] { return !queue.empty() || listed || abort; });
+        if (abort || queue.empty())
+          return;
+        batch = move(queue.front());
+        queue.pop_front();
+        cv.notify_all();
+      }
+      try {
+        auto r = retry.Run([&] {
+          return client.DeleteObjects(bucket, batch, true, cfg.headers);
+        });
+        lock_guard<mutex> lock(m);
+        result.deleted += batch.size() - r.errors.size();
+        result.errors.insert(result.errors.end(),
+                             make_move_iterator(r.errors.begin()),
+                             make_move_iterator(r.errors.end()));
+      } catch (...) {
+        fail();
+        return;
+      }
+    }
+  };
+  vector<thread> workers;
+  for (int i = 0; i != max(1, cfg.jobs); ++i) {
+    workers.emplace_back(worker);
+  }
+  try {
+    S3Api::ListObjectV2Config lc;
+    lc.prefix = prefix;
+    vector<ObjectIdentifier> batch;
+    auto push = [&] {
+      unique_lock<mutex> lock(m);
+      cv.wait(lock, [&] { return queue.size() < maxQueued || abort; });
+      queue.push_back(move(batch));
+      batch.clear();
+      cv.notify_all();
+    };
+    for (const auto &o :
+         ListObjectsV2Range(s3, bucket, lc, true, cfg.headers)) {
+      if (abort)
+        break;
+      batch.push_back({o.key, ""});
+      if (batch.size() == batchSize)
+        push();
+    }
+    if (!batch.empty())
+      push();
+  } catch (...) {
+    fail();
+  }
+  {
+    lock_guard<mutex> lock(m);
+    listed = true;
+    cv.notify_all();
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+  return result;
+}
+} // namespace api
+} // namespace sss
@@ -42,8 +42,8 @@ using namespace std;
 namespace sss {
 namespace api {
 
-std::vector<BucketInfo> ParseBuckets(const std::string &xml);
-AccessControlPolicy ParseACL(const std::string &xml);
+std::vector<BucketInfo> ParseBuckets(std::string_view xml);
+AccessControlPolicy ParseACL(std::string_view xml);
 std::string GenerateAclXML(const AccessControlPolicy &);
 
 //------------------------------------------------------------------------------
@@ -77,13 +77,7 @@ string S3Api::CreateBucket(const std::string &bucket, const Headers &headers,
     }
   }();
   auto &wc = Send(reqParams);
-  auto h = ParseHeaders(wc.GetHeaderText());
-  for (auto kv : h) {
-    if (ToLower(kv.first) == "location") {
-      return kv.second;
-    }
-  }
-  return "";
+  return string(wc.GetHeader("Location"));
 }
 
 //------------------------------------------------------------------------------
@@ -95,39 +89,37 @@ void S3Api::DeleteBucket(const std::string &bucket, const Headers &headers) {
 Headers S3Api::HeadBucket(const string &bucket, const Headers &headers) {
   const auto &wc =
       Send({.method = "HEAD", .bucket = bucket, .headers = headers});
-  return HTTPHeaders(wc.GetContentText());
+  return wc.ResponseHeaders().ToHeaders();
 }
 
 //------------------------------------------------------------------------------
 vector<BucketInfo> S3Api::ListBuckets(const Headers &headers) {
   const auto &wc = Send({.method = "GET", .headers = headers});
-  const string &c = wc.GetContentText();
-  return ParseBuckets(wc.GetContentText());
+  return ParseBuckets(wc.GetContentView());
 }
 
 //------------------------------------------------------------------------------
 AccessControlPolicy S3Api::GetBucketAcl(const string &bucket) {
   const auto &c =
       Send({.method = "GET", .bucket = bucket, .params = {{"acl", ""}}})
-          .GetContentText();
+          .GetContentView();
   return ParseACL(c);
 }
 
 //------------------------------------------------------------------------------
 void S3Api::PutBucketAcl(const string &bucket, const AccessControlPolicy &acl) {
   const string xml = GenerateAclXML(acl);
-  const auto &c = Send({.method = "PUT",
-                        .bucket = bucket,
-                        .params = {{"acl", ""}},
-                        .uploadData = xml})
-                      .GetContentText();
+  Send({.method = "PUT",
+        .bucket = bucket,
+        .params = {{"acl", ""}},
+        .uploadData = xml});
 }
 //------------------------------------------------------------------------------
-TagMap ParseTaggingResponse(const std::string &xml);
+TagMap ParseTaggingResponse(std::string_view xml);
 TagMap S3Api::GetBucketTagging(const string &bucket) {
   auto r =
       Send({.method = "GET", .bucket = bucket, .params = {{"tagging", ""}}})
-          .GetContentText();
+          .GetContentView();
   return ParseTaggingResponse(r);
 }
 
@@ -169,7 +161,7 @@ void S3Api::PutBucketVersioning(const string &bucket, bool enabled) {
 S3Api::VersioningInfo S3Api::GetBucketVersioning(const string &bucket) {
   auto xml =
       Send({.method = "GET", .bucket = bucket, .params = {{"versioning", ""}}})
-          .GetContentText();
+          .GetContentView();
   return {ToLower(XMLTag(xml, "status")) == "enabled",
           ToLower(XMLTag(xml, "mfadelete")) == "enabled"};
 }
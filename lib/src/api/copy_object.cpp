@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Server-side copy
+
+#include "error.h"
+#include "response_parser.h"
+#include "s3-api.h"
+#include "url_utility.h"
+
+using namespace std;
+
+namespace sss {
+namespace api {
+namespace {
+
+//-----------------------------------------------------------------------------
+// Value of x-amz-copy-source header: "/bucket/key" with every path segment
+// URL-encoded and the optional version id appended as a query parameter
+string CopySource(const string &bucket, const string &key,
+                  const string &versionId) {
+  string source = "/" + UrlEncode(bucket) + "/";
+  UrlEncodePath(key, source);
+  if (!versionId.empty()) {
+    source += "?versionId=";
+    UrlEncode(versionId, source);
+  }
+  return source;
+}
+
+//-----------------------------------------------------------------------------
+// Copy requests can fail after the server has already sent a 200 status code,
+// in which case the error is reported in the response body
+ETag CopyResultETag(const WebClient &wc) {
+  const string_view xml = wc.GetContentView();
+  const string code = XMLTag(xml, "Code");
+  if (!code.empty()) {
+    throw HTTPError("Code: " + code + " Message: " + XMLTag(xml, "Message"),
+                    500, code);
+  }
+  const string etag = TrimETag(XMLTag(xml, "ETag"));
+  if (etag.empty()) {
+    throw runtime_error("No ETag found in copy result");
+  }
+  return etag;
+}
+} // namespace
+
+//=============================================================================
+// Class implementation
+//=============================================================================
+
+ETag S3Api::CopyObject(const string &srcBucket, const string &srcKey,
+                       const string &dstBucket, const string &dstKey,
+                       const Headers &headers, const string &srcVersionId) {
+  Headers h = headers;
+  h["x-amz-copy-source"] = CopySource(srcBucket, srcKey, srcVersionId);
+  const auto &wc =
+      Send({.method = "PUT", .bucket = dstBucket, .key = dstKey, .headers = h});
+  return CopyResultETag(wc);
+}
+
+//-----------------------------------------------------------------------------
+ETag S3Api::UploadPartCopy(const string &bucket, const string &key,
+                           const UploadId &uid, int partNum,
+                           const string &srcBucket, const string &srcKey,
+                           size_t begin, size_t end, Headers headers,
+                           const string &srcVersionId) {
+  if (end < begin) {
+    throw logic_error("Empty copy source range");
+  }
+  headers["x-amz-copy-source"] = CopySource(srcBucket, srcKey, srcVersionId);
+  headers["x-amz-copy-source-range"] =
+      "bytes=" + to_string(begin) + "-" + to_string(end);
+  const Parameters params = {{"partNumber", to_string(partNum + 1)},
+                             {"uploadId", uid}};
+  const auto &wc = Send({.method = "PUT",
+                         .bucket = bucket,
+                         .key = key,
+                         .params = params,
+                         .headers = headers});
+  return CopyResultETag(wc);
+}
+} // namespace api
+} // namespace sss
@@ -30,24 +30,49 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  ******************************************************************************/
+#include "error.h"
 #include "response_parser.h"
 #include "webclient.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <exception>
+#include <limits>
 #include <string>
 using namespace std;
 
 namespace sss {
+namespace {
+// Return value of Retry-After header in seconds, -1 if not present or not in
+// delay-seconds format
+int RetryAfter(const WebClient &wc) {
+  const string_view v = wc.GetHeader("Retry-After");
+  if (v.empty() || !all_of(begin(v), end(v), [](unsigned char c) {
+        return isdigit(c) != 0;
+      }))
+    return -1;
+  // clamp values out of int range instead of failing
+  long long seconds = 0;
+  if (from_chars(v.data(), v.data() + v.size(), seconds).ec != errc())
+    return numeric_limits<int>::max();
+  return int(min(seconds, (long long)numeric_limits<int>::max()));
+}
+} // namespace
 // Handle error by throwing exception
 void HandleError(const WebClient &wc, const string &prefix) {
   if (wc.StatusCode() == 0) {
-    throw runtime_error("Failed to send request");
+    throw TransportError("Failed to send request: " + wc.ErrorMsg(),
+                         wc.ErrorCode());
   }
 
   if (wc.StatusCode() >= 400) {
-    const string errorCode = XMLTag(wc.GetContentText(), "Code");
-    const string errorMsg = XMLTag(wc.GetContentText(), "Message");
-    throw logic_error(prefix + " " + "Code: " + errorCode +
-                      " Message: " + errorMsg);
+    // error responses to HEAD requests have no body
+    const string_view body = wc.GetContentView();
+    const string errorCode = body.empty() ? "" : XMLTag(body, "Code");
+    const string errorMsg = body.empty() ? "" : XMLTag(body, "Message");
+    throw HTTPError(prefix + " " + "Code: " + errorCode +
+                        " Message: " + errorMsg,
+                    wc.StatusCode(), errorCode, RetryAfter(wc));
   }
 }
 } // namespace sss
@@ -0,0 +1,385 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Paginated object listing
+
+#include "list_objects.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace sss {
+namespace api {
+
+//-----------------------------------------------------------------------------
+ListObjectsV2Range::ListObjectsV2Range(const S3Api &s3, const string &bucket,
+                                       const S3Api::ListObjectV2Config &config,
+                                       bool prefetch, const Headers &headers)
+    : s3_(s3.Access(), s3.Secret(), s3.Endpoint(), s3.SigningEndpoint()),
+      bucket_(bucket), config_(config), prefetch_(prefetch),
+      headers_(headers) {
+  s3_.SetEndpointSelector(s3.GetEndpointSelector());
+}
+
+//-----------------------------------------------------------------------------
+future<S3Api::ListObjectV2Result>
+ListObjectsV2Range::Fetch(const string &token) {
+  auto cfg = config_;
+  cfg.continuationToken = token;
+  // the buffer of the previous page is recycled to store the next one
+  return async(prefetch_ ? launch::async : launch::deferred,
+               [this, cfg, r = move(spare_)]() mutable {
+                 s3_.ListObjectsV2(bucket_, cfg, r, headers_);
+                 return move(r);
+               });
+}
+
+//-----------------------------------------------------------------------------
+// Move to next non-empty page, request following page in the background
+bool ListObjectsV2Range::NextPage() {
+  while (!last_) {
+    auto page = next_.get();
+    spare_ = move(page_);
+    page_ = move(page);
+    pos_ = 0;
+    ++pages_;
+    commonPrefixes_.insert(commonPrefixes_.end(),
+                           page_.commonPrefixes.begin(),
+                           page_.commonPrefixes.end());
+    last_ = !page_.truncated || page_.nextContinuationToken.empty();
+    if (!last_) {
+      next_ = Fetch(page_.nextContinuationToken);
+    }
+    // pages with common prefixes only have no keys
+    if (!page_.keys.empty())
+      return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool ListObjectsV2Range::Advance() {
+  if (++pos_ < page_.keys.size())
+    return true;
+  return NextPage();
+}
+
+//-----------------------------------------------------------------------------
+ListObjectsV2Range::Iterator ListObjectsV2Range::begin() {
+  if (started_) {
+    throw logic_error("ListObjectsV2Range can only be iterated once");
+  }
+  started_ = true;
+  next_ = Fetch(config_.continuationToken);
+  return NextPage() ? Iterator(this) : Iterator();
+}
+
+namespace {
+// Range of keys listed by a single worker: keys starting with prefix,
+// greater than startAfter and less than or equal to last
+struct Partition {
+  string prefix;
+  string startAfter;
+  string last; // no upper bound if empty
+  vector<ObjectInfo> keys; // keys found during discovery, not listed
+  bool listed = false;     // true if keys already available
+};
+
+// Valid UTF-8 sequence of U+10FFFF, sorting after any key with the same
+// leading characters
+const char *const MAX_CHAR = "\xF4\x8F\xBF\xBF";
+// maximum number of single common prefixes or shared characters descended
+// into when discovering partitions
+const int MAX_DEPTH = 16;
+
+// Return first key starting with prefix and greater than startAfter, empty
+// if none
+string NextKey(S3Api &s3, const string &bucket, const ParallelListConfig &cfg,
+               const string &prefix, const string &startAfter) {
+  S3Api::ListObjectV2Config lc;
+  lc.prefix = prefix;
+  lc.startAfter = startAfter;
+  lc.maxKeys = 1;
+  S3Api::ListObjectV2Result page;
+  s3.ListObjectsV2(bucket, lc, page, cfg.headers);
+  return page.keys.empty() ? string() : page.keys.front().key;
+}
+
+// Return largest printable character c in [lo, '~'] such that a key starting
+// with prefix + c exists, keys starting with prefix + lo must exist
+int MaxChar(S3Api &s3, const string &bucket, const ParallelListConfig &cfg,
+            const string &prefix, int lo) {
+  int hi = '~';
+  while (lo < hi) {
+    const int c = (lo + hi + 1) / 2;
+    const string after = prefix + char(c - 1) + MAX_CHAR;
+    if (NextKey(s3, bucket, cfg, prefix, after).empty())
+      hi = c - 1;
+    else
+      lo = c;
+  }
+  return lo;
+}
+
+// Split keys starting with prefix and greater than startAfter into ranges
+// bounded by start-after split points.
+// Split points are sampled from the actual keys with single key requests:
+// characters shared by all keys are skipped, then the ranges of the first
+// two characters which differ are found by bisection and split evenly
+vector<Partition> SplitKeySpace(S3Api &s3, const string &bucket,
+                                const ParallelListConfig &cfg,
+                                const string &prefix,
+                                const string &startAfter = "") {
+  const int n = max(1, cfg.splitPoints > 0 ? cfg.splitPoints : 4 * cfg.jobs);
+  const string first = NextKey(s3, bucket, cfg, prefix, startAfter);
+  if (first.empty() || n == 1)
+    return {{.prefix = prefix, .startAfter = startAfter}};
+  string stem = prefix;
+  for (int d = 0; d != MAX_DEPTH && stem.size() < first.size(); ++d) {
+    const string next = first.substr(0, stem.size() + 1);
+    if (!NextKey(s3, bucket, cfg, prefix, next + MAX_CHAR).empty())
+      break;
+    stem = next;
+  }
+  auto at = [&first](size_t i) {
+    return i < first.size() ? max(int((unsigned char)first[i]), int(' '))
+                            : int(' ');
+  };
+  const int lo = min(at(stem.size()), int('~'));
+  const int hi = MaxChar(s3, bucket, cfg, stem, lo);
+  const string stem1 = stem + char(lo);
+  const int lo2 = min(at(stem1.size()), int('~'));
+  const int hi2 = MaxChar(s3, bucket, cfg, stem1, lo2);
+  const uint64_t width = uint64_t(hi2 - lo2 + 1);
+  const uint64_t total = uint64_t(hi - lo + 1) * width;
+  vector<Partition> partitions;
+  string after = startAfter;
+  for (int i = 1; i < n; ++i) {
+    const uint64_t v = total * uint64_t(i) / uint64_t(n);
+    const string b =
+        stem + char(lo + int(v / width)) + char(lo2 + int(v % width));
+    if (b <= after)
+      continue;
+    partitions.push_back({.prefix = prefix, .startAfter = after, .last = b});
+    after = b;
+  }
+  partitions.push_back({.prefix = prefix, .startAfter = after});
+  return partitions;
+}
+
+// Find partitions from the common prefixes returned in the first page; keys
+// found directly under prefix are stored in partitions which do not require
+// listing. A single common prefix is descended into. If the first page is
+// truncated the remaining key space is split by start-after boundaries; with
+// less than two common prefixes the whole key space is split.
+vector<Partition> DiscoverPrefixes(S3Api &s3, const string &bucket,
+                                   const ParallelListConfig &cfg,
+                                   const string &prefix, int depth = 0) {
+  S3Api::ListObjectV2Config lc;
+  lc.prefix = prefix;
+  lc.delimiter = cfg.delimiter;
+  lc.maxKeys = cfg.maxKeys;
+  S3Api::ListObjectV2Result page;
+  s3.ListObjectsV2(bucket, lc, page, cfg.headers);
+  auto &prefixes = page.commonPrefixes;
+  const bool truncated =
+      page.truncated && !page.nextContinuationToken.empty();
+  if (truncated && prefixes.size() < 2) {
+    return SplitKeySpace(s3, bucket, cfg, prefix);
+  }
+  sort(begin(prefixes), end(prefixes));
+  auto &keys = page.keys;
+  vector<Partition> partitions;
+  auto append = [&partitions](vector<Partition> &&p) {
+    partitions.insert(end(partitions), make_move_iterator(begin(p)),
+                      make_move_iterator(end(p)));
+  };
+  // merge keys and prefixes in key order
+  auto k = begin(keys);
+  for (const auto &p : prefixes) {
+    Partition direct{.listed = true};
+    for (; k != end(keys) && k->key < p; ++k)
+      direct.keys.push_back(*k);
+    if (!direct.keys.empty())
+      partitions.push_back(move(direct));
+    if (prefixes.size() == 1 && depth < MAX_DEPTH) {
+      append(DiscoverPrefixes(s3, bucket, cfg, p, depth + 1));
+    } else {
+      partitions.push_back({.prefix = p});
+    }
+  }
+  if (k != end(keys)) {
+    Partition direct{.listed = true};
+    direct.keys.assign(make_move_iterator(k), make_move_iterator(end(keys)));
+    partitions.push_back(move(direct));
+  }
+  if (truncated) {
+    // keys under the last prefix sort before prefix + U+10FFFF
+    string covered = prefixes.back() + MAX_CHAR;
+    if (!keys.empty() && keys.back().key > covered)
+      covered = keys.back().key;
+    append(SplitKeySpace(s3, bucket, cfg, prefix, covered));
+  }
+  return partitions;
+}
+
+// List partition, invoke callback for each page
+void ListPartition(S3Api &s3, const string &bucket,
+                   const ParallelListConfig &cfg, const Partition &p,
+                   const function<void(vector<ObjectInfo> &)> &emit,
+                   const atomic<bool> &abort) {
+  S3Api::ListObjectV2Config lc;
+  lc.prefix = p.prefix;
+  lc.startAfter = p.startAfter;
+  lc.maxKeys = cfg.maxKeys;
+  S3Api::ListObjectV2Result page;
+  do {
+    s3.ListObjectsV2(bucket, lc, page, cfg.headers);
+    bool done = !page.truncated || page.nextContinuationToken.empty();
+    if (!p.last.empty()) {
+      auto e = find_if(begin(page.keys), end(page.keys),
+                       [&p](const ObjectInfo &o) { return o.key > p.last; });
+      if (e != end(page.keys)) {
+        page.keys.erase(e, end(page.keys));
+        done = true;
+      }
+    }
+    emit(page.keys);
+    lc.continuationToken = page.nextContinuationToken;
+    lc.startAfter.clear();
+    if (done)
+      break;
+  } while (!abort);
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+size_t ListObjectsParallel(const S3Api &s3, const string &bucket,
+                           const ParallelListConfig &cfg,
+                           const ObjectBatchConsumer &consumer) {
+  vector<Partition> partitions = [&] {
+    S3Api client(s3.Access(), s3.Secret(), s3.Endpoint(),
+                 s3.SigningEndpoint());
+    client.SetEndpointSelector(s3.GetEndpointSelector());
+    return DiscoverPrefixes(client, bucket, cfg, cfg.prefix);
+  }();
+  const size_t numPartitions = partitions.size();
+  mutex m;
+  // ordered mode: keys are buffered until all previous partitions are done
+  vector<vector<ObjectInfo>> results(numPartitions);
+  vector<bool> done(numPartitions, false);
+  size_t nextToEmit = 0;
+  size_t count = 0;
+  atomic<size_t> nextPartition{0};
+  atomic<bool> abort{false};
+  exception_ptr error;
+  // must be invoked with lock held
+  auto flush = [&] {
+    while (nextToEmit < numPartitions && done[nextToEmit]) {
+      auto &r = results[nextToEmit];
+      if (!r.empty())
+        consumer(r);
+      count += r.size();
+      r = vector<ObjectInfo>();
+      ++nextToEmit;
+    }
+  };
+  auto worker = [&] {
+    S3Api client(s3.Access(), s3.Secret(), s3.Endpoint(),
+                 s3.SigningEndpoint());
+    client.SetEndpointSelector(s3.GetEndpointSelector());
+    for (size_t i = nextPartition++; i < numPartitions && !abort;
+         i = nextPartition++) {
+      // ordered mode moves keys into the partition buffer, otherwise the page
+      // buffer is reused for the next request
+      auto emit = [&, i](vector<ObjectInfo> &keys) {
+        lock_guard<mutex> lock(m);
+        if (!cfg.ordered) {
+          if (!keys.empty())
+            consumer(keys);
+          count += keys.size();
+        } else {
+          auto &r = results[i];
+          r.insert(end(r), make_move_iterator(begin(keys)),
+                   make_move_iterator(end(keys)));
+        }
+      };
+      try {
+        if (partitions[i].listed) {
+          emit(partitions[i].keys);
+        } else {
+          ListPartition(client, bucket, cfg, partitions[i], emit, abort);
+        }
+        lock_guard<mutex> lock(m);
+        done[i] = true;
+        if (cfg.ordered)
+          flush();
+      } catch (...) {
+        lock_guard<mutex> lock(m);
+        if (!error)
+          error = current_exception();
+        abort = true;
+      }
+    }
+  };
+  vector<thread> workers;
+  const size_t numWorkers = min(size_t(max(1, cfg.jobs)), numPartitions);
+  for (size_t i = 0; i != numWorkers; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+  return count;
+}
+
+//-----------------------------------------------------------------------------
+ObjectInventory ListObjectInventory(const S3Api &s3, const string &bucket,
+                                    const ParallelListConfig &cfg) {
+  ObjectInventory inventory;
+  ListObjectsParallel(s3, bucket, cfg,
+                      [&inventory](const vector<ObjectInfo> &objects) {
+                        inventory.Append(objects);
+                      });
+  inventory.Sort();
+  return inventory;
+}
+} // namespace api
+} // namespace sss
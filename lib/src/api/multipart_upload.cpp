@@ -37,6 +37,7 @@
 #include "common.h"
 #include "error.h"
 #include "response_parser.h"
+#include "retry_policy.h"
 #include "s3-api.h"
 #include "s3-client.h"
 
@@ -44,9 +45,9 @@ using namespace std;
 
 namespace sss {
 namespace api {
-namespace {
 
 //-----------------------------------------------------------------------------
+// External linkage: also declared by the microbenchmarks
 string BuildEndUploadXML(const vector<ETag> &etags) {
   string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
                "<CompleteMultipartUpload "
@@ -62,97 +63,63 @@ string BuildEndUploadXML(const vector<ETag> &etags) {
   return xml;
 }
 
-atomic<int> retriesG;
-
-//-----------------------------------------------------------------------------
-int GetUploadRetries() { return retriesG; }
+namespace {
 
 //-----------------------------------------------------------------------------
 ETag DoUploadFilePart(S3Api &s3, const string &fileName, size_t offset,
                       size_t size, const string &bucket, const string &key,
-                      const string &uploadId, int i, int tryNum,
-                      S3Api::FileIOMode mode, int maxRetries, Headers headers,
-                      const std::string &payloadHash) {
-
-  try {
-    headers.insert({"content-length", to_string(size)});
-    const Parameters params = {{"partNumber", to_string(i + 1)},
-                               {"uploadId", uploadId}};
-    auto &wc = s3.Config({.method = "PUT",
-                          .bucket = bucket,
-                          .key = key,
-                          .params = params,
-                          .headers = headers,
-                          .payloadHash = payloadHash});
-    switch (mode) {
-    case S3Api::BUFFERED:
-      wc.UploadFile(fileName, offset, size);
-      break;
-    case S3Api::UNBUFFERED:
-      wc.UploadFileUnbuffered(fileName, offset, size);
-      break;
-    case S3Api::MEMORY_MAPPED:
-      wc.UploadFileMM(fileName, offset, size);
-      break;
-    default:
-      break;
-    }
-    HandleError(wc);
-    string etag = HTTPHeader(wc.GetHeaderText(), "Etag");
-    if (etag.empty()) {
-      throw(runtime_error("No ETag found in HTTP header"));
-    } else {
-      return TrimETag(etag);
-    }
-  } catch (const exception &e) {
-    if (tryNum == maxRetries) {
-
-      throw(runtime_error("Cannot upload chunk " + to_string(i + 1) + " - " +
-                          e.what()));
-    } else {
-      retriesG++;
-      return DoUploadFilePart(s3, fileName, offset, size, bucket, key, uploadId,
-                              i, ++tryNum, mode, maxRetries, headers,
-                              payloadHash);
-    }
+                      const string &uploadId, int i, S3Api::FileIOMode mode,
+                      Headers headers, const std::string &payloadHash) {
+  headers.insert({"content-length", to_string(size)});
+  const Parameters params = {{"partNumber", to_string(i + 1)},
+                             {"uploadId", uploadId}};
+  auto &wc = s3.Config({.method = "PUT",
+                        .bucket = bucket,
+                        .key = key,
+                        .params = params,
+                        .headers = headers,
+                        .payloadHash = payloadHash});
+  switch (mode) {
+  case S3Api::BUFFERED:
+    wc.UploadFile(fileName, offset, size);
+    break;
+  case S3Api::UNBUFFERED:
+    wc.UploadFileUnbuffered(fileName, offset, size);
+    break;
+  case S3Api::MEMORY_MAPPED:
+    wc.UploadFileMM(fileName, offset, size);
+    break;
+  default:
+    break;
   }
+  HandleError(wc);
+  const string etag(wc.GetHeader("ETag"));
+  if (etag.empty()) {
+    throw(runtime_error("No ETag found in HTTP header"));
+  }
+  return TrimETag(etag);
 }
 
 //-----------------------------------------------------------------------------
 ETag DoUploadPart(S3Api &s3, const string &bucket, const string &key,
                   const char *data, const string &uploadId, int i, size_t size,
-                  int tryNum, int maxRetries, Headers headers,
-                  const string &payloadHash) {
+                  Headers headers, const string &payloadHash) {
   const Parameters params = {{"partNumber", to_string(i + 1)},
                              {"uploadId", uploadId}};
-
-  try {
-    headers.insert({"content-length", to_string(size)});
-    const auto &wc = s3.Send({.method = "PUT",
-                              .bucket = bucket,
-                              .key = key,
-                              .params = params,
-                              .headers = headers,
-                              .uploadData = S3Api::ReadBuffer{size, data}});
-
-    string etag = HTTPHeader(wc.GetHeaderText(), "Etag");
-    if (etag.empty()) {
-      throw(runtime_error("No ETag found in HTTP header"));
-    } else {
-      return TrimETag(etag);
-    }
-
-  } catch (const exception &e) {
-    if (tryNum == maxRetries) {
-
-      throw(runtime_error("Cannot upload chunk " + to_string(i + 1) + " - " +
-                          e.what()));
-    } else {
-      retriesG++;
-      return DoUploadPart(s3, bucket, key, data, uploadId, i, size, ++tryNum,
-                          maxRetries, headers, payloadHash);
-    }
+  headers.insert({"content-length", to_string(size)});
+  const auto &wc = s3.Send({.method = "PUT",
+                            .bucket = bucket,
+                            .key = key,
+                            .params = params,
+                            .headers = headers,
+                            .payloadHash = payloadHash,
+                            .uploadData = S3Api::ReadBuffer{size, data}});
+
+  const string etag(wc.GetHeader("ETag"));
+  if (etag.empty()) {
+    throw(runtime_error("No ETag found in HTTP header"));
   }
+  return TrimETag(etag);
 }
 } // namespace
 //=============================================================================
@@ -170,7 +137,7 @@ ETag S3Api::CompleteMultipartUpload(const UploadId &uid, const string &bucket,
                          .key = key,
                          .params = params,
                          .uploadData = postData});
-  string etag = XMLTag(wc.GetContentText(), "ETag");
+  string etag = XMLTag(wc.GetContentView(), "ETag");
   if (etag.empty()) {
     throw logic_error("Empty ETag");
   }
@@ -198,8 +165,7 @@ UploadId S3Api::CreateMultipartUpload(const std::string &bucket,
                          .key = key,
                          .params = {{"uploads", ""}},
                          .headers = headers});
-  retriesG = 0;
-  const string xml = webClient_.GetContentText();
+  const string_view xml = webClient_.GetContentView();
   return XMLTag(xml, "uploadId");
 }
 
@@ -208,8 +174,11 @@ ETag S3Api::UploadPart(const std::string &bucket, const std::string &key,
                        const UploadId &uid, int partNum, const char *data,
                        size_t size, int maxRetries, Headers headers,
                        const string &payloadHash) {
-  return DoUploadPart(*this, bucket, key, data, uid, partNum, size, 1,
-                      maxRetries, headers, payloadHash);
+  // maxRetries is the total number of attempts
+  return RetryPolicy(max(maxRetries - 1, 0)).Run([&] {
+    return DoUploadPart(*this, bucket, key, data, uid, partNum, size, headers,
+                        payloadHash);
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -218,8 +187,11 @@ ETag S3Api::UploadFilePart(const std::string &file, size_t offset, size_t size,
                            const UploadId &uid, int partNum, FileIOMode mode,
                            int maxRetries, Headers headers,
                            const string &payloadHash) {
-  return DoUploadFilePart(*this, file, offset, size, bucket, key, uid, partNum,
-                          1, mode, maxRetries, headers, payloadHash);
+  // maxRetries is the total number of attempts
+  return RetryPolicy(max(maxRetries - 1, 0)).Run([&] {
+    return DoUploadFilePart(*this, file, offset, size, bucket, key, uid,
+                            partNum, mode, headers, payloadHash);
+  });
 }
 //-----------------------------------------------------------------------------
 void S3Api::AbortMultipartUpload(const string &bucket, const string &key,
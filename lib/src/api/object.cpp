@@ -45,11 +45,17 @@ using namespace std;
 namespace sss {
 namespace api {
 
-S3Api::ListObjectV2Result ParseObjects(const std::string &xml);
-AccessControlPolicy ParseACL(const std::string &xml);
+S3Api::ListObjectV2Result ParseObjects(std::string_view xml);
+void ParseObjects(std::string_view xml, S3Api::ListObjectV2Result &res);
+S3Api::SendParams
+GenerateDeleteObjectsRequest(const std::string &bucket,
+                             const std::vector<ObjectIdentifier> &objects,
+                             bool quiet, const Headers &headers);
+DeleteObjectsResult ParseDeleteObjectsResult(std::string_view xml);
+AccessControlPolicy ParseACL(std::string_view xml);
 std::string GenerateAclXML(const AccessControlPolicy &acl);
 std::pair<std::vector<std::string>, std::vector<std::string>>
-ParseListObjectVersions(const std::string &xml);
+ParseListObjectVersions(std::string_view xml);
 //------------------------------------------------------------------------------
 ETag S3Api::PutObject(const std::string &bucket, const std::string &key,
                       const CharArray &buffer, Headers headers,
@@ -63,7 +69,7 @@ ETag S3Api::PutObject(const std::string &bucket, const std::string &key,
             .headers = headers,
             .payloadHash = payloadHash,
             .uploadData = ReadBuffer{buffer.size(), buffer.data()}});
-  const string etag = HTTPHeader(wc.GetHeaderText(), "ETag");
+  const string etag(wc.GetHeader("ETag"));
   if (etag.empty()) {
     throw runtime_error("Missing ETag");
   }
@@ -82,7 +88,7 @@ ETag S3Api::PutObject(const std::string &bucket, const std::string &key,
                          .headers = headers,
                          .payloadHash = payloadHash,
                          .uploadData = ReadBuffer{size, buffer}});
-  const string etag = HTTPHeader(wc.GetHeaderText(), "ETag");
+  const string etag(wc.GetHeader("ETag"));
   if (etag.empty()) {
     throw runtime_error("Missing ETag");
   }
@@ -105,7 +111,7 @@ ETag S3Api::PutFileObject(const std::string &fileName,
     throw runtime_error("Error uploading file - " + webClient_.ErrorMsg());
   }
   HandleError(webClient_);
-  return HTTPHeader(webClient_.GetHeaderText(), "ETag");
+  return string(webClient_.GetHeader("ETag"));
 }
 
 //------------------------------------------------------------------------------
@@ -116,7 +122,7 @@ const CharArray &S3Api::GetObject(const std::string &bucket,
 
   if (end > 0) {
     headers.insert(
-        {"Range", "bytes=" + to_string(begin) + "-" + to_string(end)});
+        {"range", "bytes=" + to_string(begin) + "-" + to_string(end)});
   }
   auto params =
       versionId.empty() ? Parameters{} : Parameters{{"versionId", versionId}};
@@ -136,7 +142,7 @@ void S3Api::GetObject(const std::string &bucket, const std::string &key,
       versionId.empty() ? Parameters{} : Parameters{{"versionId", versionId}};
   if (end > 0) {
     headers.insert(
-        {"Range", "bytes=" + to_string(begin) + "-" + to_string(end)});
+        {"range", "bytes=" + to_string(begin) + "-" + to_string(end)});
   }
   const auto &wc = Send({.method = "GET",
                          .bucket = bucket,
@@ -159,10 +165,13 @@ void S3Api::GetObject(const std::string &bucket, const std::string &key,
       versionId.empty() ? Parameters{} : Parameters{{"versionId", versionId}};
   if (end > 0) {
     headers.insert(
-        {"Range", "bytes=" + to_string(begin) + "-" + to_string(end)});
+        {"range", "bytes=" + to_string(begin) + "-" + to_string(end)});
   }
-  const auto &wc =
-      Send({.method = "GET", .bucket = bucket, .key = key, .headers = headers});
+  const auto &wc = Send({.method = "GET",
+                         .bucket = bucket,
+                         .key = key,
+                         .params = params,
+                         .headers = headers});
   const auto &bytes = wc.GetResponseBody();
   copy(bytes.begin(), bytes.end(), buffer + offset);
 }
@@ -197,6 +206,23 @@ void S3Api::GetFileObject(const std::string &fileName,
   HandleError(webClient_);
 }
 
+//------------------------------------------------------------------------------
+DeleteObjectsResult
+S3Api::DeleteObjects(const std::string &bucket,
+                     const std::vector<ObjectIdentifier> &objects, bool quiet,
+                     const Headers &headers) {
+  if (objects.size() > MAX_DELETE_OBJECTS) {
+    throw logic_error("Cannot delete more than " +
+                      to_string(MAX_DELETE_OBJECTS) +
+                      " objects in a single request");
+  }
+  if (objects.empty()) {
+    return {};
+  }
+  Send(GenerateDeleteObjectsRequest(bucket, objects, quiet, headers));
+  return ParseDeleteObjectsResult(GetResponseView());
+}
+
 //------------------------------------------------------------------------------
 void S3Api::DeleteObject(const std::string &bucket, const std::string &key,
                          const Headers &headers, const string &versionId) {
@@ -214,9 +240,12 @@ Headers S3Api::HeadObject(const std::string &bucket, const std::string &key,
                           const Headers &headers, const string &versionId) {
   auto params =
       versionId.empty() ? Parameters{} : Parameters{{"versionId", versionId}};
-  const auto &wc = Send(
-      {.method = "HEAD", .bucket = bucket, .key = key, .headers = headers});
-  return HTTPHeaders(wc.GetHeaderText());
+  const auto &wc = Send({.method = "HEAD",
+                         .bucket = bucket,
+                         .key = key,
+                         .params = params,
+                         .headers = headers});
+  return wc.ResponseHeaders().ToHeaders();
 }
 
 //------------------------------------------------------------------------------
@@ -233,19 +262,33 @@ bool S3Api::TestObject(const std::string &bucket, const std::string &key) {
 S3Api::ListObjectV2Result S3Api::ListObjectsV2(const std::string &bucket,
                                                const ListObjectV2Config &config,
                                                const Headers &headers) {
-  Map params;
-  params["continuation_token"] = config.continuationToken;
-  params["delimiter"] = config.delimiter;
-  params["encoding-type"] = config.encodingType;
-  params["fetch-owner"] = config.fetchOwner;
-  // params["max-keys"] = to_string(config.maxKeys);
-  params["prefix"] = config.prefix;
-  params["start-after"] = config.startAfter;
+  ListObjectV2Result result;
+  ListObjectsV2(bucket, config, result, headers);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+void S3Api::ListObjectsV2(const std::string &bucket,
+                          const ListObjectV2Config &config,
+                          ListObjectV2Result &result, const Headers &headers) {
+  Map params = {{"list-type", "2"}};
+  // empty parameters are not sent
+  auto add = [&params](const string &name, const string &value) {
+    if (!value.empty())
+      params[name] = value;
+  };
+  add("continuation-token", config.continuationToken);
+  add("delimiter", config.delimiter);
+  add("encoding-type", config.encodingType);
+  add("fetch-owner", config.fetchOwner);
+  add("max-keys", config.maxKeys > 0 ? to_string(config.maxKeys) : "");
+  add("prefix", config.prefix);
+  add("start-after", config.startAfter);
   const auto &wc = Send({.method = "GET",
                          .bucket = bucket,
                          .params = params,
                          .headers = headers});
-  return ParseObjects(webClient_.GetContentText());
+  ParseObjects(wc.GetContentView(), result);
 }
 
 //------------------------------------------------------------------------------
@@ -255,29 +298,28 @@ AccessControlPolicy S3Api::GetObjectAcl(const string &bucket,
                         .bucket = bucket,
                         .key = key,
                         .params = {{"acl", ""}}})
-                      .GetContentText();
+                      .GetContentView();
   return ParseACL(c);
 }
 //------------------------------------------------------------------------------
 void S3Api::PutObjectAcl(const string &bucket, const string &key,
                          const AccessControlPolicy &acl) {
   const string xml = GenerateAclXML(acl);
-  const auto &c = Send({.method = "PUT",
-                        .bucket = bucket,
-                        .key = key,
-                        .params = {{"acl", ""}},
-                        .uploadData = xml})
-                      .GetContentText();
+  Send({.method = "PUT",
+        .bucket = bucket,
+        .key = key,
+        .params = {{"acl", ""}},
+        .uploadData = xml});
 }
 
 //------------------------------------------------------------------------------
-TagMap ParseTaggingResponse(const std::string &xml);
+TagMap ParseTaggingResponse(std::string_view xml);
 TagMap S3Api::GetObjectTagging(const string &bucket, const string &key) {
   auto r = Send({.method = "GET",
                  .bucket = bucket,
                  .key = key,
                  .params = {{"tagging", ""}}})
-               .GetContentText();
+               .GetContentView();
   return ParseTaggingResponse(r);
 }
 
@@ -310,7 +352,7 @@ S3Api::ObjectVersionInfo S3Api::ListObjectVersions(const string &bucket,
         .bucket = bucket,
         .key = key,
         .params = {{"versions", ""}}});
-  auto v = ParseListObjectVersions(GetResponseText());
+  auto v = ParseListObjectVersions(GetResponseView());
   return {v.first, v.second};
 }
 } // namespace api
@@ -39,13 +39,97 @@ using namespace std;
 
 namespace sss {
 namespace api {
+namespace {
+// Operation name as static string, nullptr if not recognised; called for
+// every request, the name is not copied into a new string
+const char *OperationLabel(const S3Api::SendParams &p) {
+  const string method = ToUpper(p.method);
+  auto has = [&p](const char *param) { return p.params.count(param) > 0; };
+  auto copy = [&p] { return p.headers.count("x-amz-copy-source") > 0; };
+  if (method == "GET") {
+    if (p.bucket.empty())
+      return "ListBuckets";
+    if (p.key.empty()) {
+      if (has("list-type"))
+        return "ListObjectsV2";
+      if (has("versions"))
+        return "ListObjectVersions";
+      if (has("uploads"))
+        return "ListMultipartUploads";
+      if (has("tagging"))
+        return "GetBucketTagging";
+      if (has("versioning"))
+        return "GetBucketVersioning";
+      if (has("acl"))
+        return "GetBucketAcl";
+      if (has("location"))
+        return "GetBucketLocation";
+      return "ListObjects";
+    }
+    if (has("uploadId"))
+      return "ListParts";
+    if (has("tagging"))
+      return "GetObjectTagging";
+    if (has("acl"))
+      return "GetObjectAcl";
+    return "GetObject";
+  }
+  if (method == "HEAD")
+    return p.key.empty() ? "HeadBucket" : "HeadObject";
+  if (method == "PUT") {
+    if (p.key.empty()) {
+      if (has("tagging"))
+        return "PutBucketTagging";
+      if (has("versioning"))
+        return "PutBucketVersioning";
+      if (has("acl"))
+        return "PutBucketAcl";
+      return "CreateBucket";
+    }
+    if (has("partNumber"))
+      return copy() ? "UploadPartCopy" : "UploadPart";
+    if (has("tagging"))
+      return "PutObjectTagging";
+    if (has("acl"))
+      return "PutObjectAcl";
+    return copy() ? "CopyObject" : "PutObject";
+  }
+  if (method == "POST") {
+    if (has("uploads"))
+      return "CreateMultipartUpload";
+    if (has("uploadId"))
+      return "CompleteMultipartUpload";
+    if (has("delete"))
+      return "DeleteObjects";
+  }
+  if (method == "DELETE") {
+    if (p.key.empty())
+      return has("tagging") ? "DeleteBucketTagging" : "DeleteBucket";
+    if (has("uploadId"))
+      return "AbortMultipartUpload";
+    if (has("tagging"))
+      return "DeleteObjectTagging";
+    return "DeleteObject";
+  }
+  return nullptr;
+}
+} // namespace
+
 /// [WebClient::Config]
 WebClient &S3Api::Config(const SendParams &p) {
+  const string endpoint = selector_ ? selector_->Select() : Endpoint();
+  if (selector_) {
+    // published for hedged requests sent from other threads
+    auto current = atomic_load(&requestEndpoint_);
+    if (!current || *current != endpoint) {
+      atomic_store(&requestEndpoint_, make_shared<const string>(endpoint));
+    }
+  }
   // if credentials empty send regular unsigned request
   auto sh = Access().empty() ? Headers()
                              : SignHeaders({.access = Access(),
                                             .secret = Secret(),
-                                            .endpoint = Endpoint(),
+                                            .endpoint = endpoint,
                                             .method = p.method,
                                             .bucket = p.bucket,
                                             .key = p.key,
@@ -55,29 +139,46 @@ WebClient &S3Api::Config(const SendParams &p) {
                                             .region = p.region});
   std::string path;
   if (!p.bucket.empty()) {
-    path += "/" + p.bucket;
+    path += '/';
+    UrlEncodePath(p.bucket, path);
     if (!p.key.empty()) {
-      path += "/" + p.key;
+      path += '/';
+      UrlEncodePath(p.key, path);
     }
   }
   Clear();
-  webClient_.SetEndpoint(Endpoint());
+  webClient_.SetEndpoint(endpoint);
   webClient_.SetPath(path);
   webClient_.SetMethod(p.method);
   webClient_.SetReqParameters(p.params);
   webClient_.SetHeaders(sh);
+  const char *operation = OperationLabel(p);
+  if (operation) {
+    webClient_.SetOperation(operation);
+  } else {
+    webClient_.SetOperation(OperationName(p));
+  }
   return webClient_;
 }
 /// [WebClient::Config]
 
+//-----------------------------------------------------------------------------
+string S3Api::OperationName(const SendParams &p) {
+  const char *name = OperationLabel(p);
+  return name ? name : ToUpper(p.method);
+}
+
 ssize_t S3Api::GetObjectSize(const string &bucket, const string &key,
                              const string &versionId) {
-  const bool caseInsensitive = false;
   try {
-    const string v = GetValue(HeadObject(bucket, key, {}, versionId), "length",
-                              caseInsensitive);
+    const auto params = versionId.empty()
+                            ? Parameters{}
+                            : Parameters{{"versionId", versionId}};
+    const auto &wc = Send(
+        {.method = "HEAD", .bucket = bucket, .key = key, .params = params});
+    const string_view v = wc.GetHeader("Content-Length");
     // if object exists header should always be present, but just in case...
-    return v.empty() ? -1 : stoll(v);
+    return v.empty() ? -1 : stoll(string(v));
   } catch (...) {
     return -1;
   }
@@ -0,0 +1,358 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Directory and prefix synchronization
+
+#include "sync.h"
+#include "object_inventory.h"
+#include "response_parser.h"
+#include "retry_policy.h"
+#include "s3-client.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace sss {
+namespace api {
+namespace {
+
+//-----------------------------------------------------------------------------
+// ETag is the MD5 digest of the whole content, i.e. not a multipart ETag
+bool IsMD5(const string &etag) {
+  return etag.size() == 32 &&
+         all_of(etag.begin(), etag.end(),
+                [](char c) { return isxdigit((unsigned char)c); });
+}
+
+//-----------------------------------------------------------------------------
+bool Unchanged(const SyncEntry &src, const SyncEntry &dst,
+               const SyncConfig &cfg) {
+  if (src.size != dst.size)
+    return false;
+  if (cfg.sizeOnly)
+    return true;
+  if (!src.etag.empty() && !dst.etag.empty()) {
+    if (src.etag == dst.etag)
+      return true;
+    if (IsMD5(src.etag) && IsMD5(dst.etag))
+      return false;
+  }
+  return src.lastModified <= dst.lastModified;
+}
+
+//-----------------------------------------------------------------------------
+int64_t LastModifiedMs(const string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st)) {
+    throw runtime_error("Cannot access file " + path);
+  }
+  return int64_t(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+// Transfer configuration for multipart uploads and copies of objects larger
+// than multipartThreshold, parts are about multipartThreshold bytes
+S3DataTransferConfig TransferConfig(const S3Api &s3, const SyncConfig &cfg,
+                                    const string &bucket, const string &key,
+                                    uint64_t size) {
+  const int jobs = max(cfg.partJobs, 1);
+  const size_t threshold = max(cfg.multipartThreshold, S3Api::MIN_PART_SIZE);
+  const size_t parts =
+      max(size_t((size + threshold - 1) / threshold), size_t(1));
+  S3DataTransferConfig tc;
+  tc.accessKey = s3.Access();
+  tc.secretKey = s3.Secret();
+  tc.bucket = bucket;
+  tc.key = key;
+  tc.endpoints = {s3.Endpoint()};
+  tc.endpointSelector = s3.GetEndpointSelector();
+  tc.bandwidthShaper = cfg.bandwidthShaper;
+  tc.metrics = cfg.metrics;
+  tc.maxRetries = cfg.maxRetries;
+  tc.jobs = jobs;
+  tc.partsPerJob = (parts + jobs - 1) / jobs;
+  return tc;
+}
+
+//-----------------------------------------------------------------------------
+// Run function on jobs threads, each owning an S3Api instance sharing
+// bandwidth shaper and metrics
+void RunWorkers(const S3Api &s3, int jobs, const SyncConfig &cfg,
+                const function<void(S3Api &)> &work) {
+  vector<thread> workers;
+  for (int i = 0; i < jobs; ++i) {
+    workers.emplace_back([&] {
+      S3Api client(s3.Access(), s3.Secret(), s3.Endpoint(),
+                   s3.SigningEndpoint());
+      client.SetEndpointSelector(s3.GetEndpointSelector());
+      client.SetBandwidthShaper(cfg.bandwidthShaper);
+      const MetricsGuard<S3Api> metrics(cfg.metrics, client);
+      work(client);
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+using TransferFun = function<void(S3Api &, const SyncTransfer &)>;
+
+// Execute plan: first all transfers, then deletions in batches of
+// MAX_DELETE_OBJECTS keys, so that a failed sync never leaves the
+// destination with less data than before
+SyncResult Execute(const S3Api &s3, SyncPlan plan, const string &dstBucket,
+                   const string &dstPrefix, const SyncConfig &cfg,
+                   const TransferFun &transfer) {
+  SyncResult result;
+  result.plan = move(plan);
+  if (cfg.dryRun)
+    return result;
+  const auto &transfers = result.plan.transfers;
+  const auto &deletes = result.plan.deletes;
+  mutex m;
+  auto fail = [&](const string &key, const string &msg) {
+    lock_guard<mutex> lock(m);
+    result.errors.push_back({key, msg});
+  };
+  atomic<size_t> next{0};
+  atomic<size_t> transferred{0};
+  RunWorkers(s3, max(cfg.jobs, 1), cfg, [&](S3Api &client) {
+    for (size_t i = next++; i < transfers.size(); i = next++) {
+      try {
+        transfer(client, transfers[i]);
+        ++transferred;
+      } catch (const exception &e) {
+        fail(transfers[i].key, e.what());
+      }
+    }
+  });
+  const size_t batches = (deletes.size() + S3Api::MAX_DELETE_OBJECTS - 1) /
+                         S3Api::MAX_DELETE_OBJECTS;
+  next = 0;
+  atomic<size_t> deleted{0};
+  const int deleteJobs = int(min(size_t(max(cfg.jobs, 1)), batches));
+  RunWorkers(s3, deleteJobs, cfg, [&](S3Api &client) {
+    const RetryPolicy retry(cfg.maxRetries);
+    for (size_t b = next++; b < batches; b = next++) {
+      const size_t first = b * S3Api::MAX_DELETE_OBJECTS;
+      const size_t last =
+          min(first + S3Api::MAX_DELETE_OBJECTS, deletes.size());
+      vector<ObjectIdentifier> objects;
+      objects.reserve(last - first);
+      for (size_t i = first; i != last; ++i) {
+        objects.push_back({.key = dstPrefix + deletes[i]});
+      }
+      try {
+        const auto r = retry.Run(
+            [&] { return client.DeleteObjects(dstBucket, objects); });
+        deleted += objects.size() - r.errors.size();
+        for (const auto &e : r.errors) {
+          fail(e.key, e.code + ": " + e.message);
+        }
+      } catch (const exception &e) {
+        for (const auto &o : objects) {
+          fail(o.key, e.what());
+        }
+      }
+    }
+  });
+  result.transferred = transferred;
+  result.deleted = deleted;
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// Prefixes are synchronized as "directories": without a trailing '/' a
+// prefix would match sibling keys, e.g. dir2/a for dir, deleted as
+// extraneous, and relative paths would be appended to the last path element
+string DirectoryPrefix(const string &prefix) {
+  return prefix.empty() || prefix.back() == '/' ? prefix : prefix + '/';
+}
+
+//-----------------------------------------------------------------------------
+SyncResult ExecuteUploads(const S3Api &s3, SyncPlan plan, const string &dir,
+                          const string &bucket, const string &prefix,
+                          const SyncConfig &cfg) {
+  const fs::path root(dir);
+  return Execute(
+      s3, move(plan), bucket, prefix, cfg,
+      [&](S3Api &client, const SyncTransfer &t) {
+        const string file = (root / fs::path(t.key)).string();
+        const string key = prefix + t.key;
+        if (t.size <= cfg.multipartThreshold) {
+          RetryPolicy(cfg.maxRetries).Run([&] {
+            return client.PutFileObject(file, bucket, key, 0, t.size,
+                                        cfg.metaData);
+          });
+        } else {
+          S3DataTransferConfig tc =
+              TransferConfig(s3, cfg, bucket, key, t.size);
+          tc.file = file;
+          Upload(tc, cfg.metaData);
+        }
+      });
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+SyncManifest LocalManifest(const string &dir, bool checksum) {
+  SyncManifest manifest;
+  const fs::path root(dir);
+  for (const auto &e : fs::recursive_directory_iterator(root)) {
+    if (!e.is_regular_file())
+      continue;
+    const string path = e.path().string();
+    const fs::path rel = e.path().lexically_relative(root);
+    manifest.push_back({.key = rel.generic_string(),
+                        .size = e.file_size(),
+                        .lastModified = LastModifiedMs(path),
+                        .etag = checksum ? FileMD5(path) : string()});
+  }
+  sort(manifest.begin(), manifest.end(),
+       [](const SyncEntry &a, const SyncEntry &b) { return a.key < b.key; });
+  return manifest;
+}
+
+//-----------------------------------------------------------------------------
+SyncManifest S3Manifest(const S3Api &s3, const string &bucket,
+                        const string &prefix, const ParallelListConfig &cfg) {
+  ParallelListConfig lc = cfg;
+  lc.prefix = prefix;
+  lc.ordered = true;
+  SyncManifest manifest;
+  ListObjectsParallel(s3, bucket, lc, [&](const vector<ObjectInfo> &objects) {
+    for (const auto &o : objects) {
+      // skip "directory" placeholder matching the prefix itself
+      if (o.key.size() <= prefix.size())
+        continue;
+      manifest.push_back({.key = o.key.substr(prefix.size()),
+                          .size = o.size,
+                          .lastModified = ParseISO8601(o.lastModified),
+                          .etag = TrimETag(o.etag)});
+    }
+  });
+  return manifest;
+}
+
+//-----------------------------------------------------------------------------
+SyncPlan DiffManifests(const SyncManifest &src, const SyncManifest &dst,
+                       const SyncConfig &cfg) {
+  SyncPlan plan;
+  auto s = src.begin();
+  auto d = dst.begin();
+  auto add = [&plan](const SyncEntry &e) {
+    plan.transfers.push_back({e.key, e.size});
+    plan.bytes += e.size;
+  };
+  while (s != src.end() || d != dst.end()) {
+    if (d == dst.end() || (s != src.end() && s->key < d->key)) {
+      add(*s++);
+    } else if (s == src.end() || d->key < s->key) {
+      if (cfg.deleteExtraneous)
+        plan.deletes.push_back(d->key);
+      ++d;
+    } else {
+      if (Unchanged(*s, *d, cfg)) {
+        ++plan.unchanged;
+      } else {
+        add(*s);
+      }
+      ++s;
+      ++d;
+    }
+  }
+  return plan;
+}
+
+//-----------------------------------------------------------------------------
+SyncResult SyncDirectory(const S3Api &s3, const string &dir,
+                         const string &bucket, const string &prefix,
+                         const SyncConfig &cfg) {
+  const string dstPrefix = DirectoryPrefix(prefix);
+  const SyncManifest src = LocalManifest(dir, cfg.checksum);
+  const SyncManifest dst = S3Manifest(s3, bucket, dstPrefix, cfg.list);
+  return ExecuteUploads(s3, DiffManifests(src, dst, cfg), dir, bucket,
+                        dstPrefix, cfg);
+}
+
+//-----------------------------------------------------------------------------
+SyncResult UploadDirectory(const S3Api &s3, const string &dir,
+                           const string &bucket, const string &prefix,
+                           const SyncConfig &cfg) {
+  SyncConfig uc = cfg;
+  uc.deleteExtraneous = false;
+  return ExecuteUploads(s3, DiffManifests(LocalManifest(dir), {}, uc), dir,
+                        bucket, DirectoryPrefix(prefix), uc);
+}
+
+//-----------------------------------------------------------------------------
+SyncResult SyncPrefix(const S3Api &s3, const string &srcBucket,
+                      const string &sourcePrefix, const string &dstBucket,
+                      const string &destinationPrefix, const SyncConfig &cfg) {
+  const string srcPrefix = DirectoryPrefix(sourcePrefix);
+  const string dstPrefix = DirectoryPrefix(destinationPrefix);
+  const SyncManifest src = S3Manifest(s3, srcBucket, srcPrefix, cfg.list);
+  const SyncManifest dst = S3Manifest(s3, dstBucket, dstPrefix, cfg.list);
+  Headers headers;
+  if (!cfg.metaData.empty()) {
+    headers = cfg.metaData;
+    headers["x-amz-metadata-directive"] = "REPLACE";
+  }
+  return Execute(
+      s3, DiffManifests(src, dst, cfg), dstBucket, dstPrefix, cfg,
+      [&](S3Api &client, const SyncTransfer &t) {
+        const string srcKey = srcPrefix + t.key;
+        const string dstKey = dstPrefix + t.key;
+        if (t.size <= cfg.multipartThreshold) {
+          RetryPolicy(cfg.maxRetries).Run([&] {
+            return client.CopyObject(srcBucket, srcKey, dstBucket, dstKey,
+                                     headers);
+          });
+        } else {
+          Copy(TransferConfig(s3, cfg, dstBucket, dstKey, t.size), srcBucket,
+               srcKey, cfg.metaData);
+        }
+      });
+}
+} // namespace api
+} // namespace sss
@@ -33,7 +33,9 @@
 
 #include "s3-api.h"
 #include "tinyxml2.h"
+#include "utility.h"
 #include "xml_path.h"
+#include "xml_pull_parser.h"
 #include "xmlstreams.h"
 
 #include <variant>
@@ -45,28 +47,18 @@ namespace sss {
 namespace api {
 
 //------------------------------------------------------------------------------
-std::vector<BucketInfo> ParseBuckets(const std::string &xml) {
+std::vector<BucketInfo> ParseBuckets(std::string_view xml) {
   if (xml.empty())
     return {};
-  auto d = DOMToDict(xml);
-  if (d.empty()) {
-    return {};
-  }
-  // always use lowercase when case insensitive (default) enabled
-  auto r = ExtractSubPaths("/listallmybucketsresult/buckets", d);
-  if (r.empty()) {
-    return {};
-  }
+  const auto c =
+      ExtractRecords(xml, "/listallmybucketsresult/buckets/bucket");
+  const size_t name = c.Field("/name");
+  const size_t creationDate = c.Field("/creationdate");
   vector<BucketInfo> ret;
-  auto numBuckets = r["/bucket/creationdate"].size();
-  if (numBuckets != r["/bucket/name"].size()) {
-    throw std::logic_error("Malformed response: number of creation dates does "
-                           "not match number of buckets");
-    return {};
-  }
-  for (size_t i = 0; i != numBuckets; ++i) {
-    ret.push_back({.name = r["/bucket/name"][i],
-                   .creationDate = r["/bucket/creationdate"][i]});
+  ret.reserve(c.size);
+  for (size_t i = 0; i != c.size; ++i) {
+    ret.push_back(
+        {.name = c.Get(i, name), .creationDate = c.Get(i, creationDate)});
   }
   return ret;
 }
@@ -118,26 +110,113 @@ bool ParseBool(const string &s) {
 //    <NextContinuationToken>string</NextContinuationToken>
 //    <StartAfter>string</StartAfter>
 // </ListBucketResult>
-S3Api::ListObjectV2Result ParseObjects(const std::string &xml) {
-  if (xml.empty())
-    return {};
-  XMLIStream is(xml);
-  S3Api::ListObjectV2Result res;
-  const string truncated = is["/istruncated"];
-  res.truncated = ParseBool(truncated);
-  XMLRecords r = is["listbucketresult/contents"];
-  vector<ObjectInfo> v;
-  for (const auto &i : r) {
-    res.keys.push_back(
-        {.checksumAlgo = Get(i, "/checksumalgo"),
-         .key = Get(i, "/key"),
-         .lastModified = Get(i, "/lastmodified"),
-         .etag = Get(i, "/etag"),
-         .size = Get(i, "/size").empty() ? 0 : stoul(Get(i, "/size")),
-         .storageClass = Get(i, "/storageclass"),
-         .ownerDisplayName = Get(i, "/owner/displayname"),
-         .ownerID = Get(i, "/owner/id")});
+// Parse response into existing result, reusing capacity of strings and vectors
+// already allocated for previous pages
+void ParseObjects(std::string_view xml, S3Api::ListObjectV2Result &res) {
+  res.truncated = false;
+  res.nextContinuationToken.clear();
+  res.keyCount = 0;
+  size_t numKeys = 0;
+  size_t numPrefixes = 0;
+  enum { NONE, CONTENTS, COMMON_PREFIXES } section = NONE;
+  enum { TEXT, TRUNCATED, KEY_COUNT, SIZE } kind = TEXT;
+  bool owner = false;
+  ObjectInfo *obj = nullptr;
+  string *target = nullptr; // receives text of current element
+  string number;
+  XMLPullParser p(xml);
+  for (auto e = p.Next(); e != XMLPullParser::END_DOCUMENT; e = p.Next()) {
+    if (e == XMLPullParser::TEXT) {
+      if (target)
+        p.AppendText(*target);
+      continue;
+    }
+    if (e == XMLPullParser::END_ELEMENT) {
+      if (target && kind != TEXT) {
+        const auto n = strtoull(number.c_str(), nullptr, 10);
+        if (kind == TRUNCATED)
+          res.truncated = ParseBool(number);
+        else if (kind == KEY_COUNT)
+          res.keyCount = n;
+        else
+          obj->size = n;
+      }
+      target = nullptr;
+      if (p.Depth() == 3)
+        owner = false;
+      else if (p.Depth() == 2)
+        section = NONE;
+      continue;
+    }
+    // START_ELEMENT
+    target = nullptr;
+    kind = TEXT;
+    const int depth = p.Depth();
+    if (depth == 2) {
+      if (p.NameIs("contents")) {
+        section = CONTENTS;
+        if (numKeys == res.keys.size())
+          res.keys.emplace_back();
+        obj = &res.keys[numKeys++];
+        obj->checksumAlgo.clear();
+        obj->key.clear();
+        obj->lastModified.clear();
+        obj->etag.clear();
+        obj->size = 0;
+        obj->storageClass.clear();
+        obj->ownerDisplayName.clear();
+        obj->ownerID.clear();
+      } else if (p.NameIs("commonprefixes")) {
+        section = COMMON_PREFIXES;
+      } else if (p.NameIs("istruncated")) {
+        target = &number;
+        kind = TRUNCATED;
+      } else if (p.NameIs("keycount")) {
+        target = &number;
+        kind = KEY_COUNT;
+      } else if (p.NameIs("nextcontinuationtoken")) {
+        target = &res.nextContinuationToken;
+      }
+    } else if (depth == 3 && section == CONTENTS) {
+      if (p.NameIs("key")) {
+        target = &obj->key;
+      } else if (p.NameIs("lastmodified")) {
+        target = &obj->lastModified;
+      } else if (p.NameIs("etag")) {
+        target = &obj->etag;
+      } else if (p.NameIs("size")) {
+        target = &number;
+        kind = SIZE;
+      } else if (p.NameIs("storageclass")) {
+        target = &obj->storageClass;
+      } else if (p.NameIs("checksumalgorithm")) {
+        target = &obj->checksumAlgo;
+      } else if (p.NameIs("owner")) {
+        owner = true;
+      }
+    } else if (depth == 3 && section == COMMON_PREFIXES &&
+               p.NameIs("prefix")) {
+      if (numPrefixes == res.commonPrefixes.size())
+        res.commonPrefixes.emplace_back();
+      target = &res.commonPrefixes[numPrefixes++];
+    } else if (depth == 4 && owner) {
+      if (p.NameIs("displayname")) {
+        target = &obj->ownerDisplayName;
+      } else if (p.NameIs("id")) {
+        target = &obj->ownerID;
+      }
+    }
+    if (target)
+      target->clear();
   }
+  res.keys.resize(numKeys);
+  res.commonPrefixes.resize(numPrefixes);
+}
+
+//------------------------------------------------------------------------------
+S3Api::ListObjectV2Result ParseObjects(std::string_view xml) {
+  S3Api::ListObjectV2Result res;
+  ParseObjects(xml, res);
   return res;
 }
 
@@ -162,21 +241,29 @@ S3Api::ListObjectV2Result ParseObjects(const std::string &xml) {
 //    </AccessControlList>
 // </AccessControlPolicy>
 
-AccessControlPolicy ParseACL(const std::string &xml) {
+AccessControlPolicy ParseACL(std::string_view xml) {
   if (xml.empty())
     return {};
-  XMLIStream is(xml);
   AccessControlPolicy res;
-  const string prefix = "/accesscontrolpolicy";
-  res.ownerDisplayName = is[prefix + "/owner/displayname"];
-  res.ownerID = is[prefix + "/owner/id"];
-  XMLRecords r = is["accesscontrolpolicy/accesscontrollist/grant"];
-  for (auto &i : r) {
-    const Grant g = {{Get(i, "/grantee/displayname"),
-                      Get(i, "/grantee/emailaddress"), Get(i, "/grantee/id"),
-                      Get(i, "/grantee/type"), Get(i, "/grantee/uri")},
-                     Get(i, "/permission")};
-    res.grants.push_back(g);
+  const auto owner = ExtractRecords(xml, "/accesscontrolpolicy/owner");
+  res.ownerDisplayName = owner.Get(0, "/displayname");
+  res.ownerID = owner.Get(0, "/id");
+  const auto g =
+      ExtractRecords(xml, "/accesscontrolpolicy/accesscontrollist/grant");
+  const size_t displayName = g.Field("/grantee/displayname");
+  const size_t email = g.Field("/grantee/emailaddress");
+  const size_t id = g.Field("/grantee/id");
+  const size_t uri = g.Field("/grantee/uri");
+  const size_t permission = g.Field("/permission");
+  // type is usually sent as the xsi:type attribute of <Grantee>
+  const size_t type = g.Field("/grantee/type");
+  const size_t typeAttribute = g.Field("/grantee/@type");
+  for (size_t i = 0; i != g.size; ++i) {
+    const string &t = g.Count(i, type) ? g.Get(i, type)
+                                       : g.Get(i, typeAttribute);
+    res.grants.push_back({{g.Get(i, displayName), g.Get(i, email),
+                           g.Get(i, id), t, g.Get(i, uri)},
+                          g.Get(i, permission)});
   }
   return res;
 }
@@ -267,11 +354,11 @@ S3Api::SendParams GeneratePutBucketTaggingRequest(const std::string &bucket,
 }
 
 //-----------------------------------------------------------------------------
-TagMap ParseTaggingResponse(const std::string &xml) {
+TagMap ParseTaggingResponse(std::string_view xml) {
   if (xml.empty()) {
     return {};
   }
-  XMLIStream is(xml);
+  XMLIStream is{string(xml)};
   // return all the <tag></tag> elements
   XMLRecords r = is["tagging/tagset/tag"];
   TagMap m;
@@ -314,6 +401,81 @@ S3Api::SendParams GeneratePutObjectTaggingRequest(const std::string &bucket,
           .uploadData = os.XMLText()};
 }
 
+//-----------------------------------------------------------------------------
+// <Delete>
+//    <Object>
+//       <Key>string</Key>
+//       <VersionId>string</VersionId>
+//    </Object>
+//    ...
+//    <Quiet>boolean</Quiet>
+// </Delete>
+S3Api::SendParams
+GenerateDeleteObjectsRequest(const std::string &bucket,
+                             const std::vector<ObjectIdentifier> &objects,
+                             bool quiet, const Headers &headers) {
+  XMLDocument doc;
+  XMLOStream os(doc);
+  os["Delete"]; // <Delete>
+  os["Quiet"] = quiet ? "true" : "false";
+  for (const auto &o : objects) {
+    os["Object"];       // <Object>
+    os["Key"] = o.key;  // <Key>
+    if (!o.versionId.empty()) {
+      os["VersionId"] = o.versionId; // <VersionId>
+    }
+    os["/"]; // </Object>
+  }
+  const string body = os.XMLText();
+  Headers h = headers;
+  h["content-md5"] = ContentMD5(body);
+  h["content-type"] = "application/xml";
+  return {.method = "POST",
+          .bucket = bucket,
+          .params = {{"delete", ""}},
+          .headers = h,
+          .uploadData = body};
+}
+
+//-----------------------------------------------------------------------------
+// <DeleteResult>
+//    <Deleted>
+//       <DeleteMarker>boolean</DeleteMarker>
+//       <DeleteMarkerVersionId>string</DeleteMarkerVersionId>
+//       <Key>string</Key>
+//       <VersionId>string</VersionId>
+//    </Deleted>
+//    ...
+//    <Error>
+//       <Code>string</Code>
+//       <Key>string</Key>
+//       <Message>string</Message>
+//       <VersionId>string</VersionId>
+//    </Error>
+//    ...
+// </DeleteResult>
+DeleteObjectsResult ParseDeleteObjectsResult(std::string_view xml) {
+  if (xml.empty())
+    return {};
+  DeleteObjectsResult res;
+  const auto d = ExtractRecords(xml, "/deleteresult/deleted");
+  const size_t key = d.Field("/key");
+  const size_t versionId = d.Field("/versionid");
+  for (size_t i = 0; i != d.size; ++i) {
+    res.deleted.push_back({d.Get(i, key), d.Get(i, versionId)});
+  }
+  const auto e = ExtractRecords(xml, "/deleteresult/error");
+  const size_t ekey = e.Field("/key");
+  const size_t eversionId = e.Field("/versionid");
+  const size_t code = e.Field("/code");
+  const size_t message = e.Field("/message");
+  for (size_t i = 0; i != e.size; ++i) {
+    res.errors.push_back({e.Get(i, ekey), e.Get(i, eversionId),
+                          e.Get(i, code), e.Get(i, message)});
+  }
+  return res;
+}
+
 //-----------------------------------------------------------------------------
 // <ListVersionsResult>
 //    <IsTruncated>boolean</IsTruncated>
@@ -360,25 +522,22 @@ S3Api::SendParams GeneratePutObjectTaggingRequest(const std::string &bucket,
 // </ListVersionsResult>
 
 pair<vector<string>, vector<string>>
-ParseListObjectVersions(const string &xml) {
-  XMLIStream is(xml);
-  vector<string> versions;
-  XMLRecords vs = is["ListVersionsResult/Version"];
-  for (auto i : vs) {
-    const auto v = Get(i, "/VersionId");
-    if (!v.empty()) {
-      versions.push_back(v);
-    }
-  }
-  XMLRecords ds = is["ListVersionsResult/DeleteMarker"];
-  vector<string> deleteMarkers;
-  for (auto i : ds) {
-    const auto d = Get(i, "/VersionId");
-    if (!d.empty()) {
-      deleteMarkers.push_back(d);
+ParseListObjectVersions(string_view xml) {
+  auto versionIds = [&xml](const string &path) {
+    const auto c = ExtractRecords(xml, path);
+    const size_t f = c.Field("/versionid");
+    vector<string> ids;
+    ids.reserve(c.size);
+    for (size_t i = 0; i != c.size; ++i) {
+      if (!c.Get(i, f).empty()) {
+        ids.push_back(c.Get(i, f));
+      }
     }
-  }
-  return {versions, deleteMarkers};
+    return ids;
+  };
+  return {versionIds("/listversionsresult/version"),
+          versionIds("/listversionsresult/deletemarker")};
 }
+
 } // namespace api
 } // namespace sss
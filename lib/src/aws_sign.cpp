@@ -123,6 +123,23 @@ string Hex(const Bytes &b) {
   return os.str();
 }
 
+//------------------------------------------------------------------------------
+namespace {
+// "/bucket/key" with each path segment URL-encoded, must match the path of
+// the request URL
+string CanonicalURI(const string &bucket, const string &key) {
+  string uri = "/";
+  if (!bucket.empty()) {
+    UrlEncodePath(bucket, uri);
+    if (!key.empty()) {
+      uri += '/';
+      UrlEncodePath(key, uri);
+    }
+  }
+  return uri;
+}
+} // namespace
+
 //------------------------------------------------------------------------------
 /// Presign url, 'expiration' time must be specified in seconds
 /// @warnihg: x-amz- fields seem not to be required to sign, metatdata
@@ -177,14 +194,7 @@ string SignedURL(const S3SignUrlConfig &cfg) {
   }
   const string canonicalQueryStringUrlEncoded = UrlEncode(parameters);
 
-  string canonicalResource = "/";
-
-  if (!cfg.bucket.empty()) {
-    canonicalResource += cfg.bucket;
-    if (!cfg.key.empty()) {
-      canonicalResource += "/" + cfg.key;
-    }
-  }
+  const string canonicalResource = CanonicalURI(cfg.bucket, cfg.key);
 
   const string payloadHash = "UNSIGNED-PAYLOAD";
 
@@ -209,10 +219,7 @@ string SignedURL(const S3SignUrlConfig &cfg) {
 
   string requestUrl = cfg.endpoint;
   if (!cfg.bucket.empty()) {
-    requestUrl += "/" + cfg.bucket;
-    if (!cfg.key.empty()) {
-      requestUrl += "/" + cfg.key;
-    }
+    requestUrl += canonicalResource;
   }
   requestUrl +=
       "?" + canonicalQueryStringUrlEncoded + "&X-Amz-Signature=" + signature;
@@ -241,14 +248,7 @@ Signature ComputeSignature(const ComputeSignatureConfig &cfg) {
   Time t = cfg.dates.dateStamp.empty() ? GetDates() : cfg.dates;
   const string reqParameters =
       cfg.parameters.empty() ? "" : UrlEncode(cfg.parameters);
-  string canonicalURI = "/";
-
-  if (!cfg.bucket.empty()) {
-    canonicalURI += cfg.bucket;
-    if (!cfg.key.empty()) {
-      canonicalURI += "/" + cfg.key;
-    }
-  }
+  const string canonicalURI = CanonicalURI(cfg.bucket, cfg.key);
 
   const string canonicalQueryString = reqParameters;
 
@@ -0,0 +1,462 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+// Persistent memory mapped bucket index
+
+#include "bucket_index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace sss {
+namespace api {
+
+namespace {
+const char MAGIC[8] = {'S', '3', 'B', 'I', 'D', 'X', '\0', '\0'};
+const uint32_t VERSION = 1;
+
+// File layout: header followed by 8 byte aligned sections, offsets are
+// relative to the beginning of the file
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t count;
+  int64_t created;
+  uint64_t bucket;
+  uint64_t bucketSize;
+  uint64_t prefix;
+  uint64_t prefixSize;
+  uint64_t keyOffsets;      // count + 1 uint64_t
+  uint64_t cumulativeSizes; // count + 1 uint64_t
+  uint64_t lastModified;    // count int64_t
+  uint64_t parts;           // count uint32_t
+  uint64_t md5;             // count x 16 bytes
+  uint64_t keys;
+  uint64_t keysSize;
+  uint64_t fileSize;
+};
+
+uint64_t Align(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+bool StartsWith(string_view s, string_view prefix) {
+  return s.substr(0, prefix.size()) == prefix;
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+BucketIndex::BucketIndex(const string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("Cannot open index file " + path + ": " +
+                        strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    throw runtime_error("Cannot read size of index file " + path + ": " +
+                        strerror(errno));
+  }
+  size_ = size_t(st.st_size);
+  if (size_ < sizeof(Header)) {
+    close(fd);
+    throw runtime_error("Invalid index file " + path);
+  }
+  data_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    throw runtime_error("Cannot map index file " + path + ": " +
+                        strerror(errno));
+  }
+  const char *base = static_cast<const char *>(data_);
+  Header h;
+  memcpy(&h, base, sizeof(h));
+  auto inside = [this](uint64_t offset, uint64_t size) {
+    return offset <= size_ && size <= size_ - offset;
+  };
+  // sections are accessed in place: offsets must be aligned
+  auto aligned = [](uint64_t offset) { return offset % 8 == 0; };
+  if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) || h.version != VERSION ||
+      h.fileSize != size_ || !aligned(h.keyOffsets) ||
+      !aligned(h.cumulativeSizes) || !aligned(h.lastModified) ||
+      !aligned(h.parts) || !inside(h.bucket, h.bucketSize) ||
+      !inside(h.prefix, h.prefixSize) ||
+      !inside(h.keyOffsets, (h.count + 1) * sizeof(uint64_t)) ||
+      !inside(h.cumulativeSizes, (h.count + 1) * sizeof(uint64_t)) ||
+      !inside(h.lastModified, h.count * sizeof(int64_t)) ||
+      !inside(h.parts, h.count * sizeof(uint32_t)) ||
+      !inside(h.md5, h.count * 16) || !inside(h.keys, h.keysSize)) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    throw runtime_error("Invalid index file " + path);
+  }
+  count_ = h.count;
+  bucket_.assign(base + h.bucket, h.bucketSize);
+  prefix_.assign(base + h.prefix, h.prefixSize);
+  keyOffsets_ = reinterpret_cast<const uint64_t *>(base + h.keyOffsets);
+  cumulativeSizes_ =
+      reinterpret_cast<const uint64_t *>(base + h.cumulativeSizes);
+  lastModified_ = reinterpret_cast<const int64_t *>(base + h.lastModified);
+  parts_ = reinterpret_cast<const uint32_t *>(base + h.parts);
+  md5_ = reinterpret_cast<const array<uint8_t, 16> *>(base + h.md5);
+  keys_ = base + h.keys;
+  // key views are served without further checks: offsets must be monotonic
+  // and end at the size of the key section
+  bool valid = keyOffsets_[0] == 0 && keyOffsets_[count_] == h.keysSize;
+  for (size_t i = 0; valid && i != count_; ++i) {
+    valid = keyOffsets_[i] <= keyOffsets_[i + 1];
+  }
+  if (!valid) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    throw runtime_error("Invalid index file " + path);
+  }
+}
+
+//-----------------------------------------------------------------------------
+BucketIndex::~BucketIndex() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+//-----------------------------------------------------------------------------
+int64_t BucketIndex::Created() const {
+  Header h;
+  memcpy(&h, data_, sizeof(h));
+  return h.created;
+}
+
+//-----------------------------------------------------------------------------
+string BucketIndex::ETag(size_t i) const {
+  if (parts_[i] == ObjectInventory::NON_MD5)
+    return "";
+  static const char *hex = "0123456789abcdef";
+  string e(32, '0');
+  for (size_t b = 0; b != 16; ++b) {
+    e[2 * b] = hex[md5_[i][b] >> 4];
+    e[2 * b + 1] = hex[md5_[i][b] & 0xF];
+  }
+  if (parts_[i] > 0)
+    e += "-" + to_string(parts_[i]);
+  return e;
+}
+
+//-----------------------------------------------------------------------------
+size_t BucketIndex::LowerBound(string_view key) const {
+  size_t first = 0;
+  size_t count = count_;
+  while (count > 0) {
+    const size_t step = count / 2;
+    if (Key(first + step) < key) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+//-----------------------------------------------------------------------------
+size_t BucketIndex::Find(string_view key) const {
+  const size_t i = LowerBound(key);
+  return i < count_ && Key(i) == key ? i : npos;
+}
+
+//-----------------------------------------------------------------------------
+pair<size_t, size_t> BucketIndex::PrefixRange(string_view prefix) const {
+  const size_t first = LowerBound(prefix);
+  size_t last = first;
+  size_t count = count_ - first;
+  while (count > 0) {
+    const size_t step = count / 2;
+    if (StartsWith(Key(last + step), prefix)) {
+      last += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return {first, last};
+}
+
+//-----------------------------------------------------------------------------
+size_t BucketIndex::Count(string_view prefix) const {
+  const auto r = PrefixRange(prefix);
+  return r.second - r.first;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t BucketIndex::TotalSize(string_view prefix) const {
+  const auto r = PrefixRange(prefix);
+  return cumulativeSizes_[r.second] - cumulativeSizes_[r.first];
+}
+
+//-----------------------------------------------------------------------------
+void BucketIndex::Write(const string &path, const string &bucket,
+                        const string &prefix,
+                        const ObjectInventory &inventory) {
+  if (!inventory.Sorted()) {
+    throw logic_error("Cannot write index of unsorted inventory");
+  }
+  const uint64_t n = inventory.Size();
+  uint64_t keysSize = 0;
+  for (size_t i = 0; i != n; ++i) {
+    keysSize += inventory.Key(i).size();
+  }
+  Header h;
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = VERSION;
+  h.headerSize = sizeof(Header);
+  h.count = n;
+  h.created = chrono::duration_cast<chrono::milliseconds>(
+                  chrono::system_clock::now().time_since_epoch())
+                  .count();
+  h.bucket = Align(sizeof(Header));
+  h.bucketSize = bucket.size();
+  h.prefix = Align(h.bucket + h.bucketSize);
+  h.prefixSize = prefix.size();
+  h.keyOffsets = Align(h.prefix + h.prefixSize);
+  h.cumulativeSizes = h.keyOffsets + (n + 1) * sizeof(uint64_t);
+  h.lastModified = h.cumulativeSizes + (n + 1) * sizeof(uint64_t);
+  h.parts = h.lastModified + n * sizeof(int64_t);
+  h.md5 = Align(h.parts + n * sizeof(uint32_t));
+  h.keys = h.md5 + n * 16;
+  h.keysSize = keysSize;
+  h.fileSize = h.keys + keysSize;
+
+  // written to a temporary file in the target directory and renamed once
+  // synced to disk: readers and crashes never observe a partial index
+  string tmp = path + ".XXXXXX";
+  const int fd = mkstemp(&tmp[0]);
+  if (fd < 0) {
+    throw runtime_error("Cannot create file " + tmp + ": " + strerror(errno));
+  }
+  // mkstemp creates files readable by the owner only
+  fchmod(fd, 0644);
+  FILE *f = fdopen(fd, "wb");
+  if (!f) {
+    const int err = errno;
+    close(fd);
+    unlink(tmp.c_str());
+    throw runtime_error("Cannot open file " + tmp + ": " + strerror(err));
+  }
+  bool ok = true;
+  uint64_t pos = 0;
+  auto write = [f, &ok, &pos](const void *p, size_t size) {
+    ok = ok && fwrite(p, 1, size, f) == size;
+    pos += size;
+  };
+  auto pad = [&](uint64_t offset) {
+    static const char zeros[8] = {};
+    write(zeros, offset - pos);
+  };
+  write(&h, sizeof(h));
+  pad(h.bucket);
+  write(bucket.data(), bucket.size());
+  pad(h.prefix);
+  write(prefix.data(), prefix.size());
+  pad(h.keyOffsets);
+  uint64_t offset = 0;
+  write(&offset, sizeof(offset));
+  for (size_t i = 0; i != n; ++i) {
+    offset += inventory.Key(i).size();
+    write(&offset, sizeof(offset));
+  }
+  uint64_t total = 0;
+  write(&total, sizeof(total));
+  for (size_t i = 0; i != n; ++i) {
+    total += inventory.ObjectSize(i);
+    write(&total, sizeof(total));
+  }
+  for (size_t i = 0; i != n; ++i) {
+    const int64_t t = inventory.LastModified(i);
+    write(&t, sizeof(t));
+  }
+  for (size_t i = 0; i != n; ++i) {
+    const uint32_t p = inventory.ETagParts(i);
+    write(&p, sizeof(p));
+  }
+  pad(h.md5);
+  for (size_t i = 0; i != n; ++i) {
+    write(inventory.ETagMD5(i).data(), 16);
+  }
+  for (size_t i = 0; i != n; ++i) {
+    const auto k = inventory.Key(i);
+    write(k.data(), k.size());
+  }
+  ok = ok && fflush(f) == 0 && fsync(fd) == 0;
+  const int writeError = errno;
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    unlink(tmp.c_str());
+    throw runtime_error("Error writing file " + tmp + ": " +
+                        strerror(writeError));
+  }
+  if (rename(tmp.c_str(), path.c_str())) {
+    const int err = errno;
+    unlink(tmp.c_str());
+    throw runtime_error("Cannot rename " + tmp + " to " + path + ": " +
+                        strerror(err));
+  }
+  // sync directory to persist the rename
+  const size_t slash = path.rfind('/');
+  const string dir = slash == string::npos ? "."
+                     : slash == 0          ? "/"
+                                           : path.substr(0, slash);
+  const int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dfd < 0 || fsync(dfd)) {
+    const int err = errno;
+    if (dfd >= 0)
+      close(dfd);
+    throw runtime_error("Cannot sync directory " + dir + ": " +
+                        strerror(err));
+  }
+  close(dfd);
+}
+
+//-----------------------------------------------------------------------------
+size_t BuildBucketIndex(const S3Api &s3, const string &bucket,
+                        const string &prefix, const string &path,
+                        ParallelListConfig cfg) {
+  cfg.prefix = prefix;
+  const auto inventory = ListObjectInventory(s3, bucket, cfg);
+  BucketIndex::Write(path, bucket, prefix, inventory);
+  return inventory.Size();
+}
+
+//-----------------------------------------------------------------------------
+size_t RefreshBucketIndex(const S3Api &s3, const string &path,
+                          const BucketIndexRefreshConfig &cfg) {
+  ObjectInventory inventory;
+  string bucket;
+  string prefix;
+  {
+    const BucketIndex index(path);
+    bucket = index.Bucket();
+    prefix = index.Prefix();
+    auto append = [&inventory](const vector<ObjectInfo> &objects) {
+      inventory.Append(objects);
+    };
+    auto listAll = [&](const string &p) {
+      ParallelListConfig lc = cfg.list;
+      lc.prefix = p;
+      lc.ordered = false;
+      ListObjectsParallel(s3, bucket, lc, append);
+    };
+    auto copy = [&](size_t first, size_t last) {
+      for (size_t i = first; i != last; ++i) {
+        inventory.Append(index.Key(i), index.ObjectSize(i),
+                         index.LastModified(i), index.ETagMD5(i),
+                         index.ETagParts(i));
+      }
+    };
+    S3Api::ListObjectV2Config lc;
+    lc.prefix = prefix;
+    lc.delimiter = cfg.list.delimiter;
+    lc.maxKeys = cfg.list.maxKeys;
+    ListObjectsV2Range top(s3, bucket, lc, true, cfg.list.headers);
+    // keys directly under prefix
+    for (const auto &o : top) {
+      inventory.Append(o);
+    }
+    for (const auto &p : top.CommonPrefixes()) {
+      const auto range = index.PrefixRange(p);
+      const bool relist =
+          range.first == range.second ||
+          any_of(cfg.relist.begin(), cfg.relist.end(),
+                 [&p](const string &r) { return StartsWith(p, r); });
+      if (relist) {
+        listAll(p);
+        continue;
+      }
+      // prefixes to relist under current common prefix
+      vector<string> nested;
+      for (const auto &r : cfg.relist) {
+        if (StartsWith(r, p))
+          nested.push_back(r);
+      }
+      // drop prefixes covered by other relisted prefixes, which would be
+      // listed twice
+      sort(nested.begin(), nested.end());
+      nested.erase(unique(nested.begin(), nested.end(),
+                          [](const string &a, const string &b) {
+                            return StartsWith(b, a);
+                          }),
+                   nested.end());
+      auto isNested = [&nested](string_view key) {
+        return any_of(nested.begin(), nested.end(),
+                      [key](const string &r) { return StartsWith(key, r); });
+      };
+      size_t first = range.first;
+      for (size_t i = range.first; i != range.second; ++i) {
+        if (isNested(index.Key(i))) {
+          copy(first, i);
+          first = i + 1;
+        }
+      }
+      copy(first, range.second);
+      for (const auto &r : nested) {
+        listAll(r);
+      }
+      if (cfg.appendOnly) {
+        S3Api::ListObjectV2Config ac;
+        ac.prefix = p;
+        ac.startAfter = string(index.Key(range.second - 1));
+        ac.maxKeys = cfg.list.maxKeys;
+        for (const auto &o :
+             ListObjectsV2Range(s3, bucket, ac, true, cfg.list.headers)) {
+          if (!isNested(o.key))
+            inventory.Append(o);
+        }
+      }
+    }
+  }
+  inventory.Sort();
+  BucketIndex::Write(path, bucket, prefix, inventory);
+  return inventory.Size();
+}
+} // namespace api
+} // namespace sss
@@ -33,11 +33,15 @@
 
 // Download objects
 
+#include "retry_policy.h"
 #include "s3-api.h"
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <future>
+#include <mutex>
 #include <thread>
 
 #include <fstream>
@@ -49,55 +53,235 @@ using namespace api;
 namespace {
 // Log number or download retries;
 atomic<int> retriesG;
+// Log number of hedged requests
+atomic<int> hedgesG;
+// Minimum number of latency samples required before issuing hedged requests
+const size_t MIN_HEDGE_SAMPLES = 5;
+
+// Track part download latencies within a single transfer
+class LatencyTracker {
+public:
+  void Add(chrono::steady_clock::duration d) {
+    lock_guard<mutex> lock(mutex_);
+    samples_.push_back(d);
+  }
+  // Return latency quantile, zero if not enough samples were collected
+  chrono::steady_clock::duration Quantile(double q) const {
+    lock_guard<mutex> lock(mutex_);
+    if (samples_.size() < MIN_HEDGE_SAMPLES)
+      return chrono::steady_clock::duration::zero();
+    auto s = samples_;
+    auto n = begin(s) + size_t(q * (s.size() - 1));
+    nth_element(begin(s), n, end(s));
+    return *n;
+  }
+
+private:
+  mutable mutex mutex_;
+  vector<chrono::steady_clock::duration> samples_;
+};
+
+// Select endpoint for hedged request, different from current one if possible
+string HedgeEndpoint(const vector<string> &endpoints, const string &current) {
+  if (endpoints.size() < 2)
+    return current;
+  const string &ep = endpoints[RandomIndex(0, endpoints.size() - 2)];
+  return ep != current ? ep : endpoints.back();
+}
 } // namespace
 
 int GetDownloadRetries() { return retriesG; }
 
+int GetDownloadHedgedRequests() { return hedgesG; }
+
 //-----------------------------------------------------------------------------
 void DownloadPart(S3Api &s3, const string &file, const string &bucket,
                   const string &key, size_t offset, size_t partSize,
-                  int maxRetries, const string &versionId) {
-  try {
-    s3.GetFileObject(file, bucket, key, offset, offset, offset + partSize - 1,
-                     {}, versionId);
-  } catch (const exception &e) {
-    if (retriesG++ > maxRetries)
-      throw e;
-    else
-      DownloadPart(s3, file, bucket, key, offset, partSize, maxRetries,
-                   versionId);
-  }
+                  int maxRetries, const string &versionId,
+                  const atomic<bool> *cancel = nullptr) {
+  RetryPolicy(maxRetries).Run(
+      [&] {
+        s3.GetFileObject(file, bucket, key, offset, offset,
+                         offset + partSize - 1, {}, versionId);
+      },
+      &retriesG, cancel);
 }
 
 //-----------------------------------------------------------------------------
 void DownloadPart(S3Api &s3, char *data, const string &bucket,
                   const string &key, size_t offset, size_t partSize,
-                  int maxRetries, const string &versionId) {
-  try {
-    s3.GetObject(bucket, key, data, offset, offset, offset + partSize - 1, {},
-                 versionId);
-  } catch (const exception &e) {
-    if (retriesG++ > maxRetries)
-      throw e;
-    else
-      DownloadPart(s3, data, bucket, key, offset, partSize, maxRetries,
-                   versionId);
+                  int maxRetries, const string &versionId,
+                  const atomic<bool> *cancel = nullptr) {
+  RetryPolicy(maxRetries).Run(
+      [&] {
+        s3.GetObject(bucket, key, data, offset, offset, offset + partSize - 1,
+                     {}, versionId);
+      },
+      &retriesG, cancel);
+}
+//-----------------------------------------------------------------------------
+// Write downloaded range into file or memory buffer
+void StorePart(const vector<char> &bytes, const string &file, size_t offset) {
+  FILE *out = fopen(file.c_str(), "r+b");
+  if (!out) {
+    throw runtime_error("Cannot open file " + file + " for writing");
+  }
+  fseek(out, offset, SEEK_SET);
+  const size_t written = fwrite(bytes.data(), 1, bytes.size(), out);
+  fclose(out);
+  if (written != bytes.size()) {
+    throw runtime_error("Cannot write to file " + file);
+  }
+}
+void StorePart(const vector<char> &bytes, char *data, size_t offset) {
+  copy(begin(bytes), end(bytes), data + offset);
+}
+
+//-----------------------------------------------------------------------------
+// Download part; if the part is not received within the p95 latency observed
+// so far issue a duplicate request for the same range, possibly to a different
+// endpoint, and keep the first one that completes. The duplicate request
+// receives data into a temporary buffer copied to the output after the
+// primary request has been aborted.
+template <typename OutT>
+void DownloadPartHedged(S3Api &s3, OutT out, const S3DataTransferConfig &cfg,
+                        size_t part, size_t offset, size_t partSize,
+                        const string &versionId, LatencyTracker &latency) {
+  struct {
+    mutex m;
+    condition_variable cv;
+    int done = 0;
+    int winner = -1;
+    exception_ptr errors[2];
+  } state;
+  atomic<bool> cancel[2] = {false, false};
+  Span *parent = Span::Current();
+  // run request and notify completion
+  auto run = [&state, &cancel, parent](int i, auto f) {
+    Span span(i == 0 ? "Primary" : "Hedge", parent);
+    const auto start = chrono::steady_clock::now();
+    chrono::steady_clock::duration elapsed{};
+    try {
+      if (cancel[i])
+        throw runtime_error("Request cancelled");
+      f();
+      elapsed = chrono::steady_clock::now() - start;
+    } catch (const exception &e) {
+      state.errors[i] = current_exception();
+      span.SetError(e.what());
+    } catch (...) {
+      state.errors[i] = current_exception();
+    }
+    lock_guard<mutex> lock(state.m);
+    if (!state.errors[i] && state.winner < 0)
+      state.winner = i;
+    ++state.done;
+    state.cv.notify_all();
+    return elapsed;
+  };
+  s3.SetCancelFlag(&cancel[0]);
+  auto primary = async(launch::async, run, 0, [&] {
+    DownloadPart(s3, out, cfg.bucket, cfg.key, offset, partSize,
+                 cfg.maxRetries, versionId, &cancel[0]);
+  });
+  const auto threshold = latency.Quantile(0.95);
+  unique_lock<mutex> lock(state.m);
+  int started = 1;
+  if (threshold > chrono::steady_clock::duration::zero() &&
+      !state.cv.wait_for(lock, threshold, [&] { return state.done > 0; })) {
+    lock.unlock();
+    ++hedgesG;
+    ++started;
+    // the hedge is pinned to an endpoint other than the one the primary
+    // request was sent to: a selector attached to the hedge client would
+    // select again for each attempt
+    const string current = s3.RequestEndpoint();
+    S3Api hedge(cfg.accessKey, cfg.secretKey,
+                cfg.endpointSelector ? cfg.endpointSelector->Select(current)
+                                     : HedgeEndpoint(cfg.endpoints, current));
+    hedge.SetMetricsRegistry(cfg.registry);
+    hedge.SetBandwidthShaper(cfg.bandwidthShaper);
+    hedge.SetCancelFlag(&cancel[1]);
+    const MetricsGuard<S3Api> metrics(cfg.metrics, hedge);
+    vector<char> buffer;
+    auto secondary = async(launch::async, run, 1, [&] {
+      RetryPolicy(cfg.maxRetries)
+          .Run(
+              [&] {
+                buffer = hedge.GetObject(cfg.bucket, cfg.key, offset,
+                                         offset + partSize - 1, {},
+                                         versionId);
+              },
+              &retriesG, &cancel[1]);
+    });
+    lock.lock();
+    state.cv.wait(lock,
+                  [&] { return state.winner >= 0 || state.done == started; });
+    const int winner = state.winner;
+    lock.unlock();
+    if (winner >= 0)
+      cancel[1 - winner] = true;
+    const auto elapsed = winner == 1 ? secondary.get() : primary.get();
+    // wait for loser to exit before writing to output
+    (winner == 1 ? primary : secondary).wait();
+    s3.SetCancelFlag(nullptr);
+    if (winner < 0)
+      rethrow_exception(state.errors[0]);
+    if (winner == 1) {
+      StorePart(buffer, out, offset);
+      // hedged request does not update progress, bytes received by the
+      // cancelled primary request have been discarded
+      if (cfg.progress && state.errors[0])
+        cfg.progress->Add(part, int64_t(partSize));
+    }
+    latency.Add(elapsed);
+    return;
   }
+  lock.unlock();
+  const auto elapsed = primary.get();
+  s3.SetCancelFlag(nullptr);
+  if (state.errors[0])
+    rethrow_exception(state.errors[0]);
+  latency.Add(elapsed);
 }
+
 //-----------------------------------------------------------------------------
 void DownloadParts(const S3DataTransferConfig &cfg, size_t chunkSize,
                    int firstPart, int lastPart, size_t objectSize, int jobId,
-                   const string &versionId) {
+                   const string &versionId, LatencyTracker *latency,
+                   Span *parent) {
   size_t offset = jobId * chunkSize;
   chunkSize = min(chunkSize, objectSize - offset);
   const int numParts = lastPart - firstPart;
   const size_t partSize = (chunkSize + numParts - 1) / numParts;
   const auto endpoint = cfg.endpoints[RandomIndex(0, cfg.endpoints.size() - 1)];
   S3Api s3(cfg.accessKey, cfg.secretKey, endpoint);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  s3.SetBandwidthShaper(cfg.bandwidthShaper);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
   for (int i = 0; i != numParts; ++i) {
     const size_t size = min(partSize, chunkSize - i * partSize);
-    DownloadPart(s3, cfg.data ? cfg.data : cfg.file, cfg.bucket, cfg.key,
-                 offset, size, cfg.maxRetries, versionId);
+    const size_t part = size_t(firstPart + i);
+    Span span("Part", parent);
+    span.Set("part", part + 1);
+    span.Set("bytes", size);
+    PartProgress<S3Api> progress(cfg.progress.get(), s3, part);
+    if (latency) {
+      if (cfg.data)
+        DownloadPartHedged(s3, cfg.data, cfg, part, offset, size, versionId,
+                           *latency);
+      else
+        DownloadPartHedged(s3, cfg.file, cfg, part, offset, size, versionId,
+                           *latency);
+    } else if (cfg.data) {
+      DownloadPart(s3, cfg.data, cfg.bucket, cfg.key, offset, size,
+                   cfg.maxRetries, versionId);
+    } else {
+      DownloadPart(s3, cfg.file, cfg.bucket, cfg.key, offset, size,
+                   cfg.maxRetries, versionId);
+    }
+    progress.Success();
     offset += size;
   }
 }
@@ -110,12 +294,18 @@ void DownloadFile(const S3DataTransferConfig &cfg, bool sync,
     throw std::logic_error("No endpoint specified");
   }
   S3Api s3(cfg.accessKey, cfg.secretKey, cfg.endpoints[0]);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
   const size_t fileSize = s3.GetObjectSize(cfg.bucket, cfg.key);
+  if (cfg.progress)
+    cfg.progress->Start(fileSize, size_t(cfg.jobs) * cfg.partsPerJob);
   // create output file
   std::ofstream ofs(cfg.file, std::ios::binary | std::ios::out);
   ofs.seekp(fileSize - 1);
   ofs.write("", 1);
   ofs.close();
+  LatencyTracker latency;
   // initiate request
   const size_t perJobSize = (fileSize + cfg.jobs - 1) / cfg.jobs;
   // send parts in parallel and store ETags
@@ -124,10 +314,12 @@ void DownloadFile(const S3DataTransferConfig &cfg, bool sync,
     dloads[i] =
         async(sync ? launch::deferred : launch::async, DownloadParts, cfg,
               perJobSize, i * cfg.partsPerJob,
-              i * cfg.partsPerJob + cfg.partsPerJob, fileSize, i, versionId);
+              i * cfg.partsPerJob + cfg.partsPerJob, fileSize, i, versionId,
+              cfg.hedgeRequests ? &latency : nullptr, Span::Current());
   }
+  // get() re-throws exceptions from failed parts
   for (auto &i : dloads) {
-    i.wait();
+    i.get();
   }
 }
 
@@ -142,6 +334,12 @@ void DownloadData(const S3DataTransferConfig &cfg, bool sync,
     throw std::logic_error("No endpoint specified");
   }
   S3Api s3(cfg.accessKey, cfg.secretKey, cfg.endpoints[0]);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
+  if (cfg.progress)
+    cfg.progress->Start(cfg.size, size_t(cfg.jobs) * cfg.partsPerJob);
+  LatencyTracker latency;
   // initiate request
   const size_t perJobSize = (cfg.size + cfg.jobs - 1) / cfg.jobs;
   // send parts in parallel and store ETags
@@ -150,23 +348,40 @@ void DownloadData(const S3DataTransferConfig &cfg, bool sync,
     dloads[i] =
         async(sync ? launch::deferred : launch::async, DownloadParts, cfg,
               perJobSize, i * cfg.partsPerJob,
-              i * cfg.partsPerJob + cfg.partsPerJob, cfg.size, i, versionId);
+              i * cfg.partsPerJob + cfg.partsPerJob, cfg.size, i, versionId,
+              cfg.hedgeRequests ? &latency : nullptr, Span::Current());
   }
+  // get() re-throws exceptions from failed parts
   for (auto &i : dloads) {
-    i.wait();
+    i.get();
   }
 }
 
 //-----------------------------------------------------------------------------
-void Download(const S3DataTransferConfig &cfg, bool sync,
+void Download(const S3DataTransferConfig &config, bool sync,
               const string &versionId) {
-  if (!cfg.data && cfg.file.empty()) {
+  if (!config.data && config.file.empty()) {
     throw logic_error("File name and data buffer pointer are both NULL");
   }
+  // balance requests across endpoints if no selector specified
+  S3DataTransferConfig cfg = config;
+  if (!cfg.endpointSelector && cfg.endpoints.size() > 1) {
+    cfg.endpointSelector = make_shared<EndpointSelector>(cfg.endpoints);
+  }
+  TransferRecorder recorder(cfg.registry, "Download");
+  const ProgressFinisher finisher(cfg.progress.get());
+  Span span("Download", cfg.tracer.get());
+  span.Set("bucket", cfg.bucket);
+  span.Set("key", cfg.key);
   if (cfg.data) {
+    span.Set("bytes", cfg.size);
     DownloadData(cfg, sync, versionId);
+    recorder.SetBytes(cfg.size);
   } else {
+    span.Set("file", cfg.file);
     DownloadFile(cfg, sync, versionId);
+    recorder.SetBytes(FileSize(cfg.file));
   }
+  recorder.Success();
 }
 } // namespace sss
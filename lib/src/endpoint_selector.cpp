@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Endpoint selector implementation
+
+#include "endpoint_selector.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sss {
+
+//-----------------------------------------------------------------------------
+EndpointSelector::EndpointSelector(const vector<string> &endpoints,
+                                   const EndpointSelectorConfig &cfg)
+    : config_(cfg) {
+  if (endpoints.empty()) {
+    throw invalid_argument("Empty endpoint list");
+  }
+  for (const auto &e : endpoints) {
+    endpoints_.push_back({.endpoint = e});
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool EndpointSelector::Available(const EndpointStats &e,
+                                 Clock::time_point now) const {
+  if (e.ejections == 0)
+    return true;
+  // ejection expired: allow a single probe request
+  return now >= e.ejectedUntil && e.outstanding == 0;
+}
+
+//-----------------------------------------------------------------------------
+string EndpointSelector::Select(const string &exclude) {
+  lock_guard<mutex> lock(mutex_);
+  const auto now = Clock::now();
+  vector<const EndpointStats *> available;
+  available.reserve(endpoints_.size());
+  const EndpointStats *excluded = nullptr;
+  double latency = 0;
+  int sampled = 0;
+  for (const auto &e : endpoints_) {
+    if (!Available(e, now))
+      continue;
+    if (e.endpoint == exclude) {
+      excluded = &e;
+      continue;
+    }
+    available.push_back(&e);
+    if (e.latency > 0) {
+      latency += e.latency;
+      ++sampled;
+    }
+  }
+  if (available.empty() && excluded)
+    return excluded->endpoint;
+  if (available.empty()) {
+    return min_element(begin(endpoints_), end(endpoints_),
+                       [](const EndpointStats &a, const EndpointStats &b) {
+                         return a.ejectedUntil < b.ejectedUntil;
+                       })
+        ->endpoint;
+  }
+  if (available.size() == 1)
+    return available.front()->endpoint;
+  const int n = int(available.size());
+  const int i = RandomIndex(0, n - 1);
+  const int j = (i + RandomIndex(1, n - 1)) % n;
+  // endpoints not sampled yet get the average latency, or the same unit
+  // latency as all others if none was sampled
+  const double seed = sampled ? latency / sampled : 1.;
+  auto score = [seed](const EndpointStats *e) {
+    return (e->latency > 0 ? e->latency : seed) * (e->outstanding + 1);
+  };
+  return score(available[i]) <= score(available[j]) ? available[i]->endpoint
+                                                      : available[j]->endpoint;
+}
+
+//-----------------------------------------------------------------------------
+EndpointSelector::EndpointStats *EndpointSelector::Find(const string &ep) {
+  auto i = find_if(begin(endpoints_), end(endpoints_),
+                   [&ep](const EndpointStats &e) { return e.endpoint == ep; });
+  return i == end(endpoints_) ? nullptr : &(*i);
+}
+
+//-----------------------------------------------------------------------------
+void EndpointSelector::Begin(const string &endpoint) {
+  lock_guard<mutex> lock(mutex_);
+  if (auto e = Find(endpoint)) {
+    ++e->outstanding;
+    ++e->requests;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void EndpointSelector::Report(const string &endpoint, bool success,
+                              Clock::duration latency) {
+  lock_guard<mutex> lock(mutex_);
+  auto e = Find(endpoint);
+  if (!e)
+    return;
+  e->outstanding = max(0, e->outstanding - 1);
+  if (success) {
+    const double l = chrono::duration<double>(latency).count();
+    e->latency = e->latency == 0 ? l
+                                 : config_.ewmaAlpha * l +
+                                       (1 - config_.ewmaAlpha) * e->latency;
+    e->failures = 0;
+    e->ejections = 0;
+    return;
+  }
+  ++e->errors;
+  // failed probe or too many consecutive failures: eject
+  if (e->ejections > 0 || ++e->failures >= config_.maxConsecutiveFailures) {
+    const chrono::milliseconds t =
+        min(chrono::milliseconds(config_.ejectionTime *
+                                 (1 << min(e->ejections, 20))),
+            config_.maxEjectionTime);
+    ++e->ejections;
+    e->failures = 0;
+    e->ejectedUntil = Clock::now() + t;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void EndpointSelector::Cancel(const string &endpoint) {
+  lock_guard<mutex> lock(mutex_);
+  if (auto e = Find(endpoint)) {
+    e->outstanding = max(0, e->outstanding - 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+vector<EndpointSelector::EndpointStats> EndpointSelector::Stats() const {
+  lock_guard<mutex> lock(mutex_);
+  return endpoints_;
+}
+} // namespace sss
@@ -0,0 +1,591 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Metrics registry
+
+#include "metrics_registry.h"
+
+#include <array>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+using Slot = atomic<uint64_t>;
+constexpr size_t CHUNK_SIZE = 8192; // slots allocated at once
+constexpr size_t MAX_CHUNKS = 1024;
+// histogram buckets followed by sum of values
+constexpr size_t HISTOGRAM_SLOTS = HistogramSnapshot::NUM_BUCKETS + 1;
+
+// Counter and histogram values recorded by a single thread; chunks are
+// allocated on first use by the owning thread and never released until the
+// registry is destroyed
+struct Shard {
+  array<atomic<Slot *>, MAX_CHUNKS> chunks{};
+  ~Shard() {
+    for (auto &c : chunks)
+      delete[] c.load();
+  }
+  // called by owning thread only
+  Slot *At(uint32_t offset) {
+    auto &c = chunks[offset / CHUNK_SIZE];
+    Slot *p = c.load(memory_order_acquire);
+    if (!p) {
+      p = new Slot[CHUNK_SIZE]();
+      c.store(p, memory_order_release);
+    }
+    return p + offset % CHUNK_SIZE;
+  }
+  uint64_t Read(uint32_t offset) const {
+    const Slot *p = chunks[offset / CHUNK_SIZE].load(memory_order_acquire);
+    return p ? p[offset % CHUNK_SIZE].load(memory_order_relaxed) : 0;
+  }
+};
+
+// single writer: plain load and store, no locked read-modify-write
+inline void Add(Slot &s, uint64_t v) {
+  s.store(s.load(memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+// add value to histogram
+inline void Record(Slot *slots, uint64_t value) {
+  Add(slots[HistogramSnapshot::BucketIndex(value)], 1);
+  Add(slots[HistogramSnapshot::NUM_BUCKETS], value);
+}
+
+inline uint64_t Micros(chrono::microseconds d) {
+  return uint64_t(max(d.count(), int64_t(0)));
+}
+
+// thread serial number, unlike std::thread::id never reused by new threads
+atomic<uint64_t> threadSerials{0};
+uint64_t ThreadSerial() {
+  thread_local const uint64_t serial = ++threadSerials;
+  return serial;
+}
+
+string StatusClass(long status) {
+  return status > 0 ? to_string(status / 100) + "xx" : "error";
+}
+
+struct Series {
+  MetricsRegistry::Kind kind;
+  string name;
+  Labels labels;
+  string labelText;         // {name="value",...}, empty if no labels
+  uint32_t offset = 0;      // first slot in shards
+  atomic<int64_t> *gauge = nullptr;
+};
+
+string Escape(const string &s, bool json) {
+  string out;
+  out.reserve(s.size());
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (json && (unsigned char)c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out;
+}
+
+string LabelText(const Labels &labels) {
+  if (labels.empty())
+    return "";
+  string t = "{";
+  for (const auto &l : labels) {
+    if (t.size() > 1)
+      t += ',';
+    t += l.first + "=\"" + Escape(l.second, false) + '"';
+  }
+  return t + '}';
+}
+
+// add 'le' label to label text
+string WithLe(const string &labelText, const string &le) {
+  const string l = "le=\"" + le + '"';
+  return labelText.empty()
+             ? '{' + l + '}'
+             : labelText.substr(0, labelText.size() - 1) + ',' + l + '}';
+}
+
+const char *TypeName(MetricsRegistry::Kind k) {
+  switch (k) {
+  case MetricsRegistry::COUNTER:
+    return "counter";
+  case MetricsRegistry::GAUGE:
+    return "gauge";
+  default:
+    return "histogram";
+  }
+}
+
+atomic<uint64_t> registryIds{0};
+} // namespace
+
+//-----------------------------------------------------------------------------
+uint64_t HistogramSnapshot::Quantile(double q) const {
+  if (!count)
+    return 0;
+  q = min(max(q, 0.), 1.);
+  const uint64_t target = max(uint64_t(1), uint64_t(ceil(q * count)));
+  uint64_t n = 0;
+  for (size_t i = 0; i != buckets.size(); ++i) {
+    n += buckets[i];
+    if (n >= target)
+      return BucketUpperBound(i);
+  }
+  return BucketUpperBound(buckets.size() - 1);
+}
+
+//-----------------------------------------------------------------------------
+size_t HistogramSnapshot::BucketIndex(uint64_t value) {
+  if (value < SUB_BUCKETS)
+    return size_t(value);
+  // position of most significant bit, at least 3
+  size_t e = 63;
+  while (!(value >> e))
+    --e;
+  const size_t sub = size_t(value >> (e - 3)) & (SUB_BUCKETS - 1);
+  return SUB_BUCKETS + (e - 3) * SUB_BUCKETS + sub;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t HistogramSnapshot::BucketUpperBound(size_t i) {
+  if (i < SUB_BUCKETS)
+    return i;
+  const size_t e = (i - SUB_BUCKETS) / SUB_BUCKETS + 3;
+  const uint64_t sub = (i - SUB_BUCKETS) % SUB_BUCKETS;
+  const uint64_t lower = (SUB_BUCKETS + sub) << (e - 3);
+  return lower + ((uint64_t(1) << (e - 3)) - 1);
+}
+
+//-----------------------------------------------------------------------------
+struct MetricsRegistry::Impl {
+  const uint64_t id = registryIds++;
+  mutable mutex guard;
+  vector<Series> series;
+  unordered_map<string, size_t> index; // series key -> series
+  uint32_t nextSlot = 0;
+  deque<atomic<int64_t>> gauges;
+  vector<unique_ptr<Shard>> shards;
+  vector<Shard *> freeShards; // shards of terminated threads
+
+  // add series if not present, return series
+  const Series &Register(Kind kind, const string &key, const string &name,
+                         const Labels &labels) {
+    lock_guard<mutex> lock(guard);
+    auto i = index.find(key);
+    if (i == index.end()) {
+      Series s{kind, name, labels, LabelText(labels)};
+      if (kind == GAUGE) {
+        gauges.emplace_back(0);
+        s.gauge = &gauges.back();
+      } else {
+        const size_t len = kind == HISTOGRAM ? HISTOGRAM_SLOTS : 1;
+        // series never span chunks
+        if (nextSlot / CHUNK_SIZE != (nextSlot + len - 1) / CHUNK_SIZE) {
+          nextSlot = uint32_t((nextSlot / CHUNK_SIZE + 1) * CHUNK_SIZE);
+        }
+        if (nextSlot + len > CHUNK_SIZE * MAX_CHUNKS) {
+          throw length_error("Too many metric series");
+        }
+        s.offset = nextSlot;
+        nextSlot += uint32_t(len);
+      }
+      series.push_back(move(s));
+      i = index.insert({key, series.size() - 1}).first;
+    }
+    const Series &s = series[i->second];
+    if (s.kind != kind) {
+      throw logic_error("Metric " + key + " already registered as " +
+                        TypeName(s.kind));
+    }
+    return s;
+  }
+  Shard *AcquireShard() {
+    lock_guard<mutex> lock(guard);
+    if (!freeShards.empty()) {
+      Shard *s = freeShards.back();
+      freeShards.pop_back();
+      return s;
+    }
+    shards.push_back(make_unique<Shard>());
+    return shards.back().get();
+  }
+  void ReleaseShard(Shard *s) {
+    lock_guard<mutex> lock(guard);
+    freeShards.push_back(s);
+  }
+  // merge shards, called with lock held
+  Sample Snapshot(const Series &s) const {
+    Sample r{s.kind, s.name, s.labels};
+    auto sum = [this](uint32_t offset) {
+      uint64_t v = 0;
+      for (const auto &shard : shards)
+        v += shard->Read(offset);
+      return v;
+    };
+    if (s.kind == GAUGE) {
+      r.value = s.gauge->load(memory_order_relaxed);
+    } else if (s.kind == COUNTER) {
+      r.value = int64_t(sum(s.offset));
+    } else {
+      auto &h = r.histogram;
+      h.buckets.resize(HistogramSnapshot::NUM_BUCKETS);
+      for (size_t b = 0; b != h.buckets.size(); ++b) {
+        h.buckets[b] = sum(s.offset + uint32_t(b));
+        h.count += h.buckets[b];
+      }
+      h.sum = sum(s.offset + uint32_t(HistogramSnapshot::NUM_BUCKETS));
+    }
+    return r;
+  }
+  Sample Snapshot(const string &name, const Labels &labels) const {
+    lock_guard<mutex> lock(guard);
+    auto i = index.find(name + LabelText(labels));
+    return i == index.end() ? Sample() : Snapshot(series[i->second]);
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Per-thread state: shard and handles of series recorded by the thread;
+// the shard is returned to the registry when the thread terminates and
+// reused by new threads
+struct MetricsRegistry::Local {
+  shared_ptr<Impl> impl;
+  Shard *shard;
+  unordered_map<string, Handle> handles;
+  explicit Local(const shared_ptr<Impl> &i)
+      : impl(i), shard(i->AcquireShard()) {}
+  ~Local() { impl->ReleaseShard(shard); }
+};
+
+//-----------------------------------------------------------------------------
+MetricsRegistry::MetricsRegistry() : impl_(make_shared<Impl>()) {}
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+//-----------------------------------------------------------------------------
+const MetricsRegistry::Handle &
+MetricsRegistry::Find(Kind kind, const string &name, const Labels &labels) {
+  // keyed by registry id, not address, which could be reused
+  thread_local unordered_map<uint64_t, unique_ptr<Local>> locals;
+  auto &local = locals[impl_->id];
+  if (!local) {
+    local = make_unique<Local>(impl_);
+  }
+  string key = name + LabelText(labels);
+  auto i = local->handles.find(key);
+  if (i == local->handles.end()) {
+    const Series &s = impl_->Register(kind, key, name, labels);
+    const Handle h{kind, s.gauge ? nullptr : local->shard->At(s.offset),
+                   s.gauge};
+    i = local->handles.insert({move(key), h}).first;
+  } else if (i->second.kind != kind) {
+    throw logic_error("Metric " + key + " already registered as " +
+                      TypeName(i->second.kind));
+  }
+  return i->second;
+}
+
+//-----------------------------------------------------------------------------
+void MetricsRegistry::Increment(const string &name, const Labels &labels,
+                                uint64_t value) {
+  Add(*Find(COUNTER, name, labels).slots, value);
+}
+
+//-----------------------------------------------------------------------------
+void MetricsRegistry::Observe(const string &name, const Labels &labels,
+                              uint64_t value) {
+  Record(Find(HISTOGRAM, name, labels).slots, value);
+}
+
+//-----------------------------------------------------------------------------
+void MetricsRegistry::SetGauge(const string &name, const Labels &labels,
+                               int64_t value) {
+  Find(GAUGE, name, labels).gauge->store(value, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void MetricsRegistry::AddGauge(const string &name, const Labels &labels,
+                               int64_t delta) {
+  Find(GAUGE, name, labels).gauge->fetch_add(delta, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t MetricsRegistry::Counter(const string &name,
+                                  const Labels &labels) const {
+  const Sample s = impl_->Snapshot(name, labels);
+  return s.kind == COUNTER ? uint64_t(s.value) : 0;
+}
+
+//-----------------------------------------------------------------------------
+int64_t MetricsRegistry::Gauge(const string &name, const Labels &labels) const {
+  const Sample s = impl_->Snapshot(name, labels);
+  return s.kind == GAUGE ? s.value : 0;
+}
+
+//-----------------------------------------------------------------------------
+HistogramSnapshot MetricsRegistry::Histogram(const string &name,
+                                             const Labels &labels) const {
+  return impl_->Snapshot(name, labels).histogram;
+}
+
+//-----------------------------------------------------------------------------
+vector<MetricsRegistry::Sample> MetricsRegistry::Collect() const {
+  vector<Sample> samples;
+  {
+    lock_guard<mutex> lock(impl_->guard);
+    samples.reserve(impl_->series.size());
+    for (const auto &s : impl_->series)
+      samples.push_back(impl_->Snapshot(s));
+  }
+  stable_sort(begin(samples), end(samples),
+              [](const Sample &a, const Sample &b) { return a.name < b.name; });
+  return samples;
+}
+
+//-----------------------------------------------------------------------------
+string MetricsRegistry::Prometheus() const {
+  ostringstream os;
+  string family;
+  for (const auto &s : Collect()) {
+    if (s.name != family) {
+      family = s.name;
+      os << "# TYPE " << s.name << ' ' << TypeName(s.kind) << '\n';
+    }
+    const string labels = LabelText(s.labels);
+    if (s.kind != HISTOGRAM) {
+      os << s.name << labels << ' ' << s.value << '\n';
+      continue;
+    }
+    const auto &h = s.histogram;
+    uint64_t n = 0;
+    for (size_t b = 0; b != h.buckets.size(); ++b) {
+      if (!h.buckets[b])
+        continue;
+      n += h.buckets[b];
+      os << s.name << "_bucket"
+         << WithLe(labels, to_string(HistogramSnapshot::BucketUpperBound(b)))
+         << ' ' << n << '\n';
+    }
+    os << s.name << "_bucket" << WithLe(labels, "+Inf") << ' ' << h.count
+       << '\n'
+       << s.name << "_sum" << labels << ' ' << h.sum << '\n'
+       << s.name << "_count" << labels << ' ' << h.count << '\n';
+  }
+  return os.str();
+}
+
+//-----------------------------------------------------------------------------
+string MetricsRegistry::JSON() const {
+  ostringstream counters, gauges, histograms;
+  auto begin = [](ostringstream &os, const Sample &s) {
+    os << (os.tellp() > 0 ? ",\n" : "") << "{\"name\":\""
+       << Escape(s.name, true) << "\",\"labels\":{";
+    for (size_t i = 0; i != s.labels.size(); ++i) {
+      os << (i ? "," : "") << '"' << Escape(s.labels[i].first, true)
+         << "\":\"" << Escape(s.labels[i].second, true) << '"';
+    }
+    os << '}';
+  };
+  for (const auto &s : Collect()) {
+    if (s.kind == COUNTER) {
+      begin(counters, s);
+      counters << ",\"value\":" << s.value << '}';
+    } else if (s.kind == GAUGE) {
+      begin(gauges, s);
+      gauges << ",\"value\":" << s.value << '}';
+    } else {
+      const auto &h = s.histogram;
+      begin(histograms, s);
+      histograms << ",\"count\":" << h.count << ",\"sum\":" << h.sum
+                 << ",\"mean\":" << h.Mean() << ",\"p50\":" << h.Quantile(.5)
+                 << ",\"p90\":" << h.Quantile(.9)
+                 << ",\"p99\":" << h.Quantile(.99) << ",\"max\":" << h.Max()
+                 << ",\"buckets\":[";
+      bool first = true;
+      for (size_t b = 0; b != h.buckets.size(); ++b) {
+        if (!h.buckets[b])
+          continue;
+        histograms << (first ? "" : ",") << '['
+                   << HistogramSnapshot::BucketUpperBound(b) << ','
+                   << h.buckets[b] << ']';
+        first = false;
+      }
+      histograms << "]}";
+    }
+  }
+  return "{\"counters\":[\n" + counters.str() + "],\n\"gauges\":[\n" +
+         gauges.str() + "],\n\"histograms\":[\n" + histograms.str() + "]}\n";
+}
+
+//-----------------------------------------------------------------------------
+MetricsRegistry &MetricsRegistry::Global() {
+  // never destroyed: may be used by threads terminating after main returns
+  static MetricsRegistry *registry = new MetricsRegistry;
+  return *registry;
+}
+
+//-----------------------------------------------------------------------------
+void RecordRequest(MetricsRegistry &registry, const string &operation,
+                   const string &endpoint, long status,
+                   const RequestMetrics &m) {
+  Labels labels{{"operation", operation}, {"endpoint", endpoint}};
+  registry.Observe("s3_request_duration_microseconds", labels, m.total);
+  registry.Observe("s3_request_first_byte_microseconds", labels, m.firstByte);
+  registry.Increment("s3_request_sent_bytes_total", labels, m.bytesSent);
+  registry.Increment("s3_request_received_bytes_total", labels,
+                     m.bytesReceived);
+  labels.push_back({"status", StatusClass(status)});
+  registry.Increment("s3_requests_total", labels);
+  if (m.newConnections) {
+    registry.Increment("s3_connections_total", {{"endpoint", endpoint}},
+                       m.newConnections);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void RequestRecorder::Begin(MetricsRegistry &registry, const string &operation,
+                            const string &endpoint) {
+  const uint64_t thread = ThreadSerial();
+  if (thread != thread_ || &registry != registry_ ||
+      registry.impl_->id != registryId_ || operation != operation_ ||
+      endpoint != endpoint_) {
+    using R = MetricsRegistry;
+    thread_ = 0; // left unresolved if Find throws
+    const Labels labels{{"operation", operation}, {"endpoint", endpoint}};
+    duration_ =
+        registry.Find(R::HISTOGRAM, "s3_request_duration_microseconds", labels)
+            .slots;
+    firstByte_ = registry
+                     .Find(R::HISTOGRAM, "s3_request_first_byte_microseconds",
+                           labels)
+                     .slots;
+    sent_ =
+        registry.Find(R::COUNTER, "s3_request_sent_bytes_total", labels).slots;
+    received_ =
+        registry.Find(R::COUNTER, "s3_request_received_bytes_total", labels)
+            .slots;
+    inFlight_ = registry
+                    .Find(R::GAUGE, "s3_requests_in_flight",
+                          {{"endpoint", endpoint}})
+                    .gauge;
+    connections_ = nullptr;
+    fill(begin(requests_), end(requests_), nullptr);
+    registry_ = &registry;
+    registryId_ = registry.impl_->id;
+    operation_ = operation;
+    endpoint_ = endpoint;
+    thread_ = thread;
+  }
+  inFlight_->fetch_add(1, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void RequestRecorder::End(long status, const RequestMetrics &m) {
+  using R = MetricsRegistry;
+  inFlight_->fetch_add(-1, memory_order_relaxed);
+  Record(duration_, Micros(m.total));
+  Record(firstByte_, Micros(m.firstByte));
+  Add(*sent_, m.bytesSent);
+  Add(*received_, m.bytesReceived);
+  auto requests = [&] {
+    return registry_
+        ->Find(R::COUNTER, "s3_requests_total",
+               {{"operation", operation_},
+                {"endpoint", endpoint_},
+                {"status", StatusClass(status)}})
+        .slots;
+  };
+  const size_t c = status > 0 ? size_t(status / 100) : 0;
+  if (c < STATUS_CLASSES) {
+    if (!requests_[c])
+      requests_[c] = requests();
+    Add(*requests_[c], 1);
+  } else {
+    Add(*requests(), 1);
+  }
+  if (m.newConnections) {
+    if (!connections_) {
+      connections_ = registry_
+                         ->Find(R::COUNTER, "s3_connections_total",
+                                {{"endpoint", endpoint_}})
+                         .slots;
+    }
+    Add(*connections_, m.newConnections);
+  }
+}
+
+//-----------------------------------------------------------------------------
+TransferRecorder::~TransferRecorder() {
+  if (!registry_)
+    return;
+  try {
+    const Labels labels{{"operation", operation_}};
+    registry_->Increment(
+        "s3_transfers_total",
+        {{"operation", operation_}, {"status", success_ ? "ok" : "error"}});
+    registry_->Observe("s3_transfer_duration_microseconds", labels,
+                       chrono::duration_cast<chrono::microseconds>(
+                           chrono::steady_clock::now() - start_));
+    if (success_)
+      registry_->Increment("s3_transfer_bytes_total", labels, bytes_);
+  } catch (...) {
+    // never throw from destructor
+  }
+}
+} // namespace sss
@@ -0,0 +1,384 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+// Columnar object inventory
+
+#include "object_inventory.h"
+#include "response_parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sss {
+namespace api {
+
+namespace {
+const uint32_t NON_MD5 = ObjectInventory::NON_MD5;
+
+int HexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// parse "<32 hex digits>[-<parts>]", return false if not in this format
+bool ParseETag(string_view e, array<uint8_t, 16> &md5, uint32_t &parts) {
+  if (e.size() >= 2 && e.front() == '"' && e.back() == '"')
+    e = e.substr(1, e.size() - 2);
+  if (e.size() < 32)
+    return false;
+  for (size_t i = 0; i != 16; ++i) {
+    const int h = HexDigit(e[2 * i]);
+    const int l = HexDigit(e[2 * i + 1]);
+    if (h < 0 || l < 0)
+      return false;
+    md5[i] = uint8_t(h << 4 | l);
+  }
+  parts = 0;
+  if (e.size() == 32)
+    return true;
+  if (e[32] != '-' || e.size() == 33 || e.size() > 43)
+    return false;
+  uint64_t n = 0;
+  for (auto c : e.substr(33)) {
+    if (c < '0' || c > '9')
+      return false;
+    n = 10 * n + (c - '0');
+  }
+  if (n == 0 || n >= NON_MD5)
+    return false;
+  parts = uint32_t(n);
+  return true;
+}
+
+// days since 1970-01-01 of proleptic Gregorian date
+int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = unsigned(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + int64_t(doe) - 719468;
+}
+
+void CivilFromDays(int64_t z, int64_t &y, unsigned &m, unsigned &d) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = unsigned(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = int64_t(yoe) + era * 400 + (m <= 2);
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+int64_t ParseISO8601(string_view t) {
+  // YYYY-MM-DDThh:mm:ss[.fff]Z
+  if (t.size() < 19)
+    return 0;
+  auto num = [t](size_t pos, size_t len, int &v) {
+    v = 0;
+    for (size_t i = pos; i != pos + len; ++i) {
+      if (t[i] < '0' || t[i] > '9')
+        return false;
+      v = 10 * v + (t[i] - '0');
+    }
+    return true;
+  };
+  int y, mo, d, h, mi, s;
+  if (!num(0, 4, y) || t[4] != '-' || !num(5, 2, mo) || t[7] != '-' ||
+      !num(8, 2, d) || (t[10] != 'T' && t[10] != 't') || !num(11, 2, h) ||
+      t[13] != ':' || !num(14, 2, mi) || t[16] != ':' || !num(17, 2, s) ||
+      mo < 1 || mo > 12 || d < 1 || d > 31) {
+    return 0;
+  }
+  int ms = 0;
+  if (t.size() > 20 && t[19] == '.') {
+    int scale = 100;
+    for (size_t i = 20; i < t.size() && t[i] >= '0' && t[i] <= '9'; ++i) {
+      ms += (t[i] - '0') * scale;
+      scale /= 10;
+    }
+  }
+  const int64_t days = DaysFromCivil(y, unsigned(mo), unsigned(d));
+  return ((days * 24 + h) * 60 + mi) * 60000 + int64_t(s) * 1000 + ms;
+}
+
+//-----------------------------------------------------------------------------
+string FormatISO8601(int64_t ms) {
+  int64_t days = ms / 86400000;
+  int64_t r = ms % 86400000;
+  if (r < 0) {
+    r += 86400000;
+    --days;
+  }
+  int64_t y;
+  unsigned m, d;
+  CivilFromDays(days, y, m, d);
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%04lld-%02u-%02uT%02d:%02d:%02d.%03dZ",
+           (long long)y, m, d, int(r / 3600000), int(r / 60000 % 60),
+           int(r / 1000 % 60), int(r % 1000));
+  return buf;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t ObjectInventory::Intern(const string &s) {
+  auto i = stringIndex_.find(s);
+  if (i != stringIndex_.end())
+    return i->second;
+  strings_.push_back(s);
+  const uint32_t idx = uint32_t(strings_.size() - 1);
+  stringIndex_[s] = idx;
+  return idx;
+}
+
+//-----------------------------------------------------------------------------
+void ObjectInventory::Append(const ObjectInfo &o) {
+  if (sorted_ && !Empty() && Key(Size() - 1) > o.key)
+    sorted_ = false;
+  keys_ += o.key;
+  keyOffsets_.push_back(keys_.size());
+  sizes_.push_back(o.size);
+  lastModified_.push_back(ParseISO8601(o.lastModified));
+  array<uint8_t, 16> md5{};
+  uint32_t parts = 0;
+  if (o.etag.empty()) {
+    parts = NON_MD5;
+  } else if (!ParseETag(o.etag, md5, parts)) {
+    parts = NON_MD5;
+    etags_[sizes_.size() - 1] = o.etag;
+  }
+  md5_.push_back(md5);
+  parts_.push_back(parts);
+  storageClass_.push_back(Intern(o.storageClass));
+  checksumAlgo_.push_back(Intern(o.checksumAlgo));
+  ownerID_.push_back(Intern(o.ownerID));
+  ownerDisplayName_.push_back(Intern(o.ownerDisplayName));
+}
+
+//-----------------------------------------------------------------------------
+void ObjectInventory::Append(string_view key, uint64_t size,
+                             int64_t lastModified,
+                             const array<uint8_t, 16> &md5, uint32_t parts) {
+  if (sorted_ && !Empty() && Key(Size() - 1) > key)
+    sorted_ = false;
+  keys_ += key;
+  keyOffsets_.push_back(keys_.size());
+  sizes_.push_back(size);
+  lastModified_.push_back(lastModified);
+  md5_.push_back(md5);
+  parts_.push_back(parts);
+  storageClass_.push_back(0);
+  checksumAlgo_.push_back(0);
+  ownerID_.push_back(0);
+  ownerDisplayName_.push_back(0);
+}
+
+//-----------------------------------------------------------------------------
+// Columns grow geometrically: reserving the exact size of each batch would
+// reallocate all columns for every page appended
+void ObjectInventory::Append(const vector<ObjectInfo> &objects) {
+  for (const auto &o : objects)
+    Append(o);
+}
+
+//-----------------------------------------------------------------------------
+void ObjectInventory::Reserve(size_t objects, size_t keyBytes) {
+  keys_.reserve(keyBytes);
+  keyOffsets_.reserve(objects + 1);
+  sizes_.reserve(objects);
+  lastModified_.reserve(objects);
+  md5_.reserve(objects);
+  parts_.reserve(objects);
+  storageClass_.reserve(objects);
+  checksumAlgo_.reserve(objects);
+  ownerID_.reserve(objects);
+  ownerDisplayName_.reserve(objects);
+}
+
+//-----------------------------------------------------------------------------
+string ObjectInventory::ETag(size_t i) const {
+  if (parts_[i] == NON_MD5) {
+    auto e = etags_.find(i);
+    return e == etags_.end() ? string() : TrimETag(e->second);
+  }
+  static const char *hex = "0123456789abcdef";
+  string e(32, '0');
+  for (size_t b = 0; b != 16; ++b) {
+    e[2 * b] = hex[md5_[i][b] >> 4];
+    e[2 * b + 1] = hex[md5_[i][b] & 0xF];
+  }
+  if (parts_[i] > 0)
+    e += "-" + to_string(parts_[i]);
+  return e;
+}
+
+//-----------------------------------------------------------------------------
+ObjectInfo ObjectInventory::Get(size_t i) const {
+  return {.checksumAlgo = strings_[checksumAlgo_[i]],
+          .key = string(Key(i)),
+          .lastModified =
+              lastModified_[i] ? FormatISO8601(lastModified_[i]) : "",
+          .etag = ETag(i),
+          .size = size_t(sizes_[i]),
+          .storageClass = strings_[storageClass_[i]],
+          .ownerDisplayName = strings_[ownerDisplayName_[i]],
+          .ownerID = strings_[ownerID_[i]]};
+}
+
+//-----------------------------------------------------------------------------
+namespace {
+template <typename T> void Permute(vector<T> &v, const vector<size_t> &idx) {
+  vector<T> p;
+  p.reserve(v.size());
+  for (auto i : idx)
+    p.push_back(v[i]);
+  v.swap(p);
+}
+} // namespace
+
+void ObjectInventory::Sort() {
+  if (sorted_)
+    return;
+  vector<size_t> idx(Size());
+  iota(idx.begin(), idx.end(), 0);
+  stable_sort(idx.begin(), idx.end(),
+              [this](size_t a, size_t b) { return Key(a) < Key(b); });
+  string keys;
+  keys.reserve(keys_.size());
+  vector<uint64_t> offsets = {0};
+  offsets.reserve(keyOffsets_.size());
+  for (auto i : idx) {
+    keys += Key(i);
+    offsets.push_back(keys.size());
+  }
+  keys_.swap(keys);
+  keyOffsets_.swap(offsets);
+  Permute(sizes_, idx);
+  Permute(lastModified_, idx);
+  Permute(md5_, idx);
+  Permute(parts_, idx);
+  Permute(storageClass_, idx);
+  Permute(checksumAlgo_, idx);
+  Permute(ownerID_, idx);
+  Permute(ownerDisplayName_, idx);
+  unordered_map<size_t, string> etags;
+  for (size_t i = 0; i != idx.size(); ++i) {
+    auto e = etags_.find(idx[i]);
+    if (e != etags_.end())
+      etags[i] = move(e->second);
+  }
+  etags_.swap(etags);
+  sorted_ = true;
+}
+
+//-----------------------------------------------------------------------------
+size_t ObjectInventory::LowerBound(string_view key) const {
+  if (!sorted_) {
+    throw logic_error("ObjectInventory not sorted");
+  }
+  size_t first = 0;
+  size_t count = Size();
+  while (count > 0) {
+    const size_t step = count / 2;
+    if (Key(first + step) < key) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+//-----------------------------------------------------------------------------
+size_t ObjectInventory::Find(string_view key) const {
+  const size_t i = LowerBound(key);
+  return i < Size() && Key(i) == key ? i : npos;
+}
+
+//-----------------------------------------------------------------------------
+pair<size_t, size_t> ObjectInventory::PrefixRange(string_view prefix) const {
+  const size_t first = LowerBound(prefix);
+  size_t last = first;
+  size_t count = Size() - first;
+  // keys starting with prefix are contiguous
+  while (count > 0) {
+    const size_t step = count / 2;
+    if (Key(last + step).substr(0, prefix.size()) == prefix) {
+      last += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return {first, last};
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ObjectInventory::TotalSize(size_t first, size_t last) const {
+  return accumulate(sizes_.begin() + first, sizes_.begin() + last,
+                    uint64_t(0));
+}
+
+//-----------------------------------------------------------------------------
+size_t ObjectInventory::MemoryUsage() const {
+  size_t m = keys_.capacity() + keyOffsets_.capacity() * sizeof(uint64_t) +
+             sizes_.capacity() * sizeof(uint64_t) +
+             lastModified_.capacity() * sizeof(int64_t) +
+             md5_.capacity() * 16 + parts_.capacity() * sizeof(uint32_t) +
+             (storageClass_.capacity() + checksumAlgo_.capacity() +
+              ownerID_.capacity() + ownerDisplayName_.capacity()) *
+                 sizeof(uint32_t);
+  for (const auto &s : strings_)
+    m += 2 * (sizeof(string) + s.capacity());
+  for (const auto &e : etags_)
+    m += sizeof(e) + e.second.capacity();
+  return m;
+}
+
+//-----------------------------------------------------------------------------
+void ObjectInventory::Clear() { *this = ObjectInventory(); }
+} // namespace api
+} // namespace sss
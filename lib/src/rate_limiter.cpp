@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Token bucket and request limiter implementation
+
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+namespace sss {
+
+//-----------------------------------------------------------------------------
+void TokenBucket::SetRate(double rate, double burst) {
+  lock_guard<mutex> lock(mutex_);
+  Refill(Clock::now());
+  rate_ = max(rate, 0.0);
+  burst_ = burst > 0 ? burst : rate_;
+  tokens_ = min(tokens_, burst_);
+  if (rate_ == 0)
+    tokens_ = 0;
+}
+
+//-----------------------------------------------------------------------------
+double TokenBucket::Rate() const {
+  lock_guard<mutex> lock(mutex_);
+  return rate_;
+}
+
+//-----------------------------------------------------------------------------
+void TokenBucket::Refill(Clock::time_point now) {
+  if (rate_ > 0 && now > last_) {
+    const double elapsed = chrono::duration<double>(now - last_).count();
+    tokens_ = min(burst_, tokens_ + elapsed * rate_);
+  }
+  last_ = now;
+}
+
+//-----------------------------------------------------------------------------
+bool TokenBucket::TryConsume(double tokens) {
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ == 0)
+    return true;
+  Refill(Clock::now());
+  if (tokens_ < min(tokens, burst_))
+    return false;
+  tokens_ -= tokens;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void TokenBucket::Refund(double tokens) {
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ == 0)
+    return;
+  Refill(Clock::now());
+  tokens_ = min(burst_, tokens_ + tokens);
+}
+
+//-----------------------------------------------------------------------------
+TokenBucket::Clock::duration TokenBucket::Reserve(double tokens) {
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ == 0)
+    return Clock::duration::zero();
+  Refill(Clock::now());
+  tokens_ -= tokens;
+  if (tokens_ >= 0)
+    return Clock::duration::zero();
+  return chrono::duration_cast<Clock::duration>(
+      chrono::duration<double>(-tokens_ / rate_));
+}
+
+//-----------------------------------------------------------------------------
+void TokenBucket::Consume(double tokens) {
+  const auto wait = Reserve(tokens);
+  if (wait > Clock::duration::zero())
+    this_thread::sleep_for(wait);
+}
+
+//-----------------------------------------------------------------------------
+void RequestLimiter::Configure(const RequestLimiterConfig &cfg) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    config_ = cfg;
+    enabled_ = cfg.requestsPerSecond > 0 || cfg.bytesPerSecond > 0 ||
+               cfg.maxInFlightRequests > 0 || cfg.maxInFlightBytes > 0 ||
+               cfg.maxInFlightRequestsPerEndpoint > 0 ||
+               !cfg.endpointMaxInFlightRequests.empty();
+  }
+  requests_.SetRate(cfg.requestsPerSecond, cfg.requestBurst);
+  bytes_.SetRate(cfg.bytesPerSecond, cfg.byteBurst);
+  released_.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+size_t RequestLimiter::EndpointCap(const string &endpoint) const {
+  auto i = config_.endpointMaxInFlightRequests.find(endpoint);
+  return i != config_.endpointMaxInFlightRequests.end()
+             ? i->second
+             : config_.maxInFlightRequestsPerEndpoint;
+}
+
+//-----------------------------------------------------------------------------
+bool RequestLimiter::CanAdmit(const string &endpoint, size_t bytes) const {
+  if (config_.maxInFlightRequests > 0 &&
+      inFlightRequests_ >= config_.maxInFlightRequests)
+    return false;
+  // always admit a request if nothing else is in flight, even if bigger
+  // than the byte budget, to avoid deadlocks
+  if (config_.maxInFlightBytes > 0 && inFlightBytes_ > 0 &&
+      inFlightBytes_ + bytes > config_.maxInFlightBytes)
+    return false;
+  const size_t cap = EndpointCap(endpoint);
+  if (cap > 0) {
+    auto i = inFlightPerEndpoint_.find(endpoint);
+    if (i != inFlightPerEndpoint_.end() && i->second >= cap)
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+RequestLimiter::Permit RequestLimiter::Acquire(const string &endpoint,
+                                               size_t bytes) {
+  if (!enabled_)
+    return Permit();
+  bool blocking = true;
+  {
+    unique_lock<mutex> lock(mutex_);
+    blocking = config_.blocking;
+    if (blocking) {
+      released_.wait(lock, [&] { return CanAdmit(endpoint, bytes); });
+    } else if (!CanAdmit(endpoint, bytes)) {
+      throw RateLimitError("Too many requests in flight to endpoint " +
+                           endpoint);
+    }
+    ++inFlightRequests_;
+    inFlightBytes_ += bytes;
+    ++inFlightPerEndpoint_[endpoint];
+  }
+  Permit permit(this, endpoint, bytes);
+  if (blocking) {
+    requests_.Consume(1);
+    bytes_.Consume(double(bytes));
+  } else {
+    if (!requests_.TryConsume(1))
+      throw RateLimitError("Request rate limit exceeded");
+    if (bytes > 0 && !bytes_.TryConsume(double(bytes))) {
+      requests_.Refund(1);
+      throw RateLimitError("Byte rate limit exceeded");
+    }
+  }
+  return permit;
+}
+
+//-----------------------------------------------------------------------------
+void RequestLimiter::Charge(size_t bytes) {
+  if (!enabled_ || bytes == 0)
+    return;
+  bool blocking = true;
+  {
+    lock_guard<mutex> lock(mutex_);
+    blocking = config_.blocking;
+  }
+  // in fail-fast mode the debt is recorded and paid by the next request
+  const auto wait = bytes_.Reserve(double(bytes));
+  if (blocking && wait > TokenBucket::Clock::duration::zero())
+    this_thread::sleep_for(wait);
+}
+
+//-----------------------------------------------------------------------------
+void RequestLimiter::Release(const string &endpoint, size_t bytes) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    --inFlightRequests_;
+    inFlightBytes_ -= bytes;
+    auto i = inFlightPerEndpoint_.find(endpoint);
+    if (i != inFlightPerEndpoint_.end() && --i->second == 0)
+      inFlightPerEndpoint_.erase(i);
+  }
+  released_.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+size_t RequestLimiter::InFlightRequests() const {
+  lock_guard<mutex> lock(mutex_);
+  return inFlightRequests_;
+}
+
+//-----------------------------------------------------------------------------
+size_t RequestLimiter::InFlightBytes() const {
+  lock_guard<mutex> lock(mutex_);
+  return inFlightBytes_;
+}
+
+//-----------------------------------------------------------------------------
+RequestLimiter &RequestLimiter::Global() {
+  static RequestLimiter limiter;
+  return limiter;
+}
+} // namespace sss
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Request metrics
+
+#include "request_metrics.h"
+
+#include <mutex>
+#include <ostream>
+
+using namespace std;
+
+namespace sss {
+
+//-----------------------------------------------------------------------------
+void AccumulateMetrics(RequestMetrics &total, const RequestMetrics &m) {
+  // called once per transfer job, contention is negligible
+  static mutex guard;
+  lock_guard<mutex> lock(guard);
+  total += m;
+}
+
+//-----------------------------------------------------------------------------
+ostream &operator<<(ostream &os, const RequestMetrics &m) {
+  auto ms = [](RequestMetrics::Duration d) { return d.count() / 1000.0; };
+  return os << "requests=" << m.requests
+            << " new_connections=" << m.newConnections
+            << " dns_ms=" << ms(m.nameLookup) << " connect_ms=" << ms(m.connect)
+            << " tls_ms=" << ms(m.tlsHandshake)
+            << " first_byte_ms=" << ms(m.firstByte)
+            << " transfer_ms=" << ms(m.transfer) << " total_ms=" << ms(m.total)
+            << " bytes_sent=" << m.bytesSent
+            << " bytes_received=" << m.bytesReceived;
+}
+} // namespace sss
@@ -33,10 +33,12 @@
 #include "response_parser.h"
 #include "xml_path.h"
 #include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 using namespace std;
 
@@ -56,12 +58,15 @@ string TrimETag(const string &etag) {
   } else if (etag.substr(0, string("&#34;").size()) == "&#34;") {
     const size_t quotes = string("&#34;").size();
     return etag.substr(quotes, etag.size() - 2 * quotes);
+  } else if (etag.substr(0, string("&quot;").size()) == "&quot;") {
+    const size_t quotes = string("&quot;").size();
+    return etag.substr(quotes, etag.size() - 2 * quotes);
   } else {
     return etag;
   }
 }
 
-string XMLTag(const string &xml, const string &tag) {
+string XMLTag(string_view xml, const string &tag) {
   return FindElementText(xml, tag);
   // const regex rx{tag + "[^>]*>\\s*(.+)\\s*<\\s*/\\s*" + tag + "\\s*>",
   //                regex_constants::icase};
@@ -101,37 +106,177 @@ string XMLTagPath(const string &xml, const string &path) {
   // return curTag;
 }
 
-string HTTPHeader(const string &headers, const string &header) {
-  const regex rx{header + "\\s*:\\s*([^\\s]+)", regex_constants::icase};
-  smatch sm;
-  if (!regex_search(headers, sm, rx)) {
-    return "";
+namespace {
+string_view Trim(string_view s) {
+  const char *BLANKS = " \t\r\n";
+  const size_t b = s.find_first_not_of(BLANKS);
+  if (b == string_view::npos)
+    return string_view();
+  return s.substr(b, s.find_last_not_of(BLANKS) - b + 1);
+}
+
+bool IEquals(string_view a, string_view b) {
+  return a.size() == b.size() &&
+         equal(begin(a), end(a), begin(b), [](char x, char y) {
+           return tolower((unsigned char)x) == tolower((unsigned char)y);
+         });
+}
+
+const string_view META_PREFIX = "x-amz-meta-";
+
+bool IsMeta(string_view name) {
+  return name.size() > META_PREFIX.size() &&
+         IEquals(name.substr(0, META_PREFIX.size()), META_PREFIX);
+}
+
+enum LineType { HEADER_LINE, STATUS_LINE, OTHER_LINE };
+
+// Split "name: value\r\n" line into trimmed name and value; values are
+// returned verbatim, including quotes, commas and colons
+LineType ParseHeaderLine(string_view line, string_view &name,
+                         string_view &value) {
+  if (line.substr(0, 5) == "HTTP/")
+    return STATUS_LINE;
+  const size_t colon = line.find(':');
+  if (colon == string_view::npos)
+    return OTHER_LINE;
+  name = Trim(line.substr(0, colon));
+  if (name.empty())
+    return OTHER_LINE;
+  value = Trim(line.substr(colon + 1));
+  return HEADER_LINE;
+}
+
+// Invoke f on each line of text, line terminator included
+template <typename F> void ForEachLine(string_view text, F f) {
+  size_t b = 0;
+  while (b < text.size()) {
+    const size_t nl = text.find('\n', b);
+    const size_t e = nl == string_view::npos ? text.size() : nl + 1;
+    f(text.substr(b, e - b));
+    b = e;
   }
-  return sm[1]; // vector<uint8_t> h = req.GetResponseHeader();
-                // string hs(begin(h), end(h));
 }
 
-namespace {
-Headers HTTPHeaderFilter(const string &txt, const string &filterRx) {
-  Headers headers;
-  regex h(filterRx, regex_constants::icase);
-  smatch sm;
-  string::const_iterator si(txt.cbegin());
-  while (regex_search(si, txt.cend(), sm, h)) {
-    if (sm.size() > 1) {
-      headers[sm[1]] = sm[2];
+// Invoke f(name, value) on each header of the last header block in text;
+// reset is invoked whenever a status line starts a new block
+template <typename F, typename R>
+void ForEachHeader(string_view text, F f, R reset) {
+  ForEachLine(text, [&](string_view line) {
+    string_view name, value;
+    switch (ParseHeaderLine(line, name, value)) {
+    case HEADER_LINE:
+      f(name, value);
+      break;
+    case STATUS_LINE:
+      reset();
+      break;
+    default:
+      break;
     }
-    si = sm.suffix().first;
+  });
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+void HTTPHeaderMap::ParseLine(size_t begin, size_t end) {
+  string_view name, value;
+  switch (ParseHeaderLine(View(begin, end - begin), name, value)) {
+  case HEADER_LINE: {
+    const char *base = buffer_->data();
+    entries_.push_back({size_t(name.data() - base), name.size(),
+                        size_t(value.data() - base), value.size()});
+    break;
+  }
+  case STATUS_LINE:
+    Clear();
+    break;
+  default:
+    break;
+  }
+}
+
+void HTTPHeaderMap::Parse() {
+  Clear();
+  const string_view text = View(0, buffer_->size());
+  ForEachLine(text, [this, &text](string_view line) {
+    const size_t b = line.data() - text.data();
+    ParseLine(b, b + line.size());
+  });
+}
+
+string_view HTTPHeaderMap::Get(string_view name) const {
+  for (size_t i = 0; i != entries_.size(); ++i) {
+    if (IEquals(Name(i), name))
+      return Value(i);
+  }
+  return string_view();
+}
+
+bool HTTPHeaderMap::Has(string_view name) const {
+  for (size_t i = 0; i != entries_.size(); ++i) {
+    if (IEquals(Name(i), name))
+      return true;
+  }
+  return false;
+}
+
+Headers HTTPHeaderMap::ToHeaders() const {
+  Headers headers;
+  for (size_t i = 0; i != entries_.size(); ++i) {
+    headers[string(Name(i))] = string(Value(i));
   }
   return headers;
 }
-} // namespace
+
+MetaDataMap HTTPHeaderMap::MetaData() const {
+  MetaDataMap meta;
+  for (size_t i = 0; i != entries_.size(); ++i) {
+    if (IsMeta(Name(i)))
+      meta[string(Name(i).substr(META_PREFIX.size()))] = string(Value(i));
+  }
+  return meta;
+}
+
+//------------------------------------------------------------------------------
+string HTTPHeader(const string &headers, const string &header) {
+  string_view found;
+  bool done = false;
+  ForEachHeader(
+      headers,
+      [&](string_view name, string_view value) {
+        if (!done && IEquals(name, header)) {
+          found = value;
+          done = true;
+        }
+      },
+      [&] {
+        found = string_view();
+        done = false;
+      });
+  return string(found);
+}
 
 Headers HTTPHeaders(const string &txt) {
-  return HTTPHeaderFilter(txt, "\\s*(\\w+)\\s*:\\s*(\\w+)");
+  Headers headers;
+  ForEachHeader(
+      txt,
+      [&](string_view name, string_view value) {
+        headers[string(name)] = string(value);
+      },
+      [&] { headers.clear(); });
+  return headers;
 }
 
 MetaDataMap MetaDataHeaders(const string &txt) {
-  return HTTPHeaderFilter(txt, "\\s*x-amz-meta-(\\w+)\\s*:\\s*(\\w+)");
+  MetaDataMap meta;
+  ForEachHeader(
+      txt,
+      [&](string_view name, string_view value) {
+        if (IsMeta(name))
+          meta[string(name.substr(META_PREFIX.size()))] = string(value);
+      },
+      [&] { meta.clear(); });
+  return meta;
 }
 } // namespace sss
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Retry policy implementation
+
+#include "retry_policy.h"
+#include "error.h"
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+// S3 error codes that can be retried regardless of the HTTP status
+const set<string> retryableCodesG = {"SlowDown", "RequestTimeout",
+                                     "InternalError", "ServiceUnavailable",
+                                     "Throttling", "ThrottlingException"};
+// libcurl errors caused by wrong configuration, retrying does not help
+const set<CURLcode> fatalCurlCodesG = {
+    CURLE_UNSUPPORTED_PROTOCOL, CURLE_URL_MALFORMAT,
+    CURLE_NOT_BUILT_IN,         CURLE_BAD_FUNCTION_ARGUMENT,
+    CURLE_OUT_OF_MEMORY,        CURLE_ABORTED_BY_CALLBACK};
+} // namespace
+
+//-----------------------------------------------------------------------------
+bool RetryPolicy::Retryable(const exception &e) {
+  if (auto h = dynamic_cast<const HTTPError *>(&e)) {
+    return h->Status() >= 500 || h->Status() == 429 || h->Status() == 408 ||
+           retryableCodesG.count(h->Code());
+  }
+  if (auto t = dynamic_cast<const TransportError *>(&e)) {
+    return !fatalCurlCodesG.count(t->Code());
+  }
+  if (dynamic_cast<const RateLimitError *>(&e)) {
+    return true;
+  }
+  return dynamic_cast<const runtime_error *>(&e) != nullptr;
+}
+
+//-----------------------------------------------------------------------------
+RetryPolicy::Duration RetryPolicy::RetryAfter(const exception &e) {
+  if (auto h = dynamic_cast<const HTTPError *>(&e)) {
+    if (h->RetryAfter() > 0)
+      return chrono::duration_cast<Duration>(chrono::seconds(h->RetryAfter()));
+  }
+  return Duration::zero();
+}
+
+//-----------------------------------------------------------------------------
+RetryPolicy::Duration RetryPolicy::NextDelay(Duration previous) const {
+  thread_local mt19937_64 engine{random_device{}()};
+  const auto lo = baseDelay_.count();
+  const auto hi = max(lo, min(maxDelay_.count(), 3 * previous.count()));
+  uniform_int_distribution<Duration::rep> dist(lo, hi);
+  return Duration(dist(engine));
+}
+} // namespace sss
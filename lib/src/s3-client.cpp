@@ -89,9 +89,9 @@ WebClient SendS3Request(S3ClientConfig args) {
     args.signUrl = args.endpoint;
   string path;
   if (!args.bucket.empty()) {
-    path += "/" + args.bucket;
+    path += "/" + UrlEncodePath(args.bucket);
     if (!args.key.empty())
-      path += "/" + args.key;
+      path += "/" + UrlEncodePath(args.key);
   }
   auto headers = args.headers;
   if (!args.accessKey.empty()) {
@@ -0,0 +1,259 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file tracing.cpp
+ * \brief Tracer and Span implementation.
+ */
+#include "tracing.h"
+
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+thread_local Span *currentG = nullptr;
+atomic<uint32_t> threadsG{0};
+
+// Small sequential thread ids, easier to read than native ids in traces
+uint32_t ThreadId() {
+  thread_local const uint32_t id = ++threadsG;
+  return id;
+}
+
+string Quote(const string &s) {
+  string out = "\"";
+  out.reserve(s.size() + 2);
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out + '"';
+}
+
+int64_t Microseconds(chrono::steady_clock::duration d) {
+  return chrono::duration_cast<chrono::microseconds>(d).count();
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+Tracer::Tracer(const string &fileName, Format format)
+    : format_(format), os_(fileName),
+      epoch_(chrono::duration_cast<chrono::microseconds>(
+                 chrono::system_clock::now().time_since_epoch())
+                 .count()),
+      start_(chrono::steady_clock::now()) {
+  if (!os_) {
+    throw runtime_error("Cannot open trace file " + fileName);
+  }
+  if (format_ == CHROME_TRACE)
+    os_ << "[";
+}
+
+//------------------------------------------------------------------------------
+Tracer::~Tracer() {
+  if (format_ == CHROME_TRACE)
+    os_ << "\n]\n";
+}
+
+//------------------------------------------------------------------------------
+Tracer::Format Tracer::FormatFromFileName(const string &fileName) {
+  const string ext = ".json";
+  return fileName.size() >= ext.size() &&
+                 fileName.compare(fileName.size() - ext.size(), ext.size(),
+                                  ext) == 0
+             ? CHROME_TRACE
+             : JSON_LINES;
+}
+
+//------------------------------------------------------------------------------
+void Tracer::Flush() {
+  lock_guard<mutex> lock(mutex_);
+  os_.flush();
+}
+
+//------------------------------------------------------------------------------
+void Tracer::Write(const Span &span, chrono::steady_clock::time_point end) {
+  const int64_t start = epoch_ + Microseconds(span.start_ - start_);
+  const int64_t duration = Microseconds(end - span.start_);
+  string attributes;
+  for (const auto &a : span.attributes_) {
+    attributes += (attributes.empty() ? "" : ",") + Quote(a.first) + ':' +
+                  a.second;
+  }
+  string line;
+  if (format_ == JSON_LINES) {
+    line = "{\"name\":" + Quote(span.name_) +
+           ",\"id\":" + to_string(span.id_) +
+           ",\"parent\":" + to_string(span.parentId_) +
+           ",\"thread\":" + to_string(span.thread_) +
+           ",\"start_us\":" + to_string(start) +
+           ",\"duration_us\":" + to_string(duration) +
+           ",\"error\":" + (span.failed_ ? "true" : "false") +
+           ",\"attributes\":{" + attributes + "}}\n";
+  } else {
+    line = "{\"name\":" + Quote(span.name_) +
+           ",\"cat\":\"s3\",\"ph\":\"X\",\"ts\":" + to_string(start) +
+           ",\"dur\":" + to_string(duration) +
+           ",\"pid\":" + to_string(getpid()) +
+           ",\"tid\":" + to_string(span.thread_) +
+           ",\"args\":{\"id\":" + to_string(span.id_) +
+           ",\"parent\":" + to_string(span.parentId_) +
+           ",\"error\":" + (span.failed_ ? "true" : "false") +
+           (attributes.empty() ? "" : ",") + attributes + "}}";
+  }
+  lock_guard<mutex> lock(mutex_);
+  if (format_ == CHROME_TRACE)
+    os_ << (first_ ? "\n" : ",\n");
+  first_ = false;
+  os_ << line;
+}
+
+//------------------------------------------------------------------------------
+Span::Span(string name, Tracer *tracer) : name_(move(name)) {
+  Span *parent = currentG;
+  if (parent && tracer && parent->tracer_ != tracer)
+    parent = nullptr;
+  if (!tracer && parent)
+    tracer = parent->tracer_;
+  if (tracer)
+    Begin(tracer, parent);
+}
+
+//------------------------------------------------------------------------------
+Span::Span(string name, Span *parent) : name_(move(name)) {
+  if (parent && parent->tracer_)
+    Begin(parent->tracer_, parent);
+}
+
+//------------------------------------------------------------------------------
+void Span::Begin(Tracer *tracer, Span *parent) {
+  tracer_ = tracer;
+  parent_ = parent;
+  id_ = tracer->NextId();
+  parentId_ = parent ? parent->id_ : 0;
+  thread_ = ThreadId();
+  exceptions_ = uncaught_exceptions();
+  previous_ = currentG;
+  currentG = this;
+  start_ = chrono::steady_clock::now();
+}
+
+//------------------------------------------------------------------------------
+Span::~Span() { End(); }
+
+//------------------------------------------------------------------------------
+void Span::Set(const string &key, const string &value) {
+  if (tracer_)
+    attributes_.emplace_back(key, Quote(value));
+}
+
+//------------------------------------------------------------------------------
+void Span::Set(const string &key, double value) {
+  // JSON has no representation of NaN and infinity
+  if (tracer_)
+    attributes_.emplace_back(key,
+                             isfinite(value) ? to_string(value) : "null");
+}
+
+//------------------------------------------------------------------------------
+void Span::Set(const string &key, bool value) {
+  if (tracer_)
+    attributes_.emplace_back(key, value ? "true" : "false");
+}
+
+//------------------------------------------------------------------------------
+void Span::SetError(const string &message) {
+  if (!tracer_)
+    return;
+  failed_ = true;
+  Set("error", message);
+}
+
+//------------------------------------------------------------------------------
+int Span::Attempt() {
+  if (!parent_)
+    return 0;
+  lock_guard<mutex> lock(parent_->childrenMutex_);
+  return parent_->children_[name_]++;
+}
+
+//------------------------------------------------------------------------------
+void Span::End() {
+  if (!tracer_)
+    return;
+  const auto end = chrono::steady_clock::now();
+  if (uncaught_exceptions() > exceptions_)
+    failed_ = true;
+  // spans end in reverse order within a thread, but End() can be called
+  // explicitly before nested spans are destroyed: the span is then unlinked
+  // from the active spans so that nested spans never restore it
+  if (currentG == this) {
+    currentG = previous_;
+  } else {
+    for (Span *s = currentG; s; s = s->previous_) {
+      if (s->previous_ == this) {
+        s->previous_ = previous_;
+        break;
+      }
+    }
+  }
+  tracer_->Write(*this, end);
+  tracer_ = nullptr;
+}
+
+//------------------------------------------------------------------------------
+Span *Span::Current() { return currentG; }
+
+} // namespace sss
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+// Transfer progress
+
+#include "transfer_progress.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+int64_t Nanoseconds(chrono::steady_clock::duration d) {
+  return chrono::duration_cast<chrono::nanoseconds>(d).count();
+}
+double PerSecond(uint64_t n, int64_t ns) { return ns > 0 ? n * 1e9 / ns : 0.; }
+} // namespace
+
+//-----------------------------------------------------------------------------
+TransferProgress::TransferProgress(Observer observer,
+                                   chrono::milliseconds interval)
+    : observer_(observer), interval_(interval), start_(Clock::now()) {}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::Start(uint64_t totalBytes, size_t parts) {
+  totalBytes_ = totalBytes;
+  parts_ = parts;
+  partBytes_.reset(new Counter[parts]());
+  partRequests_.reset(new Counter[parts]());
+  bytes_ = 0;
+  partsDone_ = 0;
+  partsInFlight_ = 0;
+  retries_ = 0;
+  start_ = Clock::now();
+  nextReport_ = Nanoseconds(interval_);
+  lastData_ = 0;
+  reportedTime_ = 0;
+  reportedBytes_ = 0;
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::PartBegin(size_t) {
+  partsInFlight_.fetch_add(1, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::PartEnd(size_t, bool success) {
+  partsInFlight_.fetch_sub(1, memory_order_relaxed);
+  if (success)
+    partsDone_.fetch_add(1, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::RequestBegin(size_t part) {
+  if (part < parts_ && partRequests_[part].fetch_add(1, memory_order_relaxed))
+    retries_.fetch_add(1, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::Add(size_t part, int64_t bytes) {
+  // negative values wrap around and are subtracted
+  if (bytes) {
+    if (part < parts_)
+      partBytes_[part].fetch_add(uint64_t(bytes), memory_order_relaxed);
+    bytes_.fetch_add(uint64_t(bytes), memory_order_relaxed);
+  }
+  if (!observer_ && bytes <= 0)
+    return;
+  const auto now = Clock::now();
+  const int64_t t = Nanoseconds(now - start_);
+  if (bytes > 0)
+    lastData_.store(t, memory_order_relaxed);
+  int64_t next = nextReport_.load(memory_order_relaxed);
+  if (!observer_ || t < next)
+    return;
+  // a single thread reports in each interval
+  if (nextReport_.compare_exchange_strong(next, t + Nanoseconds(interval_)))
+    Report(now);
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::Finish() {
+  if (observer_) {
+    lock_guard<mutex> lock(reporting_);
+    ProgressInfo info = Snapshot();
+    info.finished = true;
+    observer_(info);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TransferProgress::Report(Clock::time_point now) {
+  // skip report if previous observer call still executing
+  unique_lock<mutex> lock(reporting_, try_to_lock);
+  if (!lock)
+    return;
+  const ProgressInfo info = Snapshot();
+  reportedBytes_ = info.bytes;
+  reportedTime_ = Nanoseconds(now - start_);
+  observer_(info);
+}
+
+//-----------------------------------------------------------------------------
+ProgressInfo TransferProgress::Snapshot() const {
+  ProgressInfo p;
+  const int64_t t = Nanoseconds(Clock::now() - start_);
+  p.totalBytes = totalBytes_;
+  p.bytes = bytes_.load(memory_order_relaxed);
+  p.parts = parts_;
+  p.partsDone = size_t(partsDone_.load(memory_order_relaxed));
+  p.partsInFlight = size_t(partsInFlight_.load(memory_order_relaxed));
+  p.retries = size_t(retries_.load(memory_order_relaxed));
+  const uint64_t reported = reportedBytes_.load(memory_order_relaxed);
+  p.throughput = PerSecond(p.bytes > reported ? p.bytes - reported : 0,
+                           t - reportedTime_.load(memory_order_relaxed));
+  p.averageThroughput = PerSecond(p.bytes, t);
+  p.elapsed = chrono::duration_cast<ProgressInfo::Duration>(
+      chrono::nanoseconds(t));
+  p.sinceLastData = chrono::duration_cast<ProgressInfo::Duration>(
+      chrono::nanoseconds(t - lastData_.load(memory_order_relaxed)));
+  p.partBytes.resize(parts_);
+  for (size_t i = 0; i != parts_; ++i)
+    p.partBytes[i] = partBytes_[i].load(memory_order_relaxed);
+  return p;
+}
+
+//-----------------------------------------------------------------------------
+ostream &operator<<(ostream &os, const ProgressInfo &p) {
+  const double MiB = 1024 * 1024;
+  const auto flags = os.flags();
+  os << fixed << setprecision(1) << 100 * p.Fraction() << "% "
+     << p.bytes / MiB << '/' << p.totalBytes / MiB << " MiB "
+     << p.throughput / MiB << " MiB/s (avg " << p.averageThroughput / MiB
+     << ") parts " << p.partsDone << '/' << p.parts << " in flight "
+     << p.partsInFlight << " retries " << p.retries;
+  if (!p.finished && p.sinceLastData >= chrono::seconds(1))
+    os << " stalled " << p.sinceLastData.count() / 1000.0 << "s";
+  os.flags(flags);
+  return os;
+}
+} // namespace sss
@@ -31,11 +31,13 @@
  * POSSIBILITY OF SUCH DAMAGE.
  ******************************************************************************/
 
-// Upload files in parallel using S3Client
+// Upload files and copy objects in parallel using S3Client
 
+#include "retry_policy.h"
 #include "s3-api.h"
 
 #include <fstream>
+#include <functional>
 #include <future>
 #include <set>
 #include <thread>
@@ -55,60 +57,100 @@ int GetUploadRetries() { return retriesG; }
 ETag DoUploadPart(S3Api &s3, const string &file, size_t offset, size_t size,
                   const string &bucket, const string &key, UploadId uid,
                   int part, int maxRetries) {
-
-  try {
-    return s3.UploadFilePart(file, offset, size, bucket, key, uid, part);
-  } catch (const exception &e) {
-    if (retriesG++ < maxRetries) {
-      return DoUploadPart(s3, file, offset, size, bucket, key, uid, part,
-                          maxRetries);
-    } else {
-      throw e;
-    }
-  }
+  return RetryPolicy(maxRetries).Run(
+      [&] {
+        return s3.UploadFilePart(file, offset, size, bucket, key, uid, part);
+      },
+      &retriesG);
 }
 
 //-----------------------------------------------------------------------------
 ETag DoUploadPart(S3Api &s3, const char *data, size_t offset, size_t size,
                   const string &bucket, const string &key, UploadId uid,
                   int part, int maxRetries) {
+  // retries are handled here, not inside S3Api::UploadPart
+  return RetryPolicy(maxRetries).Run(
+      [&] { return s3.UploadPart(bucket, key, uid, part, data + offset, size); },
+      &retriesG);
+}
+//-----------------------------------------------------------------------------
+// Contiguous byte range of a multipart transfer
+struct Part {
+  int number;    // zero-indexed part number
+  size_t offset; // offset of first byte
+  size_t size;   // number of bytes
+};
 
-  try {
-    return s3.UploadPart(bucket, key, uid, part, data + offset, size,
-                         maxRetries);
-  } catch (const exception &e) {
-    if (retriesG++ < maxRetries) {
-      return DoUploadPart(s3, data, offset, size, bucket, key, uid, part,
-                          maxRetries);
-    } else {
-      throw e;
-    }
+// Send a single part and return its ETag
+using PartSender = function<ETag(S3Api &, const Part &)>;
+
+//-----------------------------------------------------------------------------
+// Split [0, totalSize) into at most numParts non-empty parts of equal size but
+// the last; a single empty part is returned when totalSize is zero
+vector<Part> SplitParts(size_t totalSize, size_t numParts) {
+  numParts = max(numParts, size_t(1));
+  const size_t partSize =
+      max((totalSize + numParts - 1) / numParts, size_t(1));
+  vector<Part> parts;
+  for (size_t offset = 0; offset < totalSize; offset += partSize) {
+    parts.push_back(
+        {int(parts.size()), offset, min(partSize, totalSize - offset)});
   }
+  if (parts.empty())
+    parts.push_back({0, 0, 0});
+  return parts;
 }
-//-----------------------------------------------------------------------------
-vector<string> UploadParts(const S3DataTransferConfig &cfg,
-                           const string &uploadId, size_t chunkSize,
-                           int firstPart, int lastPart, size_t fileSize,
-                           int jobId) {
 
+//-----------------------------------------------------------------------------
+vector<ETag> SendParts(const S3DataTransferConfig &cfg, const PartSender &send,
+                       const Part *first, const Part *last, Span *parent) {
   S3Api s3(cfg.accessKey, cfg.secretKey,
            cfg.endpoints[RandomIndex(0, cfg.endpoints.size() - 1)]);
-
-  vector<string> etags;
-  size_t offset = jobId * chunkSize;
-  chunkSize = min(chunkSize, fileSize - offset);
-  const int numParts = lastPart - firstPart;
-  const size_t partSize = (chunkSize + numParts - 1) / numParts;
-  for (int i = 0; i != numParts; ++i) {
-    const size_t size = min(partSize, chunkSize - i * partSize);
-    etags.push_back(DoUploadPart(s3, cfg.data ? cfg.data : cfg.file, offset,
-                                 size, cfg.bucket, cfg.key, uploadId,
-                                 firstPart + i, cfg.maxRetries));
-    offset += size;
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  s3.SetBandwidthShaper(cfg.bandwidthShaper);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
+  vector<ETag> etags;
+  for (; first != last; ++first) {
+    Span span("Part", parent);
+    span.Set("part", first->number + 1);
+    span.Set("bytes", first->size);
+    PartProgress<S3Api> progress(cfg.progress.get(), s3, first->number);
+    etags.push_back(send(s3, *first));
+    progress.Success();
   }
   return etags;
 }
 
+//-----------------------------------------------------------------------------
+// Multipart scheduler: split data into numParts parts, assign a contiguous
+// sequence of parts to each of the cfg.jobs parallel jobs and return the
+// ETags of all parts in part order
+vector<ETag> SendAllParts(const S3DataTransferConfig &cfg, size_t totalSize,
+                          size_t numParts, bool sync, const PartSender &send) {
+  const vector<Part> parts = SplitParts(totalSize, numParts);
+  if (cfg.progress)
+    cfg.progress->Start(totalSize, parts.size());
+  const size_t jobs = min(size_t(max(cfg.jobs, 1)), parts.size());
+  vector<future<vector<ETag>>> etags(jobs);
+  // parts sent by other threads are nested into the caller's span
+  Span *parent = Span::Current();
+  for (size_t i = 0; i != jobs; ++i) {
+    const Part *first = parts.data() + i * parts.size() / jobs;
+    const Part *last = parts.data() + (i + 1) * parts.size() / jobs;
+    etags[i] = async(sync ? launch::deferred : launch::async, SendParts,
+                     cref(cfg), cref(send), first, last, parent);
+  }
+  vector<ETag> vetags;
+  for (auto &f : etags) {
+    const auto &w = f.get();
+    for (const auto &i : w) {
+      vetags.push_back(i);
+    }
+  }
+  return vetags;
+}
+
 //-----------------------------------------------------------------------------
 string UploadFile(const S3DataTransferConfig &cfg, const MetaDataMap &metaData,
                   bool sync) {
@@ -125,27 +167,20 @@ string UploadFile(const S3DataTransferConfig &cfg, const MetaDataMap &metaData,
   const string endpoint =
       cfg.endpoints[RandomIndex(0, cfg.endpoints.size() - 1)];
   S3Api s3(cfg.accessKey, cfg.secretKey, endpoint);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
   // begin upload request -> get upload id
   const auto uploadId =
       s3.CreateMultipartUpload(cfg.bucket, cfg.key, 0, metaData);
-
-  // per-job part size
-  const size_t perJobSize = (fileSize + cfg.jobs - 1) / cfg.jobs;
   // send parts in parallel and store ETags
-  vector<future<vector<string>>> etags(cfg.jobs);
-  for (int i = 0; i != cfg.jobs; ++i) {
-    etags[i] = async(sync ? launch::deferred : launch::async, UploadParts, cfg,
-                     uploadId, perJobSize, i * cfg.partsPerJob,
-                     i * cfg.partsPerJob + cfg.partsPerJob, fileSize, i);
-  }
-  vector<ETag> vetags;
-  for (auto &f : etags) {
-    const auto &w = f.get();
-    for (const auto &i : w) {
-      vetags.push_back(i);
-    }
-  }
-  return s3.CompleteMultipartUpload(uploadId, cfg.bucket, cfg.key, vetags);
+  const auto etags = SendAllParts(
+      cfg, fileSize, cfg.jobs * cfg.partsPerJob, sync,
+      [&](S3Api &worker, const Part &p) {
+        return DoUploadPart(worker, cfg.file, p.offset, p.size, cfg.bucket,
+                            cfg.key, uploadId, p.number, cfg.maxRetries);
+      });
+  return s3.CompleteMultipartUpload(uploadId, cfg.bucket, cfg.key, etags);
 }
 
 //-----------------------------------------------------------------------------
@@ -160,43 +195,139 @@ string UploadData(const S3DataTransferConfig &cfg, const MetaDataMap &metaData,
   const string endpoint =
       cfg.endpoints[RandomIndex(0, cfg.endpoints.size() - 1)];
   S3Api s3(cfg.accessKey, cfg.secretKey, endpoint);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
   // begin upload request -> get upload id
   const auto uploadId =
       s3.CreateMultipartUpload(cfg.bucket, cfg.key, 0, metaData);
-
-  // per-job part size
-  const size_t perJobSize = (cfg.size + cfg.jobs - 1) / cfg.jobs;
   // send parts in parallel and store ETags
-  vector<future<vector<string>>> etags(cfg.jobs);
-  for (int i = 0; i != cfg.jobs; ++i) {
-    etags[i] = async(sync ? launch::deferred : launch::async, UploadParts, cfg,
-                     uploadId, perJobSize, i * cfg.partsPerJob,
-                     i * cfg.partsPerJob + cfg.partsPerJob, cfg.size, i);
-  }
-  vector<ETag> vetags;
-  for (auto &f : etags) {
-    const auto &w = f.get();
-    for (const auto &i : w) {
-      vetags.push_back(i);
-    }
-  }
-  return s3.CompleteMultipartUpload(uploadId, cfg.bucket, cfg.key, vetags);
+  const auto etags = SendAllParts(
+      cfg, cfg.size, cfg.jobs * cfg.partsPerJob, sync,
+      [&](S3Api &worker, const Part &p) {
+        return DoUploadPart(worker, cfg.data, p.offset, p.size, cfg.bucket,
+                            cfg.key, uploadId, p.number, cfg.maxRetries);
+      });
+  return s3.CompleteMultipartUpload(uploadId, cfg.bucket, cfg.key, etags);
 }
 
 //-----------------------------------------------------------------------------
-string Upload(const S3DataTransferConfig &cfg, const MetaDataMap &metaData,
+string Upload(const S3DataTransferConfig &config, const MetaDataMap &metaData,
               bool sync) {
-
+  // balance requests across endpoints if no selector specified
+  S3DataTransferConfig cfg = config;
+  if (!cfg.endpointSelector && cfg.endpoints.size() > 1) {
+    cfg.endpointSelector = make_shared<EndpointSelector>(cfg.endpoints);
+  }
+  TransferRecorder recorder(cfg.registry, "Upload");
+  const ProgressFinisher finisher(cfg.progress.get());
+  Span span("Upload", cfg.tracer.get());
+  span.Set("bucket", cfg.bucket);
+  span.Set("key", cfg.key);
+  string etag;
   if (cfg.data) {
     if (!cfg.size) {
       throw logic_error("Zero size for upload data buffer");
     }
-    return UploadData(cfg, metaData, sync);
+    span.Set("bytes", cfg.size);
+    etag = UploadData(cfg, metaData, sync);
+    recorder.SetBytes(cfg.size);
   } else {
     if (cfg.file.empty()) {
       throw logic_error("Empty file name");
     }
-    return UploadFile(cfg, metaData, sync);
+    span.Set("file", cfg.file);
+    etag = UploadFile(cfg, metaData, sync);
+    recorder.SetBytes(FileSize(cfg.file));
+  }
+  recorder.Success();
+  return etag;
+}
+
+//-----------------------------------------------------------------------------
+string Copy(const S3DataTransferConfig &config, const string &srcBucket,
+            const string &srcKey, const MetaDataMap &metaData, bool sync,
+            const string &srcVersionId) {
+  retriesG = 0;
+  if (config.endpoints.empty())
+    throw std::logic_error("Missing endpoint information");
+  S3DataTransferConfig cfg = config;
+  if (!cfg.endpointSelector && cfg.endpoints.size() > 1) {
+    cfg.endpointSelector = make_shared<EndpointSelector>(cfg.endpoints);
+  }
+  S3Api s3(cfg.accessKey, cfg.secretKey,
+           cfg.endpoints[RandomIndex(0, cfg.endpoints.size() - 1)]);
+  s3.SetEndpointSelector(cfg.endpointSelector);
+  s3.SetMetricsRegistry(cfg.registry);
+  const MetricsGuard<S3Api> metrics(cfg.metrics, s3);
+  TransferRecorder recorder(cfg.registry, "Copy");
+  const ProgressFinisher finisher(cfg.progress.get());
+  Span span("Copy", cfg.tracer.get());
+  span.Set("source", srcBucket + "/" + srcKey);
+  span.Set("bucket", cfg.bucket);
+  span.Set("key", cfg.key);
+  const ssize_t srcSize = s3.GetObjectSize(srcBucket, srcKey, srcVersionId);
+  if (srcSize < 0) {
+    throw runtime_error("Cannot retrieve size of " + srcBucket + "/" + srcKey);
+  }
+  const size_t size = size_t(srcSize);
+  recorder.SetBytes(size);
+  span.Set("bytes", size);
+  // all parts but the last must be at least MIN_PART_SIZE bytes and no part
+  // can be larger than MAX_COPY_SIZE
+  const size_t numParts =
+      max(min(size_t(cfg.jobs * cfg.partsPerJob), size / S3Api::MIN_PART_SIZE),
+          (size + S3Api::MAX_COPY_SIZE - 1) / S3Api::MAX_COPY_SIZE);
+  if (numParts <= 1) {
+    Headers headers;
+    if (!metaData.empty()) {
+      headers = metaData;
+      headers["x-amz-metadata-directive"] = "REPLACE";
+    }
+    auto copy = [&] {
+      return s3.CopyObject(srcBucket, srcKey, cfg.bucket, cfg.key, headers,
+                           srcVersionId);
+    };
+    if (cfg.progress)
+      cfg.progress->Start(size, 1);
+    PartProgress<S3Api> progress(cfg.progress.get(), s3, 0);
+    const string etag = RetryPolicy(cfg.maxRetries).Run(copy, &retriesG);
+    recorder.Success();
+    if (cfg.progress) {
+      // data is copied server-side
+      cfg.progress->Add(0, int64_t(size));
+      progress.Success();
+    }
+    return etag;
+  }
+  // metadata of the source object is not copied by multipart copies
+  const auto uploadId =
+      s3.CreateMultipartUpload(cfg.bucket, cfg.key, 0, metaData);
+  try {
+    const auto etags = SendAllParts(
+        cfg, size, numParts, sync, [&](S3Api &worker, const Part &p) {
+          auto copy = [&] {
+            return worker.UploadPartCopy(cfg.bucket, cfg.key, uploadId,
+                                         p.number, srcBucket, srcKey, p.offset,
+                                         p.offset + p.size - 1, {},
+                                         srcVersionId);
+          };
+          const ETag etag = RetryPolicy(cfg.maxRetries).Run(copy, &retriesG);
+          // data is copied server-side
+          if (cfg.progress)
+            cfg.progress->Add(p.number, int64_t(p.size));
+          return etag;
+        });
+    const string etag =
+        s3.CompleteMultipartUpload(uploadId, cfg.bucket, cfg.key, etags);
+    recorder.Success();
+    return etag;
+  } catch (...) {
+    try {
+      s3.AbortMultipartUpload(cfg.bucket, cfg.key, uploadId);
+    } catch (...) {
+    }
+    throw;
   }
 }
 } // namespace sss
@@ -65,36 +65,80 @@ URL ParseURL(const string &s) {
 }
 
 //------------------------------------------------------------------------------
-// urlencode string
-string UrlEncode(const std::string &s) {
-  std::ostringstream escaped;
-  escaped.fill('0');
-  escaped << std::hex;
-
-  for (std::string::const_iterator i = s.begin(), n = s.end(); i != n; ++i) {
-    std::string::value_type c = (*i);
-    // Keep alphanumeric and other accepted characters intact
-    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-      escaped << c;
-      continue;
+namespace {
+// Characters left intact by the encoder: unreserved characters per RFC 3986
+// and optionally the path separator
+struct EncodingTable {
+  bool keep[256];
+  constexpr explicit EncodingTable(bool keepSlash) : keep() {
+    for (int c = 0; c != 256; ++c) {
+      keep[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' ||
+                c == '~' || (keepSlash && c == '/');
     }
+  }
+};
+constexpr EncodingTable QUERY_CHARS(false);
+constexpr EncodingTable PATH_CHARS(true);
+const char HEX_DIGITS[] = "0123456789ABCDEF";
 
-    // Any other characters are percent-encoded
-    escaped << std::uppercase;
-    escaped << '%' << setw(2) << int((unsigned char)c);
-    escaped << std::nouppercase;
+// Append percent-encoded text to buffer, copying runs of characters that do
+// not need encoding in one step
+void Encode(string_view s, string &out, const EncodingTable &table) {
+  size_t run = 0;
+  for (size_t i = 0; i != s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (table.keep[c])
+      continue;
+    out.append(s.data() + run, i - run);
+    const char escaped[] = {'%', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xF]};
+    out.append(escaped, sizeof(escaped));
+    run = i + 1;
   }
-  return escaped.str();
+  out.append(s.data() + run, s.size() - run);
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+// urlencode string
+void UrlEncode(string_view s, string &out) { Encode(s, out, QUERY_CHARS); }
+
+string UrlEncode(string_view s) {
+  string escaped;
+  escaped.reserve(s.size());
+  Encode(s, escaped, QUERY_CHARS);
+  return escaped;
 }
+
 //------------------------------------------------------------------------------
-// Return urlencoded url request parameters from {key, value} dictionary
+// Append urlencoded url request parameters from {key, value} dictionary
+void UrlEncode(const Map &p, string &out) {
+  for (auto i = begin(p); i != end(p); ++i) {
+    if (i != begin(p))
+      out += '&';
+    Encode(i->first, out, QUERY_CHARS);
+    out += '=';
+    Encode(i->second, out, QUERY_CHARS);
+  }
+}
+
 string UrlEncode(const Map &p) {
   string url;
-  for (auto i : p) {
-    url += UrlEncode(i.first) + "=" + UrlEncode(i.second);
-    url += '&';
-  }
-  return string(url.begin(), --url.end());
+  UrlEncode(p, url);
+  return url;
+}
+
+//------------------------------------------------------------------------------
+// urlencode path segments
+void UrlEncodePath(string_view path, string &out) {
+  Encode(path, out, PATH_CHARS);
+}
+
+string UrlEncodePath(string_view path) {
+  string escaped;
+  escaped.reserve(path.size());
+  Encode(path, escaped, PATH_CHARS);
+  return escaped;
 }
 
 //------------------------------------------------------------------------------
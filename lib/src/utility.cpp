@@ -50,7 +50,9 @@
 #include <iostream>
 #include <random>
 #include <regex>
+#include <vector>
 
+#include "md5.h"
 #include "utility.h"
 
 namespace sss {
@@ -143,11 +145,97 @@ Toml ParseTomlFile(const string &filename) {
 }
 
 int RandomIndex(int lowerBound, int upperBound) {
-  std::random_device r;
-  std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
-  std::mt19937 e(seed);
+  // seed once per thread: creating a random_device per call is expensive
+  thread_local std::mt19937 e = [] {
+    std::random_device r;
+    std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+    return std::mt19937(seed);
+  }();
   std::uniform_int_distribution<int> uniformDist(lowerBound, upperBound);
   return uniformDist(e);
 }
 
+std::string Base64Encode(const void *data, size_t size) {
+  static const char *table =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  std::string out;
+  out.reserve(4 * ((size + 2) / 3));
+  size_t i = 0;
+  for (; i + 2 < size; i += 3) {
+    const uint32_t n = p[i] << 16 | p[i + 1] << 8 | p[i + 2];
+    out += table[n >> 18];
+    out += table[(n >> 12) & 0x3F];
+    out += table[(n >> 6) & 0x3F];
+    out += table[n & 0x3F];
+  }
+  if (i + 1 == size) {
+    const uint32_t n = p[i] << 16;
+    out += table[n >> 18];
+    out += table[(n >> 12) & 0x3F];
+    out += "==";
+  } else if (i + 2 == size) {
+    const uint32_t n = p[i] << 16 | p[i + 1] << 8;
+    out += table[n >> 18];
+    out += table[(n >> 12) & 0x3F];
+    out += table[(n >> 6) & 0x3F];
+    out += '=';
+  }
+  return out;
+}
+
+namespace {
+// md5_stream processes 64 byte blocks: hash last partial block of a message
+// of totalSize bytes followed by padding and bit length
+void MD5Final(uint32_t hash[4], const uint8_t *tail, size_t tailSize,
+              uint64_t totalSize) {
+  const uint64_t size = next_div_by(tailSize + 1 + 8, 64);
+  std::vector<uint8_t> message(size, 0);
+  std::copy(tail, tail + tailSize, message.begin());
+  message[tailSize] = 0x80;
+  const uint64_t bits = 8 * totalSize;
+  for (int i = 0; i != 8; ++i) {
+    message[size - 8 + i] = uint8_t(bits >> (8 * i));
+  }
+  md5::md5_stream(hash, message.data(), message.size());
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+std::string ContentMD5(const std::string &data) {
+  uint32_t hash[4];
+  md5::init_hash(hash);
+  MD5Final(hash, reinterpret_cast<const uint8_t *>(data.data()), data.size(),
+           data.size());
+  return Base64Encode(hash, sizeof(hash));
+}
+
+//-----------------------------------------------------------------------------
+std::string FileMD5(const std::string &fileName) {
+  std::ifstream is(fileName, std::ios::binary);
+  if (!is) {
+    throw std::runtime_error("Cannot open file " + fileName);
+  }
+  // multiple of md5 block size
+  std::vector<char> buffer(1 << 20);
+  uint32_t hash[4];
+  md5::init_hash(hash);
+  uint64_t total = 0;
+  while (true) {
+    is.read(buffer.data(), buffer.size());
+    const size_t n = size_t(is.gcount());
+    total += n;
+    if (n < buffer.size()) {
+      MD5Final(hash, reinterpret_cast<const uint8_t *>(buffer.data()), n,
+               total);
+      break;
+    }
+    md5::md5_stream(hash, reinterpret_cast<const uint8_t *>(buffer.data()),
+                    n);
+  }
+  char text[33];
+  md5::hash_to_text(hash, text);
+  return text;
+}
+
 } // namespace sss
@@ -47,12 +47,14 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 // #ifdef IGNORE_SIGPIPE REQUIRED!
 #include <signal.h>
 // #endif
 
 #include "common.h"
+#include "error.h"
 
 namespace sss {
 
@@ -81,6 +83,13 @@ struct FileInfo {
   ~FileInfo() { fclose(f); }
 };
 
+// Extract <proto>://<server>:<port> from URL
+string EndpointFromUrl(const string &url) {
+  const size_t proto = url.find("://");
+  const size_t start = proto == string::npos ? 0 : proto + 3;
+  return url.substr(0, url.find('/', start));
+}
+
 struct FileDescInfo {
   int f = 0;
   size_t size = 0;
@@ -144,6 +153,50 @@ size_t WriteFileUnbuffered(char *ptr, size_t size, size_t nmemb,
  */
 
 // public:
+// Move constructor: take ownership of curl handle and header list and
+// re-point libcurl callback data to the new instance
+WebClient::WebClient(WebClient &&other)
+    : curl_(other.curl_), url_(other.url_), urlDirty_(other.urlDirty_),
+      writeBuffer_(other.writeBuffer_),
+      headerBuffer_(other.headerBuffer_),
+      responseHeaders_(other.responseHeaders_, &headerBuffer_),
+      endpoint_(other.endpoint_),
+      path_(other.path_), headers_(other.headers_), params_(other.params_),
+      method_(other.method_), curlHeaderList_(other.curlHeaderList_),
+      responseCode_(other.responseCode_), errorCode_(other.errorCode_),
+      urlEncodedPostData_(other.urlEncodedPostData_),
+      readBuffer_(other.readBuffer_), refBuffer_(other.refBuffer_),
+      limiter_(other.limiter_), requestBodySize_(other.requestBodySize_),
+      shaper_(other.shaper_), readFunction_(other.readFunction_),
+      readData_(other.readData_), writeFunction_(other.writeFunction_),
+      writeData_(other.writeData_), cancel_(other.cancel_),
+      selector_(other.selector_), lastMetrics_(other.lastMetrics_),
+      metrics_(other.metrics_), registry_(other.registry_),
+      operation_(other.operation_), recorder_(other.recorder_),
+      progress_(other.progress_),
+      progressPart_(other.progressPart_),
+      progressBytes_(other.progressBytes_), tracer_(other.tracer_) {
+  other.curl_ = NULL;
+  other.curlHeaderList_ = NULL;
+  auto remap = [this, &other](void *p) -> void * {
+    if (p == &other.writeBuffer_)
+      return &writeBuffer_;
+    if (p == &other.readBuffer_)
+      return &readBuffer_;
+    if (p == &other.refBuffer_)
+      return &refBuffer_;
+    return p;
+  };
+  readData_ = remap(readData_);
+  writeData_ = remap(writeData_);
+  if (curl_) {
+    curl_easy_setopt(curl_, CURLOPT_ERRORBUFFER, errorBuffer_.data());
+    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(curl_, CURLOPT_READDATA, this);
+    curl_easy_setopt(curl_, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, this);
+  }
+}
 /// Cleanup and invoke cleanup on libcurl in case of last instance
 WebClient::~WebClient() {
   if (curlHeaderList_) {
@@ -163,10 +216,87 @@ WebClient::~WebClient() {
 }
 // Send request
 bool WebClient::Send() {
-  const bool ret = Status(curl_easy_perform(curl_));
+  BuildURL();
+  // extracted from the URL only if needed and not set explicitly
+  string urlEndpoint;
+  auto endpoint = [&]() -> const string & {
+    if (endpoint_.empty() && urlEndpoint.empty())
+      urlEndpoint = EndpointFromUrl(url_);
+    return endpoint_.empty() ? urlEndpoint : endpoint_;
+  };
+  const string &operation = operation_.empty() ? method_ : operation_;
+  // permit is released when the function returns
+  auto permit = limiter_ && limiter_->Enabled()
+                    ? limiter_->Acquire(endpoint(), requestBodySize_)
+                    : RequestLimiter::Permit();
+  if (selector_) {
+    selector_->Begin(endpoint_);
+  }
+  if (registry_) {
+    recorder_.Begin(*registry_, operation, endpoint());
+  }
+  // most requests are not traced: do not construct inactive spans
+  optional<Span> span;
+  if (tracer_ || Span::Current()) {
+    span.emplace(operation, tracer_);
+  }
+  progressBytes_ = 0;
+  if (progress_) {
+    progress_->RequestBegin(progressPart_);
+  }
+  errorCode_ = curl_easy_perform(curl_);
+  const bool ret = Status(errorCode_);
   curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &responseCode_);
+  CaptureMetrics();
+  if (progress_ && (!ret || responseCode_ >= 300)) {
+    // data of failed requests is sent again or discarded
+    progress_->Add(progressPart_, -int64_t(progressBytes_));
+  }
+  if (registry_) {
+    recorder_.End(ret ? responseCode_ : 0, lastMetrics_);
+  }
+  if (selector_) {
+    if (errorCode_ == CURLE_ABORTED_BY_CALLBACK) {
+      // aborted transfers are not caused by the endpoint and their time to
+      // first byte, if any, is not a latency sample
+      selector_->Cancel(endpoint_);
+    } else {
+      selector_->Report(endpoint_,
+                        ret && responseCode_ > 0 && responseCode_ < 500 &&
+                            responseCode_ != 429,
+                        lastMetrics_.firstByte);
+    }
+  }
+  if (limiter_) {
+    limiter_->Charge(size_t(lastMetrics_.bytesReceived));
+  }
+  if (span && span->Active()) {
+    TraceRequest(*span, endpoint());
+  }
   return ret;
 }
+
+// Add request attributes to span
+void WebClient::TraceRequest(Span &span, const string &endpoint) {
+  span.Set("attempt", span.Attempt());
+  span.Set("endpoint", endpoint);
+  span.Set("method", method_);
+  span.Set("status", responseCode_);
+  if (errorCode_ != CURLE_OK) {
+    span.SetError(curl_easy_strerror(errorCode_));
+  } else if (responseCode_ >= 400) {
+    span.SetError("HTTP " + to_string(responseCode_));
+  }
+  const auto &m = lastMetrics_;
+  span.Set("name_lookup_us", m.nameLookup.count());
+  span.Set("connect_us", m.connect.count());
+  span.Set("tls_us", m.tlsHandshake.count());
+  span.Set("first_byte_us", m.firstByte.count());
+  span.Set("transfer_us", m.transfer.count());
+  span.Set("bytes_sent", m.bytesSent);
+  span.Set("bytes_received", m.bytesReceived);
+  span.Set("new_connection", !m.ConnectionReused());
+}
 // Set SSL verification options: peer and/or host
 // It is useful to disable everything when sending https requests through
 // e.g. httos tunnel
@@ -180,6 +310,7 @@ bool WebClient::SSLVerify(bool verifyPeer, bool verifyHost) {
 // Set full URL
 bool WebClient::SetUrl(const std::string &url) {
   url_ = url;
+  urlDirty_ = false;
   const auto res = curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
   if (res != CURLE_OK) {
     throw runtime_error(string("Error setting URL - ") +
@@ -191,12 +322,12 @@ bool WebClient::SetUrl(const std::string &url) {
 // Set endpoint: <proto>://<server>:<port>
 void WebClient::SetEndpoint(const std::string &ep) {
   endpoint_ = ep;
-  BuildURL();
+  urlDirty_ = true;
 }
 // Set URL path /.../...
 void WebClient::SetPath(const std::string &path) {
   path_ = path;
-  BuildURL();
+  urlDirty_ = true;
 }
 // Store headers internally
 void WebClient::SetHeaders(const Map &headers) {
@@ -213,33 +344,39 @@ void WebClient::SetHeaders(const Map &headers) {
   }
   curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, curlHeaderList_);
 }
-// Regenerate URL with new parameters
+// Store parameters, URL is regenerated before sending the request
 void WebClient::SetReqParameters(const Map &params) {
   params_ = params;
-  BuildURL();
+  urlDirty_ = true;
 }
 // Set HTTP method
 void WebClient::SetMethod(const std::string &method, size_t size) {
   method_ = ToUpper(method);
+  requestBodySize_ = 0;
+  // options set by a previous request on the same handle, e.g. HEAD, must not
+  // leak into the current one
+  curl_easy_setopt(curl_, CURLOPT_NOBODY, 0L);
+  curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, nullptr);
   if (method_ == "GET") {
     curl_easy_setopt(curl_, CURLOPT_UPLOAD, 0L);
-    curl_easy_setopt(curl_, CURLOPT_NOBODY, 0L);
     curl_easy_setopt(curl_, CURLOPT_HTTPGET, 1L);
-  } else if (method == "HEAD") {
+  } else if (method_ == "HEAD") {
     curl_easy_setopt(curl_, CURLOPT_UPLOAD, 0L);
     curl_easy_setopt(curl_, CURLOPT_NOBODY, 1L);
     curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "HEAD");
-  } else if (method == "DELETE") {
+  } else if (method_ == "DELETE") {
     curl_easy_setopt(curl_, CURLOPT_UPLOAD, 0L);
     curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "DELETE");
-  } else if (method == "POST") {
+  } else if (method_ == "POST") {
     curl_easy_setopt(curl_, CURLOPT_UPLOAD, 0L);
     curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "POST");
     curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, urlEncodedPostData_.size());
     curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, urlEncodedPostData_.c_str());
+    requestBodySize_ = urlEncodedPostData_.size();
   } else if (method_ == "PUT") {
     curl_easy_setopt(curl_, CURLOPT_UPLOAD, 1L);
     curl_easy_setopt(curl_, CURLOPT_INFILESIZE_LARGE, size);
+    requestBodySize_ = size;
 
     //@warining: never set method to "PUT" when specifying CURLOPT_UPLOAD
     // because it will trigger an additional PUT request
@@ -259,13 +396,17 @@ void WebClient::SetUrlEncodedPostData(const std::string &postData) {
 }
 // Set url-encoded data to be posted
 void WebClient::SetPostData(const std::string &data) {
+  requestBodySize_ = data.size();
   curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, data.size());
   curl_easy_setopt(curl_, CURLOPT_COPYPOSTFIELDS, data.c_str());
 }
 // Return status code of last executed request
 long WebClient::StatusCode() const { return responseCode_; }
 // Return full URL
-const std::string &WebClient::GetUrl() const { return url_; }
+const std::string &WebClient::GetUrl() const {
+  BuildURL();
+  return url_;
+}
 // Return response content
 const std::vector<char> &WebClient::GetResponseBody() const {
   return writeBuffer_.data;
@@ -275,21 +416,31 @@ const std::vector<char> &WebClient::GetResponseHeader() const {
   return headerBuffer_;
 }
 // Set write function to use to write received data
+// libcurl always invokes ShapedWriter which forwards to the user function
 bool WebClient::SetWriteFunction(WriteFunction f, void *ptr) {
-  if (curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, f) != CURLE_OK)
-    return false;
-  if (curl_easy_setopt(curl_, CURLOPT_WRITEDATA, ptr) != CURLE_OK)
-    return false;
+  writeFunction_ = f;
+  writeData_ = ptr;
   return true;
 }
 // Set read function to use to read data to be sent
+// libcurl always invokes ShapedReader which forwards to the user function
 bool WebClient::SetReadFunction(ReadFunction f, void *ptr) {
-  if (curl_easy_setopt(curl_, CURLOPT_READFUNCTION, f) != CURLE_OK)
-    return false;
-  if (curl_easy_setopt(curl_, CURLOPT_READDATA, ptr) != CURLE_OK)
-    return false;
+  readFunction_ = f;
+  readData_ = ptr;
   return true;
 }
+// Set cancellation flag, progress function is enabled only when cancellation
+// flag or progress are set
+void WebClient::SetCancelFlag(const std::atomic<bool> *cancel) {
+  cancel_ = cancel;
+  curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, cancel_ || progress_ ? 0L : 1L);
+}
+// Set progress updated by progress function
+void WebClient::SetProgress(TransferProgress *progress, size_t part) {
+  progress_ = progress;
+  progressPart_ = part;
+  curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, cancel_ || progress_ ? 0L : 1L);
+}
 // Upload entire file
 bool WebClient::UploadFile(const std::string &fname, size_t fsize) {
   const size_t size = fsize ? fsize : FileSize(fname);
@@ -306,7 +457,7 @@ bool WebClient::UploadFile(const std::string &fname, size_t fsize) {
   SetMethod("PUT", size);
   const bool result = Send();
   if (!result) {
-    throw std::runtime_error("Error sending request: " + ErrorMsg());
+    throw TransportError("Error sending request: " + ErrorMsg(), errorCode_);
   }
   return result;
 }
@@ -315,12 +466,7 @@ bool WebClient::UploadDataFromBuffer(const char *data, size_t offset,
                                      size_t size) {
   if (size == 0)
     return true;
-  if (curl_easy_setopt(curl_, CURLOPT_READFUNCTION, MemReader) != CURLE_OK) {
-    throw std::runtime_error("Cannot set curl read function");
-  }
-  if (curl_easy_setopt(curl_, CURLOPT_READDATA, &refBuffer_) != CURLE_OK) {
-    throw std::runtime_error("Cannot set curl read data buffer");
-  }
+  SetReadFunction((ReadFunction)MemReader, &refBuffer_);
   refBuffer_.data = data;
   refBuffer_.offset = offset;
   refBuffer_.size = size;
@@ -349,7 +495,7 @@ bool WebClient::UploadFile(const std::string &fname, size_t offset,
   SetMethod("PUT", size);
   const bool result = Send();
   if (!result) {
-    throw std::runtime_error("Error sending request: " + ErrorMsg());
+    throw TransportError("Error sending request: " + ErrorMsg(), errorCode_);
   }
   return result;
 }
@@ -375,7 +521,7 @@ bool WebClient::UploadFileUnbuffered(const std::string &fname, size_t offset,
   SetMethod("PUT", size);
   const bool result = Send();
   if (!result) {
-    throw std::runtime_error("Error sending request: " + ErrorMsg());
+    throw TransportError("Error sending request: " + ErrorMsg(), errorCode_);
     close(file);
   }
   return result;
@@ -430,16 +576,43 @@ void WebClient::SetVerbose(bool verbose) {
 }
 // Returns content as text
 std::string WebClient::GetContentText() const {
-  std::vector<char> content = GetResponseBody();
-  return std::string(begin(content), end(content));
+  return std::string(GetContentView());
 }
 // Returns headers as text
 std::string WebClient::GetHeaderText() const {
-  std::vector<char> header = GetResponseHeader();
-  return std::string(begin(header), end(header));
+  return std::string(GetHeaderView());
 }
 
 // private:
+// Read timings and sizes of last request; curl times are in microseconds
+// from the start of the request
+void WebClient::CaptureMetrics() {
+  curl_off_t dns = 0, connect = 0, tls = 0, firstByte = 0, total = 0;
+  curl_off_t sent = 0, received = 0;
+  long connects = 0;
+  curl_easy_getinfo(curl_, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+  curl_easy_getinfo(curl_, CURLINFO_CONNECT_TIME_T, &connect);
+  curl_easy_getinfo(curl_, CURLINFO_APPCONNECT_TIME_T, &tls);
+  curl_easy_getinfo(curl_, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+  curl_easy_getinfo(curl_, CURLINFO_TOTAL_TIME_T, &total);
+  curl_easy_getinfo(curl_, CURLINFO_SIZE_UPLOAD_T, &sent);
+  curl_easy_getinfo(curl_, CURLINFO_SIZE_DOWNLOAD_T, &received);
+  curl_easy_getinfo(curl_, CURLINFO_NUM_CONNECTS, &connects);
+  using D = RequestMetrics::Duration;
+  RequestMetrics &m = lastMetrics_;
+  m.nameLookup = D(dns);
+  m.connect = D(std::max(connect - dns, curl_off_t(0)));
+  m.tlsHandshake = D(tls > 0 ? std::max(tls - connect, curl_off_t(0)) : 0);
+  m.firstByte = D(firstByte);
+  m.transfer = D(firstByte > 0 ? std::max(total - firstByte, curl_off_t(0))
+                               : 0);
+  m.total = D(total);
+  m.bytesSent = uint64_t(sent);
+  m.bytesReceived = uint64_t(received);
+  m.requests = 1;
+  m.newConnections = size_t(connects);
+  metrics_ += m;
+}
 
 // @warning !!!HACK Checks status and discards SIGPIPE errors
 bool WebClient::Status(CURLcode cc) const {
@@ -491,17 +664,18 @@ bool WebClient::Init() {
     goto handle_error;
   if (curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L) != CURLE_OK)
     goto handle_error;
-  if (curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, Writer) != CURLE_OK)
+  if (curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, ShapedWriter) != CURLE_OK)
     goto handle_error;
-  if (curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &writeBuffer_) != CURLE_OK)
+  if (curl_easy_setopt(curl_, CURLOPT_WRITEDATA, this) != CURLE_OK)
     goto handle_error;
-  if (curl_easy_setopt(curl_, CURLOPT_READFUNCTION, Reader) != CURLE_OK)
+  if (curl_easy_setopt(curl_, CURLOPT_READFUNCTION, ShapedReader) != CURLE_OK)
     goto handle_error;
-  if (curl_easy_setopt(curl_, CURLOPT_READDATA, &readBuffer_) != CURLE_OK)
+  if (curl_easy_setopt(curl_, CURLOPT_READDATA, this) != CURLE_OK)
     goto handle_error;
+  ResetRWFunctions();
   if (curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, HeaderWriter) != CURLE_OK)
     goto handle_error;
-  if (curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &headerBuffer_) != CURLE_OK)
+  if (curl_easy_setopt(curl_, CURLOPT_HEADERDATA, this) != CURLE_OK)
     goto handle_error;
   // disable signal handlers
   if (curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L) != CURLE_OK) {
@@ -510,6 +684,13 @@ bool WebClient::Init() {
   if (curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L) != CURLE_OK) {
     goto handle_error;
   };
+  if (curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, XferInfo) !=
+      CURLE_OK) {
+    goto handle_error;
+  }
+  if (curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, this) != CURLE_OK) {
+    goto handle_error;
+  }
   if (curl_easy_setopt(curl_, CURLOPT_ACCEPT_ENCODING, "") != CURLE_OK) {
     goto handle_error;
   }
@@ -519,11 +700,10 @@ bool WebClient::Init() {
   if (!headers_.empty()) {
     SetHeaders(headers_);
   }
-  if (!params_.empty()) {
-    SetReqParameters(params_);
-  }
   if (!endpoint_.empty()) {
-    BuildURL();
+    urlDirty_ = true;
+  } else if (!url_.empty()) {
+    SetUrl(url_);
   }
   signal(SIGPIPE, SIG_IGN);
   curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
@@ -532,13 +712,23 @@ handle_error:
   throw(std::runtime_error(errorBuffer_.data()));
   return false;
 }
-// Build URL from <proto>://<server>:<port> AND /<path>
-bool WebClient::BuildURL() {
-  string url = endpoint_ + path_;
+// Build URL from <proto>://<server>:<port> AND /<path> once per request,
+// reusing the capacity of the previous URL
+void WebClient::BuildURL() const {
+  if (!urlDirty_)
+    return;
+  url_.assign(endpoint_);
+  url_ += path_;
   if (!params_.empty()) {
-    url += "?" + UrlEncode(params_);
+    url_ += '?';
+    UrlEncode(params_, url_);
+  }
+  urlDirty_ = false;
+  const auto res = curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
+  if (res != CURLE_OK) {
+    throw runtime_error(string("Error setting URL - ") +
+                        curl_easy_strerror(res));
   }
-  return SetUrl(url);
 }
 // Writer function: appends received content to buffer.
 size_t WebClient::Writer(char *data, size_t size, size_t nmemb,
@@ -550,12 +740,15 @@ size_t WebClient::Writer(char *data, size_t size, size_t nmemb,
   outbuffer->offset += size;
   return size;
 }
-// Writer function for headers: appends response headers to buffer.
+// Writer function for headers: appends response headers to buffer and
+// parses them; libcurl passes one complete header line per invocation.
 size_t WebClient::HeaderWriter(char *data, size_t size, size_t nmemb,
-                               std::vector<char> *writerData) {
-  assert(writerData);
-  writerData->insert(writerData->end(), (char *)data,
-                     (char *)data + size * nmemb);
+                               WebClient *self) {
+  assert(self);
+  std::vector<char> &buffer = self->headerBuffer_;
+  const size_t begin = buffer.size();
+  buffer.insert(buffer.end(), data, data + size * nmemb);
+  self->responseHeaders_.ParseLine(begin, buffer.size());
   return size * nmemb;
 }
 // Reader function, writes data to be sent into outPtr buffer in chunks.
@@ -600,6 +793,52 @@ size_t WebClient::MemReader(void *ptr, size_t bsize, size_t nmemb,
   inBuffer->offset += size;
   return size;
 }
+// Invoked by libcurl to read data to send: forwards to user read function
+// or reads from FILE* if no function specified then consumes one token per
+// byte read from bandwidth shaper
+size_t WebClient::ShapedReader(void *ptr, size_t size, size_t nmemb,
+                               WebClient *self) {
+  const size_t bytes =
+      self->readFunction_
+          ? self->readFunction_(ptr, size, nmemb, self->readData_)
+          : fread(ptr, 1, size * nmemb, static_cast<FILE *>(self->readData_));
+  // do not consume tokens in case of CURL_READFUNC_ABORT or _PAUSE
+  if (self->shaper_ && bytes > 0 && bytes <= size * nmemb) {
+    self->shaper_->Consume(double(bytes));
+  }
+  return bytes;
+}
+// Invoked by libcurl to write received data: forwards to user write function
+// or writes to FILE* if no function specified then consumes one token per
+// byte written from bandwidth shaper
+size_t WebClient::ShapedWriter(char *data, size_t size, size_t nmemb,
+                               WebClient *self) {
+  const size_t bytes =
+      self->writeFunction_
+          ? self->writeFunction_(data, size, nmemb, self->writeData_)
+          : fwrite(data, 1, size * nmemb,
+                   static_cast<FILE *>(self->writeData_));
+  if (self->shaper_ && bytes > 0 && bytes <= size * nmemb) {
+    self->shaper_->Consume(double(bytes));
+  }
+  return bytes;
+}
+// Invoked periodically by libcurl when progress is enabled, a non-zero return
+// value aborts the transfer
+int WebClient::XferInfo(WebClient *self, curl_off_t, curl_off_t dlnow,
+                        curl_off_t, curl_off_t ulnow) {
+  if (self->progress_) {
+    // libcurl reports totals of current request, add difference; only the
+    // request body is counted when sending data
+    const bool send = self->method_ == "PUT" || self->method_ == "POST";
+    const uint64_t now = uint64_t(send ? ulnow : dlnow);
+    const uint64_t delta =
+        now > self->progressBytes_ ? now - self->progressBytes_ : 0;
+    self->progressBytes_ += delta;
+    self->progress_->Add(self->progressPart_, int64_t(delta));
+  }
+  return self->cancel_ && *self->cancel_ ? 1 : 0;
+}
 
 // Redirect stderr to file. Returns \c false when it fails.
 bool WebClient::RedirectSTDErr(FILE *f) {
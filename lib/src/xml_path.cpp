@@ -32,6 +32,7 @@
  ******************************************************************************/
 #include "xml_path.h"
 #include "utility.h"
+#include "xml_pull_parser.h"
 #include <deque>
 #include <iostream>
 #include <map>
@@ -240,6 +241,39 @@ private:
   bool found_ = false;
   bool caseInsesitive_ = true;
 };
+//-----------------------------------------------------------------------------
+namespace {
+// replace reserved characters with entities
+string XMLEscape(const string &text) {
+  if (text.find_first_of("<>&\"'") == string::npos)
+    return text;
+  string r;
+  r.reserve(text.size() + 16);
+  for (auto c : text) {
+    switch (c) {
+    case '<':
+      r += "&lt;";
+      break;
+    case '>':
+      r += "&gt;";
+      break;
+    case '&':
+      r += "&amp;";
+      break;
+    case '"':
+      r += "&quot;";
+      break;
+    case '\'':
+      r += "&apos;";
+      break;
+    default:
+      r += c;
+    }
+  }
+  return r;
+}
+} // namespace
+
 //-----------------------------------------------------------------------------
 // print xml text and replace template keyword with provided map values e.g.
 // <tag1>$1</tag1> -> <tag1>Replaced value</tag1>
@@ -258,9 +292,11 @@ public:
   bool VisitEnter(const XMLElement &e, const XMLAttribute *) {
     os_ << string(indent_, ' ') << '<' << e.Name();
     if (const XMLAttribute *a = e.FirstAttribute()) {
-      os_ << ' ' << a->Name() << '=' << '"' << Map(a->Value()) << '"';
+      os_ << ' ' << a->Name() << '=' << '"' << XMLEscape(Map(a->Value()))
+          << '"';
       while ((a = a->Next())) {
-        os_ << ' ' << a->Name() << '=' << '"' << Map(a->Value()) << '"';
+        os_ << ' ' << a->Name() << '=' << '"' << XMLEscape(Map(a->Value()))
+          << '"';
       }
       os_ << ' ';
     }
@@ -282,7 +318,7 @@ public:
   bool Visit(const XMLDeclaration &) { return true; }
   bool Visit(const XMLText &t) {
     indent_ += indentIncrement_;
-    os_ << string(indent_, ' ') << Map(t.Value());
+    os_ << string(indent_, ' ') << XMLEscape(Map(t.Value()));
     if (eol_) {
       os_ << eol_;
     }
@@ -508,9 +544,9 @@ vector<pair<string, string>> GetAttributesText(const XMLElement *e) {
 }
 
 //-----------------------------------------------------------------------------
-string FindElementText(const string &xml, const string &element) {
+string FindElementText(string_view xml, const string &element) {
   tinyxml2::XMLDocument doc;
-  if (doc.Parse(xml.c_str()) != tinyxml2::XML_SUCCESS) {
+  if (doc.Parse(xml.data(), xml.size()) != tinyxml2::XML_SUCCESS) {
     throw std::logic_error("Error parsing XML text");
   }
   return Trim(FindElementText(doc, element));
@@ -642,3 +678,125 @@ string XMLToText(const XMLDocument &doc, bool header, char eol, int indent,
   doc.Accept(&v);
   return v.Text();
 }
+
+//-----------------------------------------------------------------------------
+size_t XMLColumns::Field(const string &path) const {
+  return find(begin(fields), end(fields), path) - begin(fields);
+}
+
+//-----------------------------------------------------------------------------
+size_t XMLColumns::Count(size_t record, size_t field) const {
+  if (field >= fields.size() || record >= size)
+    return 0;
+  return offsets[field][record + 1] - offsets[field][record];
+}
+
+//-----------------------------------------------------------------------------
+const string &XMLColumns::Get(size_t record, size_t field) const {
+  static const string empty;
+  return Count(record, field) ? values[field][offsets[field][record]] : empty;
+}
+
+//-----------------------------------------------------------------------------
+const string &XMLColumns::Get(size_t record, const string &path) const {
+  return Get(record, Field(path));
+}
+
+//-----------------------------------------------------------------------------
+namespace {
+// lowercase name without namespace prefix
+void AppendLocalName(string_view name, string &out) {
+  const size_t colon = name.rfind(':');
+  if (colon != string_view::npos)
+    name.remove_prefix(colon + 1);
+  for (auto c : name)
+    out += char(tolower((unsigned char)c));
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+XMLColumns ExtractRecords(string_view xml, const string &path) {
+  XMLColumns c;
+  const vector<string> prefix = ParsePath(ToLower(path));
+  if (prefix.empty())
+    return c;
+  unordered_map<string, size_t> index;
+  auto field = [&c, &index](const string &p) {
+    auto i = index.find(p);
+    if (i != end(index))
+      return i->second;
+    c.fields.push_back(p);
+    c.values.emplace_back();
+    // records already extracted have no values for new field
+    c.offsets.emplace_back(c.size + 1, 0);
+    index[p] = c.fields.size() - 1;
+    return c.fields.size() - 1;
+  };
+  // elements outside records: true if element and all its ancestors match
+  vector<bool> matched;
+  // elements inside record
+  struct Level {
+    size_t pathLength;
+    size_t field; // field receiving text, set at first text event
+    bool child;
+  };
+  const size_t npos = size_t(-1);
+  vector<Level> levels;
+  string rel; // path relative to record element
+  string name;
+  sss::XMLPullParser p(xml);
+  for (auto e = p.Next(); e != sss::XMLPullParser::END_DOCUMENT; e = p.Next()) {
+    if (e == sss::XMLPullParser::START_ELEMENT) {
+      if (levels.empty()) {
+        const size_t d = p.Depth();
+        name.clear();
+        AppendLocalName(p.Name(), name);
+        const bool m = d <= prefix.size() && (d == 1 || matched.back()) &&
+                       name == prefix[d - 1];
+        matched.push_back(m);
+        if (!m || d != prefix.size())
+          continue;
+        rel.clear();
+      } else {
+        levels.back().child = true;
+        rel += '/';
+        AppendLocalName(p.Name(), rel);
+      }
+      levels.push_back({rel.size(), npos, false});
+      p.Attributes([&](string_view n, string_view v) {
+        name = rel + "/@";
+        AppendLocalName(n, name);
+        auto &values = c.values[field(name)];
+        values.emplace_back();
+        sss::XMLUnescape(v, values.back());
+      });
+    } else if (e == sss::XMLPullParser::TEXT) {
+      if (levels.size() < 2)
+        continue;
+      auto &l = levels.back();
+      if (l.field == npos) {
+        l.field = field(rel);
+        c.values[l.field].emplace_back();
+      }
+      p.AppendText(c.values[l.field].back());
+    } else if (levels.empty()) {
+      matched.pop_back();
+    } else if (levels.size() == 1) {
+      // end of record
+      for (size_t f = 0; f != c.fields.size(); ++f) {
+        c.offsets[f].push_back(c.values[f].size());
+      }
+      ++c.size;
+      levels.pop_back();
+      matched.pop_back();
+    } else {
+      const auto &l = levels.back();
+      // empty element
+      if (!l.child && l.field == npos)
+        c.values[field(rel)].emplace_back();
+      levels.pop_back();
+      rel.resize(levels.back().pathLength);
+    }
+  }
+  return c;
+}
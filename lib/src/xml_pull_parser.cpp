@@ -0,0 +1,257 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+// Streaming XML parser
+
+#include "xml_pull_parser.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool Blank(string_view s) {
+  for (auto c : s) {
+    if (!IsSpace(c))
+      return false;
+  }
+  return true;
+}
+
+bool StartsWith(string_view s, size_t pos, string_view prefix) {
+  return s.compare(pos, prefix.size(), prefix) == 0;
+}
+
+void AppendUTF8(unsigned long cp, string &out) {
+  if (cp < 0x80) {
+    out += char(cp);
+  } else if (cp < 0x800) {
+    out += char(0xC0 | (cp >> 6));
+    out += char(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += char(0xE0 | (cp >> 12));
+    out += char(0x80 | ((cp >> 6) & 0x3F));
+    out += char(0x80 | (cp & 0x3F));
+  } else {
+    out += char(0xF0 | (cp >> 18));
+    out += char(0x80 | ((cp >> 12) & 0x3F));
+    out += char(0x80 | ((cp >> 6) & 0x3F));
+    out += char(0x80 | (cp & 0x3F));
+  }
+}
+} // namespace
+
+//-----------------------------------------------------------------------------
+void XMLUnescape(string_view text, string &out) {
+  size_t b = 0;
+  for (size_t amp = text.find('&'); amp != string_view::npos;
+       amp = text.find('&', b)) {
+    out.append(text.data() + b, amp - b);
+    const size_t semi = text.find(';', amp);
+    if (semi == string_view::npos) {
+      b = amp;
+      break;
+    }
+    const string_view e = text.substr(amp + 1, semi - amp - 1);
+    if (e == "lt") {
+      out += '<';
+    } else if (e == "gt") {
+      out += '>';
+    } else if (e == "amp") {
+      out += '&';
+    } else if (e == "quot") {
+      out += '"';
+    } else if (e == "apos") {
+      out += '\'';
+    } else if (e.size() > 1 && e[0] == '#') {
+      const bool hex = e[1] == 'x' || e[1] == 'X';
+      const string digits(e.substr(hex ? 2 : 1));
+      AppendUTF8(strtoul(digits.c_str(), nullptr, hex ? 16 : 10), out);
+    } else {
+      // unknown entity, keep as is
+      out.append(text.data() + amp, semi - amp + 1);
+    }
+    b = semi + 1;
+  }
+  out.append(text.data() + b, text.size() - b);
+}
+
+//-----------------------------------------------------------------------------
+bool XMLPullParser::NameIs(string_view name) const {
+  if (name.size() != name_.size())
+    return false;
+  for (size_t i = 0; i != name.size(); ++i) {
+    if (tolower((unsigned char)name[i]) != tolower((unsigned char)name_[i]))
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void XMLPullParser::Attributes(
+    const function<void(string_view, string_view)> &f) const {
+  const string_view a = attributes_;
+  size_t i = 0;
+  while (i < a.size()) {
+    while (i < a.size() && IsSpace(a[i]))
+      ++i;
+    const size_t nb = i;
+    while (i < a.size() && a[i] != '=' && !IsSpace(a[i]))
+      ++i;
+    const string_view name = a.substr(nb, i - nb);
+    while (i < a.size() && (IsSpace(a[i]) || a[i] == '='))
+      ++i;
+    if (i == a.size() || (a[i] != '"' && a[i] != '\'')) {
+      if (!name.empty()) {
+        throw logic_error("Malformed XML: missing value of attribute '" +
+                          string(name) + "'");
+      }
+      return;
+    }
+    const size_t ve = a.find(a[i], i + 1);
+    if (ve == string_view::npos) {
+      throw logic_error("Malformed XML: unterminated attribute value");
+    }
+    f(name, a.substr(i + 1, ve - i - 1));
+    i = ve + 1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void XMLPullParser::AppendText(string &out) const {
+  if (cdata_) {
+    out.append(text_.data(), text_.size());
+  } else {
+    XMLUnescape(text_, out);
+  }
+}
+
+//-----------------------------------------------------------------------------
+XMLPullParser::Event XMLPullParser::Next() {
+  if (popDepth_) {
+    --depth_;
+    popDepth_ = false;
+  }
+  if (selfClosed_) {
+    selfClosed_ = false;
+    popDepth_ = true;
+    return END_ELEMENT;
+  }
+  auto skipTo = [this](string_view end) {
+    const size_t e = xml_.find(end, pos_);
+    if (e == string_view::npos) {
+      throw logic_error("Malformed XML: missing '" + string(end) + "'");
+    }
+    pos_ = e + end.size();
+    return e;
+  };
+  while (pos_ < xml_.size()) {
+    if (xml_[pos_] != '<') {
+      const size_t lt = min(xml_.find('<', pos_), xml_.size());
+      const string_view t = xml_.substr(pos_, lt - pos_);
+      pos_ = lt;
+      if (depth_ > 0 && !Blank(t)) {
+        text_ = t;
+        cdata_ = false;
+        return TEXT;
+      }
+      continue;
+    }
+    if (StartsWith(xml_, pos_, "<?")) {
+      skipTo("?>");
+    } else if (StartsWith(xml_, pos_, "<!--")) {
+      skipTo("-->");
+    } else if (StartsWith(xml_, pos_, "<![CDATA[")) {
+      const size_t b = pos_ + 9;
+      const size_t e = skipTo("]]>");
+      text_ = xml_.substr(b, e - b);
+      cdata_ = true;
+      return TEXT;
+    } else if (StartsWith(xml_, pos_, "<!")) {
+      skipTo(">");
+    } else if (StartsWith(xml_, pos_, "</")) {
+      const size_t b = pos_ + 2;
+      size_t e = skipTo(">");
+      while (e > b && IsSpace(xml_[e - 1]))
+        --e;
+      name_ = xml_.substr(b, e - b);
+      if (depth_ == 0) {
+        throw logic_error("Malformed XML: unexpected '</" + string(name_) +
+                          ">'");
+      }
+      popDepth_ = true;
+      return END_ELEMENT;
+    } else {
+      const size_t b = pos_ + 1;
+      size_t e = b;
+      while (e < xml_.size() && !IsSpace(xml_[e]) && xml_[e] != '/' &&
+             xml_[e] != '>')
+        ++e;
+      name_ = xml_.substr(b, e - b);
+      const size_t ab = e;
+      // find end of element, '>' can appear inside quoted values
+      char quote = 0;
+      for (; e < xml_.size(); ++e) {
+        const char c = xml_[e];
+        if (quote) {
+          if (c == quote)
+            quote = 0;
+        } else if (c == '"' || c == '\'') {
+          quote = c;
+        } else if (c == '>') {
+          break;
+        }
+      }
+      if (e == xml_.size() || name_.empty()) {
+        throw logic_error("Malformed XML: unterminated element");
+      }
+      selfClosed_ = xml_[e - 1] == '/';
+      attributes_ = xml_.substr(ab, e - ab - (selfClosed_ ? 1 : 0));
+      pos_ = e + 1;
+      ++depth_;
+      return START_ELEMENT;
+    }
+  }
+  if (depth_ != 0) {
+    throw logic_error("Malformed XML: unexpected end of document");
+  }
+  return END_DOCUMENT;
+}
+} // namespace sss
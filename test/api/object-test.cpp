@@ -150,6 +150,22 @@ int main(int argc, char **argv) {
   }
 
   /// [GetObject]
+  /// [CopyObject]
+  action = "CopyObject";
+  try {
+    S3Api s3(cfg.access, cfg.secret, cfg.url);
+    const string copyName = objName + "-copy";
+    s3.CopyObject(bucketName, objName, bucketName, copyName);
+    const auto &obj = s3.GetObject(bucketName, copyName);
+    if (obj != data) {
+      throw logic_error("Data mismatch");
+    }
+    s3.DeleteObject(bucketName, copyName);
+    TestOutput(action, true, TEST_PREFIX);
+  } catch (const exception &e) {
+    TestOutput(action, false, TEST_PREFIX, e.what());
+  }
+  /// [CopyObject]
   /// [DeleteOject]
   action = "DeleteObject";
   try {
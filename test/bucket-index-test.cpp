@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "bucket_index.h"
+#include "mock_s3_server.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace sss;
+using namespace sss::api;
+
+//------------------------------------------------------------------------------
+bool QueryTest(const string &path) {
+  ObjectInventory inv;
+  inv.Append(ObjectInfo{.key = "a/1",
+                        .lastModified = "2023-03-01T08:47:15.843Z",
+                        .etag = "\"599bab3ed2c697f1d26842727561fd94-3\"",
+                        .size = 10});
+  inv.Append(ObjectInfo{.key = "a/2", .size = 20});
+  inv.Append(ObjectInfo{.key = "b", .size = 5});
+  BucketIndex::Write(path, "bucket", "", inv);
+  BucketIndex idx(path);
+  return idx.Size() == 3 && idx.Bucket() == "bucket" && idx.Prefix().empty() &&
+         idx.Contains("a/2") && !idx.Contains("a/") && idx.Find("b") == 2 &&
+         idx.Count("a/") == 2 && idx.TotalSize("a/") == 30 &&
+         idx.TotalSize("") == 35 && idx.ObjectSize(1) == 20 &&
+         idx.ETag(0) == "599bab3ed2c697f1d26842727561fd94-3" &&
+         idx.ETag(1).empty() && idx.LastModified(0) == 1677660435843;
+}
+
+//------------------------------------------------------------------------------
+bool InvalidFileTest(const string &path) {
+  auto invalid = [&path] {
+    try {
+      BucketIndex idx(path);
+    } catch (const runtime_error &) {
+      return true;
+    }
+    return false;
+  };
+  ofstream(path) << "not an index";
+  if (!invalid())
+    return false;
+  // valid header, second key offset beyond the key section
+  ObjectInventory inv;
+  inv.Append(ObjectInfo{.key = "a"});
+  inv.Append(ObjectInfo{.key = "b"});
+  BucketIndex::Write(path, "bucket", "", inv);
+  uint64_t keyOffsets = 0;
+  fstream f(path, ios::in | ios::out | ios::binary);
+  f.seekg(64); // Header::keyOffsets
+  f.read(reinterpret_cast<char *>(&keyOffsets), sizeof(keyOffsets));
+  const uint64_t offset = 1000;
+  f.seekp(keyOffsets + sizeof(offset));
+  f.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  f.close();
+  if (!invalid())
+    return false;
+  // misaligned key offsets section
+  BucketIndex::Write(path, "bucket", "", inv);
+  f.open(path, ios::in | ios::out | ios::binary);
+  keyOffsets += 4;
+  f.seekp(64);
+  f.write(reinterpret_cast<const char *>(&keyOffsets), sizeof(keyOffsets));
+  f.close();
+  return invalid();
+}
+
+//------------------------------------------------------------------------------
+bool NestedRelistTest(const string &path) {
+  MockS3Server server;
+  server.CreateBucket("bucket");
+  S3Api s3("access", "secret", server.Endpoint());
+  for (const char *k : {"x/a/1", "x/a/b/2", "x/c", "y/1"})
+    s3.PutObject("bucket", k, CharArray(1));
+  BuildBucketIndex(s3, "bucket", "", path);
+  s3.PutObject("bucket", "x/a/b/3", CharArray(1));
+  // nested relisted prefixes: keys under x/a/b/ must not be listed twice
+  BucketIndexRefreshConfig cfg;
+  cfg.relist = {"x/a/b/", "x/a/", "x/a/b/"};
+  if (RefreshBucketIndex(s3, path, cfg) != 5)
+    return false;
+  BucketIndex idx(path);
+  return idx.Size() == 5 && idx.Contains("x/a/b/3") && idx.Find("x/c") == 3;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  const string path = "bucket-index-test.idx";
+  cout << "BucketIndex,"
+       << "Write and query," << QueryTest(path) << ',' << endl;
+  cout << "BucketIndex,"
+       << "Invalid file," << InvalidFileTest(path) << ',' << endl;
+  cout << "BucketIndex,"
+       << "Nested relisted prefixes," << NestedRelistTest(path) << ','
+       << endl;
+  remove(path.c_str());
+  return 0;
+}
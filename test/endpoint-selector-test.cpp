@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "endpoint_selector.h"
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+bool BalancingTest() {
+  EndpointSelector es({"http://a", "http://b"});
+  es.Begin("http://a");
+  es.Report("http://a", true, chrono::milliseconds(100));
+  es.Begin("http://b");
+  es.Report("http://b", true, chrono::milliseconds(1));
+  // with two endpoints both are always compared: lowest latency wins
+  for (int i = 0; i != 10; ++i) {
+    if (es.Select() != "http://b")
+      return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// outstanding requests count before the first latency sample, cancelled
+// requests record no sample, excluded endpoints are not selected
+bool OutstandingTest() {
+  EndpointSelector es({"http://a", "http://b"});
+  es.Begin("http://a");
+  es.Begin("http://a");
+  for (int i = 0; i != 10; ++i) {
+    if (es.Select() != "http://b" || es.Select("http://b") != "http://a")
+      return false;
+  }
+  es.Cancel("http://a");
+  es.Cancel("http://a");
+  const auto s = es.Stats();
+  return s[0].outstanding == 0 && s[0].latency == 0 && s[0].errors == 0;
+}
+
+//------------------------------------------------------------------------------
+bool EjectionTest() {
+  EndpointSelector es({"http://a", "http://b", "http://c"},
+                      {.maxConsecutiveFailures = 2,
+                       .ejectionTime = chrono::milliseconds(50)});
+  for (int i = 0; i != 2; ++i) {
+    es.Begin("http://a");
+    es.Report("http://a", false, {});
+  }
+  for (int i = 0; i != 100; ++i) {
+    if (es.Select() == "http://a")
+      return false;
+  }
+  this_thread::sleep_for(chrono::milliseconds(60));
+  // ejection expired: endpoint can be probed
+  bool probed = false;
+  for (int i = 0; i != 100 && !probed; ++i) {
+    probed = es.Select() == "http://a";
+  }
+  if (!probed)
+    return false;
+  // failed probe: ejected again for twice the time
+  es.Begin("http://a");
+  es.Report("http://a", false, {});
+  const auto s = es.Stats();
+  return s[0].ejections == 2 && s[0].errors == 3 && s[0].requests == 3;
+}
+
+//------------------------------------------------------------------------------
+bool AllEjectedTest() {
+  EndpointSelector es({"http://a"}, {.maxConsecutiveFailures = 1});
+  es.Begin("http://a");
+  es.Report("http://a", false, {});
+  // fail open
+  return es.Select() == "http://a";
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "EndpointSelector,"
+       << "Balancing," << BalancingTest() << ',' << endl;
+  cout << "EndpointSelector,"
+       << "Outstanding requests," << OutstandingTest() << ',' << endl;
+  cout << "EndpointSelector,"
+       << "Ejection," << EjectionTest() << ',' << endl;
+  cout << "EndpointSelector,"
+       << "All endpoints ejected," << AllEjectedTest() << ',' << endl;
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "metrics_registry.h"
+#include "s3-api.h"
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+bool BucketTest() {
+  size_t prev = 0;
+  for (uint64_t v = 0; v < (uint64_t(1) << 40); v = v * 3 / 2 + 1) {
+    const size_t i = HistogramSnapshot::BucketIndex(v);
+    const uint64_t upper = HistogramSnapshot::BucketUpperBound(i);
+    // monotonic, value within bucket, relative error <= 12.5%
+    if (i < prev || upper < v || (upper - v) * 8 > v)
+      return false;
+    if (i && HistogramSnapshot::BucketUpperBound(i - 1) >= v)
+      return false;
+    prev = i;
+  }
+  return HistogramSnapshot::BucketIndex(~uint64_t(0)) ==
+             HistogramSnapshot::NUM_BUCKETS - 1 &&
+         HistogramSnapshot::BucketUpperBound(HistogramSnapshot::NUM_BUCKETS -
+                                             1) == ~uint64_t(0);
+}
+
+//------------------------------------------------------------------------------
+bool ThreadTest() {
+  MetricsRegistry r;
+  const int THREADS = 8;
+  const int N = 10000;
+  // two rounds: threads of the second round reuse shards of the first
+  for (int round = 0; round != 2; ++round) {
+    vector<thread> threads;
+    for (int t = 0; t != THREADS; ++t) {
+      threads.emplace_back([&r, t] {
+        for (int i = 0; i != N; ++i) {
+          r.Increment("requests_total", {{"op", "Get"}});
+          r.Observe("latency_us", {{"op", "Get"}}, uint64_t(i % 100 + 1));
+        }
+        r.AddGauge("threads", {}, t % 2 ? 1 : -1);
+      });
+    }
+    for (auto &t : threads)
+      t.join();
+  }
+  const auto h = r.Histogram("latency_us", {{"op", "Get"}});
+  const uint64_t total = uint64_t(2 * THREADS * N);
+  return r.Counter("requests_total", {{"op", "Get"}}) == total &&
+         h.count == total && h.sum == total / 100 * 5050 &&
+         h.Quantile(.5) >= 50 && h.Quantile(.5) <= 56 && h.Max() >= 100 &&
+         h.Max() <= 112 && r.Gauge("threads", {}) == 0 &&
+         r.Counter("requests_total", {{"op", "Put"}}) == 0;
+}
+
+//------------------------------------------------------------------------------
+bool ExportTest() {
+  MetricsRegistry r;
+  r.Increment("s3_requests_total", {{"operation", "GetObject"}}, 3);
+  r.SetGauge("in_flight", {}, 2);
+  r.Observe("duration_us", {{"operation", "Get\"Object"}}, 5);
+  r.Observe("duration_us", {{"operation", "Get\"Object"}}, 1000);
+  try {
+    r.Observe("s3_requests_total", {{"operation", "GetObject"}}, 1);
+    return false;
+  } catch (const logic_error &) {
+  }
+  const string p = r.Prometheus();
+  const string j = r.JSON();
+  auto has = [](const string &s, const string &t) {
+    return s.find(t) != string::npos;
+  };
+  return has(p, "# TYPE s3_requests_total counter\n") &&
+         has(p, "s3_requests_total{operation=\"GetObject\"} 3\n") &&
+         has(p, "in_flight 2\n") &&
+         has(p, "duration_us_bucket{operation=\"Get\\\"Object\",le=\"5\"} 1") &&
+         has(p, "le=\"+Inf\"} 2\n") &&
+         has(p, "duration_us_sum{operation=\"Get\\\"Object\"} 1005\n") &&
+         has(j, "\"name\":\"s3_requests_total\",\"labels\":{\"operation\":"
+                "\"GetObject\"},\"value\":3") &&
+         has(j, "\"count\":2,\"sum\":1005");
+}
+
+//------------------------------------------------------------------------------
+// cached handles record the same series as RecordRequest, also when used
+// from other threads or with other labels
+bool RequestRecorderTest() {
+  MetricsRegistry expected, r;
+  RequestMetrics m;
+  m.total = chrono::microseconds(900);
+  m.firstByte = chrono::microseconds(300);
+  m.bytesSent = 10;
+  m.bytesReceived = 100;
+  m.newConnections = 1;
+  RequestRecorder recorder;
+  auto record = [&](const string &op, const string &ep, long status) {
+    recorder.Begin(r, op, ep);
+    if (r.Gauge("s3_requests_in_flight", {{"endpoint", ep}}) != 1)
+      return false;
+    recorder.End(status, m);
+    RecordRequest(expected, op, ep, status, m);
+    expected.AddGauge("s3_requests_in_flight", {{"endpoint", ep}}, 0);
+    return true;
+  };
+  bool ok = record("GetObject", "a", 200) && record("GetObject", "a", 503) &&
+            record("PutObject", "a", 200) && record("GetObject", "b", 0) &&
+            record("GetObject", "b", 700);
+  thread([&] { ok = ok && record("GetObject", "b", 404); }).join();
+  ok = ok && record("GetObject", "b", 404);
+  return ok && r.Prometheus() == expected.Prometheus();
+}
+
+//------------------------------------------------------------------------------
+bool OperationNameTest() {
+  using api::S3Api;
+  auto op = [](const string &method, const string &bucket, const string &key,
+               const Parameters &params, const Headers &headers = {}) {
+    S3Api::SendParams p;
+    p.method = method;
+    p.bucket = bucket;
+    p.key = key;
+    p.params = params;
+    p.headers = headers;
+    return S3Api::OperationName(p);
+  };
+  return op("GET", "", "", {}) == "ListBuckets" &&
+         op("GET", "b", "", {{"list-type", "2"}}) == "ListObjectsV2" &&
+         op("GET", "b", "k", {}) == "GetObject" &&
+         op("HEAD", "b", "k", {}) == "HeadObject" &&
+         op("PUT", "b", "k", {{"partNumber", "1"}, {"uploadId", "u"}}) ==
+             "UploadPart" &&
+         op("PUT", "b", "k", {{"partNumber", "1"}, {"uploadId", "u"}},
+            {{"x-amz-copy-source", "/a/b"}}) == "UploadPartCopy" &&
+         op("PUT", "b", "k", {}) == "PutObject" &&
+         op("post", "b", "k", {{"uploads", ""}}) == "CreateMultipartUpload" &&
+         op("POST", "b", "", {{"delete", ""}}) == "DeleteObjects" &&
+         op("DELETE", "b", "k", {{"uploadId", "u"}}) ==
+             "AbortMultipartUpload" &&
+         op("OPTIONS", "b", "k", {}) == "OPTIONS";
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "MetricsRegistry,"
+       << "Histogram buckets," << BucketTest() << ',' << endl;
+  cout << "MetricsRegistry,"
+       << "Per-thread shards," << ThreadTest() << ',' << endl;
+  cout << "MetricsRegistry,"
+       << "Prometheus and JSON export," << ExportTest() << ',' << endl;
+  cout << "MetricsRegistry,"
+       << "Cached request series," << RequestRecorderTest() << ',' << endl;
+  cout << "MetricsRegistry,"
+       << "Operation names," << OperationNameTest() << ',' << endl;
+  return 0;
+}
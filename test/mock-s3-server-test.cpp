@@ -0,0 +1,408 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "list_objects.h"
+#include "mock_s3_server.h"
+#include "s3-client.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace sss;
+using namespace sss::api;
+
+namespace {
+const string BUCKET = "mock-test";
+
+//------------------------------------------------------------------------------
+vector<char> Data(size_t size) {
+  vector<char> data(size);
+  for (size_t i = 0; i != size; ++i)
+    data[i] = char(i * 7 + i / 4093);
+  return data;
+}
+
+//------------------------------------------------------------------------------
+S3DataTransferConfig TransferConfig(const MockS3Server &server,
+                                    vector<char> &data, const string &key) {
+  S3DataTransferConfig cfg;
+  cfg.accessKey = "access";
+  cfg.secretKey = "secret";
+  cfg.endpoints = {server.Endpoint()};
+  cfg.bucket = BUCKET;
+  cfg.key = key;
+  cfg.data = data.data();
+  cfg.size = data.size();
+  cfg.jobs = 4;
+  cfg.registry = nullptr;
+  return cfg;
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+bool ObjectTest() {
+  MockS3Server server;
+  S3Api s3("access", "secret", server.Endpoint());
+  s3.CreateBucket(BUCKET);
+  const vector<char> data = Data(100000);
+  s3.PutObject(BUCKET, "a/b", data);
+  const CharArray all = s3.GetObject(BUCKET, "a/b");
+  const CharArray range = s3.GetObject(BUCKET, "a/b", 10, 19);
+  const bool found = s3.TestObject(BUCKET, "a/b");
+  const ssize_t size = s3.GetObjectSize(BUCKET, "a/b");
+  s3.CopyObject(BUCKET, "a/b", BUCKET, "copy");
+  const CharArray copy = s3.GetObject(BUCKET, "copy");
+  s3.DeleteObject(BUCKET, "a/b");
+  bool missing = false;
+  try {
+    s3.GetObject(BUCKET, "a/b");
+  } catch (const HTTPError &e) {
+    missing = e.Status() == 404 && e.Code() == "NoSuchKey";
+  }
+  // error response without body
+  bool headMissing = false;
+  try {
+    s3.HeadObject(BUCKET, "a/b");
+  } catch (const HTTPError &e) {
+    headMissing = e.Status() == 404 && e.Code().empty();
+  }
+  return all == data && range == CharArray(&data[10], &data[20]) && found &&
+         size == ssize_t(data.size()) && copy == data && missing &&
+         headMissing && !s3.TestObject(BUCKET, "a/b");
+}
+
+//------------------------------------------------------------------------------
+bool KeyEncodingTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  const string key = "dir/a b+\xc3\xbc?x=1&y#";
+  const vector<char> data = Data(1000);
+  s3.PutObject(BUCKET, key, data);
+  s3.CopyObject(BUCKET, key, BUCKET, "copy of " + key);
+  S3Api::ListObjectV2Config cfg;
+  cfg.prefix = "dir/a b";
+  const auto list = s3.ListObjectsV2(BUCKET, cfg);
+  return s3.GetObject(BUCKET, key) == data &&
+         s3.GetObject(BUCKET, "copy of " + key) == data &&
+         s3.GetObjectSize(BUCKET, key) == ssize_t(data.size()) &&
+         list.keys.size() == 1 && list.keys[0].key == key;
+}
+
+//------------------------------------------------------------------------------
+bool ListTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  for (int i = 0; i != 10; ++i) {
+    s3.PutObject(BUCKET, "dir/" + to_string(i), CharArray(i));
+    s3.PutObject(BUCKET, "dir/sub" + to_string(i % 3) + "/" + to_string(i),
+                 CharArray(1));
+  }
+  s3.PutObject(BUCKET, "other", CharArray(1));
+  S3Api::ListObjectV2Config cfg;
+  cfg.prefix = "dir/";
+  cfg.maxKeys = 3;
+  size_t keys = 0;
+  size_t bytes = 0;
+  ListObjectsV2Range all(s3, BUCKET, cfg);
+  for (const auto &o : all) {
+    ++keys;
+    bytes += o.size;
+  }
+  cfg.delimiter = "/";
+  ListObjectsV2Range top(s3, BUCKET, cfg);
+  size_t topKeys = 0;
+  for (auto i = top.begin(); i != top.end(); ++i)
+    ++topKeys;
+  const auto prefixes = top.CommonPrefixes();
+  return keys == 20 && bytes == 55 && topKeys == 10 && prefixes.size() == 3 &&
+         prefixes[0] == "dir/sub0/" && prefixes[2] == "dir/sub2/";
+}
+
+//------------------------------------------------------------------------------
+// Parallel listing must return the same keys as a serial listing, in key
+// order when ordered
+bool ParallelListTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  vector<string> flat;
+  for (int i = 0; i != 60; ++i) {
+    flat.push_back("flat/" + string(1, char('0' + i % 75)) + to_string(i));
+    flat.push_back("flat/" + string(1, char('A' + i % 58)) + to_string(i));
+  }
+  vector<string> prefixed = {"tree/a", "tree/zz"};
+  for (int d = 0; d != 8; ++d)
+    for (int k = 0; k != 5; ++k)
+      prefixed.push_back("tree/d" + to_string(d) + "/" + to_string(k));
+  for (const auto &k : flat)
+    s3.PutObject(BUCKET, k, CharArray(1));
+  for (const auto &k : prefixed)
+    s3.PutObject(BUCKET, k, CharArray(1));
+  sort(begin(flat), end(flat));
+  sort(begin(prefixed), end(prefixed));
+  auto list = [&s3](const string &prefix, bool ordered) {
+    ParallelListConfig cfg;
+    cfg.prefix = prefix;
+    cfg.jobs = 3;
+    cfg.maxKeys = 4;
+    cfg.ordered = ordered;
+    vector<string> keys;
+    const size_t n = ListObjectsParallel(
+        s3, BUCKET, cfg, [&keys](const vector<ObjectInfo> &objects) {
+          for (const auto &o : objects)
+            keys.push_back(o.key);
+        });
+    if (!ordered)
+      sort(begin(keys), end(keys));
+    return n == keys.size() ? keys : vector<string>();
+  };
+  return list("flat/", true) == flat && list("flat/", false) == flat &&
+         list("tree/", true) == prefixed && list("tree/", false) == prefixed;
+}
+
+//------------------------------------------------------------------------------
+// Keys sharing a single prefix and leading characters must still be listed
+// as multiple partitions, by multiple workers
+bool SinglePrefixListTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  vector<string> expected;
+  for (int i = 0; i != 200; ++i) {
+    char key[32];
+    snprintf(key, sizeof(key), "data/2023-%05d", i * 37);
+    expected.push_back(key);
+    s3.PutObject(BUCKET, key, CharArray(1));
+  }
+  sort(begin(expected), end(expected));
+  // slow pages: workers list their partitions concurrently
+  server.Configure({.latency = chrono::milliseconds(5)});
+  ParallelListConfig cfg;
+  cfg.jobs = 4;
+  cfg.maxKeys = 10;
+  vector<string> keys;
+  set<thread::id> threads;
+  const size_t n = ListObjectsParallel(
+      s3, BUCKET, cfg, [&](const vector<ObjectInfo> &objects) {
+        threads.insert(this_thread::get_id());
+        for (const auto &o : objects)
+          keys.push_back(o.key);
+      });
+  return n == expected.size() && keys == expected && threads.size() > 1;
+}
+
+//------------------------------------------------------------------------------
+bool TaggingTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  s3.PutObject(BUCKET, "tagged", CharArray(10));
+  s3.PutObjectTagging(BUCKET, "tagged", {{"a", "1"}, {"b", "<&>"}});
+  const TagMap tags = s3.GetObjectTagging(BUCKET, "tagged");
+  s3.DeleteObjectTagging(BUCKET, "tagged");
+  s3.PutBucketTagging(BUCKET, {{"team", "x"}});
+  const TagMap bucketTags = s3.GetBucketTagging(BUCKET);
+  return tags.size() == 2 && tags.at("b") == "<&>" &&
+         s3.GetObjectTagging(BUCKET, "tagged").empty() &&
+         bucketTags.at("team") == "x";
+}
+
+//------------------------------------------------------------------------------
+bool MultipartTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  vector<char> data = Data((size_t(12) << 20) + 12345);
+  auto cfg = TransferConfig(server, data, "multipart");
+  const ETag etag = Upload(cfg);
+  vector<char> out(data.size());
+  auto down = TransferConfig(server, out, "multipart");
+  Download(down);
+  Copy(TransferConfig(server, out, "copy"), BUCKET, "multipart");
+  S3Api s3("access", "secret", server.Endpoint());
+  const auto deleted = s3.DeleteObjects(
+      BUCKET, {{.key = "multipart"}, {.key = "copy"}}, false);
+  return etag.find('-') != string::npos && out == data &&
+         deleted.deleted.size() == 2 &&
+         s3.ListObjectsV2(BUCKET).keys.empty();
+}
+
+//------------------------------------------------------------------------------
+// Transfers complete when part requests fail or connections drop as long as
+// the number of retries is high enough
+bool RetryTest() {
+  MockS3Server server(
+      {.errorRate = 0.2, .dropRate = 0.1, .dataFaultsOnly = true, .seed = 7});
+  server.CreateBucket(BUCKET);
+  vector<char> data = Data(size_t(16) << 20);
+  auto cfg = TransferConfig(server, data, "retry");
+  cfg.maxRetries = 30;
+  Upload(cfg);
+  vector<char> out(data.size());
+  auto down = TransferConfig(server, out, "retry");
+  down.maxRetries = 30;
+  Download(down);
+  return out == data && server.InjectedErrors() > 0;
+}
+
+//------------------------------------------------------------------------------
+// last progress report is sent also when the transfer fails
+bool FailedProgressTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  vector<char> out(1000);
+  auto cfg = TransferConfig(server, out, "missing");
+  bool finished = false;
+  cfg.progress = make_shared<TransferProgress>(
+      [&finished](const ProgressInfo &i) { finished = i.finished; });
+  try {
+    Download(cfg);
+  } catch (const exception &) {
+    return finished;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool LatencyBandwidthTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  const vector<char> data = Data(200000);
+  s3.PutObject(BUCKET, "slow", data);
+  server.Configure(
+      {.latency = chrono::milliseconds(50), .bandwidth = 1000000});
+  const auto start = chrono::steady_clock::now();
+  s3.HeadObject(BUCKET, "slow");
+  const auto head = chrono::steady_clock::now();
+  const bool ok = s3.GetObject(BUCKET, "slow") == data;
+  const auto get = chrono::steady_clock::now();
+  // 50ms latency, 200ms to transfer 200KB at 1MB/s
+  return ok && head - start >= chrono::milliseconds(50) &&
+         get - head >= chrono::milliseconds(240);
+}
+
+//------------------------------------------------------------------------------
+// A part delayed by the server is requested again once the p95 latency of
+// previous parts has elapsed, the duplicate request completes first
+bool HedgeTest() {
+  MockS3Server server;
+  server.CreateBucket(BUCKET);
+  S3Api s3("access", "secret", server.Endpoint());
+  vector<char> data = Data(80000);
+  s3.PutObject(BUCKET, "hedged", data);
+  // parts 1 to 6 provide latency samples, part 7 is the straggler
+  server.Configure({.latency = chrono::milliseconds(10),
+                    .stragglerInterval = 7,
+                    .stragglerLatency = chrono::seconds(3)});
+  vector<char> out(data.size());
+  auto cfg = TransferConfig(server, out, "hedged");
+  cfg.jobs = 1;
+  cfg.partsPerJob = 8;
+  cfg.hedgeRequests = true;
+  const size_t requests = server.Requests();
+  const auto start = chrono::steady_clock::now();
+  Download(cfg);
+  const auto elapsed = chrono::steady_clock::now() - start;
+  // 8 parts and one hedged request, the straggler is aborted
+  return out == data && server.Requests() - requests == 9 &&
+         elapsed < chrono::seconds(2);
+}
+
+//------------------------------------------------------------------------------
+bool DirectoryTest() {
+  char dir[] = "/tmp/mock-s3-XXXXXX";
+  if (!mkdtemp(dir))
+    return false;
+  bool ok = false;
+  {
+    MockS3Server server({.dataDir = dir});
+    server.CreateBucket(BUCKET);
+    S3Api s3("access", "secret", server.Endpoint());
+    const vector<char> data = Data(50000);
+    s3.PutObject(BUCKET, "file", data);
+    s3.PutObject(BUCKET, "file", data);
+    ok = s3.GetObject(BUCKET, "file", 100, 199) ==
+         CharArray(&data[100], &data[200]);
+  }
+  // files removed when server is destroyed
+  return ok && rmdir(dir) == 0;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "ObjectTest,"
+       << "PUT/GET/HEAD/copy/DELETE of single object," << ObjectTest() << ','
+       << endl;
+  cout << "KeyEncodingTest,"
+       << "keys with spaces and reserved and unicode characters,"
+       << KeyEncodingTest() << ',' << endl;
+  cout << "ListTest,"
+       << "ListObjectsV2 pagination and common prefixes," << ListTest() << ','
+       << endl;
+  cout << "ParallelListTest,"
+       << "parallel listing of flat and prefixed key spaces,"
+       << ParallelListTest() << ',' << endl;
+  cout << "SinglePrefixListTest,"
+       << "parallel listing of keys under a single prefix,"
+       << SinglePrefixListTest() << ',' << endl;
+  cout << "TaggingTest,"
+       << "object and bucket tagging," << TaggingTest() << ',' << endl;
+  cout << "MultipartTest,"
+       << "parallel upload, download, copy and batch delete,"
+       << MultipartTest() << ',' << endl;
+  cout << "RetryTest,"
+       << "transfers complete with injected errors," << RetryTest() << ','
+       << endl;
+  cout << "FailedProgressTest,"
+       << "progress finished when transfer fails," << FailedProgressTest()
+       << ',' << endl;
+  cout << "LatencyBandwidthTest,"
+       << "injected latency and bandwidth limit," << LatencyBandwidthTest()
+       << ',' << endl;
+  cout << "HedgeTest,"
+       << "slow part overtaken by hedged request," << HedgeTest() << ','
+       << endl;
+  cout << "DirectoryTest,"
+       << "objects stored in temporary directory," << DirectoryTest() << ','
+       << endl;
+  return 0;
+}
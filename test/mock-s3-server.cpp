@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file mock-s3-server.cpp
+ * \brief Run MockS3Server until interrupted, e.g. as a target for s3-bench.
+ *
+ * Usage: mock-s3-server [port] [latency ms] [error rate] [MiB/s] [directory]
+ *                       [bucket...]
+ */
+#include "mock_s3_server.h"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+  MockS3Config cfg;
+  try {
+    if (argc > 1)
+      cfg.port = uint16_t(stoul(argv[1]));
+    if (argc > 2)
+      cfg.latency = chrono::milliseconds(stol(argv[2]));
+    if (argc > 3)
+      cfg.errorRate = stod(argv[3]);
+    if (argc > 4)
+      cfg.bandwidth = stod(argv[4]) * (1 << 20);
+    if (argc > 5)
+      cfg.dataDir = argv[5];
+  } catch (const exception &) {
+    cerr << "usage: " << argv[0]
+         << " [port] [latency ms] [error rate] [MiB/s] [directory]"
+            " [bucket...]"
+         << endl;
+    return EXIT_FAILURE;
+  }
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  // block before starting server threads, which inherit the mask
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  try {
+    MockS3Server server(cfg);
+    for (int i = 6; i < argc; ++i)
+      server.CreateBucket(argv[i]);
+    cout << server.Endpoint() << endl;
+    int signal;
+    sigwait(&signals, &signal);
+    cout << server.Requests() << " requests, " << server.InjectedErrors()
+         << " injected errors" << endl;
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1349 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file mock_s3_server.cpp
+ * \brief MockS3Server implementation.
+ */
+#include "mock_s3_server.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace sss {
+
+namespace {
+
+const size_t IO_CHUNK_SIZE = 1 << 16;
+const size_t MAX_HEADER_SIZE = 1 << 16;
+const size_t MAX_KEYS = 1000;
+
+//------------------------------------------------------------------------------
+// Request received from client, header names are lowercase
+struct Request {
+  string method;
+  string path;
+  map<string, string> query;
+  map<string, string> headers;
+  string body;
+  bool keepAlive = true;
+  bool Has(const string &param) const { return query.count(param) != 0; }
+  string Query(const string &param) const {
+    auto i = query.find(param);
+    return i == query.end() ? "" : i->second;
+  }
+  string Header(const string &name) const {
+    auto i = headers.find(name);
+    return i == headers.end() ? "" : i->second;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Response body is a range of shared data to serve objects without copying
+struct Response {
+  int status = 200;
+  vector<pair<string, string>> headers;
+  shared_ptr<const string> data;
+  size_t offset = 0;
+  size_t length = 0;
+  Response(int s = 200) : status(s) {}
+  void Body(string text) {
+    data = make_shared<const string>(move(text));
+    offset = 0;
+    length = data->size();
+  }
+  void Xml(const string &xml) {
+    headers.push_back({"Content-Type", "application/xml"});
+    Body("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + xml);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Transfer rate limit: waits until the bytes accounted so far would have been
+// transferred at the configured rate
+class Throttle {
+public:
+  explicit Throttle(double rate)
+      : rate_(rate), start_(chrono::steady_clock::now()) {}
+  void Account(size_t bytes) {
+    if (rate_ <= 0)
+      return;
+    bytes_ += bytes;
+    this_thread::sleep_until(
+        start_ + chrono::duration_cast<chrono::steady_clock::duration>(
+                     chrono::duration<double>(bytes_ / rate_)));
+  }
+
+private:
+  double rate_;
+  chrono::steady_clock::time_point start_;
+  size_t bytes_ = 0;
+};
+
+//------------------------------------------------------------------------------
+string ToLower(string s) {
+  transform(s.begin(), s.end(), s.begin(),
+            [](unsigned char c) { return tolower(c); });
+  return s;
+}
+
+//------------------------------------------------------------------------------
+string Trim(const string &s) {
+  const size_t b = s.find_first_not_of(" \t");
+  if (b == string::npos)
+    return "";
+  return s.substr(b, s.find_last_not_of(" \t") - b + 1);
+}
+
+//------------------------------------------------------------------------------
+string UrlDecode(const string &s, bool plusIsSpace) {
+  string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '%' && i + 2 < s.size() && isxdigit(s[i + 1]) &&
+        isxdigit(s[i + 2])) {
+      out += char(stoi(s.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else if (s[i] == '+' && plusIsSpace) {
+      out += ' ';
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+string Hex(const string &s) {
+  static const char *digits = "0123456789abcdef";
+  string out;
+  out.reserve(2 * s.size());
+  for (unsigned char c : s) {
+    out += digits[c >> 4];
+    out += digits[c & 0xF];
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+string Unhex(const string &s) {
+  string out;
+  for (size_t i = 0; i + 1 < s.size(); i += 2)
+    out += char(stoi(s.substr(i, 2), nullptr, 16));
+  return out;
+}
+
+//------------------------------------------------------------------------------
+string XmlEscape(const string &s) {
+  string out;
+  out.reserve(s.size());
+  for (char c : s) {
+    switch (c) {
+    case '&':
+      out += "&amp;";
+      break;
+    case '<':
+      out += "&lt;";
+      break;
+    case '>':
+      out += "&gt;";
+      break;
+    case '"':
+      out += "&quot;";
+      break;
+    case '\'':
+      out += "&apos;";
+      break;
+    default:
+      out += c;
+    }
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+string XmlUnescape(const string &s) {
+  static const pair<const char *, char> entities[] = {
+      {"&amp;", '&'},  {"&lt;", '<'},   {"&gt;", '>'},
+      {"&quot;", '"'}, {"&apos;", '\''}};
+  string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    bool replaced = false;
+    if (s[i] == '&') {
+      for (const auto &e : entities) {
+        if (s.compare(i, strlen(e.first), e.first) == 0) {
+          out += e.second;
+          i += strlen(e.first) - 1;
+          replaced = true;
+          break;
+        }
+      }
+    }
+    if (!replaced)
+      out += s[i];
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+// Text of all the <tag>...</tag> elements found in xml, enough to parse the
+// flat request bodies sent by S3 clients
+vector<string> Elements(const string &xml, const string &tag) {
+  vector<string> out;
+  const string open = "<" + tag + ">";
+  const string close = "</" + tag + ">";
+  size_t b = xml.find(open);
+  while (b != string::npos) {
+    b += open.size();
+    const size_t e = xml.find(close, b);
+    if (e == string::npos)
+      break;
+    out.push_back(xml.substr(b, e - b));
+    b = xml.find(open, e + close.size());
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+string Element(const string &xml, const string &tag) {
+  const auto e = Elements(xml, tag);
+  return e.empty() ? "" : XmlUnescape(e.front());
+}
+
+//------------------------------------------------------------------------------
+// 128 bit FNV-1a style hash printed as 32 hex digits, same format as MD5
+string ContentHash(const char *data, size_t size) {
+  uint64_t h1 = 0xcbf29ce484222325ULL;
+  uint64_t h2 = 0x84222325cbf29ce4ULL;
+  for (size_t i = 0; i != size; ++i) {
+    h1 = (h1 ^ uint8_t(data[i])) * 0x100000001b3ULL;
+    h2 = (h2 ^ uint8_t(data[i])) * 0x100000001b3ULL + 1;
+  }
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)h1,
+           (unsigned long long)h2);
+  return buf;
+}
+
+//------------------------------------------------------------------------------
+string FormatTime(time_t t, const char *format) {
+  tm g;
+  gmtime_r(&t, &g);
+  char buf[64];
+  strftime(buf, sizeof(buf), format, &g);
+  return buf;
+}
+
+string HttpDate(time_t t) {
+  return FormatTime(t, "%a, %d %b %Y %H:%M:%S GMT");
+}
+
+string IsoDate(time_t t) { return FormatTime(t, "%Y-%m-%dT%H:%M:%S.000Z"); }
+
+//------------------------------------------------------------------------------
+const char *StatusText(int status) {
+  switch (status) {
+  case 100:
+    return "Continue";
+  case 200:
+    return "OK";
+  case 204:
+    return "No Content";
+  case 206:
+    return "Partial Content";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 409:
+    return "Conflict";
+  case 416:
+    return "Requested Range Not Satisfiable";
+  case 501:
+    return "Not Implemented";
+  case 503:
+    return "Slow Down";
+  default:
+    return "Internal Server Error";
+  }
+}
+
+//------------------------------------------------------------------------------
+Response Error(int status, const string &code, const string &resource) {
+  Response r(status);
+  r.Xml("<Error><Code>" + code + "</Code><Message>" + code +
+        "</Message><Resource>" + XmlEscape(resource) +
+        "</Resource></Error>");
+  return r;
+}
+
+//------------------------------------------------------------------------------
+// Parse "bytes=b-e", "bytes=b-" or "bytes=-n"; false if not satisfiable
+bool ParseRange(const string &spec, size_t size, size_t &begin, size_t &end) {
+  if (spec.compare(0, 6, "bytes=") != 0 || size == 0)
+    return false;
+  const string r = spec.substr(6);
+  const size_t dash = r.find('-');
+  if (dash == string::npos || r.find(',') != string::npos)
+    return false;
+  const string first = r.substr(0, dash);
+  const string last = r.substr(dash + 1);
+  try {
+    if (first.empty()) {
+      const size_t n = stoull(last);
+      if (n == 0)
+        return false;
+      begin = n > size ? 0 : size - n;
+      end = size - 1;
+    } else {
+      begin = stoull(first);
+      end = last.empty() ? size - 1 : min(size_t(stoull(last)), size - 1);
+    }
+  } catch (const exception &) {
+    return false;
+  }
+  return begin <= end && begin < size;
+}
+
+//------------------------------------------------------------------------------
+bool SendAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Object data is either shared memory or a file under the data directory
+struct Object {
+  shared_ptr<const string> data;
+  string path;
+  size_t size = 0;
+  string etag;
+  time_t modified = 0;
+  map<string, string> metadata;
+  map<string, string> tags;
+};
+
+struct Bucket {
+  map<string, Object> objects;
+  map<string, string> tags;
+  time_t created = 0;
+};
+
+struct MultipartUpload {
+  string bucket;
+  string key;
+  map<string, string> metadata;
+  map<int, pair<string, shared_ptr<const string>>> parts; // etag, data
+};
+
+} // namespace
+
+//==============================================================================
+struct MockS3Server::Impl {
+  MockS3Config config;
+  mutable mutex configMutex;
+  mt19937 rng;
+  size_t dataRequests = 0; // since last configuration, for stragglers
+  int listenFd = -1;
+  uint16_t port = 0;
+  thread acceptor;
+  atomic<bool> stopping{false};
+  mutex connectionsMutex;
+  set<int> connections;
+  vector<thread> threads;
+  mutex storeMutex;
+  map<string, Bucket> buckets;
+  map<string, MultipartUpload> uploads;
+  size_t nextId = 0;
+  atomic<size_t> requests{0};
+  atomic<size_t> injectedErrors{0};
+
+  //----------------------------------------------------------------------------
+  enum Fault { NONE, ERROR, DROP };
+  Fault Draw(const Request &req, chrono::microseconds &delay) {
+    lock_guard<mutex> lock(configMutex);
+    delay = config.latency;
+    if (config.jitter.count() > 0) {
+      delay += chrono::microseconds(uniform_int_distribution<int64_t>(
+          0, config.jitter.count())(rng));
+    }
+    const bool data = IsDataRequest(req);
+    if (data && config.stragglerInterval > 0 &&
+        ++dataRequests % config.stragglerInterval == 0)
+      delay += config.stragglerLatency;
+    const double x = uniform_real_distribution<double>(0, 1)(rng);
+    if (config.dataFaultsOnly && !data)
+      return NONE;
+    if (x < config.dropRate)
+      return DROP;
+    if (x < config.dropRate + config.errorRate)
+      return ERROR;
+    return NONE;
+  }
+
+  // Object or part upload, object download
+  static bool IsDataRequest(const Request &req) {
+    const size_t slash = req.path.find('/', 1);
+    if (slash == string::npos || slash + 1 == req.path.size() ||
+        req.Has("tagging"))
+      return false;
+    return req.method == "GET" ||
+           (req.method == "PUT" && req.Header("x-amz-copy-source").empty());
+  }
+
+  double Bandwidth() const {
+    lock_guard<mutex> lock(configMutex);
+    return config.bandwidth;
+  }
+
+  //----------------------------------------------------------------------------
+  // Read more data from socket into buffer, false on error or close
+  static bool Receive(int fd, string &buffer, Throttle *throttle = nullptr) {
+    char buf[IO_CHUNK_SIZE];
+    const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+      return false;
+    buffer.append(buf, n);
+    if (throttle)
+      throttle->Account(n);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Read exactly size body bytes, consuming pending data in buffer first
+  static bool ReadBody(int fd, string &buffer, size_t size, string &body,
+                       Throttle &throttle) {
+    while (buffer.size() < size) {
+      if (!Receive(fd, buffer, &throttle))
+        return false;
+    }
+    body.append(buffer, 0, size);
+    buffer.erase(0, size);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  static bool ReadLine(int fd, string &buffer, string &line,
+                       Throttle &throttle) {
+    size_t e;
+    while ((e = buffer.find("\r\n")) == string::npos) {
+      if (buffer.size() > MAX_HEADER_SIZE || !Receive(fd, buffer, &throttle))
+        return false;
+    }
+    line = buffer.substr(0, e);
+    buffer.erase(0, e + 2);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  static bool ReadRequest(int fd, string &buffer, Request &req,
+                          double bandwidth) {
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == string::npos) {
+      if (buffer.size() > MAX_HEADER_SIZE || !Receive(fd, buffer))
+        return false;
+    }
+    const string head = buffer.substr(0, end);
+    buffer.erase(0, end + 4);
+    size_t b = head.find("\r\n");
+    const string line = head.substr(0, b);
+    const size_t s1 = line.find(' ');
+    const size_t s2 = line.rfind(' ');
+    if (s1 == string::npos || s2 == s1)
+      return false;
+    req.method = line.substr(0, s1);
+    const string target = line.substr(s1 + 1, s2 - s1 - 1);
+    const bool http10 = line.substr(s2 + 1) == "HTTP/1.0";
+    const size_t q = target.find('?');
+    req.path = UrlDecode(target.substr(0, q), false);
+    if (q != string::npos) {
+      const string query = target.substr(q + 1);
+      size_t p = 0;
+      while (p <= query.size()) {
+        size_t a = query.find('&', p);
+        if (a == string::npos)
+          a = query.size();
+        const string kv = query.substr(p, a - p);
+        if (!kv.empty()) {
+          const size_t eq = kv.find('=');
+          req.query[UrlDecode(kv.substr(0, eq), true)] =
+              eq == string::npos ? "" : UrlDecode(kv.substr(eq + 1), true);
+        }
+        p = a + 1;
+      }
+    }
+    while (b != string::npos) {
+      const size_t e = head.find("\r\n", b + 2);
+      const string h = head.substr(b + 2, e == string::npos ? e : e - b - 2);
+      const size_t colon = h.find(':');
+      if (colon != string::npos)
+        req.headers[ToLower(Trim(h.substr(0, colon)))] =
+            Trim(h.substr(colon + 1));
+      b = e;
+    }
+    const string connection = ToLower(req.Header("connection"));
+    req.keepAlive = http10 ? connection == "keep-alive" : connection != "close";
+    if (ToLower(req.Header("expect")) == "100-continue") {
+      const string cont = "HTTP/1.1 100 Continue\r\n\r\n";
+      if (!SendAll(fd, cont.data(), cont.size()))
+        return false;
+    }
+    Throttle throttle(bandwidth);
+    if (ToLower(req.Header("transfer-encoding")) == "chunked") {
+      string size;
+      while (ReadLine(fd, buffer, size, throttle)) {
+        const size_t n = strtoull(size.c_str(), nullptr, 16);
+        if (n == 0) {
+          string trailer;
+          while (ReadLine(fd, buffer, trailer, throttle) && !trailer.empty())
+            ;
+          return true;
+        }
+        string crlf;
+        if (!ReadBody(fd, buffer, n, req.body, throttle) ||
+            !ReadLine(fd, buffer, crlf, throttle))
+          return false;
+      }
+      return false;
+    }
+    const string length = req.Header("content-length");
+    return length.empty() ||
+           ReadBody(fd, buffer, stoull(length), req.body, throttle);
+  }
+
+  //----------------------------------------------------------------------------
+  static bool WriteResponse(int fd, const Request &req, const Response &res,
+                            double bandwidth) {
+    string head = "HTTP/1.1 " + to_string(res.status) + " " +
+                  StatusText(res.status) + "\r\n";
+    bool length = false;
+    for (const auto &h : res.headers) {
+      head += h.first + ": " + h.second + "\r\n";
+      length = length || h.first == "Content-Length";
+    }
+    if (!length)
+      head += "Content-Length: " + to_string(res.length) + "\r\n";
+    head += "Date: " + HttpDate(time(nullptr)) + "\r\n";
+    head += "Server: MockS3\r\n";
+    head += req.keepAlive ? "Connection: keep-alive\r\n\r\n"
+                          : "Connection: close\r\n\r\n";
+    if (!SendAll(fd, head.data(), head.size()))
+      return false;
+    if (req.method == "HEAD" || !res.data)
+      return true;
+    Throttle throttle(bandwidth);
+    const char *p = res.data->data() + res.offset;
+    for (size_t sent = 0; sent < res.length;) {
+      const size_t n = min(IO_CHUNK_SIZE, res.length - sent);
+      if (!SendAll(fd, p + sent, n))
+        return false;
+      sent += n;
+      throttle.Account(n);
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void Serve(int fd) {
+    string buffer;
+    while (!stopping) {
+      const double bandwidth = Bandwidth();
+      Request req;
+      if (!ReadRequest(fd, buffer, req, bandwidth))
+        break;
+      ++requests;
+      chrono::microseconds delay;
+      const Fault fault = Draw(req, delay);
+      if (fault == DROP) {
+        ++injectedErrors;
+        break;
+      }
+      if (delay.count() > 0)
+        this_thread::sleep_for(delay);
+      Response res;
+      if (fault == ERROR) {
+        ++injectedErrors;
+        res = Error(503, "SlowDown", req.path);
+      } else {
+        try {
+          res = Handle(req);
+        } catch (const exception &e) {
+          res = Error(500, "InternalError", e.what());
+        }
+      }
+      res.headers.push_back({"x-amz-request-id", to_string(requests)});
+      if (!WriteResponse(fd, req, res, bandwidth) || !req.keepAlive)
+        break;
+    }
+    {
+      lock_guard<mutex> lock(connectionsMutex);
+      connections.erase(fd);
+    }
+    close(fd);
+  }
+
+  //----------------------------------------------------------------------------
+  void Accept() {
+    while (!stopping) {
+      const int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        if (stopping)
+          break;
+        continue;
+      }
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      lock_guard<mutex> lock(connectionsMutex);
+      if (stopping) {
+        close(fd);
+        break;
+      }
+      connections.insert(fd);
+      threads.emplace_back([this, fd] { Serve(fd); });
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Storage
+  //----------------------------------------------------------------------------
+  string DataDir() const {
+    lock_guard<mutex> lock(configMutex);
+    return config.dataDir;
+  }
+
+  // Build object from data, writing file outside the store lock when a data
+  // directory is configured; files are renamed in place so that readers
+  // holding an open stream keep seeing consistent data
+  Object MakeObject(shared_ptr<const string> data, string etag,
+                    map<string, string> metadata) {
+    Object o;
+    o.size = data->size();
+    o.etag = move(etag);
+    o.modified = time(nullptr);
+    o.metadata = move(metadata);
+    const string dir = DataDir();
+    if (dir.empty()) {
+      o.data = move(data);
+      return o;
+    }
+    size_t id;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      id = nextId++;
+    }
+    o.path = dir + "/mock-s3-" + to_string(getpid()) + "-" + to_string(id);
+    ofstream os(o.path, ios::binary);
+    os.write(data->data(), data->size());
+    if (!os)
+      throw runtime_error("Cannot write " + o.path);
+    return o;
+  }
+
+  // Remove file backing replaced or deleted object
+  static void Discard(const Object &o) {
+    if (!o.path.empty())
+      remove(o.path.c_str());
+  }
+
+  // Object data range, files are read when the object is requested
+  static shared_ptr<const string> Load(const Object &o, size_t begin,
+                                       size_t length, size_t &offset) {
+    if (o.path.empty()) {
+      offset = begin;
+      return o.data;
+    }
+    offset = 0;
+    ifstream is(o.path, ios::binary);
+    string data(length, '\0');
+    is.seekg(begin);
+    is.read(&data[0], length);
+    if (size_t(is.gcount()) != length)
+      return nullptr;
+    return make_shared<const string>(move(data));
+  }
+
+  void Store(const string &bucket, const string &key, Object o) {
+    lock_guard<mutex> lock(storeMutex);
+    auto b = buckets.find(bucket);
+    if (b == buckets.end()) {
+      Discard(o);
+      throw runtime_error("NoSuchBucket");
+    }
+    auto i = b->second.objects.find(key);
+    if (i != b->second.objects.end()) {
+      Discard(i->second);
+      i->second = move(o);
+    } else {
+      b->second.objects.emplace(key, move(o));
+    }
+  }
+
+  static map<string, string> Metadata(const Request &req) {
+    map<string, string> m;
+    for (const auto &h : req.headers) {
+      if (h.first.compare(0, 11, "x-amz-meta-") == 0 ||
+          h.first == "content-type")
+        m.insert(h);
+    }
+    return m;
+  }
+
+  static void AddMetadata(Response &res, const Object &o) {
+    res.headers.push_back({"ETag", "\"" + o.etag + "\""});
+    res.headers.push_back({"Last-Modified", HttpDate(o.modified)});
+    res.headers.push_back({"Accept-Ranges", "bytes"});
+    for (const auto &m : o.metadata)
+      res.headers.push_back(m);
+  }
+
+  static string TagsXml(const map<string, string> &tags) {
+    string xml = "<Tagging><TagSet>";
+    for (const auto &t : tags) {
+      xml += "<Tag><Key>" + XmlEscape(t.first) + "</Key><Value>" +
+             XmlEscape(t.second) + "</Value></Tag>";
+    }
+    return xml + "</TagSet></Tagging>";
+  }
+
+  static map<string, string> ParseTags(const string &xml) {
+    map<string, string> tags;
+    for (const auto &t : Elements(xml, "Tag"))
+      tags[Element(t, "Key")] = Element(t, "Value");
+    return tags;
+  }
+
+  //----------------------------------------------------------------------------
+  // Request dispatch
+  //----------------------------------------------------------------------------
+  Response Handle(const Request &req) {
+    string bucket = req.path.size() > 1 ? req.path.substr(1) : "";
+    string key;
+    const size_t slash = bucket.find('/');
+    if (slash != string::npos) {
+      key = bucket.substr(slash + 1);
+      bucket.resize(slash);
+    }
+    if (bucket.empty()) {
+      if (req.method == "GET")
+        return ListBuckets();
+    } else if (key.empty()) {
+      if (req.Has("tagging"))
+        return BucketTagging(req, bucket);
+      if (req.method == "PUT")
+        return CreateBucket(bucket);
+      if (req.method == "HEAD")
+        return HeadBucket(bucket);
+      if (req.method == "DELETE")
+        return DeleteBucket(bucket);
+      if (req.method == "GET" && req.Query("list-type") == "2")
+        return ListObjectsV2(req, bucket);
+      if (req.method == "POST" && req.Has("delete"))
+        return DeleteObjects(req, bucket);
+    } else {
+      if (req.Has("tagging"))
+        return ObjectTagging(req, bucket, key);
+      if (req.method == "POST" && req.Has("uploads"))
+        return CreateMultipartUpload(req, bucket, key);
+      if (req.method == "POST" && req.Has("uploadId"))
+        return CompleteMultipartUpload(req, bucket, key);
+      if (req.method == "DELETE" && req.Has("uploadId"))
+        return AbortMultipartUpload(req);
+      if (req.method == "PUT" && req.Has("uploadId"))
+        return UploadPart(req);
+      if (req.method == "PUT")
+        return PutObject(req, bucket, key);
+      if (req.method == "GET" || req.method == "HEAD")
+        return GetObject(req, bucket, key);
+      if (req.method == "DELETE")
+        return DeleteObject(bucket, key);
+    }
+    return Error(501, "NotImplemented", req.path);
+  }
+
+  //----------------------------------------------------------------------------
+  Response ListBuckets() {
+    string xml = "<ListAllMyBucketsResult><Owner><ID>mock</ID>"
+                 "<DisplayName>mock</DisplayName></Owner><Buckets>";
+    lock_guard<mutex> lock(storeMutex);
+    for (const auto &b : buckets) {
+      xml += "<Bucket><Name>" + XmlEscape(b.first) + "</Name><CreationDate>" +
+             IsoDate(b.second.created) + "</CreationDate></Bucket>";
+    }
+    Response res;
+    res.Xml(xml + "</Buckets></ListAllMyBucketsResult>");
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response CreateBucket(const string &bucket) {
+    lock_guard<mutex> lock(storeMutex);
+    if (buckets.count(bucket))
+      return Error(409, "BucketAlreadyOwnedByYou", "/" + bucket);
+    buckets[bucket].created = time(nullptr);
+    Response res;
+    res.headers.push_back({"Location", "/" + bucket});
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response HeadBucket(const string &bucket) {
+    lock_guard<mutex> lock(storeMutex);
+    return buckets.count(bucket) ? Response(200)
+                                 : Error(404, "NoSuchBucket", "/" + bucket);
+  }
+
+  //----------------------------------------------------------------------------
+  Response DeleteBucket(const string &bucket) {
+    lock_guard<mutex> lock(storeMutex);
+    auto b = buckets.find(bucket);
+    if (b == buckets.end())
+      return Error(404, "NoSuchBucket", "/" + bucket);
+    if (!b->second.objects.empty())
+      return Error(409, "BucketNotEmpty", "/" + bucket);
+    buckets.erase(b);
+    return Response(204);
+  }
+
+  //----------------------------------------------------------------------------
+  Response BucketTagging(const Request &req, const string &bucket) {
+    lock_guard<mutex> lock(storeMutex);
+    auto b = buckets.find(bucket);
+    if (b == buckets.end())
+      return Error(404, "NoSuchBucket", "/" + bucket);
+    if (req.method == "PUT") {
+      b->second.tags = ParseTags(req.body);
+      return Response(204);
+    }
+    if (req.method == "DELETE") {
+      b->second.tags.clear();
+      return Response(204);
+    }
+    if (b->second.tags.empty())
+      return Error(404, "NoSuchTagSet", "/" + bucket);
+    Response res;
+    res.Xml(TagsXml(b->second.tags));
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  // Continuation tokens are the hex encoded last key or common prefix
+  // returned; a common prefix is skipped entirely when resuming
+  Response ListObjectsV2(const Request &req, const string &bucket) {
+    const string prefix = req.Query("prefix");
+    const string delimiter = req.Query("delimiter");
+    const string token = Unhex(req.Query("continuation-token"));
+    const string startAfter = req.Query("start-after");
+    size_t maxKeys = MAX_KEYS;
+    if (req.Has("max-keys"))
+      maxKeys = min(MAX_KEYS, size_t(stoull(req.Query("max-keys"))));
+    lock_guard<mutex> lock(storeMutex);
+    auto b = buckets.find(bucket);
+    if (b == buckets.end())
+      return Error(404, "NoSuchBucket", "/" + bucket);
+    const auto &objects = b->second.objects;
+    const string &after = req.Has("continuation-token") ? token : startAfter;
+    auto i = after.empty() ? objects.lower_bound(prefix)
+                           : objects.upper_bound(max(after, prefix));
+    string lastPrefix;
+    if (!delimiter.empty() && after.size() >= delimiter.size() &&
+        after.compare(after.size() - delimiter.size(), delimiter.size(),
+                      delimiter) == 0)
+      lastPrefix = after;
+    string contents;
+    string prefixes;
+    string last;
+    size_t count = 0;
+    bool truncated = false;
+    for (; i != objects.end(); ++i) {
+      const string &key = i->first;
+      if (key.compare(0, prefix.size(), prefix) != 0)
+        break;
+      string commonPrefix;
+      if (!delimiter.empty()) {
+        const size_t d = key.find(delimiter, prefix.size());
+        if (d != string::npos)
+          commonPrefix = key.substr(0, d + delimiter.size());
+      }
+      if (!commonPrefix.empty() && commonPrefix == lastPrefix)
+        continue;
+      if (count == maxKeys) {
+        truncated = true;
+        break;
+      }
+      ++count;
+      if (!commonPrefix.empty()) {
+        lastPrefix = last = commonPrefix;
+        prefixes += "<CommonPrefixes><Prefix>" + XmlEscape(commonPrefix) +
+                    "</Prefix></CommonPrefixes>";
+        continue;
+      }
+      last = key;
+      const Object &o = i->second;
+      contents += "<Contents><Key>" + XmlEscape(key) +
+                  "</Key><LastModified>" + IsoDate(o.modified) +
+                  "</LastModified><ETag>&quot;" + o.etag +
+                  "&quot;</ETag><Size>" + to_string(o.size) +
+                  "</Size><StorageClass>STANDARD</StorageClass></Contents>";
+    }
+    string xml = "<ListBucketResult><Name>" + XmlEscape(bucket) +
+                 "</Name><Prefix>" + XmlEscape(prefix) + "</Prefix>";
+    if (!delimiter.empty())
+      xml += "<Delimiter>" + XmlEscape(delimiter) + "</Delimiter>";
+    xml += "<MaxKeys>" + to_string(maxKeys) + "</MaxKeys><KeyCount>" +
+           to_string(count) + "</KeyCount><IsTruncated>" +
+           (truncated ? "true" : "false") + "</IsTruncated>";
+    if (req.Has("continuation-token"))
+      xml += "<ContinuationToken>" + req.Query("continuation-token") +
+             "</ContinuationToken>";
+    if (truncated)
+      xml += "<NextContinuationToken>" + Hex(last) + "</NextContinuationToken>";
+    Response res;
+    res.Xml(xml + contents + prefixes + "</ListBucketResult>");
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response DeleteObjects(const Request &req, const string &bucket) {
+    const bool quiet = Element(req.body, "Quiet") == "true";
+    string xml = "<DeleteResult>";
+    vector<Object> removed;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto b = buckets.find(bucket);
+      if (b == buckets.end())
+        return Error(404, "NoSuchBucket", "/" + bucket);
+      for (const auto &o : Elements(req.body, "Object")) {
+        const string key = Element(o, "Key");
+        auto i = b->second.objects.find(key);
+        if (i != b->second.objects.end()) {
+          removed.push_back(move(i->second));
+          b->second.objects.erase(i);
+        }
+        if (!quiet)
+          xml += "<Deleted><Key>" + XmlEscape(key) + "</Key></Deleted>";
+      }
+    }
+    for (const auto &o : removed)
+      Discard(o);
+    Response res;
+    res.Xml(xml + "</DeleteResult>");
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response ObjectTagging(const Request &req, const string &bucket,
+                         const string &key) {
+    lock_guard<mutex> lock(storeMutex);
+    auto b = buckets.find(bucket);
+    if (b == buckets.end())
+      return Error(404, "NoSuchBucket", "/" + bucket);
+    auto i = b->second.objects.find(key);
+    if (i == b->second.objects.end())
+      return Error(404, "NoSuchKey", req.path);
+    if (req.method == "PUT") {
+      i->second.tags = ParseTags(req.body);
+      return Response(200);
+    }
+    if (req.method == "DELETE") {
+      i->second.tags.clear();
+      return Response(204);
+    }
+    Response res;
+    res.Xml(TagsXml(i->second.tags));
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  // Return source object data in [begin, end] for copy requests, the
+  // x-amz-copy-source header is "[/]bucket/key" with URL-encoded segments
+  Response CopySource(const Request &req, shared_ptr<const string> &data,
+                      string &etag, map<string, string> &metadata) {
+    const string header = req.Header("x-amz-copy-source");
+    string source = UrlDecode(header.substr(0, header.find('?')), false);
+    if (!source.empty() && source[0] == '/')
+      source.erase(0, 1);
+    const size_t slash = source.find('/');
+    if (slash == string::npos)
+      return Error(400, "InvalidArgument", source);
+    Object o;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto b = buckets.find(source.substr(0, slash));
+      if (b == buckets.end())
+        return Error(404, "NoSuchBucket", source);
+      auto i = b->second.objects.find(source.substr(slash + 1));
+      if (i == b->second.objects.end())
+        return Error(404, "NoSuchKey", source);
+      o = i->second;
+    }
+    size_t begin = 0;
+    size_t end = o.size - 1;
+    const string range = req.Header("x-amz-copy-source-range");
+    if (!range.empty() && !ParseRange(range, o.size, begin, end))
+      return Error(416, "InvalidRange", source);
+    const size_t length = o.size == 0 ? 0 : end - begin + 1;
+    size_t offset;
+    auto d = Load(o, begin, length, offset);
+    if (!d)
+      return Error(404, "NoSuchKey", source);
+    data = make_shared<const string>(*d, offset, length);
+    etag = o.etag;
+    metadata = o.metadata;
+    return Response(200);
+  }
+
+  //----------------------------------------------------------------------------
+  Response PutObject(const Request &req, const string &bucket,
+                     const string &key) {
+    {
+      lock_guard<mutex> lock(storeMutex);
+      if (!buckets.count(bucket))
+        return Error(404, "NoSuchBucket", "/" + bucket);
+    }
+    shared_ptr<const string> data;
+    string etag;
+    map<string, string> metadata = Metadata(req);
+    const bool copy = !req.Header("x-amz-copy-source").empty();
+    if (copy) {
+      map<string, string> sourceMetadata;
+      Response res = CopySource(req, data, etag, sourceMetadata);
+      if (res.status != 200)
+        return res;
+      if (ToLower(req.Header("x-amz-metadata-directive")) != "replace")
+        metadata = sourceMetadata;
+    } else {
+      data = make_shared<const string>(req.body);
+      etag = ContentHash(data->data(), data->size());
+    }
+    Object o = MakeObject(data, etag, metadata);
+    const time_t modified = o.modified;
+    Store(bucket, key, move(o));
+    Response res;
+    if (copy) {
+      res.Xml("<CopyObjectResult><LastModified>" + IsoDate(modified) +
+              "</LastModified><ETag>&quot;" + etag +
+              "&quot;</ETag></CopyObjectResult>");
+    } else {
+      res.headers.push_back({"ETag", "\"" + etag + "\""});
+    }
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response GetObject(const Request &req, const string &bucket,
+                     const string &key) {
+    Object o;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto b = buckets.find(bucket);
+      if (b == buckets.end())
+        return Error(404, "NoSuchBucket", "/" + bucket);
+      auto i = b->second.objects.find(key);
+      if (i == b->second.objects.end())
+        return Error(404, "NoSuchKey", req.path);
+      o = i->second;
+    }
+    Response res;
+    AddMetadata(res, o);
+    size_t begin = 0;
+    size_t end = o.size == 0 ? 0 : o.size - 1;
+    size_t length = o.size;
+    const string range = req.Header("range");
+    if (!range.empty()) {
+      if (!ParseRange(range, o.size, begin, end)) {
+        Response err = Error(416, "InvalidRange", req.path);
+        err.headers.push_back(
+            {"Content-Range", "bytes */" + to_string(o.size)});
+        return err;
+      }
+      length = end - begin + 1;
+      res.status = 206;
+      res.headers.push_back({"Content-Range", "bytes " + to_string(begin) +
+                                                  "-" + to_string(end) + "/" +
+                                                  to_string(o.size)});
+    }
+    if (req.method == "HEAD") {
+      res.headers.push_back({"Content-Length", to_string(length)});
+      return res;
+    }
+    res.data = Load(o, begin, length, res.offset);
+    if (!res.data)
+      return Error(404, "NoSuchKey", req.path);
+    res.length = length;
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response DeleteObject(const string &bucket, const string &key) {
+    Object o;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto b = buckets.find(bucket);
+      if (b == buckets.end())
+        return Error(404, "NoSuchBucket", "/" + bucket);
+      auto i = b->second.objects.find(key);
+      if (i == b->second.objects.end())
+        return Response(204);
+      o = move(i->second);
+      b->second.objects.erase(i);
+    }
+    Discard(o);
+    return Response(204);
+  }
+
+  //----------------------------------------------------------------------------
+  Response CreateMultipartUpload(const Request &req, const string &bucket,
+                                 const string &key) {
+    lock_guard<mutex> lock(storeMutex);
+    if (!buckets.count(bucket))
+      return Error(404, "NoSuchBucket", "/" + bucket);
+    const string id = "upload-" + to_string(nextId++);
+    uploads[id] = {bucket, key, Metadata(req), {}};
+    Response res;
+    res.Xml("<InitiateMultipartUploadResult><Bucket>" + XmlEscape(bucket) +
+            "</Bucket><Key>" + XmlEscape(key) + "</Key><UploadId>" + id +
+            "</UploadId></InitiateMultipartUploadResult>");
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response UploadPart(const Request &req) {
+    const string id = req.Query("uploadId");
+    const int part = atoi(req.Query("partNumber").c_str());
+    if (part < 1 || part > 10000)
+      return Error(400, "InvalidArgument", req.path);
+    {
+      lock_guard<mutex> lock(storeMutex);
+      if (!uploads.count(id))
+        return Error(404, "NoSuchUpload", req.path);
+    }
+    shared_ptr<const string> data;
+    const bool copy = !req.Header("x-amz-copy-source").empty();
+    if (copy) {
+      string etag;
+      map<string, string> metadata;
+      Response res = CopySource(req, data, etag, metadata);
+      if (res.status != 200)
+        return res;
+    } else {
+      data = make_shared<const string>(req.body);
+    }
+    const string etag = ContentHash(data->data(), data->size());
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto u = uploads.find(id);
+      if (u == uploads.end())
+        return Error(404, "NoSuchUpload", req.path);
+      u->second.parts[part] = {etag, data};
+    }
+    Response res;
+    if (copy) {
+      res.Xml("<CopyPartResult><LastModified>" + IsoDate(time(nullptr)) +
+              "</LastModified><ETag>&quot;" + etag +
+              "&quot;</ETag></CopyPartResult>");
+    } else {
+      res.headers.push_back({"ETag", "\"" + etag + "\""});
+    }
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  // Multipart ETag is the hash of the part ETags followed by the part count
+  Response CompleteMultipartUpload(const Request &req, const string &bucket,
+                                   const string &key) {
+    const string id = req.Query("uploadId");
+    MultipartUpload upload;
+    {
+      lock_guard<mutex> lock(storeMutex);
+      auto u = uploads.find(id);
+      if (u == uploads.end())
+        return Error(404, "NoSuchUpload", req.path);
+      upload = u->second;
+    }
+    auto data = make_shared<string>();
+    string etags;
+    int previous = 0;
+    const auto parts = Elements(req.body, "Part");
+    for (const auto &p : parts) {
+      const int n = atoi(Element(p, "PartNumber").c_str());
+      string etag = Element(p, "ETag");
+      etag.erase(remove(etag.begin(), etag.end(), '"'), etag.end());
+      auto i = upload.parts.find(n);
+      if (i == upload.parts.end() || i->second.first != etag)
+        return Error(400, "InvalidPart", req.path);
+      if (n <= previous)
+        return Error(400, "InvalidPartOrder", req.path);
+      previous = n;
+      data->append(*i->second.second);
+      etags += etag;
+    }
+    if (parts.empty())
+      return Error(400, "MalformedXML", req.path);
+    const string etag = ContentHash(etags.data(), etags.size()) + "-" +
+                        to_string(parts.size());
+    Object o = MakeObject(move(data), etag, upload.metadata);
+    {
+      lock_guard<mutex> lock(storeMutex);
+      if (!uploads.erase(id)) {
+        Discard(o);
+        return Error(404, "NoSuchUpload", req.path);
+      }
+    }
+    Store(bucket, key, move(o));
+    Response res;
+    res.Xml("<CompleteMultipartUploadResult><Location>/" + XmlEscape(bucket) +
+            "/" + XmlEscape(key) + "</Location><Bucket>" + XmlEscape(bucket) +
+            "</Bucket><Key>" + XmlEscape(key) + "</Key><ETag>&quot;" + etag +
+            "&quot;</ETag></CompleteMultipartUploadResult>");
+    return res;
+  }
+
+  //----------------------------------------------------------------------------
+  Response AbortMultipartUpload(const Request &req) {
+    lock_guard<mutex> lock(storeMutex);
+    if (!uploads.erase(req.Query("uploadId")))
+      return Error(404, "NoSuchUpload", req.path);
+    return Response(204);
+  }
+};
+
+//==============================================================================
+MockS3Server::MockS3Server(const MockS3Config &config)
+    : impl_(new Impl) {
+  impl_->config = config;
+  impl_->rng.seed(config.seed);
+  impl_->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (impl_->listenFd < 0)
+    throw runtime_error("Cannot create socket");
+  const int one = 1;
+  setsockopt(impl_->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(config.port);
+  socklen_t len = sizeof(addr);
+  if (::bind(impl_->listenFd, reinterpret_cast<sockaddr *>(&addr), len) ||
+      listen(impl_->listenFd, SOMAXCONN) ||
+      getsockname(impl_->listenFd, reinterpret_cast<sockaddr *>(&addr),
+                  &len)) {
+    close(impl_->listenFd);
+    throw runtime_error("Cannot listen on port " + to_string(config.port));
+  }
+  impl_->port = ntohs(addr.sin_port);
+  impl_->acceptor = thread([this] { impl_->Accept(); });
+}
+
+//------------------------------------------------------------------------------
+MockS3Server::~MockS3Server() {
+  Stop();
+  for (auto &b : impl_->buckets) {
+    for (auto &o : b.second.objects)
+      Impl::Discard(o.second);
+  }
+}
+
+//------------------------------------------------------------------------------
+void MockS3Server::Stop() {
+  if (impl_->stopping.exchange(true))
+    return;
+  shutdown(impl_->listenFd, SHUT_RDWR);
+  impl_->acceptor.join();
+  close(impl_->listenFd);
+  vector<thread> threads;
+  {
+    lock_guard<mutex> lock(impl_->connectionsMutex);
+    for (int fd : impl_->connections)
+      shutdown(fd, SHUT_RDWR);
+    threads.swap(impl_->threads);
+  }
+  for (auto &t : threads)
+    t.join();
+}
+
+//------------------------------------------------------------------------------
+string MockS3Server::Endpoint() const {
+  return "http://127.0.0.1:" + to_string(impl_->port);
+}
+
+//------------------------------------------------------------------------------
+uint16_t MockS3Server::Port() const { return impl_->port; }
+
+//------------------------------------------------------------------------------
+void MockS3Server::Configure(const MockS3Config &config) {
+  lock_guard<mutex> lock(impl_->configMutex);
+  const uint16_t port = impl_->config.port;
+  const string dataDir = impl_->config.dataDir;
+  impl_->config = config;
+  impl_->config.port = port;
+  impl_->config.dataDir = dataDir;
+  impl_->dataRequests = 0;
+}
+
+//------------------------------------------------------------------------------
+void MockS3Server::CreateBucket(const string &bucket) {
+  lock_guard<mutex> lock(impl_->storeMutex);
+  if (!impl_->buckets.count(bucket))
+    impl_->buckets[bucket].created = time(nullptr);
+}
+
+//------------------------------------------------------------------------------
+size_t MockS3Server::Requests() const { return impl_->requests; }
+
+//------------------------------------------------------------------------------
+size_t MockS3Server::InjectedErrors() const { return impl_->injectedErrors; }
+
+} // namespace sss
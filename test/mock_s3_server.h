@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+/**
+ * \file mock_s3_server.h
+ * \brief Loopback S3 server for offline tests and benchmarks.
+ *
+ * Implements the subset of the S3 REST API used by the client library:
+ * bucket create/head/delete/list, PUT/GET (with \c Range)/HEAD/DELETE/copy of
+ * objects, multipart uploads (including part copy), \c ListObjectsV2 with
+ * pagination and delimiters, \c DeleteObjects and bucket and object tagging.
+ * Requests are not authenticated: signatures are accepted as they are.
+ *
+ * Latency, bandwidth and error rates can be injected to measure the overhead
+ * of the client, retries and hedging reproducibly without network access.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sss {
+
+/// \brief MockS3Server configuration.
+struct MockS3Config {
+  /// listening port on 127.0.0.1, \c 0 to select any free port
+  uint16_t port = 0;
+  /// store object data as files under this directory instead of memory;
+  /// the directory must exist, multipart parts are always kept in memory
+  std::string dataDir;
+  /// delay added before sending each response
+  std::chrono::microseconds latency{0};
+  /// uniformly distributed random delay in [0, jitter] added to \c latency
+  std::chrono::microseconds jitter{0};
+  /// every n-th request transferring object data is delayed by an additional
+  /// \c stragglerLatency, to simulate tail latency; \c 0 to disable
+  size_t stragglerInterval = 0;
+  /// delay added to straggler requests
+  std::chrono::microseconds stragglerLatency{0};
+  /// maximum bytes per second per connection and direction, \c 0 unlimited
+  double bandwidth = 0;
+  /// fraction of requests answered with \c 503 \c SlowDown
+  double errorRate = 0;
+  /// fraction of requests closing the connection without a response
+  double dropRate = 0;
+  /// inject errors only into requests transferring object data: object and
+  /// part uploads and object downloads, which parallel transfers retry
+  bool dataFaultsOnly = false;
+  /// seed of the random number generator used to inject faults
+  unsigned seed = 0;
+};
+
+/// \brief In-process S3 server listening on the loopback interface.
+///
+/// Each connection is served by a dedicated thread, requests are kept alive
+/// as long as the client does not close the connection.
+///
+/// \code{.cpp}
+/// MockS3Server server({.errorRate = 0.1});
+/// server.CreateBucket("test");
+/// S3Api s3("access", "secret", server.Endpoint());
+/// s3.PutObject("test", "key", data);
+/// \endcode
+class MockS3Server {
+public:
+  /// \brief Start server.
+  /// \param[in] config server configuration
+  /// \throw std::runtime_error if the socket cannot be bound
+  explicit MockS3Server(const MockS3Config &config = {});
+  MockS3Server(const MockS3Server &) = delete;
+  MockS3Server &operator=(const MockS3Server &) = delete;
+  /// \brief Stop server and close all open connections.
+  ~MockS3Server();
+  /// \brief Return endpoint URL in the form \c http://127.0.0.1:port.
+  std::string Endpoint() const;
+  /// \brief Return listening port.
+  uint16_t Port() const;
+  /// \brief Update latency, bandwidth and error injection parameters.
+  ///
+  /// \c port and \c dataDir are ignored, changes apply to the next request;
+  /// straggler requests are counted from the next request.
+  void Configure(const MockS3Config &config);
+  /// \brief Create bucket if it does not exist.
+  void CreateBucket(const std::string &bucket);
+  /// \brief Number of requests received.
+  size_t Requests() const;
+  /// \brief Number of requests failed or dropped by fault injection.
+  size_t InjectedErrors() const;
+  /// \brief Stop accepting requests and close all connections; called by the
+  /// destructor.
+  void Stop();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+} // namespace sss
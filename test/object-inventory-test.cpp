@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "object_inventory.h"
+#include <iostream>
+
+using namespace std;
+using namespace sss;
+using namespace sss::api;
+
+//------------------------------------------------------------------------------
+bool RoundTripTest() {
+  const vector<ObjectInfo> objects = {
+      {.key = "b/2",
+       .lastModified = "2023-03-01T08:47:15.843Z",
+       .etag = "\"599bab3ed2c697f1d26842727561fd94\"",
+       .size = 10,
+       .storageClass = "STANDARD",
+       .ownerID = "o1"},
+      {.key = "a",
+       .etag = "\"599bab3ed2c697f1d26842727561fd94-12\"",
+       .size = 1,
+       .storageClass = "STANDARD"},
+      {.key = "b/1", .etag = "opaque", .size = 5}};
+  ObjectInventory inv;
+  inv.Append(objects);
+  const auto o = inv.Get(0);
+  return !inv.Sorted() && inv.Size() == 3 && o.key == "b/2" &&
+         o.lastModified == "2023-03-01T08:47:15.843Z" &&
+         o.etag == "599bab3ed2c697f1d26842727561fd94" && o.size == 10 &&
+         o.storageClass == "STANDARD" && o.ownerID == "o1" &&
+         inv.ETag(1) == "599bab3ed2c697f1d26842727561fd94-12" &&
+         inv.ETag(2) == "opaque" &&
+         ParseISO8601(o.lastModified) == 1677660435843;
+}
+
+//------------------------------------------------------------------------------
+bool SearchTest() {
+  ObjectInventory inv;
+  for (auto k : {"c", "b/2", "a", "b/1", "b0"}) {
+    inv.Append(ObjectInfo{.key = k, .etag = k, .size = 1});
+  }
+  inv.Sort();
+  const auto r = inv.PrefixRange("b/");
+  return inv.Sorted() && inv.Key(0) == "a" && inv.Key(4) == "c" &&
+         inv.ETag(1) == "b/1" && r.first == 1 && r.second == 3 &&
+         inv.TotalSize(r.first, r.second) == 2 && inv.Find("b0") == 3 &&
+         inv.Find("b") == ObjectInventory::npos &&
+         inv.PrefixRange("z").first == inv.PrefixRange("z").second;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "ObjectInventory,"
+       << "Round trip," << RoundTripTest() << ',' << endl;
+  cout << "ObjectInventory,"
+       << "Sort and search," << SearchTest() << ',' << endl;
+  return 0;
+}
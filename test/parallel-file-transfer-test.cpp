@@ -84,6 +84,7 @@ int main(int argc, char **argv) {
   string action = "Parallel file upload";
   ////
   try {
+    RequestMetrics metrics;
     S3DataTransferConfig c = {.accessKey = cfg.access,
                               .secretKey = cfg.secret,
                               .bucket = bucket,
@@ -91,11 +92,17 @@ int main(int argc, char **argv) {
                               .file = tmp.path,
                               .endpoints = {cfg.url},
                               .jobs = NUM_JOBS,
-                              .partsPerJob = CHUNKS_PER_JOB};
+                              .partsPerJob = CHUNKS_PER_JOB,
+                              .metrics = &metrics};
     auto etag = Upload(c);
     if (etag.empty()) {
       throw logic_error("Empty etag");
     }
+    // create + parts + complete, retries excluded
+    if (metrics.requests < size_t(NUM_JOBS * CHUNKS_PER_JOB + 2) ||
+        metrics.bytesSent < data.size()) {
+      throw logic_error("Wrong request metrics");
+    }
     S3Api s3(cfg.access, cfg.secret, cfg.url);
     const CharArray uploaded = s3.GetObject(bucket, key);
     if (uploaded != data)
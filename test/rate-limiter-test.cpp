@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "rate_limiter.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+bool TokenBucketTest() {
+  TokenBucket tb(100, 10);
+  // bucket starts empty and refills at 100 tokens/s
+  if (tb.TryConsume(10))
+    return false;
+  if (tb.Reserve(5) <= TokenBucket::Clock::duration::zero())
+    return false;
+  TokenBucket unlimited;
+  return unlimited.TryConsume(1e9) && !unlimited.Enabled();
+}
+
+//------------------------------------------------------------------------------
+bool InFlightTest() {
+  RequestLimiter rl({.maxInFlightRequests = 2,
+                     .maxInFlightRequestsPerEndpoint = 1,
+                     .blocking = false});
+  auto p1 = rl.Acquire("http://a", 100);
+  try {
+    auto p2 = rl.Acquire("http://a");
+    return false;
+  } catch (const RateLimitError &) {
+  }
+  {
+    auto p2 = rl.Acquire("http://b", 10);
+    if (rl.InFlightRequests() != 2 || rl.InFlightBytes() != 110)
+      return false;
+    try {
+      auto p3 = rl.Acquire("http://c");
+      return false;
+    } catch (const RateLimitError &) {
+    }
+  }
+  return rl.InFlightRequests() == 1 && rl.InFlightBytes() == 100;
+}
+
+//------------------------------------------------------------------------------
+bool RequestRateTest() {
+  RequestLimiter rl({.requestsPerSecond = 20});
+  const auto start = chrono::steady_clock::now();
+  // bucket starts empty: 4 requests need ~200ms
+  for (int i = 0; i != 4; ++i)
+    rl.Acquire("http://a");
+  const auto elapsed = chrono::steady_clock::now() - start;
+  return elapsed >= chrono::milliseconds(150);
+}
+
+//------------------------------------------------------------------------------
+bool FailFastByteTest() {
+  RequestLimiter big({.bytesPerSecond = 1000,
+                      .byteBurst = 100,
+                      .blocking = false});
+  this_thread::sleep_for(chrono::milliseconds(120));
+  // full bucket: request bigger than burst admitted, excess becomes debt
+  big.Acquire("http://a", 1000);
+  try {
+    big.Acquire("http://a", 1);
+    return false;
+  } catch (const RateLimitError &) {
+  }
+  RequestLimiter rl({.requestsPerSecond = 10,
+                     .requestBurst = 1,
+                     .bytesPerSecond = 1000,
+                     .byteBurst = 100,
+                     .blocking = false});
+  this_thread::sleep_for(chrono::milliseconds(120));
+  rl.Charge(1000);
+  try {
+    rl.Acquire("http://a", 10);
+    return false;
+  } catch (const RateLimitError &) {
+  }
+  // request token refunded when the byte check fails
+  rl.Acquire("http://a");
+  return true;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "RateLimiter,"
+       << "Token bucket," << TokenBucketTest() << ',' << endl;
+  cout << "RateLimiter,"
+       << "In-flight requests," << InFlightTest() << ',' << endl;
+  cout << "RateLimiter,"
+       << "Request rate," << RequestRateTest() << ',' << endl;
+  cout << "RateLimiter,"
+       << "Fail-fast byte rate," << FailFastByteTest() << ',' << endl;
+  return 0;
+}
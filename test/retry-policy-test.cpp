@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "error.h"
+#include "rate_limiter.h"
+#include "retry_policy.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+bool ClassificationTest() {
+  return RetryPolicy::Retryable(HTTPError("", 503, "SlowDown")) &&
+         RetryPolicy::Retryable(HTTPError("", 500, "InternalError")) &&
+         RetryPolicy::Retryable(HTTPError("", 429, "")) &&
+         RetryPolicy::Retryable(HTTPError("", 400, "RequestTimeout")) &&
+         !RetryPolicy::Retryable(HTTPError("", 403, "AccessDenied")) &&
+         !RetryPolicy::Retryable(HTTPError("", 404, "NoSuchKey")) &&
+         RetryPolicy::Retryable(TransportError("", CURLE_RECV_ERROR)) &&
+         !RetryPolicy::Retryable(TransportError("", CURLE_URL_MALFORMAT)) &&
+         RetryPolicy::Retryable(RateLimitError("")) &&
+         !RetryPolicy::Retryable(logic_error(""));
+}
+
+//------------------------------------------------------------------------------
+bool BackoffTest() {
+  const RetryPolicy p(3, RetryPolicy::Duration(10), RetryPolicy::Duration(50));
+  RetryPolicy::Duration d(10);
+  for (int i = 0; i != 100; ++i) {
+    d = p.NextDelay(d);
+    if (d < RetryPolicy::Duration(10) || d > RetryPolicy::Duration(50))
+      return false;
+  }
+  return RetryPolicy::RetryAfter(HTTPError("", 503, "SlowDown", 2)) ==
+         RetryPolicy::Duration(2000);
+}
+
+//------------------------------------------------------------------------------
+bool RunTest() {
+  const RetryPolicy p(3, RetryPolicy::Duration(1), RetryPolicy::Duration(2));
+  atomic<int> retries{0};
+  int attempts = 0;
+  // succeeds at third attempt
+  const int r = p.Run(
+      [&] {
+        if (++attempts < 3)
+          throw HTTPError("", 503, "SlowDown");
+        return attempts;
+      },
+      &retries);
+  if (r != 3 || retries != 2)
+    return false;
+  // not retryable: single attempt
+  attempts = 0;
+  try {
+    p.Run([&] {
+      ++attempts;
+      throw HTTPError("", 404, "NoSuchKey");
+    });
+  } catch (const HTTPError &e) {
+    if (e.Status() != 404 || attempts != 1)
+      return false;
+  }
+  // Retry-After of 2 seconds bounded by maximum delay
+  attempts = 0;
+  const auto start = chrono::steady_clock::now();
+  p.Run([&] {
+    if (++attempts < 2)
+      throw HTTPError("", 503, "SlowDown", 2);
+  });
+  if (chrono::steady_clock::now() - start > chrono::seconds(1))
+    return false;
+  // retries exhausted: 1 + 3 attempts
+  attempts = 0;
+  try {
+    p.Run([&] {
+      ++attempts;
+      throw TransportError("reset", CURLE_RECV_ERROR);
+    });
+  } catch (const TransportError &) {
+    return attempts == 4;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool CancelTest() {
+  const RetryPolicy p(3, RetryPolicy::Duration(5000),
+                      RetryPolicy::Duration(20000));
+  atomic<bool> cancel{false};
+  int attempts = 0;
+  thread canceller([&cancel] {
+    this_thread::sleep_for(chrono::milliseconds(50));
+    cancel = true;
+  });
+  // delay between attempts interrupted, last error re-thrown
+  const auto start = chrono::steady_clock::now();
+  bool thrown = false;
+  try {
+    p.Run(
+        [&] {
+          ++attempts;
+          throw HTTPError("", 503, "SlowDown");
+        },
+        nullptr, &cancel);
+  } catch (const HTTPError &) {
+    thrown = true;
+  }
+  canceller.join();
+  return thrown && attempts == 1 &&
+         chrono::steady_clock::now() - start < chrono::seconds(1);
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "RetryPolicy,"
+       << "Error classification," << ClassificationTest() << ',' << endl;
+  cout << "RetryPolicy,"
+       << "Backoff," << BackoffTest() << ',' << endl;
+  cout << "RetryPolicy,"
+       << "Retry," << RunTest() << ',' << endl;
+  cout << "RetryPolicy,"
+       << "Cancel," << CancelTest() << ',' << endl;
+  return 0;
+}
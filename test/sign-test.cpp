@@ -32,6 +32,7 @@
  ******************************************************************************/
 #include "aws_sign.h"
 #include "s3-client.h"
+#include "url_utility.h"
 #include <cassert>
 #include <iostream>
 
@@ -56,5 +57,13 @@ int main(int, char **) {
        << "Sign request," << (signature == ComputeSignature(cfg).signature)
        << ',' << endl;
   /// [Create signature example]
+  const bool encode =
+      UrlEncode("a b/c~-_.") == "a%20b%2Fc~-_." &&
+      UrlEncode(Map{{"prefix", "a b"}, {"acl", ""}}) == "acl=&prefix=a%20b" &&
+      UrlEncode(Map{}).empty() &&
+      UrlEncodePath("/bucket/dir/a b+\xc3\xbc") ==
+          "/bucket/dir/a%20b%2B%C3%BC";
+  cout << "UrlEncode,"
+       << "URL-encode text, parameters and paths," << encode << ',' << endl;
   return 0;
 }
@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "mock_s3_server.h"
+#include "sync.h"
+#include "utility.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace sss;
+using namespace sss::api;
+
+//------------------------------------------------------------------------------
+bool DiffTest() {
+  const string md5a = "599bab3ed2c697f1d26842727561fd94";
+  const string md5b = "699bab3ed2c697f1d26842727561fd94";
+  const SyncManifest src = {{"a", 1, 100, md5a},  // unchanged, same ETag
+                            {"b", 2, 100, md5a},  // size differs
+                            {"c", 1, 100, md5a},  // ETag differs
+                            {"d", 1, 300, ""},    // newer, no ETag
+                            {"e", 1, 100, ""},    // older, no ETag
+                            {"g", 1, 100, md5a}}; // new
+  const SyncManifest dst = {{"a", 1, 200, md5a},      {"b", 1, 200, md5a},
+                            {"c", 1, 200, md5b},      {"d", 1, 200, md5a},
+                            {"e", 1, 200, md5b + "-2"}, {"f", 1, 200, md5a}};
+  SyncConfig cfg;
+  const SyncPlan p = DiffManifests(src, dst, cfg);
+  cfg.deleteExtraneous = true;
+  cfg.sizeOnly = true;
+  const SyncPlan q = DiffManifests(src, dst, cfg);
+  auto keys = [](const SyncPlan &p) {
+    string k;
+    for (const auto &t : p.transfers)
+      k += t.key;
+    return k;
+  };
+  return keys(p) == "bcdg" && p.unchanged == 2 && p.bytes == 5 &&
+         p.deletes.empty() && keys(q) == "bg" && q.unchanged == 4 &&
+         q.deletes == vector<string>{"f"};
+}
+
+//------------------------------------------------------------------------------
+bool LocalManifestTest() {
+  const auto dir = filesystem::temp_directory_path() / "sss-sync-test";
+  filesystem::remove_all(dir);
+  filesystem::create_directories(dir / "x" / "y");
+  ofstream(dir / "b") << "abc";
+  ofstream(dir / "x" / "y" / "a") << "";
+  const SyncManifest m = LocalManifest(dir.string(), true);
+  filesystem::remove_all(dir);
+  return m.size() == 2 && m[0].key == "b" && m[0].size == 3 &&
+         m[0].etag == "900150983cd24fb0d6963f7d28e17f72" &&
+         m[1].key == "x/y/a" && m[1].size == 0 &&
+         m[1].etag == "d41d8cd98f00b204e9800998ecf8427e" &&
+         m[0].lastModified > 0;
+}
+
+//------------------------------------------------------------------------------
+// prefixes are synced as directories: sibling prefixes sharing the same
+// leading characters are neither listed nor deleted
+bool SiblingPrefixTest() {
+  MockS3Server server;
+  const string bucket = "sync-test";
+  server.CreateBucket(bucket);
+  S3Api s3("access", "secret", server.Endpoint());
+  s3.PutObject(bucket, "backup2/x", vector<char>(1, 'x'));
+  s3.PutObject(bucket, "src2/y", vector<char>(1, 'y'));
+  s3.PutObject(bucket, "src/z", vector<char>(1, 'z'));
+  const auto dir = filesystem::temp_directory_path() / "sss-sync-sibling";
+  filesystem::remove_all(dir);
+  filesystem::create_directories(dir);
+  ofstream(dir / "a") << "abc";
+  SyncConfig cfg;
+  cfg.deleteExtraneous = true;
+  const SyncResult d = SyncDirectory(s3, dir.string(), bucket, "backup", cfg);
+  filesystem::remove_all(dir);
+  const SyncResult p = SyncPrefix(s3, bucket, "src", bucket, "copy", cfg);
+  return d.transferred == 1 && d.plan.deletes.empty() &&
+         s3.GetObjectSize(bucket, "backup/a") == 3 &&
+         s3.GetObjectSize(bucket, "backup2/x") == 1 && p.transferred == 1 &&
+         s3.GetObjectSize(bucket, "copy/z") == 1 &&
+         s3.GetObjectSize(bucket, "copy/y") < 0 &&
+         s3.GetObjectSize(bucket, "copy2/y") < 0;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "Sync,"
+       << "Diff manifests," << DiffTest() << ',' << endl;
+  cout << "Sync,"
+       << "Local manifest," << LocalManifestTest() << ',' << endl;
+  cout << "Sync,"
+       << "Sibling prefixes," << SiblingPrefixTest() << ',' << endl;
+  return 0;
+}
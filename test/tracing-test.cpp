@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "mock_s3_server.h"
+#include "s3-client.h"
+#include "tracing.h"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace sss;
+
+namespace {
+//------------------------------------------------------------------------------
+string TempFile() {
+  char path[] = "/tmp/tracing-test-XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd >= 0)
+    close(fd);
+  return path;
+}
+
+//------------------------------------------------------------------------------
+vector<string> ReadLines(const string &path) {
+  ifstream is(path);
+  vector<string> lines;
+  for (string line; getline(is, line);)
+    lines.push_back(line);
+  return lines;
+}
+
+//------------------------------------------------------------------------------
+size_t Count(const vector<string> &lines, const string &text) {
+  size_t n = 0;
+  for (const auto &l : lines)
+    n += l.find(text) != string::npos;
+  return n;
+}
+} // namespace
+
+//------------------------------------------------------------------------------
+bool NestingTest() {
+  const string path = TempFile();
+  {
+    Tracer tracer(path);
+    Span root("Root", &tracer);
+    root.Set("key", "a\"b");
+    {
+      Span child("Child");
+      child.Set("attempt", child.Attempt());
+    }
+    {
+      Span child("Child");
+      child.Set("attempt", child.Attempt());
+    }
+    thread([&root] {
+      Span worker("Worker", &root);
+      Span nested("Nested");
+      worker.Set("size", size_t(10));
+    }).join();
+    try {
+      Span failed("Failed");
+      throw runtime_error("error");
+    } catch (const exception &) {
+    }
+  }
+  Span inactive("Inactive");
+  inactive.Set("ignored", 1);
+  const auto lines = ReadLines(path);
+  remove(path.c_str());
+  return lines.size() == 6 && !inactive.Active() &&
+         Count(lines, "\"parent\":1,") == 4 &&
+         Count(lines, "\"attempt\":1") == 1 &&
+         Count(lines, "\"name\":\"Nested\",\"id\":5,\"parent\":4") == 1 &&
+         Count(lines, "\"error\":true") == 1 &&
+         Count(lines, "\"key\":\"a\\\"b\"") == 1 &&
+         lines.back().find("\"name\":\"Root\"") != string::npos;
+}
+
+//------------------------------------------------------------------------------
+// span ended before a nested span is not restored as current when the
+// nested span ends; non-finite values are written as null
+bool EarlyEndTest() {
+  const string path = TempFile();
+  bool ok = true;
+  {
+    Tracer tracer(path);
+    Span root("Root", &tracer);
+    {
+      auto outer = make_unique<Span>("Outer");
+      Span inner("Inner");
+      inner.Set("ratio", numeric_limits<double>::quiet_NaN());
+      inner.Set("rate", numeric_limits<double>::infinity());
+      outer.reset();
+      ok = Span::Current() == &inner;
+    }
+    ok = ok && Span::Current() == &root;
+  }
+  const auto lines = ReadLines(path);
+  remove(path.c_str());
+  return ok && lines.size() == 3 && Span::Current() == nullptr &&
+         Count(lines, "\"ratio\":null,\"rate\":null") == 1;
+}
+
+//------------------------------------------------------------------------------
+bool ChromeTraceTest() {
+  const string path = TempFile() + ".json";
+  {
+    Tracer tracer(path, Tracer::FormatFromFileName(path));
+    Span root("Root", &tracer);
+    Span child("Child");
+  }
+  const auto lines = ReadLines(path);
+  remove(path.substr(0, path.size() - 5).c_str());
+  remove(path.c_str());
+  return lines.size() == 4 && lines.front() == "[" && lines.back() == "]" &&
+         Count(lines, "\"ph\":\"X\"") == 2 && lines[1].back() == ',';
+}
+
+//------------------------------------------------------------------------------
+// Upload -> CreateMultipartUpload, Part[n] -> UploadPart[attempt],
+// CompleteMultipartUpload
+bool UploadTraceTest() {
+  MockS3Server server({.errorRate = 0.3, .dataFaultsOnly = true, .seed = 3});
+  server.CreateBucket("bucket");
+  vector<char> data(size_t(24) << 20);
+  const string path = TempFile();
+  S3DataTransferConfig cfg;
+  cfg.accessKey = "access";
+  cfg.secretKey = "secret";
+  cfg.endpoints = {server.Endpoint()};
+  cfg.bucket = "bucket";
+  cfg.key = "key";
+  cfg.data = data.data();
+  cfg.size = data.size();
+  cfg.jobs = 4;
+  cfg.maxRetries = 20;
+  cfg.registry = nullptr;
+  cfg.tracer = make_shared<Tracer>(path);
+  Upload(cfg);
+  cfg.tracer.reset();
+  const auto lines = ReadLines(path);
+  remove(path.c_str());
+  const size_t uploadParts = Count(lines, "\"name\":\"UploadPart\"");
+  return Count(lines, "\"name\":\"Upload\"") == 1 &&
+         Count(lines, "\"name\":\"Part\"") == 4 &&
+         Count(lines, "\"name\":\"CreateMultipartUpload\",") == 1 &&
+         Count(lines, "\"name\":\"CompleteMultipartUpload\",") == 1 &&
+         uploadParts == 4 + server.InjectedErrors() &&
+         Count(lines, "\"attempt\":1") > 0 &&
+         Count(lines, "\"endpoint\":\"" + server.Endpoint()) ==
+             uploadParts + 2;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "NestingTest,"
+       << "span nesting and JSON lines output," << NestingTest() << ','
+       << endl;
+  cout << "EarlyEndTest,"
+       << "span ended before nested spans," << EarlyEndTest() << ',' << endl;
+  cout << "ChromeTraceTest,"
+       << "Chrome trace event output," << ChromeTraceTest() << ',' << endl;
+  cout << "UploadTraceTest,"
+       << "spans of multipart upload with retries," << UploadTraceTest()
+       << ',' << endl;
+  return 0;
+}
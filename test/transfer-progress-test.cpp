@@ -0,0 +1,100 @@
+/*******************************************************************************
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020-2023, Ugo Varetto
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+#include "transfer_progress.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sss;
+
+//------------------------------------------------------------------------------
+bool AggregationTest() {
+  TransferProgress p;
+  const int PARTS = 8;
+  const int N = 1000;
+  p.Start(uint64_t(PARTS) * N * 10, PARTS);
+  vector<thread> threads;
+  for (int t = 0; t != PARTS; ++t) {
+    threads.emplace_back([&p, t] {
+      p.PartBegin(t);
+      // failed first attempt, bytes discarded
+      p.RequestBegin(t);
+      p.Add(t, 100);
+      p.Add(t, -100);
+      p.RequestBegin(t);
+      for (int i = 0; i != N; ++i)
+        p.Add(t, 10);
+      p.PartEnd(t, true);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  const ProgressInfo i = p.Snapshot();
+  return i.bytes == i.totalBytes && i.Fraction() == 1. &&
+         i.partsDone == PARTS && i.partsInFlight == 0 && i.retries == PARTS &&
+         i.partBytes.size() == PARTS && i.partBytes[3] == N * 10 &&
+         i.averageThroughput > 0;
+}
+
+//------------------------------------------------------------------------------
+bool ReportTest() {
+  vector<ProgressInfo> reports;
+  TransferProgress p([&](const ProgressInfo &i) { reports.push_back(i); },
+                     chrono::milliseconds(20));
+  p.Start(1000, 1);
+  p.PartBegin(0);
+  // reported at most once per interval
+  for (int i = 0; i != 5; ++i) {
+    p.Add(0, 100);
+    this_thread::sleep_for(chrono::milliseconds(15));
+  }
+  p.PartEnd(0, false);
+  p.Finish();
+  ostringstream os;
+  os << reports.back();
+  return reports.size() >= 2 && reports.size() <= 4 &&
+         reports.back().finished && reports.back().bytes == 500 &&
+         reports.back().partsDone == 0 && !reports.front().finished &&
+         os.str().find("50.0%") == 0;
+}
+
+//------------------------------------------------------------------------------
+int main(int, char **) {
+  cout << "TransferProgress,"
+       << "Aggregation," << AggregationTest() << ',' << endl;
+  cout << "TransferProgress,"
+       << "Reports," << ReportTest() << ',' << endl;
+  return 0;
+}
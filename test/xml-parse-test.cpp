@@ -31,6 +31,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  *******************************************************************************/
 #include "response_parser.h"
+#include "utility.h"
 #include "xml_path.h"
 #include <algorithm>
 #include <cassert>
@@ -43,10 +44,21 @@ namespace sss {
 namespace api {
 std::string GenerateAclXML(const AccessControlPolicy &);
 using TagMap = std::unordered_map<std::string, std::string>;
-std::pair<S3Api::SendParams, std::string>
-GeneratePutBucketTaggingRequest(const std::string &bucket, const TagMap &tags,
-                                const Headers &headers);
-TagMap ParseTaggingResponse(const std::string &xml);
+S3Api::SendParams GeneratePutBucketTaggingRequest(const std::string &bucket,
+                                                  const TagMap &tags,
+                                                  const Headers &headers);
+TagMap ParseTaggingResponse(std::string_view xml);
+S3Api::ListObjectV2Result ParseObjects(std::string_view xml);
+void ParseObjects(std::string_view xml, S3Api::ListObjectV2Result &res);
+std::vector<BucketInfo> ParseBuckets(std::string_view xml);
+AccessControlPolicy ParseACL(std::string_view xml);
+std::pair<std::vector<std::string>, std::vector<std::string>>
+ParseListObjectVersions(std::string_view xml);
+S3Api::SendParams
+GenerateDeleteObjectsRequest(const std::string &bucket,
+                             const std::vector<ObjectIdentifier> &objects,
+                             bool quiet, const Headers &headers);
+DeleteObjectsResult ParseDeleteObjectsResult(std::string_view xml);
 } // namespace api
 } // namespace sss
 using namespace sss;
@@ -181,9 +193,173 @@ static const char *TAGGING =
 void TaggingXMLTest() {
   api::TagMap tags = {{"key1", "value1"}, {"key2", "value2"}};
   auto r = api::GeneratePutBucketTaggingRequest("MyBucket", tags, {});
-  auto m = api::ParseTaggingResponse(r.second);
+  auto m = api::ParseTaggingResponse(get<string>(r.uploadData));
   assert(m["key1"] == "value1" && m["key2"] == "value2");
 }
+static const char *LIST_OBJECTS_V2 = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<ListBucketResult xmlns="http://s3.amazonaws.com/doc/2006-03-01/">
+  <Name>bucket</Name>
+  <Prefix>logs/</Prefix>
+  <KeyCount>3</KeyCount>
+  <MaxKeys>3</MaxKeys>
+  <Delimiter>/</Delimiter>
+  <IsTruncated>true</IsTruncated>
+  <NextContinuationToken>1ueGcxLPRx1Tr/XYExHnhbYLgveDs2J/wm36Hy4vbOwM=</NextContinuationToken>
+  <Contents>
+    <Key>logs/Key1</Key>
+    <LastModified>2023-03-01T08:47:15.843Z</LastModified>
+    <ETag>"599bab3ed2c697f1d26842727561fd94"</ETag>
+    <Size>142863</Size>
+    <StorageClass>STANDARD</StorageClass>
+  </Contents>
+  <CommonPrefixes>
+    <Prefix>logs/2023/</Prefix>
+  </CommonPrefixes>
+  <CommonPrefixes>
+    <Prefix>logs/2024/</Prefix>
+  </CommonPrefixes>
+</ListBucketResult>
+)";
+void ParseObjectsTest() {
+  auto r = api::ParseObjects(LIST_OBJECTS_V2);
+  assert(r.truncated && r.keyCount == 3);
+  assert(r.nextContinuationToken ==
+         "1ueGcxLPRx1Tr/XYExHnhbYLgveDs2J/wm36Hy4vbOwM=");
+  assert(r.keys.size() == 1 && r.keys[0].key == "logs/Key1" &&
+         r.keys[0].size == 142863);
+  assert(r.commonPrefixes.size() == 2 &&
+         r.commonPrefixes[1] == "logs/2024/");
+  // parse next page into same instance
+  const string page2 = R"(<ListBucketResult><IsTruncated>false</IsTruncated>
+    <Contents><Key>a&amp;b&#x20;&lt;c&gt;</Key><Size/>
+    <Owner><ID>id1</ID><DisplayName><![CDATA[one & two]]></DisplayName></Owner>
+    </Contents><!-- comment --><Contents><Key>k2</Key></Contents>
+    </ListBucketResult>)";
+  api::ParseObjects(page2, r);
+  assert(!r.truncated && r.nextContinuationToken.empty());
+  assert(r.keys.size() == 2 && r.commonPrefixes.empty());
+  assert(r.keys[0].key == "a&b <c>" && r.keys[0].size == 0 &&
+         r.keys[0].ownerID == "id1" && r.keys[0].ownerDisplayName == "one & two");
+  assert(r.keys[1].key == "k2" && r.keys[1].ownerID.empty());
+}
+
+void ExtractRecordsTest() {
+  const char *xml = R"(
+  <ListVersionsResult>
+    <Version><Key>k1</Key><VersionId>v1</VersionId></Version>
+    <DeleteMarker><Key>k1</Key><VersionId>d1</VersionId></DeleteMarker>
+    <Version>
+      <Key>k2</Key>
+      <Owner><ID>o2</ID></Owner>
+      <VersionId>v2</VersionId>
+    </Version>
+    <Version><Key>k3</Key><VersionId></VersionId></Version>
+  </ListVersionsResult>
+  )";
+  // optional field missing from first record does not shift values
+  const auto c = ExtractRecords(xml, "/listversionsresult/version");
+  assert(c.size == 3);
+  assert(c.Get(0, "/owner/id").empty() && c.Get(1, "/owner/id") == "o2");
+  assert(c.Get(2, "/key") == "k3" && c.Count(2, c.Field("/versionid")) == 1);
+  const auto v = api::ParseListObjectVersions(xml);
+  assert(v.first == vector<string>({"v1", "v2"}));
+  assert(v.second == vector<string>({"d1"}));
+  const auto b = api::ParseBuckets(listBuckets);
+  assert(b.size() == 3 && b[2].name == "mybucket");
+  const auto acl = api::ParseACL(R"(
+  <AccessControlPolicy>
+    <Owner><ID>owner</ID></Owner>
+    <AccessControlList>
+      <Grant>
+        <Grantee xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance"
+                 xsi:type="Group"><URI>http://acs/AllUsers</URI></Grantee>
+        <Permission>READ</Permission>
+      </Grant>
+      <Grant>
+        <Grantee xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance"
+                 xsi:type="CanonicalUser"><ID>owner</ID></Grantee>
+        <Permission>FULL_CONTROL</Permission>
+      </Grant>
+    </AccessControlList>
+  </AccessControlPolicy>)");
+  assert(acl.ownerID == "owner" && acl.grants.size() == 2);
+  assert(acl.grants[0].grantee.xsiType == "Group" &&
+         acl.grants[0].grantee.id.empty() &&
+         acl.grants[0].grantee.uri == "http://acs/AllUsers");
+  assert(acl.grants[1].grantee.id == "owner" &&
+         acl.grants[1].permission == "FULL_CONTROL");
+}
+
+void DeleteObjectsXMLTest() {
+  const auto r = api::GenerateDeleteObjectsRequest(
+      "bucket", {{"a&<b>", ""}, {"c", "v1"}}, true, {});
+  const string body = get<string>(r.uploadData);
+  assert(r.method == "POST" && r.params.count("delete"));
+  assert(ContentMD5("") == "1B2M2Y8AsgTpgAmY7PhCfg==");
+  assert(ContentMD5("abc") == "kAFQmDzST7DWlj99KOF/cg==");
+  assert(r.headers.at("content-md5") == ContentMD5(body));
+  // round trip through the parser
+  const auto c = ExtractRecords(body, "/delete/object");
+  assert(c.size == 2 && c.Get(0, "/key") == "a&<b>" &&
+         c.Get(0, "/versionid").empty() && c.Get(1, "/versionid") == "v1");
+  assert(ParseXMLPath(body, "/delete/quiet") == "true");
+  const auto d = api::ParseDeleteObjectsResult(R"(
+  <DeleteResult>
+    <Deleted><Key>c</Key><VersionId>v1</VersionId></Deleted>
+    <Error><Key>a&amp;&lt;b&gt;</Key><Code>AccessDenied</Code>
+    <Message>Access Denied</Message></Error>
+  </DeleteResult>)");
+  assert(d.deleted.size() == 1 && d.deleted[0].versionId == "v1");
+  assert(d.errors.size() == 1 && d.errors[0].key == "a&<b>" &&
+         d.errors[0].code == "AccessDenied");
+}
+
+static const char *RESPONSE_HEADERS = "HTTP/1.1 100 Continue\r\n"
+                                     "\r\n"
+                                     "HTTP/1.1 200 OK\r\n"
+                                     "Date: Fri, 21 Apr 2023 08:47:15 GMT\r\n"
+                                     "ETag: \"fba9dede5f27731c\"\r\n"
+                                     "x-amz-meta-author:  user 1 \r\n"
+                                     "Content-Length: 8388608\r\n"
+                                     "\r\n";
+void HTTPHeadersTest() {
+  assert(HTTPHeader(RESPONSE_HEADERS, "etag") == "\"fba9dede5f27731c\"");
+  assert(HTTPHeader(RESPONSE_HEADERS, "Missing").empty());
+  const Headers h = HTTPHeaders(RESPONSE_HEADERS);
+  assert(h.size() == 4 && h.at("Date") == "Fri, 21 Apr 2023 08:47:15 GMT" &&
+         h.at("Content-Length") == "8388608");
+  const MetaDataMap m = MetaDataHeaders(RESPONSE_HEADERS);
+  assert(m.size() == 1 && m.at("author") == "user 1");
+  // headers of interim responses are discarded
+  assert(HTTPHeader("HTTP/1.1 301 Moved\r\nETag: a\r\n\r\n"
+                    "HTTP/1.1 200 OK\r\n\r\n",
+                    "ETag")
+             .empty());
+}
+
+void HTTPHeaderMapTest() {
+  const string text(RESPONSE_HEADERS);
+  vector<char> buffer;
+  HTTPHeaderMap headers(&buffer);
+  // feed one line at a time as libcurl does
+  size_t b = 0;
+  while (b != text.size()) {
+    const size_t e = text.find('\n', b) + 1;
+    buffer.insert(end(buffer), begin(text) + b, begin(text) + e);
+    headers.ParseLine(b, e);
+    b = e;
+  }
+  assert(headers.Size() == 4 && headers.Name(1) == "ETag");
+  assert(headers.Get("ETAG") == "\"fba9dede5f27731c\"");
+  assert(headers.Get("content-length") == "8388608");
+  assert(headers.Has("date") && !headers.Has("Content-Type"));
+  assert(headers.MetaData().at("author") == "user 1");
+  assert(headers.ToHeaders() == HTTPHeaders(text));
+  HTTPHeaderMap copy(headers, &buffer);
+  copy.Parse();
+  assert(copy.Size() == 4 && copy.Get("date") == headers.Get("date"));
+}
 
 int main(int, char **) {
   ParseXMLTagTest();
@@ -198,6 +374,16 @@ int main(int, char **) {
   cout << "GenerateAclXMLTest: Pass" << endl;
   TaggingXMLTest();
   cout << "TaggingXMLTest: Pass" << endl;
+  ParseObjectsTest();
+  cout << "ParseObjectsTest: Pass" << endl;
+  ExtractRecordsTest();
+  cout << "ExtractRecordsTest: Pass" << endl;
+  DeleteObjectsXMLTest();
+  cout << "DeleteObjectsXMLTest: Pass" << endl;
+  HTTPHeadersTest();
+  cout << "HTTPHeadersTest: Pass" << endl;
+  HTTPHeaderMapTest();
+  cout << "HTTPHeaderMapTest: Pass" << endl;
   // ParseRecordList();
   // PrintDOMToDict();
   return 0;